@@ -6,12 +6,21 @@
 #include "LicensingApiException.hpp"
 #include "ActivationCodeCredentialsModel.hpp"
 #include "Helpers.hpp"
+#include "LicenseStorage.hpp"
+#include "ActivationSnapshot.hpp"
+#include "LicensingCall.hpp"
+#include "RequestCoalescer.hpp"
+#include "ShutdownDrain.hpp"
+#include <algorithm>
 #include <optional>
 #include <iostream>
 #include <functional>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <fstream>
+#include <future>
+#include <mutex>
 
 #ifdef __APPLE__
 #include <termios.h>
@@ -47,6 +56,140 @@ namespace ActivationActions
 		return oss.str();
 	}
 
+	// Snapshots published by main after every change, empty when nobody registered them
+	inline std::weak_ptr<ActivationSnapshots>& PublishedSnapshots()
+	{
+		static std::weak_ptr<ActivationSnapshots> snapshots;
+		return snapshots;
+	}
+
+	// Activation lock main holds while an action runs. Actions release it while they wait for console input, so a
+	// prompt does not hold up the lease refreshes of the background thread or the shutdown drain.
+	class ActionLock
+	{
+	public:
+		explicit ActionLock(std::timed_mutex& mutex)
+			: lock_(mutex)
+		{
+			Current() = this;
+		}
+
+		~ActionLock()
+		{
+			Current() = nullptr;
+		}
+
+		ActionLock(const ActionLock&) = delete;
+		ActionLock& operator=(const ActionLock&) = delete;
+
+		// Scope in which an action reads console input, nothing read from the activation may be held across it
+		class Released
+		{
+		public:
+			Released()
+				: held_(Current())
+			{
+				if (held_)
+				{
+					held_->lock_.unlock();
+				}
+			}
+
+			~Released()
+			{
+				if (held_)
+				{
+					held_->lock_.lock();
+				}
+			}
+
+			Released(const Released&) = delete;
+			Released& operator=(const Released&) = delete;
+
+		private:
+			ActionLock* held_;
+		};
+
+	private:
+		static ActionLock*& Current()
+		{
+			static thread_local ActionLock* current = nullptr;
+			return current;
+		}
+
+		std::unique_lock<std::timed_mutex> lock_;
+	};
+
+	// Single-flight for lease refreshes and remote state pulls, empty when main did not register one
+	inline std::weak_ptr<RequestCoalescer>& Coalescer()
+	{
+		static std::weak_ptr<RequestCoalescer> coalescer;
+		return coalescer;
+	}
+
+	// Tells the user that an explicit request was answered from what another console fetched moments ago
+	void ReportServedByOtherProcess(std::uint64_t servedBefore, std::uint64_t servedAfter, const std::string& what)
+	{
+		if (servedAfter != servedBefore)
+		{
+			DisplayHelper::WriteWarning("Another console " + what + " for this seat within Coalescing.CrossProcessWindowSeconds, "
+				"its result was loaded from the storage instead of calling the server.");
+		}
+	}
+
+	bool RefreshLeaseCoalesced(Activation& activation)
+	{
+		auto coalescer = Coalescer().lock();
+		if (coalescer && coalescer->isFor(activation))
+		{
+			auto served = coalescer->refreshCounters().servedByOtherProcess;
+			auto refreshed = LicensingCall::Await(LicensingCall::Operations::RefreshLease, coalescer->refreshLease());
+			ReportServedByOtherProcess(served, coalescer->refreshCounters().servedByOtherProcess, "refreshed the lease");
+			return refreshed;
+		}
+		return LicensingCall::Call(LicensingCall::Operations::RefreshLease, [&]() { return activation.refreshLease(); });
+	}
+
+	ActivationStateModel PullRemoteStateCoalesced(Activation& activation)
+	{
+		auto coalescer = Coalescer().lock();
+		if (coalescer && coalescer->isFor(activation))
+		{
+			auto served = coalescer->pullCounters().servedByOtherProcess;
+			auto state = LicensingCall::Await(LicensingCall::Operations::PullRemoteState, coalescer->pullRemoteState());
+			ReportServedByOtherProcess(served, coalescer->pullCounters().servedByOtherProcess, "pulled the remote state");
+			return state;
+		}
+		return LicensingCall::Run(LicensingCall::Operations::PullRemoteState, [&activation]() { return activation.pullRemoteState(); });
+	}
+
+	// Typed feature set handle, cached in the published snapshot so it is not cast again on every action
+	std::shared_ptr<ActiveFeatureSet> ActiveFeatures(Activation& activation)
+	{
+		auto snapshots = PublishedSnapshots().lock();
+		if (snapshots && snapshots->isFor(activation))
+		{
+			return snapshots->current()->activeFeatures;
+		}
+		return std::dynamic_pointer_cast<ActiveFeatureSet>(activation.features());
+	}
+
+	// Feature set to use once a prompt released the action lock. The activation may have been refreshed, deactivated or
+	// changed meanwhile, so the set is fetched again and null is returned when the selected feature is no longer eligible.
+	std::shared_ptr<ActiveFeatureSet> ActiveFeaturesAfterInput(Activation& activation, const std::string& featureKey,
+		const std::function<bool(const ActivationFeature&)>& eligible)
+	{
+		auto activeFeatureSet = ActiveFeatures(activation);
+		if (!activeFeatureSet)
+		{
+			return nullptr;
+		}
+		auto features = activeFeatureSet->getFeaturesAsVector();
+		bool found = std::any_of(features.begin(), features.end(),
+			[&](const ActivationFeature& feature) { return feature.key == featureKey && eligible(feature); });
+		return found ? activeFeatureSet : nullptr;
+	}
+
 	// Generic helper function to handle exceptions with a custom error message
 	void ExecuteWithErrorHandling(const std::string& errorContext, const std::function<void()>& action)
 	{
@@ -57,26 +200,88 @@ namespace ActivationActions
 		catch (LicensingApiException& ex)
 		{
 			ApiError error = ex.getApiError();
+			FlightRecorder::ApiError(errorContext + ": " + error.toString());
 			DisplayHelper::WriteError(errorContext + ": " + error.toString());
 		}
 		catch (const SDKException& ex)
 		{
+			FlightRecorder::Error(errorContext + ": " + std::string(ex.what()));
+			DisplayHelper::WriteError(errorContext + ": " + std::string(ex.what()));
+		}
+		catch (const LicensingCall::DeadlineExceeded& ex)
+		{
+			FlightRecorder::Error(errorContext + ": " + std::string(ex.what()));
 			DisplayHelper::WriteError(errorContext + ": " + std::string(ex.what()));
 		}
 		catch (const std::exception& ex)
 		{
+			FlightRecorder::Error("Unexpected error in " + errorContext + ": " + std::string(ex.what()));
 			DisplayHelper::WriteError("Unexpected error in " + errorContext + ": " + std::string(ex.what()));
 		}
 	}
 
-	void Initialize(Activation& activation)
+	// Waits for an initialization that is already running, see Initialize and the offline-first startup in main.
+	// Returns false when it missed its deadline and keeps running in the background.
+	bool AwaitInitialization(const std::shared_future<void>& initializing)
 	{
+		bool finished = true;
 		ExecuteWithErrorHandling("Initialization failed", [&]()
 			{
-				auto initializeFuture = activation.initialize();
-				initializeFuture.get();
+				try
+				{
+					LicensingCall::Await(LicensingCall::Operations::Initialize, initializing);
+				}
+				catch (const LicensingCall::DeadlineExceeded& ex)
+				{
+					DisplayHelper::WriteWarning(std::string(ex.what()) + ". Continuing with the persisted activation state.");
+					finished = false;
+					return;
+				}
 				DisplayHelper::WriteSuccess("Initialization successful.");
 			});
+		return finished;
+	}
+
+	// Returns the initialization when it missed its deadline and keeps running on the activation
+	std::optional<std::shared_future<void>> Initialize(Activation& activation)
+	{
+		std::optional<std::shared_future<void>> running;
+		ExecuteWithErrorHandling("Initialization failed", [&]()
+			{
+				LicensingCall::Admit(LicensingCall::Operations::Initialize);
+				auto initializing = activation.initialize().share();
+				if (!AwaitInitialization(initializing))
+				{
+					running = initializing;
+				}
+			});
+		return running;
+	}
+
+	// Persisted activation of this seat whose lease is valid for at least minimumRemainingSeconds, read straight
+	// from the storage without initializing the activation. Null when there is none or it cannot be read.
+	std::shared_ptr<const ActivationSnapshot> LoadValidPersistedState(Persistence::Storage::IActivationStorage& storage,
+		const std::string& seatId, int minimumRemainingSeconds)
+	{
+		try
+		{
+			auto persisted = LicensingCall::Await(LicensingCall::Operations::PullPersistedState, storage.load());
+			auto info = persisted.isEmpty() ? std::nullopt : persisted.getActivationInfo();
+			if (!info || !info->leaseExpiry || (info->seatId && *info->seatId != seatId))
+			{
+				return nullptr;
+			}
+			if (std::difftime(*info->leaseExpiry, std::time(nullptr)) < minimumRemainingSeconds)
+			{
+				return nullptr;
+			}
+			return ActivationSnapshot::FromPersisted(*info);
+		}
+		catch (const std::exception& ex)
+		{
+			DisplayHelper::WriteWarning("Persisted state could not be read, initializing first: " + std::string(ex.what()));
+			return nullptr;
+		}
 	}
 
 	void ActivateWithCode(Activation& activation)
@@ -84,24 +289,26 @@ namespace ActivationActions
 		ExecuteWithErrorHandling("Activation failed", [&]()
 			{
 				std::string activationCode;
-				std::cout << "Enter activation code: ";
-				std::getline(std::cin, activationCode);
+				std::string seatName;
+				std::string editionId;
+				{
+					ActionLock::Released input;
+					std::cout << "Enter activation code: ";
+					std::getline(std::cin, activationCode);
+
+					std::cout << "Enter seat name (keep empty for no seat name): ";
+					std::getline(std::cin, seatName);
 
+					std::cout << "Enter edition ID (keep empty for default edition): ";
+					std::getline(std::cin, editionId);
+				}
 
 				std::shared_ptr<ActivationCodeCredentialsModel> credentials = std::make_shared<ActivationCodeCredentialsModel>(
 					activationCode
 				);
 
-				std::string seatName;
-				std::cout << "Enter seat name (keep empty for no seat name): ";
-				std::getline(std::cin, seatName);
-
-				std::string editionId;
-				std::cout << "Enter edition ID (keep empty for default edition): ";
-				std::getline(std::cin, editionId);
-
-				auto activationFuture = activation.activate(credentials, seatName, editionId);
-				auto activationInfo = activationFuture.get();
+				auto activationInfo = LicensingCall::Call(LicensingCall::Operations::Activate,
+					[&]() { return activation.activate(credentials, seatName, editionId); });
 
 				DisplayHelper::ShowActivationStateModelPanel(activation);
 
@@ -120,23 +327,26 @@ namespace ActivationActions
 				);
 
 				std::string activationCode;
-				std::cout << "Enter activation code: ";
-				std::getline(std::cin, activationCode);
-
 				std::string seatName;
-				std::cout << "Enter seat name (keep empty for no seat name): ";
-				std::getline(std::cin, seatName);
+				{
+					ActionLock::Released input;
+					std::cout << "Enter activation code: ";
+					std::getline(std::cin, activationCode);
 
-				std::cout << "Generating activation request token..." << std::endl;
+					std::cout << "Enter seat name (keep empty for no seat name): ";
+					std::getline(std::cin, seatName);
+				}
 
-				auto tokenFuture = activation.generateOfflineActivationRequestToken(
-					activationCode,
-					seatName,
-					std::string("")
-				);
-				auto token = tokenFuture.get();
+				Log::Information(Log::Categories::Console, "Generating activation request token...");
 
-				std::cout << "Activation request token (copy and use in the End User Portal):" << std::endl;
+				auto token = LicensingCall::Call(LicensingCall::Operations::GenerateOfflineRequest,
+					[&]() { return activation.generateOfflineActivationRequestToken(
+						activationCode,
+						seatName,
+						std::string("")
+					); });
+
+				std::cout << "Activation request token (copy and use in the End User Portal):" << '\n';
 				DisplayHelper::WriteSuccess(token);
 			});
 	}
@@ -145,19 +355,63 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Failed to pull remote state", [&]()
 			{
-				std::cout << "Pulling current activation state from the server..." << std::endl;
-				auto activationInfo = activation.pullRemoteState();
+				Log::Information(Log::Categories::Console, "Pulling current activation state from the server...");
+				try
+				{
+					PullRemoteStateCoalesced(activation);
+				}
+				catch (const LicensingCall::DeadlineExceeded& ex)
+				{
+					// The pull keeps running on the activation, show the state captured before it started
+					auto snapshots = PublishedSnapshots().lock();
+					if (!snapshots || !snapshots->isFor(activation))
+					{
+						throw;
+					}
+					DisplayHelper::WriteWarning(std::string(ex.what()) + ". Showing the cached state instead.");
+					DisplayHelper::ShowActivationStateModelPanel(*snapshots->current());
+					return;
+				}
 				DisplayHelper::ShowActivationStateModelPanel(activation);
 			});
 	}
 
+	// Writes the feature keys of the current activation for Tools/FeatureKeyGenerator (ZENTITLE_FEATURE_KEYS_JSON)
+	void ExportFeatureKeys(Activation& activation)
+	{
+		ExecuteWithErrorHandling("Failed to export feature keys", [&]()
+			{
+				Log::Information(Log::Categories::Console, "Pulling current activation state from the server...");
+				auto activationInfo = PullRemoteStateCoalesced(activation);
+
+				nlohmann::json features = nlohmann::json::array();
+				for (const auto& feature : activationInfo.features)
+				{
+					features.push_back({
+						{ "key", feature.key },
+						{ "type", ActivationFeature::featureTypeToString(feature.type) }
+					});
+				}
+
+				const std::string fileName = "features.json";
+				std::ofstream file(fileName, std::ios::trunc);
+				file << nlohmann::json{ { "features", features } }.dump(2) << '\n';
+				if (!file)
+				{
+					DisplayHelper::WriteError("Failed to write " + fileName);
+					return;
+				}
+
+				DisplayHelper::WriteSuccess("Exported " + std::to_string(features.size()) + " feature keys to " + fileName);
+			});
+	}
+
 	void PullPersistedState(Activation& activation)
 	{
 		ExecuteWithErrorHandling("Failed to pull persistent data", [&]()
 			{
-				std::cout << "Pulling current activation state from the local storage..." << std::endl;
-				auto persistenceDataFuture = activation.pullPersistedState();
-				auto persistenceData = persistenceDataFuture.get();
+				Log::Information(Log::Categories::Console, "Pulling current activation state from the local storage...");
+				auto persistenceData = LicensingCall::Call(LicensingCall::Operations::PullPersistedState, [&]() { return activation.pullPersistedState(); });
 
 				if (persistenceData.isEmpty())
 				{
@@ -173,7 +427,7 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Refreshing lease failed", [&]()
 			{
-				std::cout << "Refreshing current activation..." << std::endl;
+				Log::Information(Log::Categories::Console, "Refreshing current activation...");
 				auto previousLeaseExpiryOpt = activation.getActivationInfo().leaseExpiry;
 
 				if (!previousLeaseExpiryOpt.has_value())
@@ -182,8 +436,18 @@ namespace ActivationActions
 				}
 				auto previousLeaseExpiry = previousLeaseExpiryOpt.value();
 
-				auto leaseFuture = activation.refreshLease();
-				auto refreshed = leaseFuture.get();
+				bool refreshed = false;
+				try
+				{
+					refreshed = RefreshLeaseCoalesced(activation);
+				}
+				catch (const LicensingCall::DeadlineExceeded& ex)
+				{
+					// The lease that was valid before the call is still the best known state
+					DisplayHelper::WriteWarning(std::string(ex.what()) + ". Continuing with the cached lease, it expires "
+						+ FormatDateTime(previousLeaseExpiry) + ".");
+					return;
+				}
 
 				if (!activation.getActivationInfo().leaseExpiry.has_value())
 				{
@@ -195,14 +459,14 @@ namespace ActivationActions
 				if (!refreshed)
 				{
 					std::cout << "Activation lease period could not be refreshed, please activate again. Current lease expiry is "
-						<< FormatDateTime(currentLeaseExpiry) << std::endl;
+						<< FormatDateTime(currentLeaseExpiry) << '\n';
 				}
 				else
 				{
 					auto newLeaseExpiry = currentLeaseExpiry;
 					std::cout << "Activation lease successfully refreshed from ["
 						<< FormatDateTime(previousLeaseExpiry) << "] to ["
-						<< FormatDateTime(newLeaseExpiry) << "]" << std::endl;
+						<< FormatDateTime(newLeaseExpiry) << "]" << '\n';
 				}
 			});
 	}
@@ -212,36 +476,31 @@ namespace ActivationActions
 		ExecuteWithErrorHandling("Refreshing offline lease failed", [&]()
 			{
 				std::string refreshToken;
-				std::cout << "Enter offline refresh token: ";
+				{
+					ActionLock::Released input;
+					std::cout << "Enter offline refresh token: ";
 
 #ifdef __APPLE__
-				TerminalRawMode raw;
-				char ch;
-				while (std::cin.get(ch)) {
-					std::cout << ch << std::flush; // echo manually
-					if (ch == '\n') break;         // finish on Enter
-					refreshToken += ch;
-				}
+					TerminalRawMode raw;
+					char ch;
+					while (std::cin.get(ch)) {
+						std::cout << ch << std::flush; // echo manually
+						if (ch == '\n') break;         // finish on Enter
+						refreshToken += ch;
+					}
 #else
-				std::getline(std::cin, refreshToken);
+					std::getline(std::cin, refreshToken);
 #endif
+				}
 
-				auto persistedStateFuture = activation.pullPersistedState();
-				persistedStateFuture.wait();
-
-				auto persistedState = persistedStateFuture.get();
+				auto persistedState = LicensingCall::Call(LicensingCall::Operations::PullPersistedState, [&]() { return activation.pullPersistedState(); });
 
 				auto activationState = persistedState.getActivationInfo();
 				auto previousLeaseExpiryOpt = activationState->leaseExpiry;
 
-				auto leaseFuture = activation.refreshLeaseOffline(refreshToken);
-				leaseFuture.wait();
-				leaseFuture.get();
+				LicensingCall::Call(LicensingCall::Operations::RefreshLeaseOffline, [&]() { return activation.refreshLeaseOffline(refreshToken); });
 
-				persistedStateFuture = activation.pullPersistedState();
-				persistedStateFuture.wait();
-
-				persistedState = persistedStateFuture.get();
+				persistedState = LicensingCall::Call(LicensingCall::Operations::PullPersistedState, [&]() { return activation.pullPersistedState(); });
 				activationState = persistedState.getActivationInfo();
 				auto currentLeaseExpiryOpt = activationState->leaseExpiry;
 
@@ -249,11 +508,11 @@ namespace ActivationActions
 				{
 					std::cout << "Activation lease successfully refreshed from ["
 						<< FormatDateTime(previousLeaseExpiryOpt.value()) << "] to ["
-						<< FormatDateTime(currentLeaseExpiryOpt.value()) << "]" << std::endl;
+						<< FormatDateTime(currentLeaseExpiryOpt.value()) << "]" << '\n';
 				}
 				else
 				{
-					std::cout << "Lease expiry info missing. Please verify the activation state." << std::endl;
+					std::cout << "Lease expiry info missing. Please verify the activation state." << '\n';
 				}
 			});
 	}
@@ -262,11 +521,11 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Deactivation failed", [&]()
 			{
-				std::cout << "Deactivating the license..." << std::endl;
-				auto deactivateFuture = activation.deactivate();
-				ActivationOperationRes success = deactivateFuture.get();
+				Log::Information(Log::Categories::Console, "Deactivating the license...");
+				ActivationOperationRes success = LicensingCall::Call(LicensingCall::Operations::Deactivate, [&]() { return activation.deactivate(); });
 				if (success.IsSuccess())
 				{
+					LicenseStorage::Flush();
 					DisplayHelper::WriteSuccess("Deactivation successful.");
 				}
 				else
@@ -280,13 +539,13 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Offline deactivation failed", [&]()
 			{
-				std::cout << "Deactivating the offline license..." << std::endl;
-				auto deactivateFuture = activation.deactivateOffline();
-				auto offlineDeactivationToken = deactivateFuture.get();
+				Log::Information(Log::Categories::Console, "Deactivating the offline license...");
+				auto offlineDeactivationToken = LicensingCall::Call(LicensingCall::Operations::DeactivateOffline, [&]() { return activation.deactivateOffline(); });
 
 				if (!offlineDeactivationToken.empty())
 				{
-					std::cout << "Offline deactivation token (copy and use in the End User Portal):" << std::endl;
+					LicenseStorage::Flush();
+					std::cout << "Offline deactivation token (copy and use in the End User Portal):" << '\n';
 					DisplayHelper::WriteSuccess(offlineDeactivationToken);
 				}
 				else
@@ -300,9 +559,8 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Failed to retrieve activation entitlement", [&]()
 			{
-				std::cout << "Retrieving the entitlement..." << std::endl;
-				auto entitlementFuture = activation.getActivationEntitlement();
-				auto entitlement = entitlementFuture.get();
+				Log::Information(Log::Categories::Console, "Retrieving the entitlement...");
+				auto entitlement = LicensingCall::Call(LicensingCall::Operations::GetEntitlement, [&]() { return activation.getActivationEntitlement(); });
 
 				if (entitlement.isEmpty())
 				{
@@ -316,30 +574,37 @@ namespace ActivationActions
 
 	void ShowActivationInfo(Activation& activation)
 	{
-		auto persistedStateFuture = activation.pullPersistedState();
-		persistedStateFuture.wait();
-		auto persistedState = persistedStateFuture.get();
-		DisplayHelper::ShowActivationStateModelPanel(persistedState);
+		ExecuteWithErrorHandling("Failed to show activation info", [&]()
+			{
+				try
+				{
+					auto persistedState = LicensingCall::Call(LicensingCall::Operations::PullPersistedState, [&]() { return activation.pullPersistedState(); });
+					DisplayHelper::ShowActivationStateModelPanel(persistedState);
+				}
+				catch (const LicensingCall::DeadlineExceeded& ex)
+				{
+					auto snapshots = PublishedSnapshots().lock();
+					if (!snapshots || !snapshots->isFor(activation))
+					{
+						throw;
+					}
+					DisplayHelper::WriteWarning(std::string(ex.what()) + ". Showing the cached state instead.");
+					DisplayHelper::ShowActivationStateModelPanel(*snapshots->current());
+				}
+			});
 	}
 
 	void CheckoutFeature(Activation& activation)
 	{
 		ExecuteWithErrorHandling("Feature checkout failed", [&]()
 			{
-				std::shared_ptr<IFeatureSet> features = activation.features();
-				if (auto activeFeatureSet = std::dynamic_pointer_cast<ActiveFeatureSet>(features))
+				if (auto activeFeatureSet = ActiveFeatures(activation))
 				{
-					// Filter features that have availability > 0
-					auto featuresVector = activeFeatureSet->getFeaturesAsVector();
-					std::vector<ActivationFeature> availableFeatures;
-
-					for (const auto& feature : featuresVector)
-					{
-						if (feature.type != FeatureType::Bool)
-						{
-							availableFeatures.push_back(feature);
-						}
-					}
+					// Filter features that have availability > 0, in place instead of copying them
+					auto checkoutEligible = [](const ActivationFeature& feature) { return feature.type != FeatureType::Bool; };
+					auto availableFeatures = activeFeatureSet->getFeaturesAsVector();
+					availableFeatures.erase(std::remove_if(availableFeatures.begin(), availableFeatures.end(),
+						[&](const ActivationFeature& feature) { return !checkoutEligible(feature); }), availableFeatures.end());
 
 					if (availableFeatures.empty())
 					{
@@ -347,12 +612,15 @@ namespace ActivationActions
 						return;
 					}
 
-					std::cout << "Following features can be checked out:" << std::endl;
+					std::cout << "Following features can be checked out:" << '\n';
 					DisplayHelper::ShowFeaturesTable(availableFeatures);
 
 					std::string featureKey;
-					std::cout << "Select feature to checkout (or type 'None' to cancel): ";
-					std::getline(std::cin, featureKey);
+					{
+						ActionLock::Released input;
+						std::cout << "Select feature to checkout (or type 'None' to cancel): ";
+						std::getline(std::cin, featureKey);
+					}
 
 					if (featureKey == "None")
 					{
@@ -360,23 +628,33 @@ namespace ActivationActions
 					}
 
 					int amountToCheckout;
-					std::cout << "Specify amount to checkout: ";
 					std::string amountStr;
-					std::getline(std::cin, amountStr);
+					{
+						ActionLock::Released input;
+						std::cout << "Specify amount to checkout: ";
+						std::getline(std::cin, amountStr);
+					}
 					if (!InputHelper::TryParseInt(amountStr, amountToCheckout) || amountToCheckout <= 0)
 					{
 						DisplayHelper::WriteError("Invalid amount. Please enter a positive integer.");
 						return;
 					}
 
-					std::cout << "Checking out " << amountToCheckout << " "
-						<< (amountToCheckout > 1 ? "features" : "feature")
-						<< " with key '" << featureKey << "'" << std::endl;
+					activeFeatureSet = ActiveFeaturesAfterInput(activation, featureKey, checkoutEligible);
+					if (!activeFeatureSet)
+					{
+						DisplayHelper::WriteError("Feature '" + featureKey + "' is not eligible for checkout");
+						return;
+					}
+
+					Log::Information(Log::Categories::Console, "Checking out " + std::to_string(amountToCheckout) + " "
+						+ (amountToCheckout > 1 ? "features" : "feature")
+						+ " with key '" + featureKey + "'");
 
-					auto checkoutFuture = activeFeatureSet->checkoutFeature(featureKey, amountToCheckout);
-					checkoutFuture.get();
+					LicensingCall::Call(LicensingCall::Operations::CheckoutFeature, [&]() { return activeFeatureSet->checkoutFeature(featureKey, amountToCheckout); });
+					Checkouts().checkedOut(featureKey, amountToCheckout);
 
-					std::cout << "Feature successfully checked out!" << std::endl;
+					std::cout << "Feature successfully checked out!" << '\n';
 
 					// Get updated features and display them
 					auto updatedFeatures = activeFeatureSet->getFeaturesAsVector();
@@ -393,20 +671,13 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Feature return failed", [&]()
 			{
-				std::shared_ptr<IFeatureSet> features = activation.features();
-				if (auto activeFeatureSet = std::dynamic_pointer_cast<ActiveFeatureSet>(features))
+				if (auto activeFeatureSet = ActiveFeatures(activation))
 				{
-					// Filter features that are element pools and have active > 0
-					auto featuresVector = activeFeatureSet->getFeaturesAsVector();
-					std::vector<ActivationFeature> returnableFeatures;
-
-					for (const auto& feature : featuresVector)
-					{
-						if (feature.type == FeatureType::ElementPool)
-						{
-							returnableFeatures.push_back(feature);
-						}
-					}
+					// Filter features that are element pools and have active > 0, in place instead of copying them
+					auto returnEligible = [](const ActivationFeature& feature) { return feature.type == FeatureType::ElementPool; };
+					auto returnableFeatures = activeFeatureSet->getFeaturesAsVector();
+					returnableFeatures.erase(std::remove_if(returnableFeatures.begin(), returnableFeatures.end(),
+						[&](const ActivationFeature& feature) { return !returnEligible(feature); }), returnableFeatures.end());
 
 					if (returnableFeatures.empty())
 					{
@@ -414,12 +685,15 @@ namespace ActivationActions
 						return;
 					}
 
-					std::cout << "Following features can be returned:" << std::endl;
+					std::cout << "Following features can be returned:" << '\n';
 					DisplayHelper::ShowFeaturesTable(returnableFeatures);
 
 					std::string featureKey;
-					std::cout << "Select feature to return (or type 'None' to cancel): ";
-					std::getline(std::cin, featureKey);
+					{
+						ActionLock::Released input;
+						std::cout << "Select feature to return (or type 'None' to cancel): ";
+						std::getline(std::cin, featureKey);
+					}
 
 					if (featureKey == "None")
 					{
@@ -427,23 +701,33 @@ namespace ActivationActions
 					}
 
 					int amountToReturn;
-					std::cout << "Specify amount to return: ";
 					std::string amountStr;
-					std::getline(std::cin, amountStr);
+					{
+						ActionLock::Released input;
+						std::cout << "Specify amount to return: ";
+						std::getline(std::cin, amountStr);
+					}
 					if (!InputHelper::TryParseInt(amountStr, amountToReturn) || amountToReturn <= 0)
 					{
 						DisplayHelper::WriteError("Invalid amount. Please enter a positive integer.");
 						return;
 					}
 
-					std::cout << "Returning " << amountToReturn << " "
-						<< (amountToReturn > 1 ? "features" : "feature")
-						<< " with key '" << featureKey << "'" << std::endl;
+					activeFeatureSet = ActiveFeaturesAfterInput(activation, featureKey, returnEligible);
+					if (!activeFeatureSet)
+					{
+						DisplayHelper::WriteError("Feature '" + featureKey + "' is not eligible for return");
+						return;
+					}
+
+					Log::Information(Log::Categories::Console, "Returning " + std::to_string(amountToReturn) + " "
+						+ (amountToReturn > 1 ? "features" : "feature")
+						+ " with key '" + featureKey + "'");
 
-					auto returnFuture = activeFeatureSet->returnFeature(featureKey, amountToReturn);
-					returnFuture.get();
+					LicensingCall::Call(LicensingCall::Operations::ReturnFeature, [&]() { return activeFeatureSet->returnFeature(featureKey, amountToReturn); });
+					Checkouts().returned(featureKey, amountToReturn);
 
-					std::cout << "Feature successfully returned!" << std::endl;
+					std::cout << "Feature successfully returned!" << '\n';
 
 					// Get updated features and display them
 					auto updatedFeatures = activeFeatureSet->getFeaturesAsVector();
@@ -460,20 +744,13 @@ namespace ActivationActions
 	{
 		ExecuteWithErrorHandling("Feature usage tracking failed", [&]()
 			{
-				std::shared_ptr<IFeatureSet> features = activation.features();
-				if (auto activeFeatureSet = std::dynamic_pointer_cast<ActiveFeatureSet>(features))
+				if (auto activeFeatureSet = ActiveFeatures(activation))
 				{
-					// Filter for bool features only
-					auto featuresVector = activeFeatureSet->getFeaturesAsVector();
-					std::vector<ActivationFeature> boolFeatures;
-
-					for (const auto& feature : featuresVector)
-					{
-						if (feature.type == FeatureType::Bool)
-						{
-							boolFeatures.push_back(feature);
-						}
-					}
+					// Filter for bool features only, in place instead of copying them
+					auto trackingEligible = [](const ActivationFeature& feature) { return feature.type == FeatureType::Bool; };
+					auto boolFeatures = activeFeatureSet->getFeaturesAsVector();
+					boolFeatures.erase(std::remove_if(boolFeatures.begin(), boolFeatures.end(),
+						[&](const ActivationFeature& feature) { return !trackingEligible(feature); }), boolFeatures.end());
 
 					if (boolFeatures.empty())
 					{
@@ -481,21 +758,30 @@ namespace ActivationActions
 						return;
 					}
 
-					std::cout << "Usage can be tracked on the following features:" << std::endl;
+					std::cout << "Usage can be tracked on the following features:" << '\n';
 					DisplayHelper::ShowFeaturesTable(boolFeatures);
 
 					std::string featureKey;
-					std::cout << "Select feature for tracking the usage (or type 'None' to cancel): ";
-					std::getline(std::cin, featureKey);
+					{
+						ActionLock::Released input;
+						std::cout << "Select feature for tracking the usage (or type 'None' to cancel): ";
+						std::getline(std::cin, featureKey);
+					}
 
 					if (featureKey == "None")
 					{
 						return;
 					}
 
-					auto trackUsageFuture = activeFeatureSet->trackUsage(featureKey);
-					trackUsageFuture.get();
-					std::cout << "Feature usage successfully tracked!" << std::endl;
+					activeFeatureSet = ActiveFeaturesAfterInput(activation, featureKey, trackingEligible);
+					if (!activeFeatureSet)
+					{
+						DisplayHelper::WriteError("Feature '" + featureKey + "' is not eligible for usage tracking");
+						return;
+					}
+
+					LicensingCall::Call(LicensingCall::Operations::TrackUsage, [&]() { return activeFeatureSet->trackUsage(featureKey); });
+					std::cout << "Feature usage successfully tracked!" << '\n';
 				}
 				else
 				{
@@ -509,30 +795,30 @@ namespace ActivationActions
 		ExecuteWithErrorHandling("Offline activation failed", [&]()
 			{
 				std::string offlineActivationResponseToken;
-
+				{
+					ActionLock::Released input;
 #ifdef __APPLE__
-				std::cout << "Enter offline activation response token (finish with Enter): ";
-
-				TerminalRawMode raw;
-				char ch;
-				while (std::cin.get(ch)) {
-					std::cout << ch << std::flush; // echo manually
-					if (ch == '\n') break;         // finish on Enter
-					offlineActivationResponseToken += ch;
-				}
+					std::cout << "Enter offline activation response token (finish with Enter): ";
+
+					TerminalRawMode raw;
+					char ch;
+					while (std::cin.get(ch)) {
+						std::cout << ch << std::flush; // echo manually
+						if (ch == '\n') break;         // finish on Enter
+						offlineActivationResponseToken += ch;
+					}
 #else
-				std::cout << "Enter offline activation response token: ";
-				std::getline(std::cin, offlineActivationResponseToken);
+					std::cout << "Enter offline activation response token: ";
+					std::getline(std::cin, offlineActivationResponseToken);
 #endif
+				}
 
-				std::cout << "\nActivating offline..." << std::endl;
+				Log::Information(Log::Categories::Console, "Activating offline...");
 
-				auto offlineActivationFuture = activation.activateOffline(offlineActivationResponseToken);
-				auto activationInfo = offlineActivationFuture.get();
+				auto activationInfo = LicensingCall::Call(LicensingCall::Operations::ActivateOffline,
+					[&]() { return activation.activateOffline(offlineActivationResponseToken); });
 
-				auto persistedStateFuture = activation.pullPersistedState();
-				persistedStateFuture.wait();
-				auto persistedState = persistedStateFuture.get();
+				auto persistedState = LicensingCall::Call(LicensingCall::Operations::PullPersistedState, [&]() { return activation.pullPersistedState(); });
 				DisplayHelper::ShowActivationStateModelPanel(persistedState);
 				DisplayHelper::WriteSuccess("Offline activation successful.");
 			});
@@ -559,7 +845,8 @@ namespace ActivationActions
 				[](Activation& activation, const std::string& host) { RefreshLeaseOffline(activation); },
 				[](Activation& activation, const std::string& host) { Deactivate(activation); },
 				[](Activation& activation, const std::string& host) { DeactivateOffline(activation); },
-				[](Activation& activation, const std::string& host) { GetActivationEntitlement(activation); }
+				[](Activation& activation, const std::string& host) { GetActivationEntitlement(activation); },
+				[](Activation& activation, const std::string& host) { ExportFeatureKeys(activation); }
 			},
 			{
 				"Show activation info",
@@ -572,7 +859,8 @@ namespace ActivationActions
 				"Refresh offline activation lease (with refresh token from End User Portal)",
 				"Deactivate license",
 				"Deactivate offline license",
-				"Get entitlement associated with the activation"
+				"Get entitlement associated with the activation",
+				"Export feature keys (for the feature key generator)"
 			}
 		},
 		{
@@ -653,10 +941,10 @@ namespace ActivationActions
 			return;
 		}
 
-		std::cout << "Available actions for current state [" << activation.getStateAsString() << "]:" << std::endl;
+		std::cout << "Available actions for current state [" << activation.getStateAsString() << "]:" << '\n';
 		for (size_t i = 0; i < actionMapping->actionNames.size(); i++)
 		{
-			std::cout << i + 1 << ". " << actionMapping->actionNames[i] << std::endl;
+			std::cout << i + 1 << ". " << actionMapping->actionNames[i] << '\n';
 		}
 
 		std::cout << "Select action (1-" << actionMapping->actionNames.size() << "): ";
@@ -673,6 +961,7 @@ namespace ActivationActions
 		choice -= 1;
 		if (choice < actionMapping->actions.size())
 		{
+			LicensingCall::BudgetScope budget;
 			actionMapping->actions[choice](activation, host);
 		}
 		else
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifdef ZENTITLE_COROUTINES
+
+#include "Activation.hpp"
+#include "CoroutineExecutor.hpp"
+#include "LicensingCall.hpp"
+
+#include <memory>
+#include <string>
+
+// Awaitable versions of the SDK calls that return std::future, for code that runs many licensing operations
+// concurrently on a Coroutines::Executor instead of blocking one thread per pending call:
+//
+//   Coroutines::Executor executor(2);
+//   executor.spawn([](Coroutines::Executor& executor, Activation& activation) -> Coroutines::Task<>
+//   {
+//       bool refreshed = co_await RefreshLeaseAsync(executor, activation);
+//       ...
+//   }(executor, *activation));
+//   executor.waitIdle();
+//
+// SDK exceptions are rethrown from co_await, exactly as from future.get(). Requests to the Licensing API first wait
+// for the rate limiter of LicensingCall, suspended like on a future.
+namespace ActivationAwaitables
+{
+	// co_await Admission(executor, operation): suspends until the rate limiter lets the request go, the poller of
+	// the executor checks the ticket the same way it checks a future
+	class Admission : public Coroutines::Detail::PendingFuture
+	{
+	public:
+		Admission(Coroutines::Executor& executor, const std::string& operation)
+			: executor_(executor), ticket_(LicensingCall::Enqueue(operation))
+		{
+		}
+
+		bool ready() const override
+		{
+			return ticket_.tryAdmit();
+		}
+
+		bool await_ready() const
+		{
+			return ready();
+		}
+
+		void await_suspend(std::coroutine_handle<> awaiting)
+		{
+			handle = awaiting;
+			executor_.watch(this);
+		}
+
+		void await_resume() const
+		{
+		}
+
+	private:
+		Coroutines::Executor& executor_;
+		mutable RateLimiter::Ticket ticket_;
+	};
+
+	inline Coroutines::Task<void> InitializeAsync(Coroutines::Executor& executor, Activation& activation)
+	{
+		co_await Admission(executor, LicensingCall::Operations::Initialize);
+		co_await Coroutines::Await(executor, activation.initialize());
+	}
+
+	inline Coroutines::Task<ActivationStateModel> ActivateAsync(Coroutines::Executor& executor, Activation& activation,
+		std::shared_ptr<ICredentialsModel> credentials, std::string seatName, std::string editionId)
+	{
+		co_await Admission(executor, LicensingCall::Operations::Activate);
+		co_return co_await Coroutines::Await(executor, activation.activate(credentials, seatName, editionId));
+	}
+
+	inline Coroutines::Task<bool> RefreshLeaseAsync(Coroutines::Executor& executor, Activation& activation)
+	{
+		co_await Admission(executor, LicensingCall::Operations::RefreshLease);
+		co_return co_await Coroutines::Await(executor, activation.refreshLease());
+	}
+
+	inline Coroutines::Task<Persistence::PersistentData> PullPersistedStateAsync(Coroutines::Executor& executor, Activation& activation)
+	{
+		co_return co_await Coroutines::Await(executor, activation.pullPersistedState());
+	}
+
+	inline Coroutines::Task<ActivationOperationRes> DeactivateAsync(Coroutines::Executor& executor, Activation& activation)
+	{
+		co_await Admission(executor, LicensingCall::Operations::Deactivate);
+		co_return co_await Coroutines::Await(executor, activation.deactivate());
+	}
+
+	inline Coroutines::Task<void> CheckoutFeatureAsync(Coroutines::Executor& executor, ActiveFeatureSet& features, std::string key, int amount)
+	{
+		co_await Admission(executor, LicensingCall::Operations::CheckoutFeature);
+		co_await Coroutines::Await(executor, features.checkoutFeature(key, amount));
+	}
+
+	inline Coroutines::Task<void> ReturnFeatureAsync(Coroutines::Executor& executor, ActiveFeatureSet& features, std::string key, int amount)
+	{
+		co_await Admission(executor, LicensingCall::Operations::ReturnFeature);
+		co_await Coroutines::Await(executor, features.returnFeature(key, amount));
+	}
+
+	inline Coroutines::Task<void> TrackUsageAsync(Coroutines::Executor& executor, ActiveFeatureSet& features, std::string key)
+	{
+		co_await Admission(executor, LicensingCall::Operations::TrackUsage);
+		co_await Coroutines::Await(executor, features.trackUsage(key));
+	}
+}
+
+#endif
@@ -1,10 +1,14 @@
 #pragma once 
 
 #include "json.hpp"
+#include <cstdint>
 #include <fstream>
+#include <map>
 #include <string>
 #include <iostream>
 
+#include "LicensingOperations.hpp"
+
 namespace ActivationConsole
 {
 
@@ -18,8 +22,158 @@ namespace ActivationConsole
 		const std::string configUseCoreLibrary = "UseCoreLibrary";
 		const std::string configCoreLibPath = "CoreLibPath";
 		const std::string tenantRsaKeyModulus = "TenantRsaKeyModulus";
+		const std::string configStorage = "Storage";
+		const std::string configWriteBehindDebounceMs = "WriteBehindDebounceMs";
+		const std::string configStorageBackend = "Backend";
+		const std::string configJournalCompactionBytes = "JournalCompactionBytes";
+		const std::string configStorageCompression = "Compression";
+		const std::string configStorageScope = "Scope";
+		const std::string configSharedActivation = "SharedActivation";
+		const std::string configRefreshCheckIntervalSeconds = "RefreshCheckIntervalSeconds";
+		const std::string configRefreshBeforeExpirySeconds = "RefreshBeforeExpirySeconds";
+		const std::string configAgent = "Agent";
+		const std::string configAgentSocketPath = "SocketPath";
+		const std::string configAgentMaxClients = "MaxClients";
+		const std::string configAgentMaxPendingRequestsPerClient = "MaxPendingRequestsPerClient";
+		const std::string configAgentMaxPendingRequests = "MaxPendingRequests";
+		const std::string configDeadlines = "Deadlines";
+		const std::string configDefaultTimeoutMs = "DefaultTimeoutMs";
+		const std::string configOperationTimeoutsMs = "OperationTimeoutsMs";
+		const std::string configLatencyBudgetMs = "LatencyBudgetMs";
+		const std::string configStartup = "Startup";
+		const std::string configOfflineFirst = "OfflineFirst";
+		const std::string configMinimumLeaseRemainingSeconds = "MinimumLeaseRemainingSeconds";
+		const std::string configCoalescing = "Coalescing";
+		const std::string configLogging = "Logging";
+		const std::string configLogLevel = "LogLevel";
+		const std::string configLogFormat = "Format";
+		const std::string configLogFilePath = "FilePath";
+		const std::string configLogQueueCapacity = "QueueCapacity";
+		const std::string configShutdown = "Shutdown";
+		const std::string configSeatPool = "SeatPool";
+		const std::string configSeatPoolSize = "Size";
+		const std::string configSeatPoolActivationCode = "ActivationCode";
+		const std::string configSeatPoolSeatName = "SeatName";
+		const std::string configSeatPoolEditionId = "EditionId";
+		const std::string configReplenishIntervalMs = "ReplenishIntervalMs";
+		const std::string configDrainTimeoutMs = "DrainTimeoutMs";
+		const std::string configDeactivateOnExit = "DeactivateOnExit";
+		const std::string configCoalescingEnabled = "Enabled";
+		const std::string configCrossProcessWindowSeconds = "CrossProcessWindowSeconds";
+		const std::string configTracing = "Tracing";
+		const std::string configTracingEnabled = "Enabled";
+		const std::string configTraceFilePath = "FilePath";
+		const std::string configTraceBufferEvents = "BufferEvents";
+		const std::string configProvisioning = "Provisioning";
+		const std::string configProvisioningConcurrency = "Concurrency";
+		const std::string configRequestsPerSecond = "RequestsPerSecond";
+		const std::string configCheckpointFile = "CheckpointFile";
+		const std::string configRateLimits = "RateLimits";
+		const std::string configBurst = "Burst";
+		const std::string configOperationRequestsPerSecond = "OperationRequestsPerSecond";
 	}
 
+	enum class StorageBackend
+	{
+		Secure,   ///< Whole state rewritten to license.encrypted on every save
+		Journaled ///< Encrypted deltas appended to a journal, compacted into a snapshot
+	};
+
+	enum class StorageScope
+	{
+		User,   ///< Activation stored per user (USER_DATA)
+		Machine ///< One activation shared by every user and process on the host (PUBLIC_DATA)
+	};
+
+	struct StorageConfig
+	{
+		StorageScope Scope{ StorageScope::User };
+		StorageBackend Backend{ StorageBackend::Secure };
+		int WriteBehindDebounceMs{ 0 }; ///< Window in which saves are coalesced, 0 writes every save immediately
+		std::uint64_t JournalCompactionBytes{ 64 * 1024 }; ///< Journal size that triggers a background compaction
+		bool Compression{ false }; ///< Deflate the serialized state before encryption (journaled backend)
+	};
+
+	struct SharedActivationConfig
+	{
+		int RefreshCheckIntervalSeconds{ 30 };  ///< How often the refresh owner checks the lease and followers try to take over
+		int RefreshBeforeExpirySeconds{ 300 };  ///< Lease is refreshed once it expires within this window
+	};
+
+	struct AgentConfig
+	{
+		std::string SocketPath;                 ///< Empty places agent.sock in the activation storage folder
+		int MaxClients{ 256 };                  ///< Connections beyond this are closed right after accept
+		int MaxPendingRequestsPerClient{ 16 };  ///< Queued checkouts, returns and usage tracks of one client, more are answered Busy
+		int MaxPendingRequests{ 1024 };         ///< Queued checkouts, returns and usage tracks of all clients, more are answered Busy
+		int RefreshCheckIntervalSeconds{ 30 };  ///< How often the agent checks whether the lease needs a refresh
+		int RefreshBeforeExpirySeconds{ 300 };  ///< Lease is refreshed once it expires within this window
+	};
+
+	struct DeadlineConfig
+	{
+		int DefaultTimeoutMs{ 15000 };                  ///< Deadline of operations without their own entry, 0 waits forever
+		std::map<std::string, int> OperationTimeoutsMs; ///< Per operation deadline, keyed by the names in LicensingCall::Operations
+		int LatencyBudgetMs{ 45000 };                   ///< Total time one console action may block on licensing calls, 0 disables
+	};
+
+	struct RateLimitConfig
+	{
+		double RequestsPerSecond{ 0 };                              ///< Licensing requests of the whole process, 0 is unlimited
+		double Burst{ 10 };                                         ///< Requests that may go out back to back after a quiet period
+		std::map<std::string, double> OperationRequestsPerSecond;   ///< Per operation cap, keyed by the names in LicensingCall::Operations
+	};
+
+	struct StartupConfig
+	{
+		bool OfflineFirst{ false };                 ///< Use a valid persisted lease right away and initialize in the background
+		int MinimumLeaseRemainingSeconds{ 3600 };   ///< Persisted lease must stay valid at least this long to be used
+	};
+
+	struct CoalescingConfig
+	{
+		bool Enabled{ true };                   ///< Concurrent lease refreshes and remote state pulls share one request
+		int CrossProcessWindowSeconds{ 0 };    ///< A request another process finished this recently is reused, 0 coalesces in process only
+	};
+
+	struct LoggingConfig
+	{
+		std::map<std::string, std::string> LogLevel{ { "Default", "Information" } }; ///< Minimum level per category, "Default" for categories without an entry
+		std::string Format{ "Text" };       ///< "Text" or "Json" (one object per line)
+		std::string FilePath;               ///< Empty logs to the console
+		int QueueCapacity{ 8192 };          ///< Records waiting to be written, records beyond it are dropped
+	};
+
+	struct TracingConfig
+	{
+		bool Enabled{ false };                          ///< Record Chrome trace events of licensing calls, storage access and rendering
+		std::string FilePath{ "activation-trace.json" };
+		int BufferEvents{ 1024 };                       ///< Events a thread records before they are handed to the writer thread
+	};
+
+	struct ShutdownConfig
+	{
+		int DrainTimeoutMs{ 5000 };         ///< Time the exit waits for returns, pending operations and deactivation, 0 only sends the returns
+		bool DeactivateOnExit{ false };     ///< Deactivate the seat as the last step of the drain
+	};
+
+	struct SeatPoolConfig
+	{
+		int Size{ 4 };                          ///< Seats the manager keeps activated and ready to lease
+		std::string ActivationCode;             ///< Used to activate every pooled seat
+		std::string SeatName;
+		std::string EditionId;                  ///< Empty activates the default edition
+		int ReplenishIntervalMs{ 1000 };        ///< How often the manager reclaims released seats and replenishes the pool
+		int RefreshBeforeExpirySeconds{ 300 };  ///< Leases of ready seats are refreshed once they expire within this window
+	};
+
+	struct ProvisioningConfig
+	{
+		int Concurrency{ 4 };               ///< Manifest rows activated at the same time
+		double RequestsPerSecond{ 5.0 };    ///< Licensing API requests of all workers together, 0 is unlimited
+		std::string CheckpointFile;         ///< Empty places <manifest>.checkpoint next to the manifest
+	};
+
 	struct ActivationConfig
 	{
 		std::string ApiUrl;
@@ -28,6 +182,18 @@ namespace ActivationConsole
 		bool UseCoreLibrary{ true };
 		std::string CoreLibPath;
 		std::string TenantRsaKeyModulus;
+		StorageConfig Storage;
+		SharedActivationConfig SharedActivation;
+		AgentConfig Agent;
+		DeadlineConfig Deadlines;
+		RateLimitConfig RateLimits;
+		StartupConfig Startup;
+		CoalescingConfig Coalescing;
+		ShutdownConfig Shutdown;
+		SeatPoolConfig SeatPool;
+		ProvisioningConfig Provisioning;
+		LoggingConfig Logging;
+		TracingConfig Tracing;
 	};
 
 	ActivationConfig LoadConfiguration(const std::string& filePath)
@@ -35,7 +201,7 @@ namespace ActivationConsole
 		std::ifstream configFile(filePath);
 		if (!configFile.is_open())
 		{
-			std::cerr << "Failed to open configuration file." << std::endl;
+			std::cerr << "Failed to open configuration file." << '\n';
 			exit(EXIT_FAILURE);
 		}
 
@@ -50,16 +216,201 @@ namespace ActivationConsole
 		config.CoreLibPath = configJson[constant_strings::configCoreLibPath].get<std::string>();
 		config.TenantRsaKeyModulus = configJson[constant_strings::configLicesing][constant_strings::tenantRsaKeyModulus].get<std::string>();
 
+		if (configJson.contains(constant_strings::configStorage))
+		{
+			const auto& storageJson = configJson[constant_strings::configStorage];
+			config.Storage.WriteBehindDebounceMs = storageJson.value(constant_strings::configWriteBehindDebounceMs, config.Storage.WriteBehindDebounceMs);
+			config.Storage.JournalCompactionBytes = storageJson.value(constant_strings::configJournalCompactionBytes, config.Storage.JournalCompactionBytes);
+			config.Storage.Compression = storageJson.value(constant_strings::configStorageCompression, config.Storage.Compression);
+
+			std::string backend = storageJson.value(constant_strings::configStorageBackend, std::string("Secure"));
+			if (backend == "Journaled")
+			{
+				config.Storage.Backend = StorageBackend::Journaled;
+			}
+			else if (backend != "Secure")
+			{
+				std::cerr << "Unknown storage backend '" << backend << "', expected 'Secure' or 'Journaled'." << '\n';
+				exit(EXIT_FAILURE);
+			}
+
+			std::string scope = storageJson.value(constant_strings::configStorageScope, std::string("User"));
+			if (scope == "Machine")
+			{
+				config.Storage.Scope = StorageScope::Machine;
+			}
+			else if (scope != "User")
+			{
+				std::cerr << "Unknown storage scope '" << scope << "', expected 'User' or 'Machine'." << '\n';
+				exit(EXIT_FAILURE);
+			}
+
+			if (config.Storage.Scope == StorageScope::Machine && config.Storage.Backend == StorageBackend::Journaled)
+			{
+				std::cerr << "The journaled storage backend keeps its state in process and cannot be shared machine-wide." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (configJson.contains(constant_strings::configSharedActivation))
+		{
+			const auto& sharedJson = configJson[constant_strings::configSharedActivation];
+			config.SharedActivation.RefreshCheckIntervalSeconds = sharedJson.value(constant_strings::configRefreshCheckIntervalSeconds, config.SharedActivation.RefreshCheckIntervalSeconds);
+			config.SharedActivation.RefreshBeforeExpirySeconds = sharedJson.value(constant_strings::configRefreshBeforeExpirySeconds, config.SharedActivation.RefreshBeforeExpirySeconds);
+		}
+
+		if (configJson.contains(constant_strings::configAgent))
+		{
+			const auto& agentJson = configJson[constant_strings::configAgent];
+			config.Agent.SocketPath = agentJson.value(constant_strings::configAgentSocketPath, config.Agent.SocketPath);
+			config.Agent.MaxClients = agentJson.value(constant_strings::configAgentMaxClients, config.Agent.MaxClients);
+			config.Agent.MaxPendingRequestsPerClient = agentJson.value(constant_strings::configAgentMaxPendingRequestsPerClient, config.Agent.MaxPendingRequestsPerClient);
+			config.Agent.MaxPendingRequests = agentJson.value(constant_strings::configAgentMaxPendingRequests, config.Agent.MaxPendingRequests);
+			if (config.Agent.MaxPendingRequestsPerClient < 1 || config.Agent.MaxPendingRequests < 1)
+			{
+				std::cerr << "Agent.MaxPendingRequestsPerClient and Agent.MaxPendingRequests must be at least 1." << '\n';
+				exit(EXIT_FAILURE);
+			}
+			config.Agent.RefreshCheckIntervalSeconds = agentJson.value(constant_strings::configRefreshCheckIntervalSeconds, config.Agent.RefreshCheckIntervalSeconds);
+			config.Agent.RefreshBeforeExpirySeconds = agentJson.value(constant_strings::configRefreshBeforeExpirySeconds, config.Agent.RefreshBeforeExpirySeconds);
+		}
+
+		if (configJson.contains(constant_strings::configDeadlines))
+		{
+			const auto& deadlinesJson = configJson[constant_strings::configDeadlines];
+			config.Deadlines.DefaultTimeoutMs = deadlinesJson.value(constant_strings::configDefaultTimeoutMs, config.Deadlines.DefaultTimeoutMs);
+			config.Deadlines.LatencyBudgetMs = deadlinesJson.value(constant_strings::configLatencyBudgetMs, config.Deadlines.LatencyBudgetMs);
+			if (deadlinesJson.contains(constant_strings::configOperationTimeoutsMs))
+			{
+				config.Deadlines.OperationTimeoutsMs = deadlinesJson[constant_strings::configOperationTimeoutsMs].get<std::map<std::string, int>>();
+			}
+
+			bool negative = config.Deadlines.DefaultTimeoutMs < 0 || config.Deadlines.LatencyBudgetMs < 0;
+			for (const auto& [operation, timeout] : config.Deadlines.OperationTimeoutsMs)
+			{
+				if (!LicensingCall::Operations::IsKnown(operation))
+				{
+					std::cerr << "Unknown operation in Deadlines.OperationTimeoutsMs: " << operation << '\n';
+					exit(EXIT_FAILURE);
+				}
+				negative = negative || timeout < 0;
+			}
+			if (negative)
+			{
+				std::cerr << "Deadlines must not be negative." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (configJson.contains(constant_strings::configRateLimits))
+		{
+			const auto& rateLimitsJson = configJson[constant_strings::configRateLimits];
+			config.RateLimits.RequestsPerSecond = rateLimitsJson.value(constant_strings::configRequestsPerSecond, config.RateLimits.RequestsPerSecond);
+			config.RateLimits.Burst = rateLimitsJson.value(constant_strings::configBurst, config.RateLimits.Burst);
+			if (rateLimitsJson.contains(constant_strings::configOperationRequestsPerSecond))
+			{
+				config.RateLimits.OperationRequestsPerSecond = rateLimitsJson[constant_strings::configOperationRequestsPerSecond].get<std::map<std::string, double>>();
+			}
+
+			bool negative = config.RateLimits.RequestsPerSecond < 0 || config.RateLimits.Burst < 0;
+			for (const auto& [operation, rate] : config.RateLimits.OperationRequestsPerSecond)
+			{
+				if (!LicensingCall::Operations::IsKnown(operation))
+				{
+					std::cerr << "Unknown operation in RateLimits.OperationRequestsPerSecond: " << operation << '\n';
+					exit(EXIT_FAILURE);
+				}
+				negative = negative || rate < 0;
+			}
+			if (negative)
+			{
+				std::cerr << "RateLimits must not be negative." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (configJson.contains(constant_strings::configStartup))
+		{
+			const auto& startupJson = configJson[constant_strings::configStartup];
+			config.Startup.OfflineFirst = startupJson.value(constant_strings::configOfflineFirst, config.Startup.OfflineFirst);
+			config.Startup.MinimumLeaseRemainingSeconds = startupJson.value(constant_strings::configMinimumLeaseRemainingSeconds, config.Startup.MinimumLeaseRemainingSeconds);
+		}
+
+		if (configJson.contains(constant_strings::configCoalescing))
+		{
+			const auto& coalescingJson = configJson[constant_strings::configCoalescing];
+			config.Coalescing.Enabled = coalescingJson.value(constant_strings::configCoalescingEnabled, config.Coalescing.Enabled);
+			config.Coalescing.CrossProcessWindowSeconds = coalescingJson.value(constant_strings::configCrossProcessWindowSeconds, config.Coalescing.CrossProcessWindowSeconds);
+		}
+
+		if (configJson.contains(constant_strings::configLogging))
+		{
+			const auto& loggingJson = configJson[constant_strings::configLogging];
+			if (loggingJson.contains(constant_strings::configLogLevel))
+			{
+				config.Logging.LogLevel = loggingJson[constant_strings::configLogLevel].get<std::map<std::string, std::string>>();
+			}
+			config.Logging.Format = loggingJson.value(constant_strings::configLogFormat, config.Logging.Format);
+			config.Logging.FilePath = loggingJson.value(constant_strings::configLogFilePath, config.Logging.FilePath);
+			config.Logging.QueueCapacity = loggingJson.value(constant_strings::configLogQueueCapacity, config.Logging.QueueCapacity);
+
+			if (config.Logging.Format != "Text" && config.Logging.Format != "Json")
+			{
+				std::cerr << "Unknown log format '" << config.Logging.Format << "', expected 'Text' or 'Json'." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (configJson.contains(constant_strings::configTracing))
+		{
+			const auto& tracingJson = configJson[constant_strings::configTracing];
+			config.Tracing.Enabled = tracingJson.value(constant_strings::configTracingEnabled, config.Tracing.Enabled);
+			config.Tracing.FilePath = tracingJson.value(constant_strings::configTraceFilePath, config.Tracing.FilePath);
+			config.Tracing.BufferEvents = tracingJson.value(constant_strings::configTraceBufferEvents, config.Tracing.BufferEvents);
+		}
+
+		if (configJson.contains(constant_strings::configShutdown))
+		{
+			const auto& shutdownJson = configJson[constant_strings::configShutdown];
+			config.Shutdown.DrainTimeoutMs = shutdownJson.value(constant_strings::configDrainTimeoutMs, config.Shutdown.DrainTimeoutMs);
+			config.Shutdown.DeactivateOnExit = shutdownJson.value(constant_strings::configDeactivateOnExit, config.Shutdown.DeactivateOnExit);
+		}
+
+		if (configJson.contains(constant_strings::configSeatPool))
+		{
+			const auto& seatPoolJson = configJson[constant_strings::configSeatPool];
+			config.SeatPool.Size = seatPoolJson.value(constant_strings::configSeatPoolSize, config.SeatPool.Size);
+			config.SeatPool.ActivationCode = seatPoolJson.value(constant_strings::configSeatPoolActivationCode, config.SeatPool.ActivationCode);
+			config.SeatPool.SeatName = seatPoolJson.value(constant_strings::configSeatPoolSeatName, config.SeatPool.SeatName);
+			config.SeatPool.EditionId = seatPoolJson.value(constant_strings::configSeatPoolEditionId, config.SeatPool.EditionId);
+			config.SeatPool.ReplenishIntervalMs = seatPoolJson.value(constant_strings::configReplenishIntervalMs, config.SeatPool.ReplenishIntervalMs);
+			config.SeatPool.RefreshBeforeExpirySeconds = seatPoolJson.value(constant_strings::configRefreshBeforeExpirySeconds, config.SeatPool.RefreshBeforeExpirySeconds);
+		}
+
+		if (configJson.contains(constant_strings::configProvisioning))
+		{
+			const auto& provisioningJson = configJson[constant_strings::configProvisioning];
+			config.Provisioning.Concurrency = provisioningJson.value(constant_strings::configProvisioningConcurrency, config.Provisioning.Concurrency);
+			config.Provisioning.RequestsPerSecond = provisioningJson.value(constant_strings::configRequestsPerSecond, config.Provisioning.RequestsPerSecond);
+			config.Provisioning.CheckpointFile = provisioningJson.value(constant_strings::configCheckpointFile, config.Provisioning.CheckpointFile);
+
+			if (config.Provisioning.Concurrency < 1 || config.Provisioning.RequestsPerSecond < 0)
+			{
+				std::cerr << "Provisioning.Concurrency must be at least 1 and RequestsPerSecond must not be negative." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
 		if (config.UseCoreLibrary && config.CoreLibPath.empty())
 		{
-			std::cerr << "CoreLibPath is required when UseCoreLibrary is true." << std::endl;
+			std::cerr << "CoreLibPath is required when UseCoreLibrary is true." << '\n';
 			exit(EXIT_FAILURE);
 		}
 
 		if (config.ApiUrl.empty() || config.TenantId.empty() || config.ProductId.empty() || config.TenantRsaKeyModulus.empty())
 		{
-			std::cerr << "Missing required configuration fields." << std::endl;
-			std::cerr << "Please check your configuration file." << std::endl;
+			std::cerr << "Missing required configuration fields." << '\n';
+			std::cerr << "Please check your configuration file." << '\n';
 			exit(EXIT_FAILURE);
 		}
 
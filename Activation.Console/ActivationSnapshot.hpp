@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "Activation.hpp"
+#include "ActivationStateModel.hpp"
+#include "ActiveFeatureSet.hpp"
+#include "AtomicSnapshot.hpp"
+#include "FlightRecorder.hpp"
+
+#ifdef ZENTITLE_FEATURE_KEYS
+#include "FeatureKeys.hpp"
+#include "IndexedFeatureSet.hpp"
+#endif
+
+using namespace ZentitleLicensingClient;
+
+// Immutable copy of everything the console reads from an Activation between two changes
+struct ActivationSnapshot
+{
+	std::uint64_t version{ 0 };
+	ActivationState state{};
+	std::string stateName;
+	ActivationStateModel info;
+	std::shared_ptr<IFeatureSet> features;
+	std::shared_ptr<ActiveFeatureSet> activeFeatures; ///< Null when the feature set is read only or unavailable
+	bool provisional{ false }; ///< Taken from the persisted state while the activation is still being initialized
+
+#ifdef ZENTITLE_FEATURE_KEYS
+	// Features by the IDs generated at build time. Built by the first caller instead of on every refresh,
+	// most snapshots are replaced before anything looks a feature up by ID.
+	const IndexedFeatureSet<FeatureKeys>& indexedFeatures() const
+	{
+		std::call_once(indexedFeaturesBuilt_, [this]() { indexedFeatures_ = IndexedFeatureSet<FeatureKeys>(info.features); });
+		return indexedFeatures_;
+	}
+#endif
+
+	static std::shared_ptr<const ActivationSnapshot> Capture(Activation& activation, std::uint64_t version = 0)
+	{
+		auto snapshot = std::make_shared<ActivationSnapshot>();
+		snapshot->version = version;
+		snapshot->state = activation.getState();
+		snapshot->stateName = activation.getStateAsString();
+		snapshot->info = activation.getActivationInfo();
+
+		try
+		{
+			snapshot->features = activation.features();
+			snapshot->activeFeatures = std::dynamic_pointer_cast<ActiveFeatureSet>(snapshot->features);
+		}
+		catch (const std::exception&)
+		{
+			// No feature set in the current state
+		}
+		return snapshot;
+	}
+
+	// Offline-first startup: the persisted activation treated as active until initialize() reconciled it with
+	// the server. Carries no feature set, actions that need one wait for the initialization.
+	static std::shared_ptr<const ActivationSnapshot> FromPersisted(const ActivationStateModel& info, std::uint64_t version = 0)
+	{
+		auto snapshot = std::make_shared<ActivationSnapshot>();
+		snapshot->version = version;
+		snapshot->state = ActivationState::Active;
+		snapshot->stateName = "Active (persisted, reconciling with the server)";
+		snapshot->info = info;
+		snapshot->provisional = true;
+		return snapshot;
+	}
+
+	// Stands in for the activation while an initialization that missed its deadline is still running on it
+	static std::shared_ptr<const ActivationSnapshot> Initializing()
+	{
+		auto snapshot = std::make_shared<ActivationSnapshot>();
+		snapshot->state = ActivationState::NotActivated;
+		snapshot->stateName = "Unknown (initialization still running in the background)";
+		snapshot->provisional = true;
+		return snapshot;
+	}
+
+#ifdef ZENTITLE_FEATURE_KEYS
+private:
+	mutable std::once_flag indexedFeaturesBuilt_;
+	mutable IndexedFeatureSet<FeatureKeys> indexedFeatures_;
+#endif
+};
+
+// Publishes a new ActivationSnapshot after each change of the Activation. refresh() must be serialized with
+// the changes (called by whoever changed the activation, under the activation mutex when one is shared);
+// current() and reader() are safe from any thread.
+class ActivationSnapshots
+{
+public:
+	explicit ActivationSnapshots(std::shared_ptr<Activation> activation)
+		: activation_(std::move(activation))
+	{
+		refresh();
+	}
+
+	// Starts from a snapshot that was not captured from the activation, the activation is not touched until refresh()
+	ActivationSnapshots(std::shared_ptr<Activation> activation, std::shared_ptr<const ActivationSnapshot> initial)
+		: activation_(std::move(activation)), version_(initial ? initial->version : 0), snapshot_(std::move(initial))
+	{
+	}
+
+	void refresh()
+	{
+		auto snapshot = ActivationSnapshot::Capture(*activation_, ++version_);
+		FlightRecorder::Observe(static_cast<std::int32_t>(snapshot->state), snapshot->stateName,
+			snapshot->info.leaseExpiry ? std::optional<std::int64_t>(*snapshot->info.leaseExpiry) : std::nullopt);
+		snapshot_.store(std::move(snapshot));
+	}
+
+	std::shared_ptr<const ActivationSnapshot> current() const
+	{
+		return snapshot_.load();
+	}
+
+	AtomicSnapshot<ActivationSnapshot>::Reader reader() const
+	{
+		return AtomicSnapshot<ActivationSnapshot>::Reader(snapshot_);
+	}
+
+	bool isFor(const Activation& activation) const
+	{
+		return activation_.get() == &activation;
+	}
+
+private:
+	std::shared_ptr<Activation> activation_;
+	std::uint64_t version_{ 0 };
+	AtomicSnapshot<ActivationSnapshot> snapshot_;
+};
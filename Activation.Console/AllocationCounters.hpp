@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Counters shared by AllocationTracker.hpp and the operator new/delete replacements in AllocationTracker.cpp.
+// Kept apart from the tracker because the headers behind Logger.hpp may only be compiled into main.cpp.
+namespace AllocationTracking
+{
+	// Plain counters without constructor, so operator new can use them before any static initialization
+	struct Counters
+	{
+		std::uint64_t allocations; ///< Calls to operator new
+		std::uint64_t bytes;       ///< Bytes requested from operator new
+		std::int64_t live;         ///< Bytes allocated and not yet freed by this thread, freeing another thread's block lowers it
+		std::int64_t peak;         ///< Highest value of live since the innermost open scope started
+	};
+
+	// Same allocation counts over all threads, including the SDK's threads and the log writer
+	struct ProcessCounters
+	{
+		std::atomic<std::uint64_t> allocations;
+		std::atomic<std::uint64_t> bytes;
+	};
+
+#ifdef ZENTITLE_ALLOCATION_TRACKING
+	namespace Detail
+	{
+		// Defined in AllocationTracker.cpp
+		extern thread_local Counters threadCounters;
+		extern ProcessCounters processCounters;
+	}
+#endif
+}
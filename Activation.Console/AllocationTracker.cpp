@@ -0,0 +1,138 @@
+// Replaceable global allocation functions for the allocation accounting in AllocationTracker.hpp.
+// Only compiled in with -DZENTITLE_ALLOCATION_TRACKING=ON.
+#ifdef ZENTITLE_ALLOCATION_TRACKING
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounters.hpp"
+
+thread_local AllocationTracking::Counters AllocationTracking::Detail::threadCounters{};
+AllocationTracking::ProcessCounters AllocationTracking::Detail::processCounters{};
+
+namespace
+{
+	// Every block starts with a header holding the requested size, so that delete knows how much to subtract.
+	// The header keeps the alignment malloc guarantees, over-aligned allocations go through the untracked
+	// std::align_val_t overloads of the standard library.
+	constexpr std::size_t HeaderSize = alignof(std::max_align_t) > sizeof(std::size_t) ? alignof(std::max_align_t) : sizeof(std::size_t);
+
+	void* Allocate(std::size_t size) noexcept
+	{
+		auto* block = static_cast<unsigned char*>(std::malloc(size + HeaderSize));
+		if (!block)
+		{
+			return nullptr;
+		}
+		*reinterpret_cast<std::size_t*>(block) = size;
+
+		auto& counters = AllocationTracking::Detail::threadCounters;
+		++counters.allocations;
+		counters.bytes += size;
+		counters.live += static_cast<std::int64_t>(size);
+		if (counters.live > counters.peak)
+		{
+			counters.peak = counters.live;
+		}
+
+		auto& process = AllocationTracking::Detail::processCounters;
+		process.allocations.fetch_add(1, std::memory_order_relaxed);
+		process.bytes.fetch_add(size, std::memory_order_relaxed);
+		return block + HeaderSize;
+	}
+
+	void* AllocateOrThrow(std::size_t size)
+	{
+		for (;;)
+		{
+			if (auto* pointer = Allocate(size))
+			{
+				return pointer;
+			}
+			auto handler = std::get_new_handler();
+			if (!handler)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	void Free(void* pointer) noexcept
+	{
+		if (!pointer)
+		{
+			return;
+		}
+		auto* block = static_cast<unsigned char*>(pointer) - HeaderSize;
+		AllocationTracking::Detail::threadCounters.live -= static_cast<std::int64_t>(*reinterpret_cast<std::size_t*>(block));
+		std::free(block);
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	return AllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return AllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return AllocateOrThrow(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return AllocateOrThrow(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* pointer) noexcept
+{
+	Free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	Free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	Free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	Free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	Free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	Free(pointer);
+}
+
+#endif
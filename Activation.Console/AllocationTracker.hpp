@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#ifdef ZENTITLE_ALLOCATION_TRACKING
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#endif
+
+#include "AllocationCounters.hpp"
+#include "Logger.hpp"
+
+// Heap allocation accounting per console action and render.
+// Built with -DZENTITLE_ALLOCATION_TRACKING=ON, AllocationTracker.cpp replaces the global operator new/delete
+// and counts every allocation into counters of the allocating thread and into process-wide counters. A Scope takes
+// the difference of these counters and of the process RSS over its lifetime, logs it to Activation.Console.Memory
+// at Debug level and adds it to the totals printed on exit. The thread counters miss what the SDK's threads allocate
+// for the operation, the process-wide ones also include whatever other threads allocated in the meantime.
+// Without the option a Scope compiles to nothing.
+namespace AllocationTracking
+{
+#ifdef ZENTITLE_ALLOCATION_TRACKING
+	constexpr bool Enabled = true;
+
+	namespace Detail
+	{
+		// Resident set size in bytes, read without allocating so that it does not show up in the counters
+		inline std::int64_t ResidentBytes()
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters{};
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			{
+				return 0;
+			}
+			return static_cast<std::int64_t>(counters.WorkingSetSize);
+#elif defined(__APPLE__)
+			mach_task_basic_info_data_t info{};
+			mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+			if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+			{
+				return 0;
+			}
+			return static_cast<std::int64_t>(info.resident_size);
+#else
+			int fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				return 0;
+			}
+			char buffer[128];
+			auto length = ::read(fd, buffer, sizeof(buffer) - 1);
+			::close(fd);
+			if (length <= 0)
+			{
+				return 0;
+			}
+			buffer[length] = '\0';
+
+			// statm: size resident shared text lib data dt, in pages
+			const char* cursor = buffer;
+			while (*cursor && *cursor != ' ')
+			{
+				++cursor;
+			}
+			std::int64_t pages = 0;
+			for (++cursor; *cursor >= '0' && *cursor <= '9'; ++cursor)
+			{
+				pages = pages * 10 + (*cursor - '0');
+			}
+			return pages * static_cast<std::int64_t>(::sysconf(_SC_PAGESIZE));
+#endif
+		}
+
+		inline std::string FormatBytes(std::int64_t bytes)
+		{
+			std::ostringstream out;
+			auto magnitude = bytes < 0 ? -bytes : bytes;
+			if (magnitude < 1024)
+			{
+				out << bytes << " B";
+			}
+			else if (magnitude < 1024 * 1024)
+			{
+				out << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KiB";
+			}
+			else
+			{
+				out << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB";
+			}
+			return out.str();
+		}
+
+		struct Totals
+		{
+			std::uint64_t scopes{ 0 };
+			std::uint64_t allocations{ 0 };
+			std::uint64_t bytes{ 0 };
+			std::uint64_t processAllocations{ 0 };
+			std::uint64_t processBytes{ 0 };
+			std::int64_t maxPeak{ 0 };
+			std::int64_t maxRssDelta{ 0 };
+		};
+
+		inline std::mutex& TotalsMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		inline std::map<std::string, Totals>& AllTotals()
+		{
+			static std::map<std::string, Totals> totals;
+			return totals;
+		}
+	}
+
+	inline Counters Current()
+	{
+		return Detail::threadCounters;
+	}
+
+	// Measures what the current thread allocates until it goes out of scope, scopes nest
+	class Scope
+	{
+	public:
+		explicit Scope(std::string name)
+			: name_(std::move(name))
+		{
+			rssAtStart_ = Detail::ResidentBytes();
+			auto& counters = Detail::threadCounters;
+			outerPeak_ = counters.peak;
+			counters.peak = counters.live;
+			atStart_ = counters;
+			processAllocationsAtStart_ = Detail::processCounters.allocations.load(std::memory_order_relaxed);
+			processBytesAtStart_ = Detail::processCounters.bytes.load(std::memory_order_relaxed);
+		}
+
+		~Scope()
+		{
+			auto& counters = Detail::threadCounters;
+			Counters atEnd = counters;
+			counters.peak = std::max(outerPeak_, atEnd.peak);
+			auto rssDelta = Detail::ResidentBytes() - rssAtStart_;
+
+			auto allocations = atEnd.allocations - atStart_.allocations;
+			auto bytes = atEnd.bytes - atStart_.bytes;
+			auto peak = atEnd.peak - atStart_.live;
+			auto processAllocations = Detail::processCounters.allocations.load(std::memory_order_relaxed) - processAllocationsAtStart_;
+			auto processBytes = Detail::processCounters.bytes.load(std::memory_order_relaxed) - processBytesAtStart_;
+
+			{
+				std::lock_guard<std::mutex> lock(Detail::TotalsMutex());
+				auto& totals = Detail::AllTotals()[name_];
+				++totals.scopes;
+				totals.allocations += allocations;
+				totals.bytes += bytes;
+				totals.processAllocations += processAllocations;
+				totals.processBytes += processBytes;
+				totals.maxPeak = std::max(totals.maxPeak, peak);
+				totals.maxRssDelta = std::max(totals.maxRssDelta, rssDelta);
+			}
+
+			if (Log::IsEnabled(Log::Level::Debug, Log::Categories::Memory))
+			{
+				Log::Debug(Log::Categories::Memory, name_ + ": " + std::to_string(allocations) + " allocations, "
+					+ Detail::FormatBytes(static_cast<std::int64_t>(bytes)) + " allocated, peak "
+					+ Detail::FormatBytes(peak) + " live, RSS " + (rssDelta >= 0 ? "+" : "") + Detail::FormatBytes(rssDelta)
+					+ ", " + std::to_string(processAllocations) + " allocations process-wide",
+					{
+						{ "operation", name_ },
+						{ "allocations", std::to_string(allocations) },
+						{ "allocatedBytes", std::to_string(bytes) },
+						{ "processAllocations", std::to_string(processAllocations) },
+						{ "processAllocatedBytes", std::to_string(processBytes) },
+						{ "peakLiveBytes", std::to_string(peak) },
+						{ "rssDeltaBytes", std::to_string(rssDelta) },
+					});
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		std::string name_;
+		Counters atStart_{};
+		std::uint64_t processAllocationsAtStart_{ 0 };
+		std::uint64_t processBytesAtStart_{ 0 };
+		std::int64_t outerPeak_{ 0 };
+		std::int64_t rssAtStart_{ 0 };
+	};
+
+	// Totals per scope name since start, averages are per scope
+	inline void Report(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(Detail::TotalsMutex());
+		if (Detail::AllTotals().empty())
+		{
+			return;
+		}
+
+		out << "Heap allocations per operation (average per run, peak live and RSS growth are maximums):" << '\n'
+			<< "  The first columns count the thread that ran the operation only, work the SDK does on its own threads is missing.\n"
+			<< "  The process-wide columns count every thread, including allocations unrelated to the operation.\n";
+		for (const auto& [name, totals] : Detail::AllTotals())
+		{
+			out << "  " << std::left << std::setw(36) << name << std::right
+				<< std::setw(6) << totals.scopes << " runs "
+				<< std::setw(8) << totals.allocations / totals.scopes << " allocations "
+				<< std::setw(10) << Detail::FormatBytes(static_cast<std::int64_t>(totals.bytes / totals.scopes)) << " allocated, peak "
+				<< std::setw(10) << Detail::FormatBytes(totals.maxPeak) << " live, RSS +"
+				<< std::setw(10) << Detail::FormatBytes(totals.maxRssDelta) << ", process-wide "
+				<< std::setw(8) << totals.processAllocations / totals.scopes << " allocations "
+				<< std::setw(10) << Detail::FormatBytes(static_cast<std::int64_t>(totals.processBytes / totals.scopes)) << " allocated" << '\n';
+		}
+	}
+#else
+	constexpr bool Enabled = false;
+
+	inline Counters Current()
+	{
+		return Counters{};
+	}
+
+	class Scope
+	{
+	public:
+		template <typename Name>
+		explicit Scope(const Name&)
+		{
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+	inline void Report(std::ostream&)
+	{
+	}
+#endif
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Holder of an immutable value that one writer replaces and any number of threads read (read-copy-update).
+// The writer builds a complete new value and swaps it in; readers keep the shared_ptr they loaded for as long
+// as they need it, so a value is never modified after it was published and is freed with its last reader.
+//
+// load() is an atomic shared_ptr load. Threads that read at a high rate use a Reader instead: it keeps its own
+// reference and only reloads when the version counter changed, so steady state reads touch no shared reference
+// count and scale with the number of cores.
+template <typename T>
+class AtomicSnapshot
+{
+public:
+	using Pointer = std::shared_ptr<const T>;
+
+	explicit AtomicSnapshot(Pointer initial = nullptr)
+		: current_(std::move(initial))
+	{
+	}
+
+	AtomicSnapshot(const AtomicSnapshot&) = delete;
+	AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+	Pointer load() const
+	{
+		return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+	}
+
+	void store(Pointer next)
+	{
+		std::atomic_store_explicit(&current_, std::move(next), std::memory_order_release);
+		version_.fetch_add(1, std::memory_order_release);
+	}
+
+	std::uint64_t version() const
+	{
+		return version_.load(std::memory_order_acquire);
+	}
+
+	// Per-thread cached view of the snapshot, not safe to share between threads
+	class Reader
+	{
+	public:
+		explicit Reader(const AtomicSnapshot& source)
+			: source_(&source)
+		{
+		}
+
+		const Pointer& get()
+		{
+			std::uint64_t version = source_->version();
+			if (version != version_ || !current_)
+			{
+				// Read before the load: a store racing with this one bumps the version again and is picked up next time
+				version_ = version;
+				current_ = source_->load();
+			}
+			return current_;
+		}
+
+		const T* operator->()
+		{
+			return get().get();
+		}
+
+	private:
+		const AtomicSnapshot* source_;
+		std::uint64_t version_{ 0 };
+		Pointer current_;
+	};
+
+private:
+	Pointer current_;
+	std::atomic<std::uint64_t> version_{ 0 };
+};
@@ -0,0 +1,240 @@
+// Runs N concurrent simulated licensing operations (default 10000) whose std::future completes after a fixed
+// latency, the way the SDK's futures complete when the Licensing API answers:
+//   thread per future - one std::async thread blocks in future.get() per operation
+//   blocking pool     - a fixed pool of threads, each blocking in future.get() for one operation at a time
+//   coroutines        - every operation is a coroutine awaiting its future on a Coroutines::Executor
+// The latency is simulated by a timer thread, so the benchmark runs without a tenant or the core library.
+// Built only with -DZENTITLE_ENABLE_COROUTINES=ON.
+//
+// Usage: Zentitle.Activation.CoroutineBenchmark [operations] [latency-ms] [executor-threads] [pool-threads]
+
+#include "CoroutineExecutor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Completes promises once their latency elapsed, stands in for the HTTP round trip of an SDK call
+	class SimulatedService
+	{
+	public:
+		explicit SimulatedService(std::chrono::milliseconds latency)
+			: latency_(latency), timer_([this]() { run(); })
+		{
+		}
+
+		~SimulatedService()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			changed_.notify_one();
+			timer_.join();
+		}
+
+		std::future<bool> call()
+		{
+			std::promise<bool> promise;
+			auto future = promise.get_future();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				pending_.push(Pending{ Clock::now() + latency_, std::move(promise) });
+			}
+			changed_.notify_one();
+			return future;
+		}
+
+	private:
+		struct Pending
+		{
+			Clock::time_point due;
+			mutable std::promise<bool> promise;
+
+			bool operator>(const Pending& other) const
+			{
+				return due > other.due;
+			}
+		};
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (!stopping_)
+			{
+				if (pending_.empty())
+				{
+					changed_.wait(lock);
+					continue;
+				}
+				auto due = pending_.top().due;
+				if (Clock::now() < due)
+				{
+					changed_.wait_until(lock, due);
+					continue;
+				}
+				pending_.top().promise.set_value(true);
+				pending_.pop();
+			}
+		}
+
+		std::chrono::milliseconds latency_;
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending_;
+		bool stopping_{ false };
+		std::thread timer_;
+	};
+
+	struct Result
+	{
+		double seconds{ 0 };
+		int completed{ 0 };
+		int failed{ 0 };
+		std::size_t threads{ 0 };
+	};
+
+	Result ThreadPerFuture(SimulatedService& service, int operations)
+	{
+		Result result;
+		std::atomic<int> completed{ 0 };
+		auto start = Clock::now();
+
+		std::vector<std::future<void>> waiters;
+		waiters.reserve(operations);
+		for (int i = 0; i < operations; ++i)
+		{
+			try
+			{
+				waiters.push_back(std::async(std::launch::async, [&service, &completed]() {
+					if (service.call().get())
+					{
+						completed.fetch_add(1);
+					}
+					}));
+			}
+			catch (const std::system_error&)
+			{
+				// Thread limit of the process reached
+				++result.failed;
+			}
+		}
+		result.threads = waiters.size();
+		for (auto& waiter : waiters)
+		{
+			waiter.get();
+		}
+
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.completed = completed.load();
+		return result;
+	}
+
+	Result BlockingPool(SimulatedService& service, int operations, std::size_t threads)
+	{
+		Result result;
+		std::atomic<int> next{ 0 };
+		std::atomic<int> completed{ 0 };
+		auto start = Clock::now();
+
+		std::vector<std::thread> pool;
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			pool.emplace_back([&]() {
+				while (next.fetch_add(1) < operations)
+				{
+					if (service.call().get())
+					{
+						completed.fetch_add(1);
+					}
+				}
+				});
+		}
+		for (auto& thread : pool)
+		{
+			thread.join();
+		}
+
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.completed = completed.load();
+		result.threads = threads;
+		return result;
+	}
+
+	Coroutines::Task<void> Operation(Coroutines::Executor& executor, SimulatedService& service, std::atomic<int>& completed)
+	{
+		bool succeeded = co_await Coroutines::Await(executor, service.call());
+		if (succeeded)
+		{
+			completed.fetch_add(1);
+		}
+	}
+
+	Result CoroutinesOnExecutor(SimulatedService& service, int operations, std::size_t threads)
+	{
+		Result result;
+		std::atomic<int> completed{ 0 };
+		auto start = Clock::now();
+		{
+			Coroutines::Executor executor(threads);
+			for (int i = 0; i < operations; ++i)
+			{
+				executor.spawn(Operation(executor, service, completed));
+			}
+			executor.waitIdle();
+		}
+
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.completed = completed.load();
+		result.threads = threads + 1; // workers and the future poller
+		return result;
+	}
+
+	void Print(const std::string& name, const Result& result)
+	{
+		std::cout << std::left << std::setw(20) << name
+			<< std::right << std::setw(10) << result.threads
+			<< std::setw(12) << std::fixed << std::setprecision(3) << result.seconds
+			<< std::setw(14) << std::setprecision(0) << result.completed / result.seconds
+			<< std::setw(12) << result.completed
+			<< std::setw(10) << result.failed << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int operations = argc > 1 ? std::atoi(argv[1]) : 10000;
+	std::chrono::milliseconds latency(argc > 2 ? std::atoi(argv[2]) : 50);
+	std::size_t executorThreads = argc > 3 ? static_cast<std::size_t>(std::atoi(argv[3])) : 2;
+	std::size_t poolThreads = argc > 4 ? static_cast<std::size_t>(std::atoi(argv[4])) : 64;
+
+	std::cout << operations << " concurrent operations, " << latency.count() << " ms simulated latency\n\n";
+	std::cout << std::left << std::setw(20) << "Mode"
+		<< std::right << std::setw(10) << "Threads"
+		<< std::setw(12) << "Time (s)"
+		<< std::setw(14) << "Ops/s"
+		<< std::setw(12) << "Completed"
+		<< std::setw(10) << "Failed" << "\n";
+
+	SimulatedService service(latency);
+	Print("thread per future", ThreadPerFuture(service, operations));
+	Print("blocking pool", BlockingPool(service, operations, poolThreads));
+	Print("coroutines", CoroutinesOnExecutor(service, operations, executorThreads));
+	return 0;
+}
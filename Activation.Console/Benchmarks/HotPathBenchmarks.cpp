@@ -0,0 +1,242 @@
+// Microbenchmarks of the console's in-process hot paths: input parsing, date formatting, the feature and
+// attribute tables for 10 to 100k synthetic rows written to a null stream, console escaping and loading the
+// configuration. Built on Google Benchmark, so every run can be written as JSON and compared between releases.
+//
+// Usage: Zentitle.Activation.Benchmarks [--benchmark_filter=<regex>] [--benchmark_out=<file> --benchmark_out_format=json]
+// Run it from the build directory so that appsettings.json is found for LoadConfiguration.
+
+#include "ActivationConfig.hpp"
+#include "ActivationActions.hpp"
+#include "DisplayHelper.hpp"
+#include "Helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Discards everything, so the tables are measured without the terminal
+	class NullBuffer : public std::streambuf
+	{
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			return traits_type::not_eof(ch);
+		}
+
+		std::streamsize xsputn(const char*, std::streamsize count) override
+		{
+			return count;
+		}
+	};
+
+	// Points std::cout at the null buffer for the lifetime of a benchmark
+	class NullConsole
+	{
+	public:
+		NullConsole()
+			: previous_(std::cout.rdbuf(&buffer_))
+		{
+		}
+
+		~NullConsole()
+		{
+			std::cout.rdbuf(previous_);
+		}
+
+		NullConsole(const NullConsole&) = delete;
+		NullConsole& operator=(const NullConsole&) = delete;
+
+	private:
+		NullBuffer buffer_;
+		std::streambuf* previous_;
+	};
+
+	std::vector<ActivationFeature> MakeFeatures(std::size_t count)
+	{
+		std::vector<ActivationFeature> features;
+		features.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			ActivationFeature feature{};
+			feature.key = "benchmark-feature-" + std::to_string(i);
+			switch (i % 3)
+			{
+			case 0:
+				feature.type = FeatureType::Bool;
+				break;
+			case 1:
+				feature.type = FeatureType::ElementPool;
+				feature.active = static_cast<long long>(i % 10);
+				feature.available = static_cast<long long>(100 - i % 10);
+				feature.total = 100;
+				break;
+			default:
+				feature.type = FeatureType::UsageCount;
+				feature.active = static_cast<long long>(i % 50);
+				feature.total = 1000;
+				feature.currentUsagePeriodStart = 1700000000;
+				feature.nextUsagePeriodStart = 1702592000;
+				break;
+			}
+			features.push_back(feature);
+		}
+		return features;
+	}
+
+	std::vector<ActivationAttribute> MakeAttributes(std::size_t count)
+	{
+		std::vector<ActivationAttribute> attributes;
+		attributes.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			ActivationAttribute attribute{};
+			attribute.key = "attribute-" + std::to_string(i);
+			attribute.type = i % 2 == 0 ? "String" : "Number";
+			if (i % 5 != 0)
+			{
+				attribute.value = "value-" + std::to_string(i * 7);
+			}
+			attributes.push_back(attribute);
+		}
+		return attributes;
+	}
+
+	void BM_TrimCopy(benchmark::State& state)
+	{
+		const std::string input = "   \t  Activate with a code  \r\n";
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(InputHelper::TrimCopy(input));
+		}
+	}
+	BENCHMARK(BM_TrimCopy);
+
+	void BM_ToLowerCopy(benchmark::State& state)
+	{
+		const std::string input = "Refresh Lease And Pull The Remote State";
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(InputHelper::ToLowerCopy(input));
+		}
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * input.size()));
+	}
+	BENCHMARK(BM_ToLowerCopy);
+
+	void BM_TryParseSizeT(benchmark::State& state)
+	{
+		const std::string input = " 12 ";
+		for (auto _ : state)
+		{
+			std::size_t value = 0;
+			benchmark::DoNotOptimize(InputHelper::TryParseSizeT(input, value));
+			benchmark::DoNotOptimize(value);
+		}
+	}
+	BENCHMARK(BM_TryParseSizeT);
+
+	void BM_TryParseInt(benchmark::State& state)
+	{
+		const std::string input = "-2147483648";
+		for (auto _ : state)
+		{
+			int value = 0;
+			benchmark::DoNotOptimize(InputHelper::TryParseInt(input, value));
+			benchmark::DoNotOptimize(value);
+		}
+	}
+	BENCHMARK(BM_TryParseInt);
+
+	void BM_StringConverterToLong(benchmark::State& state)
+	{
+		const std::string input = "1234567890";
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(StringConverter::toLong(input));
+		}
+	}
+	BENCHMARK(BM_StringConverterToLong);
+
+	void BM_FormatDateTime(benchmark::State& state)
+	{
+		const std::time_t time = 1700000000;
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(ActivationActions::FormatDateTime(time));
+		}
+	}
+	BENCHMARK(BM_FormatDateTime);
+
+	void BM_TimeToString(benchmark::State& state)
+	{
+		const std::time_t time = 1700000000;
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(DisplayHelper::timeToString(time));
+		}
+	}
+	BENCHMARK(BM_TimeToString);
+
+	void BM_ShowFeaturesTable(benchmark::State& state)
+	{
+		auto features = MakeFeatures(static_cast<std::size_t>(state.range(0)));
+		std::optional<std::string> highlight = features[features.size() / 2].key;
+		NullConsole console;
+		for (auto _ : state)
+		{
+			DisplayHelper::ShowFeaturesTable(features, highlight);
+		}
+		state.SetItemsProcessed(state.iterations() * state.range(0));
+	}
+	BENCHMARK(BM_ShowFeaturesTable)->RangeMultiplier(10)->Range(10, 100000)->Unit(benchmark::kMicrosecond);
+
+	void BM_ShowAttributesTable(benchmark::State& state)
+	{
+		auto attributes = MakeAttributes(static_cast<std::size_t>(state.range(0)));
+		NullConsole console;
+		for (auto _ : state)
+		{
+			DisplayHelper::ShowAttributesTable(attributes);
+		}
+		state.SetItemsProcessed(state.iterations() * state.range(0));
+	}
+	BENCHMARK(BM_ShowAttributesTable)->RangeMultiplier(10)->Range(10, 100000)->Unit(benchmark::kMicrosecond);
+
+	void BM_EscapeConsoleOutput(benchmark::State& state)
+	{
+		std::string input;
+		for (int i = 0; i < 64; ++i)
+		{
+			input += "feature-" + std::to_string(i) + (i % 8 == 0 ? "\033[31m" : " ");
+		}
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(DisplayHelper::EscapeConsoleOutput(input));
+		}
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * input.size()));
+	}
+	BENCHMARK(BM_EscapeConsoleOutput);
+
+	void BM_LoadConfiguration(benchmark::State& state)
+	{
+		auto configPath = (std::filesystem::current_path() / "appsettings.json").string();
+		if (!std::filesystem::exists(configPath))
+		{
+			state.SkipWithError("appsettings.json not found in the working directory");
+			return;
+		}
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(ActivationConsole::LoadConfiguration(configPath));
+		}
+	}
+	BENCHMARK(BM_LoadConfiguration)->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+// Read throughput of the activation state while a writer keeps replacing it, for 1..N reader threads:
+//   mutex        - readers lock the activation mutex and read the live state (what the console did before)
+//   atomic load  - readers load the published ActivationSnapshot with an atomic shared_ptr load per read
+//   reader       - readers use AtomicSnapshot::Reader, which reloads only when the version changed
+// The state is synthetic, so the benchmark runs without a tenant or the core library.
+//
+// Usage: Zentitle.Activation.SnapshotReadBenchmark [milliseconds-per-run] [writer-interval-us]
+
+#include "ActivationSnapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	std::shared_ptr<const ActivationSnapshot> MakeSnapshot(std::uint64_t version)
+	{
+		auto snapshot = std::make_shared<ActivationSnapshot>();
+		snapshot->version = version;
+		snapshot->state = ActivationState::Active;
+		snapshot->stateName = "Active";
+		for (int i = 0; i < 64; ++i)
+		{
+			ActivationFeature feature{};
+			feature.key = "feature-" + std::to_string(i);
+			feature.type = FeatureType::ElementPool;
+			feature.available = static_cast<long long>(version % 100);
+			feature.total = 100;
+			snapshot->info.features.push_back(feature);
+		}
+		return snapshot;
+	}
+
+	// Reads performed per second by all reader threads together
+	double Run(int readers, std::chrono::milliseconds duration, std::chrono::microseconds writerInterval,
+		const std::function<void()>& publish, const std::function<long long(std::size_t)>& makeReader)
+	{
+		std::atomic<bool> stop{ false };
+		std::atomic<long long> total{ 0 };
+
+		std::thread writer([&]() {
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				publish();
+				std::this_thread::sleep_for(writerInterval);
+			}
+			});
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < readers; ++i)
+		{
+			threads.emplace_back([&, i]() {
+				long long reads = makeReader(static_cast<std::size_t>(i));
+				total.fetch_add(reads);
+				});
+		}
+
+		std::this_thread::sleep_for(duration);
+		stop = true;
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		writer.join();
+		return static_cast<double>(total.load()) / std::chrono::duration<double>(duration).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 500);
+	std::chrono::microseconds writerInterval(argc > 2 ? std::atoi(argv[2]) : 1000);
+	int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::cout << "Writer replaces the state every " << writerInterval.count() << " us, " << duration.count() << " ms per run\n\n";
+	std::cout << std::left << std::setw(10) << "Threads"
+		<< std::right << std::setw(18) << "mutex (M/s)"
+		<< std::setw(18) << "atomic load (M/s)"
+		<< std::setw(18) << "reader (M/s)" << "\n";
+
+	for (int threads : threadCounts)
+	{
+		std::uint64_t version = 0;
+
+		// Live state behind a mutex
+		std::mutex mutex;
+		ActivationStateModel live = MakeSnapshot(0)->info;
+		auto mutexRate = Run(threads, duration, writerInterval,
+			[&]() {
+				auto next = MakeSnapshot(++version);
+				std::lock_guard<std::mutex> lock(mutex);
+				live = next->info;
+			},
+			[&](std::size_t seed) {
+				long long reads = 0, sum = 0;
+				auto deadline = std::chrono::steady_clock::now() + duration;
+				while (std::chrono::steady_clock::now() < deadline)
+				{
+					for (int i = 0; i < 1000; ++i, ++reads)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						sum += *live.features[(seed + reads) % live.features.size()].available;
+					}
+				}
+				return reads + (sum == -1);
+			});
+
+		AtomicSnapshot<ActivationSnapshot> published(MakeSnapshot(0));
+		auto publish = [&]() { published.store(MakeSnapshot(++version)); };
+
+		auto atomicRate = Run(threads, duration, writerInterval, publish,
+			[&](std::size_t seed) {
+				long long reads = 0, sum = 0;
+				auto deadline = std::chrono::steady_clock::now() + duration;
+				while (std::chrono::steady_clock::now() < deadline)
+				{
+					for (int i = 0; i < 1000; ++i, ++reads)
+					{
+						auto snapshot = published.load();
+						sum += *snapshot->info.features[(seed + reads) % snapshot->info.features.size()].available;
+					}
+				}
+				return reads + (sum == -1);
+			});
+
+		auto readerRate = Run(threads, duration, writerInterval, publish,
+			[&](std::size_t seed) {
+				AtomicSnapshot<ActivationSnapshot>::Reader reader(published);
+				long long reads = 0, sum = 0;
+				auto deadline = std::chrono::steady_clock::now() + duration;
+				while (std::chrono::steady_clock::now() < deadline)
+				{
+					for (int i = 0; i < 1000; ++i, ++reads)
+					{
+						const auto& snapshot = reader.get();
+						sum += *snapshot->info.features[(seed + reads) % snapshot->info.features.size()].available;
+					}
+				}
+				return reads + (sum == -1);
+			});
+
+		std::cout << std::left << std::setw(10) << threads
+			<< std::right << std::fixed << std::setprecision(1)
+			<< std::setw(18) << mutexRate / 1e6
+			<< std::setw(18) << atomicRate / 1e6
+			<< std::setw(18) << readerRate / 1e6 << "\n";
+	}
+
+	return 0;
+}
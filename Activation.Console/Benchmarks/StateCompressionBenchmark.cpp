@@ -0,0 +1,162 @@
+// Load/save latency and on-disk size of the persisted activation state with and without compression.
+// The state is synthetic but shaped like the serialized PersistentData (activation, features, attributes,
+// entitlement), so the benchmark runs without a tenant or the core library.
+//
+// Usage: Zentitle.Activation.StateCompressionBenchmark [iterations]
+
+#include "SecureBlobCodec.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	nlohmann::json MakeState(std::size_t featureCount, std::size_t attributeCount)
+	{
+		static const char* featureTypes[] = { "Bool", "ElementPool", "UsageCount" };
+
+		nlohmann::json features = nlohmann::json::array();
+		for (std::size_t i = 0; i < featureCount; ++i)
+		{
+			features.push_back({
+				{ "key", "feature-" + std::to_string(i) },
+				{ "type", featureTypes[i % 3] },
+				{ "active", static_cast<int>(i % 7) },
+				{ "available", static_cast<int>(100 - i % 100) },
+				{ "total", 100 },
+				{ "currentUsagePeriodStart", 1760000000 + static_cast<long long>(i) },
+				{ "nextUsagePeriodStart", 1762592000 + static_cast<long long>(i) }
+			});
+		}
+
+		nlohmann::json attributes = nlohmann::json::array();
+		for (std::size_t i = 0; i < attributeCount; ++i)
+		{
+			attributes.push_back({
+				{ "key", "attribute-" + std::to_string(i) },
+				{ "type", "String" },
+				{ "value", "value of attribute " + std::to_string(i) }
+			});
+		}
+
+		return {
+			{ "activation", {
+				{ "id", "7f0c6c1e-3f7b-4d55-9a6e-2f4b1d9a8c11" },
+				{ "productId", "prod_0123456789abcdef" },
+				{ "seatId", "c6b1b9f5d2a84b0c9e3f7a1d5b6c8e90" },
+				{ "seatName", "build-host-042" },
+				{ "leaseExpiry", 1760600000 },
+				{ "mode", "Online" },
+				{ "features", features },
+				{ "attributes", attributes }
+			} },
+			{ "entitlement", {
+				{ "offeringName", "Enterprise Offering" },
+				{ "sku", "ENT-001" },
+				{ "productName", "Sample Product" },
+				{ "plan", { { "name", "Annual" }, { "licenseType", "Subscription" }, { "licenseStartType", "LicenseActivation" } } },
+				{ "snapshotDate", "2026-10-18T00:00:00Z" }
+			} }
+		};
+	}
+
+	struct Result
+	{
+		std::size_t fileBytes{ 0 };
+		double saveUs{ 0 };
+		double loadUs{ 0 };
+	};
+
+	// Save: serialize, encode and write the file. Load: read the file, decode and parse.
+	Result Measure(const nlohmann::json& state, bool compress, int iterations, const std::filesystem::path& file)
+	{
+		SecureBlobCodec::Key key{};
+		std::fill(key.begin(), key.end(), static_cast<std::uint8_t>(0x5A));
+		SecureBlobCodec codec(key, compress);
+
+		Result result;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			auto blob = codec.Encode(nlohmann::json::to_cbor(state));
+			std::ofstream out(file, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+			result.fileBytes = blob.size();
+		}
+		result.saveUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		nlohmann::json loaded;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			std::ifstream in(file, std::ios::binary);
+			SecureBlobCodec::Bytes blob((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			auto payload = codec.Decode(blob);
+			if (!payload)
+			{
+				std::cerr << "Failed to decode the saved state\n";
+				std::exit(EXIT_FAILURE);
+			}
+			loaded = nlohmann::json::from_cbor(*payload);
+		}
+		result.loadUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		if (loaded != state)
+		{
+			std::cerr << "Round trip changed the state\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+	auto file = std::filesystem::temp_directory_path() / "z2_state_compression_benchmark.bin";
+
+	struct Scenario
+	{
+		const char* name;
+		std::size_t features;
+		std::size_t attributes;
+	};
+
+	const Scenario scenarios[] = {
+		{ "small", 5, 3 },
+		{ "medium", 500, 50 },
+		{ "very-large", 50000, 2000 }
+	};
+
+	std::cout << std::left << std::setw(12) << "scenario"
+		<< std::setw(12) << "format"
+		<< std::right << std::setw(14) << "file_bytes"
+		<< std::setw(14) << "save_us"
+		<< std::setw(14) << "load_us" << "\n";
+
+	for (const auto& scenario : scenarios)
+	{
+		auto state = MakeState(scenario.features, scenario.attributes);
+		for (bool compress : { false, true })
+		{
+			auto result = Measure(state, compress, iterations, file);
+			std::cout << std::left << std::setw(12) << scenario.name
+				<< std::setw(12) << (compress ? "deflate" : "plain")
+				<< std::right << std::setw(14) << result.fileBytes
+				<< std::setw(14) << std::fixed << std::setprecision(1) << result.saveUs
+				<< std::setw(14) << result.loadUs << "\n";
+		}
+	}
+
+	std::filesystem::remove(file);
+	return EXIT_SUCCESS;
+}
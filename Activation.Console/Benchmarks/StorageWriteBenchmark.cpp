@@ -0,0 +1,119 @@
+// Stress benchmark for activation persistence: measures how many state saves per second the console
+// can absorb when every save goes straight to SecureActivationStorage compared to the write-behind
+// decorator that coalesces them.
+//
+// Usage: Zentitle.Activation.StorageBenchmark [saves-per-burst] [bursts] [debounce-ms]
+// Run it from the build directory so that appsettings.json (CoreLibPath) is found.
+
+#include "ActivationConfig.hpp"
+#include "CoreLibraryManagerConfigProvider.hpp"
+#include "LicenseStorage.hpp"
+#include "SecureActivationStorage.hpp"
+#include "SecureStorage.hpp"
+#include "WriteBehindActivationStorage.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace
+{
+	constexpr const char* BenchmarkDirectory = "Z2_OnlineActivation_Console_Benchmark";
+
+	std::shared_ptr<SecureActivationStorage> CreateStorage(const std::string& fileName)
+	{
+		return std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
+			SecureStorage::getSystemFolder(PredefinedFolder::USER_DATA),
+			BenchmarkDirectory,
+			fileName
+		)
+		);
+	}
+
+	void PrintResult(const std::string& name, std::size_t saves, std::uint64_t writes, std::chrono::steady_clock::duration elapsed)
+	{
+		double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout << std::left << std::setw(16) << name
+			<< " saves=" << saves
+			<< " physical_writes=" << writes
+			<< " elapsed_s=" << std::fixed << std::setprecision(4) << seconds
+			<< " saves_per_s=" << std::setprecision(1) << (seconds > 0 ? saves / seconds : 0.0)
+			<< "\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t savesPerBurst = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+	std::size_t bursts = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+	int debounceMs = argc > 3 ? std::atoi(argv[3]) : 250;
+
+	auto configPath = (std::filesystem::current_path() / "appsettings.json").string();
+	auto config = ActivationConsole::LoadConfiguration(configPath);
+
+	std::filesystem::path coreLibraryPath = config.CoreLibPath;
+	std::string libraryDirectory = coreLibraryPath.parent_path().string();
+	if (!libraryDirectory.empty())
+	{
+		libraryDirectory += std::filesystem::path::preferred_separator;
+	}
+	CoreLibraryManagerConfigProvider configProvider(libraryDirectory, coreLibraryPath.filename().string());
+	SecureActivationStorage::setLibraryConfig(configProvider);
+
+	// Use the console's persisted activation as a realistic payload when there is one
+	auto consoleStorage = std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
+		SecureStorage::getSystemFolder(PredefinedFolder::USER_DATA),
+		LicenseStorage::AppDirectory,
+		"license.encrypted"
+	)
+	);
+	auto payload = consoleStorage->load().get();
+	if (payload.isEmpty())
+	{
+		std::cout << "No persisted activation found, benchmarking with an empty state. Activate with the console first for a realistic payload.\n";
+	}
+
+	const std::size_t totalSaves = savesPerBurst * bursts;
+
+	// Baseline: every save is a full encrypted write
+	{
+		auto direct = CreateStorage("license.encrypted");
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < totalSaves; ++i)
+		{
+			direct->save(payload).get();
+		}
+		PrintResult("direct", totalSaves, totalSaves, std::chrono::steady_clock::now() - start);
+		direct->clear().get();
+	}
+
+	// Write-behind: bursts of saves, each followed by a flush. The flush is measured too, the state is only
+	// persisted once it returned.
+	{
+		auto writeBehind = std::make_shared<WriteBehindActivationStorage>(
+			CreateStorage("license.encrypted"), CreateStorage("license.encrypted.tmp"), std::chrono::milliseconds(debounceMs));
+
+		std::chrono::steady_clock::duration busy{};
+		for (std::size_t burst = 0; burst < bursts; ++burst)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < savesPerBurst; ++i)
+			{
+				writeBehind->save(payload).get();
+			}
+			writeBehind->flush();
+			busy += std::chrono::steady_clock::now() - start;
+		}
+
+		auto statistics = writeBehind->statistics();
+		PrintResult("write-behind", totalSaves, statistics.writesPerformed, busy);
+		writeBehind->clear().get();
+	}
+
+	std::filesystem::remove_all(std::filesystem::path(SecureStorage::getSystemFolder(PredefinedFolder::USER_DATA)) / BenchmarkDirectory);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "IActivationStorage.hpp"
+#include "PersistentData.hpp"
+#include "StorageHelpers.hpp"
+#include "Tracer.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Read-through cache in front of another activation storage.
+// Keeps the last loaded PersistentData in memory and serves repeated loads from it, so that
+// pulling the persisted state does not decrypt the storage file every time.
+// The cache is dropped on every save/clear issued through this instance and whenever the
+// storage file changes on disk (device, inode, size or modification time differ).
+class CachedActivationStorage : public Persistence::Storage::IActivationStorage
+{
+public:
+	explicit CachedActivationStorage(std::shared_ptr<Persistence::Storage::IActivationStorage> inner)
+		: inner_(std::move(inner)), storagePath_(inner_->storageId())
+	{
+	}
+
+	std::string storageId() const override
+	{
+		return inner_->storageId();
+	}
+
+	std::future<void> save(const Persistence::PersistentData& data) override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.Save");
+		std::lock_guard<std::mutex> lock(mutex_);
+		invalidate();
+		return inner_->save(data);
+	}
+
+	std::future<Persistence::PersistentData> load() override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.Load");
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		// Take the signature before reading, a concurrent external write then shows up on the next load
+		auto signature = StorageHelpers::FileSignature::Of(storagePath_);
+		if (cached_ && signature == cachedSignature_)
+		{
+			++hits_;
+			span.arg("cache", "hit");
+			return StorageHelpers::MakeReadyFuture(*cached_);
+		}
+
+		++misses_;
+		span.arg("cache", "miss");
+		auto data = inner_->load().get();
+		cached_ = data;
+		cachedSignature_ = signature;
+		return StorageHelpers::MakeReadyFuture(std::move(data));
+	}
+
+	std::future<void> clear() override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		invalidate();
+		return inner_->clear();
+	}
+
+	std::uint64_t cacheHits() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return hits_;
+	}
+
+	std::uint64_t cacheMisses() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return misses_;
+	}
+
+private:
+	void invalidate()
+	{
+		cached_.reset();
+		cachedSignature_ = StorageHelpers::FileSignature{};
+	}
+
+	std::shared_ptr<Persistence::Storage::IActivationStorage> inner_;
+	std::filesystem::path storagePath_;
+
+	mutable std::mutex mutex_;
+	std::optional<Persistence::PersistentData> cached_;
+	StorageHelpers::FileSignature cachedSignature_;
+	std::uint64_t hits_{ 0 };
+	std::uint64_t misses_{ 0 };
+};
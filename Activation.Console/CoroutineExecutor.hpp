@@ -0,0 +1,531 @@
+#pragma once
+
+// C++20 coroutine support over the std::future based SDK API, built with -DZENTITLE_ENABLE_COROUTINES=ON.
+#ifdef ZENTITLE_COROUTINES
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Coroutines
+{
+	template <typename T>
+	class Task;
+
+	namespace Detail
+	{
+		struct PromiseBase
+		{
+			std::coroutine_handle<> continuation;
+			std::exception_ptr error;
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			// Resumes whoever awaited the task without growing the stack (symmetric transfer)
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					auto continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			FinalAwaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void unhandled_exception()
+			{
+				error = std::current_exception();
+			}
+		};
+
+		template <typename T>
+		struct Promise : PromiseBase
+		{
+			std::optional<T> value;
+
+			Task<T> get_return_object();
+
+			template <typename U>
+			void return_value(U&& result)
+			{
+				value.emplace(std::forward<U>(result));
+			}
+
+			T result()
+			{
+				if (error)
+				{
+					std::rethrow_exception(error);
+				}
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct Promise<void> : PromiseBase
+		{
+			Task<void> get_return_object();
+
+			void return_void()
+			{
+			}
+
+			void result()
+			{
+				if (error)
+				{
+					std::rethrow_exception(error);
+				}
+			}
+		};
+
+		// Fire and forget coroutine used to start tasks on the executor
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object()
+				{
+					return {};
+				}
+
+				std::suspend_never initial_suspend() noexcept
+				{
+					return {};
+				}
+
+				std::suspend_never final_suspend() noexcept
+				{
+					return {};
+				}
+
+				void return_void()
+				{
+				}
+
+				void unhandled_exception()
+				{
+					std::terminate();
+				}
+			};
+		};
+	}
+
+	// Lazily started coroutine producing a T, runs when awaited or passed to Executor::spawn / SyncWait
+	template <typename T = void>
+	class [[nodiscard]] Task
+	{
+	public:
+		using promise_type = Detail::Promise<T>;
+
+		explicit Task(std::coroutine_handle<promise_type> handle)
+			: handle_(handle)
+		{
+		}
+
+		Task(Task&& other) noexcept
+			: handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle_)
+				{
+					handle_.destroy();
+				}
+				handle_ = std::exchange(other.handle_, nullptr);
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		~Task()
+		{
+			if (handle_)
+			{
+				handle_.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			handle_.promise().continuation = continuation;
+			return handle_;
+		}
+
+		T await_resume()
+		{
+			return handle_.promise().result();
+		}
+
+	private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	namespace Detail
+	{
+		template <typename T>
+		Task<T> Promise<T>::get_return_object()
+		{
+			return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+		}
+
+		inline Task<void> Promise<void>::get_return_object()
+		{
+			return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+		}
+
+		// Suspended coroutine waiting for a future, checked by the executor's poller
+		struct PendingFuture
+		{
+			virtual ~PendingFuture() = default;
+			virtual bool ready() const = 0;
+			std::coroutine_handle<> handle;
+		};
+	}
+
+	// Runs coroutines on a fixed number of threads. std::future has no completion callback, so a single poller
+	// thread checks the futures awaited through Await() and hands the coroutines whose future is ready back to
+	// the worker threads. The poll interval backs off from 50 us up to maxPollInterval while nothing completes.
+	//
+	// The executor does not make the SDK thread safe: coroutines touching the same Activation must still be
+	// serialized by the caller, exactly like threads would be.
+	class Executor
+	{
+	public:
+		explicit Executor(std::size_t threads = 2, std::chrono::microseconds maxPollInterval = std::chrono::milliseconds(1))
+			: maxPollInterval_(maxPollInterval)
+		{
+			for (std::size_t i = 0; i < std::max<std::size_t>(1, threads); ++i)
+			{
+				workers_.emplace_back([this]() { work(); });
+			}
+			poller_ = std::thread([this]() { poll(); });
+		}
+
+		~Executor()
+		{
+			waitIdle();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			runnable_.notify_all();
+			pendingChanged_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+			poller_.join();
+		}
+
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+
+		void schedule(std::coroutine_handle<> handle)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				queue_.push_back(handle);
+			}
+			runnable_.notify_one();
+		}
+
+		void watch(Detail::PendingFuture* pending)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				pending_.push_back(pending);
+			}
+			pendingChanged_.notify_one();
+		}
+
+		// Awaitable that continues the awaiting coroutine on one of the executor threads
+		auto resumeOnExecutor()
+		{
+			struct Awaiter
+			{
+				Executor& executor;
+
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					executor.schedule(handle);
+				}
+
+				void await_resume() const noexcept
+				{
+				}
+			};
+			return Awaiter{ *this };
+		}
+
+		// Starts the task on the executor without waiting for it, failures are reported to std::cerr
+		template <typename T>
+		void spawn(Task<T> task)
+		{
+			outstanding_.fetch_add(1);
+			RunDetached(*this, std::move(task));
+		}
+
+		// Blocks until every spawned task has finished
+		void waitIdle()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			idle_.wait(lock, [this]() { return outstanding_.load() == 0; });
+		}
+
+	private:
+		template <typename T>
+		static Detail::Detached RunDetached(Executor& executor, Task<T> task)
+		{
+			co_await executor.resumeOnExecutor();
+			try
+			{
+				co_await task;
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Coroutine failed: " << e.what() << '\n';
+			}
+			executor.finishOne();
+		}
+
+		void finishOne()
+		{
+			if (outstanding_.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				idle_.notify_all();
+			}
+		}
+
+		void work()
+		{
+			while (true)
+			{
+				std::coroutine_handle<> handle;
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					runnable_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+					if (queue_.empty())
+					{
+						return;
+					}
+					handle = queue_.front();
+					queue_.pop_front();
+				}
+				handle.resume();
+			}
+		}
+
+		void poll()
+		{
+			std::vector<Detail::PendingFuture*> watching;
+			std::vector<std::coroutine_handle<>> ready;
+			auto interval = MinPollInterval;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					if (watching.empty())
+					{
+						pendingChanged_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+					}
+					if (stopping_)
+					{
+						return;
+					}
+					watching.insert(watching.end(), pending_.begin(), pending_.end());
+					pending_.clear();
+				}
+
+				// The coroutine owns its PendingFuture, so it is only touched before the coroutine is resumed
+				auto stillWaiting = std::partition(watching.begin(), watching.end(),
+					[](const Detail::PendingFuture* pending) { return !pending->ready(); });
+				for (auto it = stillWaiting; it != watching.end(); ++it)
+				{
+					ready.push_back((*it)->handle);
+				}
+				watching.erase(stillWaiting, watching.end());
+
+				if (!ready.empty())
+				{
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						queue_.insert(queue_.end(), ready.begin(), ready.end());
+					}
+					runnable_.notify_all();
+					ready.clear();
+					interval = MinPollInterval;
+				}
+				else if (!watching.empty())
+				{
+					std::this_thread::sleep_for(interval);
+					interval = std::min(interval * 2, maxPollInterval_);
+				}
+			}
+		}
+
+		static constexpr std::chrono::microseconds MinPollInterval{ 50 };
+
+		std::chrono::microseconds maxPollInterval_;
+		std::mutex mutex_;
+		std::condition_variable runnable_;
+		std::condition_variable pendingChanged_;
+		std::condition_variable idle_;
+		std::deque<std::coroutine_handle<>> queue_;
+		std::vector<Detail::PendingFuture*> pending_;
+		std::atomic<std::size_t> outstanding_{ 0 };
+		bool stopping_{ false };
+		std::vector<std::thread> workers_;
+		std::thread poller_;
+	};
+
+	// co_await Await(executor, future): suspends without blocking a thread until the future is ready, then
+	// resumes on an executor thread and returns future.get(). Deferred futures count as ready and run inline.
+	template <typename T>
+	class FutureAwaiter : public Detail::PendingFuture
+	{
+	public:
+		FutureAwaiter(Executor& executor, std::future<T> future)
+			: executor_(executor), future_(std::move(future))
+		{
+		}
+
+		bool ready() const override
+		{
+			return future_.wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+		}
+
+		bool await_ready() const
+		{
+			return ready();
+		}
+
+		void await_suspend(std::coroutine_handle<> awaiting)
+		{
+			handle = awaiting;
+			executor_.watch(this);
+		}
+
+		T await_resume()
+		{
+			return future_.get();
+		}
+
+	private:
+		Executor& executor_;
+		std::future<T> future_;
+	};
+
+	template <typename T>
+	FutureAwaiter<T> Await(Executor& executor, std::future<T> future)
+	{
+		return FutureAwaiter<T>(executor, std::move(future));
+	}
+
+	// Runs the task on the executor and blocks the calling (non executor) thread until it finished
+	template <typename T>
+	T SyncWait(Executor& executor, Task<T> task)
+	{
+		// Lives on this stack frame. The coroutine sets the result and the done flag under the same lock the waiter
+		// reads them under, so it no longer touches the frame once the waiter sees done.
+		struct Outcome
+		{
+			std::mutex mutex;
+			std::condition_variable finished;
+			bool done{ false };
+			std::optional<std::conditional_t<std::is_void_v<T>, std::monostate, T>> value;
+			std::exception_ptr error;
+		} outcome;
+
+		executor.spawn([](Task<T> inner, Outcome& outcome) -> Task<void>
+			{
+				std::exception_ptr error;
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+					{
+						co_await inner;
+						std::lock_guard<std::mutex> lock(outcome.mutex);
+						outcome.value.emplace();
+					}
+					else
+					{
+						auto value = co_await inner;
+						std::lock_guard<std::mutex> lock(outcome.mutex);
+						outcome.value.emplace(std::move(value));
+					}
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(outcome.mutex);
+				outcome.error = error;
+				outcome.done = true;
+				outcome.finished.notify_all();
+			}(std::move(task), outcome));
+
+		std::unique_lock<std::mutex> lock(outcome.mutex);
+		outcome.finished.wait(lock, [&outcome]() { return outcome.done; });
+		if (outcome.error)
+		{
+			std::rethrow_exception(outcome.error);
+		}
+		if constexpr (!std::is_void_v<T>)
+		{
+			return std::move(*outcome.value);
+		}
+	}
+}
+
+#endif
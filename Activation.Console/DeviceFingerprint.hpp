@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "DynamicLibraryLoader.hpp"
+
+namespace DeviceFingerprint
+{
+	constexpr int OptionDefault = 1 << 0;
+
+	// Asks the Zentitle2Core library for the fingerprint of this device
+	inline std::optional<std::string> Generate(helpers::DynamicLibraryLoader& loader, int option = OptionDefault)
+	{
+		const auto loadedFunction = loader.get_function<int32_t(char*, int*, int)>("generateDeviceFingerprint");
+
+		const static unsigned int DeviceFingerprintMaxLength = 128;
+		std::array<char, DeviceFingerprintMaxLength> generatedDeviceFingerprint = {};
+		int length = 0;
+
+		const int32_t retValue = loadedFunction(generatedDeviceFingerprint.data(), &length, option);
+
+		if (retValue != 0 || length < 0 || static_cast<std::size_t>(length) > generatedDeviceFingerprint.size())
+		{
+			return std::nullopt;
+		}
+
+		return std::string(generatedDeviceFingerprint.data(), static_cast<std::size_t>(length));
+	}
+
+	inline std::optional<std::string> Generate(const std::string& coreLibraryPath, int option = OptionDefault)
+	{
+		helpers::DynamicLibraryLoader loader(coreLibraryPath, false);
+		return Generate(loader, option);
+	}
+}
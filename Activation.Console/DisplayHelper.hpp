@@ -1,9 +1,11 @@
 #pragma once 
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <ctime>
 #include <sstream>
+#include <string_view>
 #include <iomanip>
 #include <type_traits>
 #include <utility>
@@ -17,6 +19,10 @@
 
 #include "ActiveFeatureSet.hpp"
 #include "PersistentData.hpp"
+#include "ActivationSnapshot.hpp"
+#include "Logger.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
 
 #pragma warning(disable : 4996)
 
@@ -34,7 +40,7 @@ namespace DisplayHelper
 	{
 	};
 
-	void ShowFeaturesTable(std::vector<ActivationFeature> features, const std::optional<std::string>& keyToHighlight = std::nullopt);
+	void ShowFeaturesTable(const std::vector<ActivationFeature>& features, const std::optional<std::string>& keyToHighlight = std::nullopt);
 	void ShowAttributesTable(const std::vector<ActivationAttribute>& attributes);
 
 	void SetConsoleColor(int colorCode)
@@ -47,6 +53,8 @@ namespace DisplayHelper
 #endif
 	}
 
+	// Results for the user, tokens included, go straight to the console whatever the log level. std::cout waits for
+	// the log records queued before it, std::cerr does the same through its tie to std::cout.
 	void WriteError(const std::string& message)
 	{
 		SetConsoleColor(4); // Red
@@ -68,6 +76,50 @@ namespace DisplayHelper
 		SetConsoleColor(7); // Reset
 	}
 
+	// Views the optional value or "N/A", without copying the string like a ?: with a literal would
+	inline std::string_view ValueOrNotAvailable(const std::optional<std::string>& value)
+	{
+		return value ? std::string_view(*value) : std::string_view("N/A");
+	}
+
+	// Writes count characters of the run, whole pieces of it at a time instead of one put() per character
+	inline void WriteRepeated(std::ostream& out, std::string_view run, std::size_t count)
+	{
+		while (count > 0)
+		{
+			auto piece = std::min(count, run.size());
+			out.write(run.data(), static_cast<std::streamsize>(piece));
+			count -= piece;
+		}
+	}
+
+	constexpr std::string_view Spaces = "                                                                ";
+	constexpr std::string_view Dashes = "----------------------------------------------------------------";
+
+	// Writes the value into a left-aligned cell of the given width, cut with "..." when it is longer.
+	// Tables write their cells straight to the stream instead of building a padded string per cell.
+	inline void WriteCell(std::ostream& out, std::string_view value, std::size_t width)
+	{
+		if (value.size() > width)
+		{
+			if (width <= 3)
+			{
+				out << value.substr(0, width);
+				return;
+			}
+			out << value.substr(0, width - 3) << "...";
+			return;
+		}
+		out << value;
+		WriteRepeated(out, Spaces, width - value.size());
+	}
+
+	inline void WriteRule(std::ostream& out, std::size_t width)
+	{
+		WriteRepeated(out, Dashes, width);
+		out << '\n';
+	}
+
 	std::string timeToString(std::time_t time)
 	{
 		if (time == 0)
@@ -151,28 +203,34 @@ namespace DisplayHelper
 
 	void ShowEntitlementInfoPanel(const ActivationEntitlementModel& activationEntitlementData)
 	{
-		std::cout << "Entitlement Info:" << std::endl;
-		std::cout << "    Customer Name: " << (activationEntitlementData.customerName.has_value() ? *activationEntitlementData.customerName : "N/A") << std::endl;
-		std::cout << "    Customer Account Ref ID: " << (activationEntitlementData.customerAccountRefId.has_value() ? *activationEntitlementData.customerAccountRefId : "N/A") << std::endl;
-		std::cout << "    Order Ref ID: " << (activationEntitlementData.orderRefId.has_value() ? *activationEntitlementData.orderRefId : "N/A") << std::endl;
-		std::cout << "    Offering Name: " << activationEntitlementData.offeringName << std::endl;
-		std::cout << "    SKU: " << activationEntitlementData.sku << std::endl;
-		std::cout << "    Product Name: " << activationEntitlementData.productName << std::endl;
-		std::cout << "    " << planModelToString(activationEntitlementData.plan) << std::endl;
-		std::cout << "    Grace Period: " << intervalToString(activationEntitlementData.gracePeriod) << std::endl;
-		std::cout << "    Linger Period: " << lingerPeriodToString(activationEntitlementData) << std::endl;
-		std::cout << "    Lease Period: " << intervalToString(activationEntitlementData.leasePeriod) << std::endl;
-		std::cout << "    Offline Lease Period: " << intervalToString(activationEntitlementData.offlineLeasePeriod) << std::endl;
-		std::cout << "    Has Maintenance: " << (activationEntitlementData.hasMaintenance ? "true" : "false") << std::endl;
-		std::cout << "    Maintenance Expiry Date: " << (activationEntitlementData.maintenanceExpiryDate.has_value() ? *activationEntitlementData.maintenanceExpiryDate : "N/A") << std::endl;
-		std::cout << "    Snapshot Date: " << activationEntitlementData.snapshotDate << std::endl;
+		Tracing::Span span(Tracing::Categories::Display, "Display.EntitlementPanel");
+		AllocationTracking::Scope memory("Display.EntitlementPanel");
+		Log::Flush();
+		std::cout << "Entitlement Info:" << '\n';
+		std::cout << "    Customer Name: " << ValueOrNotAvailable(activationEntitlementData.customerName) << '\n';
+		std::cout << "    Customer Account Ref ID: " << ValueOrNotAvailable(activationEntitlementData.customerAccountRefId) << '\n';
+		std::cout << "    Order Ref ID: " << ValueOrNotAvailable(activationEntitlementData.orderRefId) << '\n';
+		std::cout << "    Offering Name: " << activationEntitlementData.offeringName << '\n';
+		std::cout << "    SKU: " << activationEntitlementData.sku << '\n';
+		std::cout << "    Product Name: " << activationEntitlementData.productName << '\n';
+		std::cout << "    " << planModelToString(activationEntitlementData.plan) << '\n';
+		std::cout << "    Grace Period: " << intervalToString(activationEntitlementData.gracePeriod) << '\n';
+		std::cout << "    Linger Period: " << lingerPeriodToString(activationEntitlementData) << '\n';
+		std::cout << "    Lease Period: " << intervalToString(activationEntitlementData.leasePeriod) << '\n';
+		std::cout << "    Offline Lease Period: " << intervalToString(activationEntitlementData.offlineLeasePeriod) << '\n';
+		std::cout << "    Has Maintenance: " << (activationEntitlementData.hasMaintenance ? "true" : "false") << '\n';
+		std::cout << "    Maintenance Expiry Date: " << ValueOrNotAvailable(activationEntitlementData.maintenanceExpiryDate) << '\n';
+		std::cout << "    Snapshot Date: " << activationEntitlementData.snapshotDate << '\n';
 	}
 
-	void ShowActivationStateModelPanel(const Activation& activation)
+	void ShowActivationStateModelPanel(ActivationState state, const ActivationStateModel& info)
 	{
-		std::cout << "==================== Activation Info ====================" << std::endl;
-		std::cout << "Activation State: " << std::endl;
-		switch (activation.getState())
+		Tracing::Span span(Tracing::Categories::Display, "Display.ActivationPanel");
+		AllocationTracking::Scope memory("Display.ActivationPanel");
+		Log::Flush();
+		std::cout << "==================== Activation Info ====================" << '\n';
+		std::cout << "Activation State: " << '\n';
+		switch (state)
 		{
 		case ActivationState::Active:
 			SetConsoleColor(2); // Green
@@ -197,30 +255,43 @@ namespace DisplayHelper
 		}
 
 		SetConsoleColor(7); // Reset to default
-		std::cout << std::endl;
+		std::cout << '\n';
 
-		if (activation.getActivationInfo().productId)
+		if (info.productId)
 		{
-			std::cout << "Product ID: " << *activation.getActivationInfo().productId << std::endl;
+			std::cout << "Product ID: " << *info.productId << '\n';
 		}
-		if (activation.getActivationInfo().seatId)
+		if (info.seatId)
 		{
-			std::cout << "Seat ID: " << *activation.getActivationInfo().seatId << std::endl;
+			std::cout << "Seat ID: " << *info.seatId << '\n';
 		}
 
-		if (activation.getActivationInfo().leaseExpiry)
+		if (info.leaseExpiry)
 		{
-			std::cout << "Lease Expiry: " << timeToString(*activation.getActivationInfo().leaseExpiry) << std::endl;
+			std::cout << "Lease Expiry: " << timeToString(*info.leaseExpiry) << '\n';
 		}
 
-		ShowFeaturesTable(activation.getActivationInfo().features);
-		ShowAttributesTable(activation.getActivationInfo().attributes);
-		std::cout << "=========================================================" << std::endl;
+		ShowFeaturesTable(info.features);
+		ShowAttributesTable(info.attributes);
+		std::cout << "=========================================================" << '\n';
+	}
+
+	void ShowActivationStateModelPanel(const Activation& activation)
+	{
+		ShowActivationStateModelPanel(activation.getState(), activation.getActivationInfo());
+	}
+
+	void ShowActivationStateModelPanel(const ActivationSnapshot& snapshot)
+	{
+		ShowActivationStateModelPanel(snapshot.state, snapshot.info);
 	}
 
 	void ShowActivationStateModelPanel(const Persistence::PersistentData& persistenceData)
 	{
-		std::cout << "==================== Activation Info (Persistence) ====================" << std::endl;
+		Tracing::Span span(Tracing::Categories::Display, "Display.PersistedStatePanel");
+		AllocationTracking::Scope memory("Display.PersistedStatePanel");
+		Log::Flush();
+		std::cout << "==================== Activation Info (Persistence) ====================" << '\n';
 
 		auto entitlementInfo = persistenceData.getEntitlementData();
 		if (entitlementInfo)
@@ -229,7 +300,7 @@ namespace DisplayHelper
 		}
 		else
 		{
-			std::cout << "No Entitlement Info available." << std::endl;
+			std::cout << "No Entitlement Info available." << '\n';
 		}
 
 		auto ActivationStateModel = persistenceData.getActivationInfo();
@@ -237,35 +308,35 @@ namespace DisplayHelper
 		if (!ActivationStateModel)
 		{
 			DisplayHelper::WriteWarning("No ActivationStateModel available.");
-			std::cout << "=======================================================================" << std::endl;
+			std::cout << "=======================================================================" << '\n';
 			return;
 		}
 
 		if (ActivationStateModel->productId)
 		{
-			std::cout << "Product ID: " << *ActivationStateModel->productId << std::endl;
+			std::cout << "Product ID: " << *ActivationStateModel->productId << '\n';
 		}
 		else
 		{
-			std::cout << "Product ID: N/A" << std::endl;
+			std::cout << "Product ID: N/A" << '\n';
 		}
 
 		if (ActivationStateModel->seatId)
 		{
-			std::cout << "Seat ID: " << *ActivationStateModel->seatId << std::endl;
+			std::cout << "Seat ID: " << *ActivationStateModel->seatId << '\n';
 		}
 		else
 		{
-			std::cout << "Seat ID: N/A" << std::endl;
+			std::cout << "Seat ID: N/A" << '\n';
 		}
 
 		if (ActivationStateModel->leaseExpiry)
 		{
-			std::cout << "Lease Expiry: " << DisplayHelper::timeToString(*ActivationStateModel->leaseExpiry) << std::endl;
+			std::cout << "Lease Expiry: " << DisplayHelper::timeToString(*ActivationStateModel->leaseExpiry) << '\n';
 		}
 		else
 		{
-			std::cout << "Lease Expiry: N/A" << std::endl;
+			std::cout << "Lease Expiry: N/A" << '\n';
 		}
 
 		if (!ActivationStateModel->features.empty())
@@ -286,86 +357,61 @@ namespace DisplayHelper
 			std::cout << "\nNo Attributes available.\n";
 		}
 
-		std::cout << "=======================================================================" << std::endl;
+		std::cout << "=======================================================================" << '\n';
 	}
 
-	void ShowFeaturesTable(std::vector<ActivationFeature> features, const std::optional<std::string>& keyToHighlight /*= std::nullopt*/)
+	void ShowFeaturesTable(const std::vector<ActivationFeature>& features, const std::optional<std::string>& keyToHighlight /*= std::nullopt*/)
 	{
+		Tracing::Span span(Tracing::Categories::Display, "Display.FeaturesTable");
+		AllocationTracking::Scope memory("Display.FeaturesTable");
+		if (span.active())
+		{
+			span.arg("features", std::to_string(features.size()));
+		}
+		Log::Flush();
+
 		const std::size_t keyWidth = 32;
 		const std::size_t typeWidth = 12;
 		const std::size_t activeWidth = 12;
 		const std::size_t availableWidth = 12;
 		const std::size_t totalWidth = 10;
 
-		auto truncateWithEllipsis = [](const std::string& value, std::size_t width) -> std::string
-			{
-				if (value.size() <= width)
-				{
-					return value;
-				}
-				if (width <= 3)
-				{
-					return value.substr(0, width);
-				}
-				return value.substr(0, width - 3) + "...";
-			};
-
-		auto formatCell = [&](const std::string& value, std::size_t width) -> std::string
-			{
-				std::string truncated = truncateWithEllipsis(value, width);
-				if (truncated.size() < width)
-				{
-					truncated.append(width - truncated.size(), ' ');
-				}
-				return truncated;
-			};
-
-		auto formatKeyCell = [&](const std::string& value, bool highlight, std::size_t width) -> std::string
-			{
-				std::string cell = formatCell(value, width);
-				if (!highlight)
-				{
-					return cell;
-				}
-				return std::string("\033[34m") + cell + "\033[0m";
-			};
-
-		std::cout << "\n\033[1;36m=== Available Features ===\033[0m\n";
-		std::cout
-			<< formatCell("Feature Key", keyWidth)
-			<< formatCell("Type", typeWidth)
-			<< formatCell("ActiveState", activeWidth)
-			<< formatCell("Available", availableWidth)
-			<< formatCell("Total", totalWidth)
-			<< "\n";
-		std::cout << std::string(keyWidth + typeWidth + activeWidth + availableWidth + totalWidth, '-') << "\n";
-
-		for (auto feature : features)
+		auto& out = std::cout;
+		out << "\n\033[1;36m=== Available Features ===\033[0m\n";
+		WriteCell(out, "Feature Key", keyWidth);
+		WriteCell(out, "Type", typeWidth);
+		WriteCell(out, "ActiveState", activeWidth);
+		WriteCell(out, "Available", availableWidth);
+		WriteCell(out, "Total", totalWidth);
+		out << "\n";
+		WriteRule(out, keyWidth + typeWidth + activeWidth + availableWidth + totalWidth);
+
+		// Counts fit into the small string buffer, so std::to_string does not allocate
+		for (const auto& feature : features)
 		{
 			bool highlightKey = keyToHighlight && feature.key == *keyToHighlight;
 
-			std::cout
-				<< formatKeyCell(feature.key, highlightKey, keyWidth)
-				<< formatCell(ActivationFeature::featureTypeToString(feature.type), typeWidth)
-				<< formatCell(feature.active ? std::to_string(*feature.active) : "", activeWidth)
-				<< formatCell(feature.available ? std::to_string(*feature.available) : "Unlimited", availableWidth)
-				<< formatCell(feature.total ? std::to_string(*feature.total) : "Unlimited", totalWidth)
-				<< "\n";
-		}
-		std::cout << std::string(keyWidth + typeWidth + activeWidth + availableWidth + totalWidth, '-') << "\n";
-
-		std::vector<const ActivationFeature*> usageCountFeatures;
-		for (const auto& feature : features)
-		{
-			if (feature.type == FeatureType::UsageCount)
+			if (highlightKey)
 			{
-				usageCountFeatures.push_back(&feature);
+				out << "\033[34m";
 			}
+			WriteCell(out, feature.key, keyWidth);
+			if (highlightKey)
+			{
+				out << "\033[0m";
+			}
+			WriteCell(out, ActivationFeature::featureTypeToString(feature.type), typeWidth);
+			WriteCell(out, feature.active ? std::to_string(*feature.active) : std::string(), activeWidth);
+			WriteCell(out, feature.available ? std::to_string(*feature.available) : std::string("Unlimited"), availableWidth);
+			WriteCell(out, feature.total ? std::to_string(*feature.total) : std::string("Unlimited"), totalWidth);
+			out << "\n";
 		}
+		WriteRule(out, keyWidth + typeWidth + activeWidth + availableWidth + totalWidth);
 
-		if (!usageCountFeatures.empty())
+		auto isUsageCount = [](const ActivationFeature& feature) { return feature.type == FeatureType::UsageCount; };
+		if (std::any_of(features.begin(), features.end(), isUsageCount))
 		{
-			auto formatOptionalUtc = [](const std::optional<std::time_t>& value) -> std::string
+			auto formatOptionalUtc = [](const std::optional<std::time_t>& value, char (&buffer)[32]) -> std::string_view
 				{
 					if (!value.has_value())
 					{
@@ -380,52 +426,60 @@ namespace DisplayHelper
 					gmtime_r(&ts, &tm_utc);
 #endif
 
-					std::ostringstream timeStream;
-					timeStream << std::put_time(&tm_utc, "%Y-%m-%dT%H:%M:%S") << "Z";
-					return timeStream.str();
+					return std::string_view(buffer, std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm_utc));
 				};
 
 			const std::size_t usageKeyWidth = 32;
 			const std::size_t usageCurrentWidth = 21;
 			const std::size_t usageNextWidth = 21;
 
-			std::cout << "\n\033[1;36m=== Usage Count Details ===\033[0m\n";
-			std::cout
-				<< formatCell("Feature Key", usageKeyWidth)
-				<< formatCell("CurrentStart", usageCurrentWidth)
-				<< formatCell("NextStart", usageNextWidth)
-				<< "\n";
-			std::cout << std::string(usageKeyWidth + usageCurrentWidth + usageNextWidth, '-') << "\n";
+			out << "\n\033[1;36m=== Usage Count Details ===\033[0m\n";
+			WriteCell(out, "Feature Key", usageKeyWidth);
+			WriteCell(out, "CurrentStart", usageCurrentWidth);
+			WriteCell(out, "NextStart", usageNextWidth);
+			out << "\n";
+			WriteRule(out, usageKeyWidth + usageCurrentWidth + usageNextWidth);
 
-			for (const auto* feature : usageCountFeatures)
+			char timeBuffer[32];
+			for (const auto& feature : features)
 			{
-				std::cout
-					<< formatCell(feature->key, usageKeyWidth)
-					<< formatCell(formatOptionalUtc(feature->currentUsagePeriodStart), usageCurrentWidth)
-					<< formatCell(formatOptionalUtc(feature->nextUsagePeriodStart), usageNextWidth)
-					<< "\n";
+				if (!isUsageCount(feature))
+				{
+					continue;
+				}
+				WriteCell(out, feature.key, usageKeyWidth);
+				WriteCell(out, formatOptionalUtc(feature.currentUsagePeriodStart, timeBuffer), usageCurrentWidth);
+				WriteCell(out, formatOptionalUtc(feature.nextUsagePeriodStart, timeBuffer), usageNextWidth);
+				out << "\n";
 			}
 
-			std::cout << std::string(usageKeyWidth + usageCurrentWidth + usageNextWidth, '-') << "\n";
+			WriteRule(out, usageKeyWidth + usageCurrentWidth + usageNextWidth);
 		}
 	}
 
 	void ShowAttributesTable(const std::vector<ActivationAttribute>& attributes)
 	{
+		Tracing::Span span(Tracing::Categories::Display, "Display.AttributesTable");
+		AllocationTracking::Scope memory("Display.AttributesTable");
+		if (span.active())
+		{
+			span.arg("attributes", std::to_string(attributes.size()));
+		}
+		Log::Flush();
 		std::cout << "\n\033[1;36m=== Activation Attributes ===\033[0m\n";
 		std::cout << std::setw(20) << "Key"
 			<< std::setw(15) << "Type"
 			<< std::setw(20) << "Value" << "\n";
 
-		std::cout << std::string(55, '-') << "\n";
+		WriteRule(std::cout, 55);
 
-		for (auto attribute : attributes)
+		for (const auto& attribute : attributes)
 		{
 			std::cout << std::setw(20) << attribute.key
 				<< std::setw(15) << attribute.type
-				<< std::setw(20) << (attribute.value ? *attribute.value : "null") << "\n";
+				<< std::setw(20) << (attribute.value ? std::string_view(*attribute.value) : std::string_view("null")) << "\n";
 		}
-		std::cout << std::string(55, '-') << "\n";
+		WriteRule(std::cout, 55);
 	}
 
 	std::string EscapeConsoleOutput(const std::string& input)
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Seeded string hash of the generated feature key table (see Tools/FeatureKeyGenerator). The generator and the
+// generated FeatureKeys.hpp both use this function, so a key always lands in the slot it was assigned at build time.
+constexpr std::uint32_t FeatureKeyHash(std::string_view key, std::uint32_t seed)
+{
+	std::uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+	for (char c : key)
+	{
+		hash ^= static_cast<std::uint8_t>(c);
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	return hash;
+}
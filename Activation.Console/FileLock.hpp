@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Advisory inter-process lock backed by a lock file. Locks are released automatically when the
+// owning process exits, so a crashed owner never leaves the lock behind.
+// The caller passes the permissions of the lock file, see LicenseStorage::FileMode.
+class FileLock
+{
+public:
+	FileLock(const std::filesystem::path& path, int mode)
+		: path_(path)
+	{
+		std::filesystem::create_directories(path.parent_path());
+#ifdef _WIN32
+		handle_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle_ == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open lock file: " + path.string());
+		}
+#else
+		fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, static_cast<mode_t>(mode));
+		if (fd_ < 0)
+		{
+			throw std::runtime_error("Failed to open lock file: " + path.string());
+		}
+		// The umask may have cleared the group bits, and files left by older versions were world writable
+		::fchmod(fd_, static_cast<mode_t>(mode));
+#endif
+	}
+
+	~FileLock()
+	{
+		unlock();
+#ifdef _WIN32
+		CloseHandle(handle_);
+#else
+		::close(fd_);
+#endif
+	}
+
+	FileLock(const FileLock&) = delete;
+	FileLock& operator=(const FileLock&) = delete;
+
+	void lock()
+	{
+		acquire(true, true);
+	}
+
+	void lockShared()
+	{
+		acquire(false, true);
+	}
+
+	bool tryLock()
+	{
+		return acquire(true, false);
+	}
+
+	void unlock()
+	{
+		if (!locked_)
+		{
+			return;
+		}
+#ifdef _WIN32
+		OVERLAPPED overlapped{};
+		UnlockFileEx(handle_, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+		::flock(fd_, LOCK_UN);
+#endif
+		locked_ = false;
+	}
+
+	bool isLocked() const
+	{
+		return locked_;
+	}
+
+	const std::filesystem::path& path() const
+	{
+		return path_;
+	}
+
+private:
+	bool acquire(bool exclusive, bool wait)
+	{
+#ifdef _WIN32
+		DWORD flags = (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+		OVERLAPPED overlapped{};
+		if (!LockFileEx(handle_, flags, 0, MAXDWORD, MAXDWORD, &overlapped))
+		{
+			if (!wait)
+			{
+				return false;
+			}
+			throw std::runtime_error("Failed to lock file: " + path_.string());
+		}
+#else
+		int operation = (exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB);
+		int result;
+		while ((result = ::flock(fd_, operation)) != 0 && errno == EINTR)
+		{
+		}
+		if (result != 0)
+		{
+			if (!wait && errno == EWOULDBLOCK)
+			{
+				return false;
+			}
+			throw std::runtime_error("Failed to lock file: " + path_.string());
+		}
+#endif
+		locked_ = true;
+		return true;
+	}
+
+	std::filesystem::path path_;
+	bool locked_{ false };
+#ifdef _WIN32
+	HANDLE handle_{ INVALID_HANDLE_VALUE };
+#else
+	int fd_{ -1 };
+#endif
+};
+
+// Scoped holder in the spirit of std::lock_guard, exclusive or shared
+class FileLockGuard
+{
+public:
+	enum class Mode
+	{
+		Exclusive, Shared
+	};
+
+	explicit FileLockGuard(FileLock& lock, Mode mode = Mode::Exclusive)
+		: lock_(lock)
+	{
+		if (mode == Mode::Exclusive)
+		{
+			lock_.lock();
+		}
+		else
+		{
+			lock_.lockShared();
+		}
+	}
+
+	~FileLockGuard()
+	{
+		lock_.unlock();
+	}
+
+	FileLockGuard(const FileLockGuard&) = delete;
+	FileLockGuard& operator=(const FileLockGuard&) = delete;
+
+private:
+	FileLock& lock_;
+};
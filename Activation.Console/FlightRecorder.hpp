@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "FileLock.hpp"
+#include "MappedFile.hpp"
+
+// Always-on record of what happened to the activation, kept in a fixed-size ring of binary records in a file
+// mapped into memory (flight-recorder.bin in the activation storage folder). Every console process of the
+// user writes into the same ring: state transitions, lease changes, API errors and the latency of every
+// licensing operation. A record is complete once its sequence number is stored, which happens last, so a
+// process that dies in the middle of a write leaves a record the dump skips. The pages belong to the OS, a
+// crashed process loses nothing it finished writing. `--dump-flight-recorder` decodes the ring.
+// Has no SDK dependencies, states are recorded by value and by name.
+namespace FlightRecorder
+{
+	constexpr const char* FileName = "flight-recorder.bin";
+	constexpr std::uint32_t Magic = 0x5A32464C; // "Z2FL"
+	constexpr std::uint32_t LayoutVersion = 2;
+	constexpr std::size_t RecordCount = 4096;   ///< Records kept, 1 MiB of file
+	constexpr std::size_t MaxTextLength = 212;  ///< Longer texts, usually API errors, are cut off
+
+	enum class RecordType : std::uint8_t
+	{
+		ProcessStarted = 1,     ///< text: mode of the console
+		StateChanged = 2,       ///< previous/value: state before and after, text: "<before> -> <after>"
+		LeaseChanged = 3,       ///< previous/value: lease expiry before and after (Unix time, 0 for none)
+		ApiError = 4,           ///< text: context and ApiError::toString()
+		Error = 5,              ///< text: context and exception message
+		Operation = 6           ///< value: latency in microseconds, outcome, text: operation name
+	};
+
+	enum class Outcome : std::uint8_t
+	{
+		Completed = 0,
+		Failed = 1,
+		DeadlineExceeded = 2
+	};
+
+	struct Record
+	{
+		std::atomic<std::uint64_t> sequence;    ///< Sequence + 1 once the record is complete, 0 while it is written
+		std::int64_t time;                      ///< Microseconds since the Unix epoch
+		std::int64_t value;
+		std::int64_t previous;
+		std::uint32_t processId;
+		std::uint32_t checksum;                 ///< FNV-1a of the other fields after the sequence
+		std::uint8_t type;
+		std::uint8_t outcome;
+		std::uint16_t textLength;
+		char text[MaxTextLength];
+	};
+
+	static_assert(sizeof(Record) == 256, "Flight recorder records must stay 256 bytes");
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Flight recorder requires lock-free 64-bit atomics");
+
+	struct Region
+	{
+		std::uint32_t magic;
+		std::uint32_t layoutVersion;
+		std::atomic<std::uint64_t> next;        ///< Sequence of the next record, shared by every writing process
+		char reserved[112];
+		Record records[RecordCount];
+	};
+
+	// Decoded copy of a complete record
+	struct Entry
+	{
+		std::uint64_t sequence{ 0 };
+		std::int64_t time{ 0 };
+		std::int64_t value{ 0 };
+		std::int64_t previous{ 0 };
+		std::uint32_t processId{ 0 };
+		RecordType type{ RecordType::Error };
+		Outcome outcome{ Outcome::Completed };
+		std::string text;
+	};
+
+	namespace Detail
+	{
+		inline std::uint32_t Hash(std::uint32_t hash, const std::uint8_t* bytes, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		// Everything after the sequence except the checksum itself
+		inline std::uint32_t Checksum(const Record& record)
+		{
+			const auto* bytes = reinterpret_cast<const std::uint8_t*>(&record);
+			auto hash = Hash(2166136261u, bytes + offsetof(Record, time), offsetof(Record, checksum) - offsetof(Record, time));
+			return Hash(hash, bytes + offsetof(Record, type), sizeof(Record) - offsetof(Record, type));
+		}
+
+		inline std::uint32_t ProcessId()
+		{
+#ifdef _WIN32
+			return static_cast<std::uint32_t>(GetCurrentProcessId());
+#else
+			return static_cast<std::uint32_t>(::getpid());
+#endif
+		}
+	}
+
+	class Recorder
+	{
+	public:
+		Recorder(const std::filesystem::path& path, int fileMode)
+			: file_(path, sizeof(Region), MappedFile::Access::ReadWrite, fileMode)
+		{
+			// Processes starting at the same time must not both reset the ring, the second one would wipe the
+			// records the first one already wrote
+			std::filesystem::path lockPath = path;
+			lockPath += ".lock";
+			FileLock lock(lockPath, fileMode);
+			lock.lock();
+
+			Region& shared = region();
+			if (shared.magic != Magic || shared.layoutVersion != LayoutVersion)
+			{
+				// New file, or one written by another layout: start over
+				std::memset(static_cast<void*>(shared.records), 0, sizeof(shared.records));
+				shared.next.store(0, std::memory_order_relaxed);
+				shared.layoutVersion = LayoutVersion;
+				shared.magic = Magic;
+			}
+		}
+
+		void record(RecordType type, std::int64_t value, std::int64_t previous, Outcome outcome, const char* text, std::size_t textLength)
+		{
+			Region& shared = region();
+			auto sequence = shared.next.fetch_add(1, std::memory_order_relaxed);
+			Record& slot = shared.records[sequence % RecordCount];
+
+			slot.sequence.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			slot.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			slot.value = value;
+			slot.previous = previous;
+			slot.processId = processId_;
+			slot.type = static_cast<std::uint8_t>(type);
+			slot.outcome = static_cast<std::uint8_t>(outcome);
+			slot.textLength = static_cast<std::uint16_t>(std::min(textLength, MaxTextLength));
+			std::memcpy(slot.text, text, slot.textLength);
+			std::memset(slot.text + slot.textLength, 0, MaxTextLength - slot.textLength);
+			slot.checksum = Detail::Checksum(slot);
+
+			slot.sequence.store(sequence + 1, std::memory_order_release);
+		}
+
+		// Called on shutdown, the records are already safe from a crash of the process but not from one of the OS
+		void flushAsync()
+		{
+			file_.flushAsync();
+		}
+
+		// Records a state transition or lease change when the activation differs from what this process saw last
+		void observe(std::int32_t state, const std::string& stateName, std::int64_t leaseExpiry)
+		{
+			std::lock_guard<std::mutex> lock(observedMutex_);
+			if (!observedState_ || *observedState_ != state)
+			{
+				std::string text = observedState_ ? observedStateName_ + " -> " + stateName : stateName;
+				record(RecordType::StateChanged, state, observedState_.value_or(-1), Outcome::Completed, text.data(), text.size());
+				observedState_ = state;
+				observedStateName_ = stateName;
+			}
+
+			if (leaseExpiry != observedLeaseExpiry_)
+			{
+				record(RecordType::LeaseChanged, leaseExpiry, observedLeaseExpiry_, Outcome::Completed, "", 0);
+				observedLeaseExpiry_ = leaseExpiry;
+			}
+		}
+
+	private:
+		Region& region() const
+		{
+			return *static_cast<Region*>(file_.data());
+		}
+
+		MappedFile file_;
+		const std::uint32_t processId_{ Detail::ProcessId() };
+
+		std::mutex observedMutex_;
+		std::optional<std::int32_t> observedState_;
+		std::string observedStateName_;
+		std::int64_t observedLeaseExpiry_{ 0 };
+	};
+
+	namespace Detail
+	{
+		inline std::atomic<Recorder*>& Instance()
+		{
+			static std::atomic<Recorder*> recorder{ nullptr };
+			return recorder;
+		}
+
+		inline void Write(RecordType type, std::int64_t value, std::int64_t previous, Outcome outcome, const std::string& text)
+		{
+			if (auto* recorder = Instance().load(std::memory_order_acquire))
+			{
+				recorder->record(type, value, previous, outcome, text.data(), text.size());
+			}
+		}
+	}
+
+	// Call once at startup. Never destroyed, records written by exit handlers and late operations still have a
+	// recorder. A ring that cannot be mapped only costs the records, the console keeps running.
+	// fileMode: permissions of the ring and its lock file, see LicenseStorage::FileMode
+	inline bool Open(const std::filesystem::path& directory, const std::string& mode, int fileMode)
+	{
+		try
+		{
+			auto* recorder = new Recorder(directory / FileName, fileMode);
+			Detail::Instance().store(recorder, std::memory_order_release);
+			Detail::Write(RecordType::ProcessStarted, 0, 0, Outcome::Completed, mode);
+			return true;
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+	}
+
+	inline void Flush()
+	{
+		if (auto* recorder = Detail::Instance().load(std::memory_order_acquire))
+		{
+			recorder->flushAsync();
+		}
+	}
+
+	inline void Operation(const std::string& operation, std::chrono::microseconds latency, Outcome outcome)
+	{
+		Detail::Write(RecordType::Operation, latency.count(), 0, outcome, operation);
+	}
+
+	inline void ApiError(const std::string& message)
+	{
+		Detail::Write(RecordType::ApiError, 0, 0, Outcome::Failed, message);
+	}
+
+	inline void Error(const std::string& message)
+	{
+		Detail::Write(RecordType::Error, 0, 0, Outcome::Failed, message);
+	}
+
+	// Callers pass the state after every change of the activation, an unchanged state costs a mutex and two comparisons
+	inline void Observe(std::int32_t state, const std::string& stateName, std::optional<std::int64_t> leaseExpiry)
+	{
+		if (auto* recorder = Detail::Instance().load(std::memory_order_acquire))
+		{
+			recorder->observe(state, stateName, leaseExpiry.value_or(0));
+		}
+	}
+
+	// Complete records of the ring at the given path, oldest first. Reads while other processes keep writing:
+	// records torn by a concurrent write or by a crash are left out.
+	inline std::vector<Entry> Read(const std::filesystem::path& path)
+	{
+		MappedFile file(path, sizeof(Region), MappedFile::Access::ReadOnly);
+		const Region& shared = *static_cast<const Region*>(file.data());
+		if (shared.magic != Magic || shared.layoutVersion != LayoutVersion)
+		{
+			throw std::runtime_error("Not a flight recorder file: " + path.string());
+		}
+
+		std::vector<Entry> entries;
+		auto copy = std::make_unique<Record>();
+		for (const auto& slot : shared.records)
+		{
+			auto before = slot.sequence.load(std::memory_order_acquire);
+			if (before == 0)
+			{
+				continue;
+			}
+			std::memcpy(reinterpret_cast<char*>(copy.get()) + offsetof(Record, time), reinterpret_cast<const char*>(&slot) + offsetof(Record, time),
+				sizeof(Record) - offsetof(Record, time));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != before || Detail::Checksum(*copy) != copy->checksum)
+			{
+				continue;
+			}
+
+			Entry entry;
+			entry.sequence = before - 1;
+			entry.time = copy->time;
+			entry.value = copy->value;
+			entry.previous = copy->previous;
+			entry.processId = copy->processId;
+			entry.type = static_cast<RecordType>(copy->type);
+			entry.outcome = static_cast<Outcome>(copy->outcome);
+			entry.text.assign(copy->text, std::min<std::size_t>(copy->textLength, MaxTextLength));
+			entries.push_back(std::move(entry));
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.sequence < b.sequence; });
+		return entries;
+	}
+
+	namespace Detail
+	{
+		inline std::string FormatTime(std::int64_t microseconds)
+		{
+			std::time_t seconds = static_cast<std::time_t>(microseconds / 1000000);
+			std::ostringstream text;
+			text << std::put_time(std::localtime(&seconds), "%F %T") << '.' << std::setw(6) << std::setfill('0') << (microseconds % 1000000);
+			return text.str();
+		}
+
+		inline std::string FormatLatency(std::int64_t microseconds)
+		{
+			std::ostringstream text;
+			text << std::fixed << std::setprecision(1) << microseconds / 1000.0 << " ms";
+			return text.str();
+		}
+
+		inline std::string FormatExpiry(std::int64_t expiry)
+		{
+			if (expiry == 0)
+			{
+				return "none";
+			}
+			std::time_t seconds = static_cast<std::time_t>(expiry);
+			std::ostringstream text;
+			text << std::put_time(std::localtime(&seconds), "%F %T");
+			return text.str();
+		}
+	}
+
+	// One line per record: time, process, kind and details
+	inline void Dump(const std::filesystem::path& path, std::ostream& out)
+	{
+		auto entries = Read(path);
+		for (const auto& entry : entries)
+		{
+			out << Detail::FormatTime(entry.time) << "  pid " << std::setw(7) << std::left << entry.processId << std::right << "  ";
+			switch (entry.type)
+			{
+			case RecordType::ProcessStarted:
+				out << "Started       " << entry.text;
+				break;
+			case RecordType::StateChanged:
+				out << "State         " << entry.text;
+				break;
+			case RecordType::LeaseChanged:
+				out << "Lease         " << Detail::FormatExpiry(entry.previous) << " -> " << Detail::FormatExpiry(entry.value);
+				break;
+			case RecordType::ApiError:
+				out << "API error     " << entry.text;
+				break;
+			case RecordType::Error:
+				out << "Error         " << entry.text;
+				break;
+			case RecordType::Operation:
+				out << "Operation     " << entry.text << " " << Detail::FormatLatency(entry.value)
+					<< (entry.outcome == Outcome::Failed ? " failed" : entry.outcome == Outcome::DeadlineExceeded ? " deadline exceeded" : "");
+				break;
+			default:
+				out << "Unknown record type " << static_cast<int>(entry.type);
+				break;
+			}
+			out << '\n';
+		}
+		out << entries.size() << " record(s) in " << path.string() << '\n';
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ActivationFeature.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Features of an activation stored in a flat array indexed by the IDs generated into FeatureKeys.hpp
+// (see Tools/FeatureKeyGenerator), so application code checks a feature by ID with a single array access.
+// Features the server reports that were not in the list at build time are kept in a map by key instead.
+template <typename Keys>
+class IndexedFeatureSet
+{
+public:
+	using Id = typename Keys::Id;
+
+	IndexedFeatureSet() = default;
+
+	explicit IndexedFeatureSet(const std::vector<ActivationFeature>& features)
+	{
+		for (const auto& feature : features)
+		{
+			int index = Keys::IndexOf(feature.key);
+			if (index >= 0)
+			{
+				known_[static_cast<std::size_t>(index)] = feature;
+			}
+			else
+			{
+				unknown_.emplace(feature.key, feature);
+			}
+		}
+	}
+
+	// nullptr when the activation does not include the feature
+	const ActivationFeature* get(Id id) const
+	{
+		const auto& feature = known_[static_cast<std::size_t>(id)];
+		return feature ? &*feature : nullptr;
+	}
+
+	bool contains(Id id) const
+	{
+		return known_[static_cast<std::size_t>(id)].has_value();
+	}
+
+	// Lookup by key for keys only known at run time, goes through the perfect hash first
+	const ActivationFeature* find(std::string_view key) const
+	{
+		int index = Keys::IndexOf(key);
+		if (index >= 0)
+		{
+			return get(static_cast<Id>(index));
+		}
+
+		auto it = unknown_.find(std::string(key));
+		return it != unknown_.end() ? &it->second : nullptr;
+	}
+
+	// Features reported by the server that are missing from the generated key list
+	const std::unordered_map<std::string, ActivationFeature>& unknown() const
+	{
+		return unknown_;
+	}
+
+private:
+	std::array<std::optional<ActivationFeature>, Keys::Count> known_;
+	std::unordered_map<std::string, ActivationFeature> unknown_;
+};
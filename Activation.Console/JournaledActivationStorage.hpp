@@ -0,0 +1,504 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "json.hpp"
+#include "IActivationStorage.hpp"
+#include "Logger.hpp"
+#include "PersistentData.hpp"
+#include "SecureBlobCodec.hpp"
+#include "StorageHelpers.hpp"
+#include "Tracer.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace ZentitleLicensingClient;
+
+// Activation storage that appends small encrypted deltas instead of rewriting the whole state.
+//
+// Files inside the storage directory:
+//   <name>.snapshot     full state, rewritten only by compaction
+//   <name>.journal      JSON patches on top of the state identified by the journal header
+//   <name>.journal.old  previous journal while a compaction is writing the new snapshot
+//
+// Every journal starts with the SHA-256 of the state it applies to. Recovery loads the snapshot and
+// replays each journal whose base matches the state reached so far, so a crash at any point of a
+// compaction replays exactly the records that are missing from the snapshot. A torn record at the
+// end of a journal fails authentication and ends the replay.
+// If no snapshot exists yet, the state is imported once from the legacy storage, which is cleared once the
+// snapshot holds it so no stale copy of the activation stays behind.
+// With compression enabled, snapshots and larger records are deflated before encryption (see SecureBlobCodec).
+class JournaledActivationStorage : public Persistence::Storage::IActivationStorage
+{
+public:
+	struct Statistics
+	{
+		std::uint64_t recordsAppended{ 0 };
+		std::uint64_t bytesAppended{ 0 };
+		std::uint64_t compactions{ 0 };
+		std::uint64_t snapshotBytesWritten{ 0 };
+	};
+
+	JournaledActivationStorage(
+		std::filesystem::path directory,
+		std::string name,
+		const SecureBlobCodec::Key& key,
+		std::shared_ptr<Persistence::Storage::IActivationStorage> legacyStorage,
+		std::uint64_t compactionThresholdBytes,
+		bool compress = false)
+		: snapshotPath_(directory / (name + ".snapshot")),
+		journalPath_(directory / (name + ".journal")),
+		oldJournalPath_(directory / (name + ".journal.old")),
+		codec_(key, compress),
+		legacyStorage_(std::move(legacyStorage)),
+		compactionThresholdBytes_(compactionThresholdBytes)
+	{
+		std::filesystem::create_directories(directory);
+		compactor_ = std::thread([this]() { runCompactor(); });
+	}
+
+	~JournaledActivationStorage() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wakeCompactor_.notify_all();
+		compactor_.join();
+		closeJournal();
+	}
+
+	JournaledActivationStorage(const JournaledActivationStorage&) = delete;
+	JournaledActivationStorage& operator=(const JournaledActivationStorage&) = delete;
+
+	std::string storageId() const override
+	{
+		return journalPath_.string();
+	}
+
+	std::future<void> save(const Persistence::PersistentData& data) override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.Append");
+		std::promise<void> saved;
+		try
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ensureRecovered();
+
+			nlohmann::json next = data;
+			nlohmann::json patch = nlohmann::json::diff(state_, next);
+			if (span.active())
+			{
+				span.arg("operations", std::to_string(patch.size()));
+			}
+			if (!patch.empty())
+			{
+				appendRecord(patch);
+				state_ = std::move(next);
+				data_ = data;
+			}
+
+			if (journalBytes_ >= compactionThresholdBytes_ && !compactionRequested_)
+			{
+				compactionRequested_ = true;
+				wakeCompactor_.notify_all();
+			}
+			saved.set_value();
+		}
+		catch (...)
+		{
+			saved.set_exception(std::current_exception());
+		}
+		return saved.get_future();
+	}
+
+	std::future<Persistence::PersistentData> load() override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.Load");
+		std::promise<Persistence::PersistentData> loaded;
+		try
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ensureRecovered();
+			loaded.set_value(data_);
+		}
+		catch (...)
+		{
+			loaded.set_exception(std::current_exception());
+		}
+		return loaded.get_future();
+	}
+
+	std::future<void> clear() override
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			compactionFinished_.wait(lock, [this]() { return !compacting_; });
+
+			closeJournal();
+			std::error_code ec;
+			std::filesystem::remove(snapshotPath_, ec);
+			std::filesystem::remove(journalPath_, ec);
+			std::filesystem::remove(oldJournalPath_, ec);
+
+			state_ = nlohmann::json();
+			data_ = Persistence::PersistentData();
+			startJournal(StateHash(state_));
+			recovered_ = true;
+		}
+
+		if (legacyStorage_)
+		{
+			return legacyStorage_->clear();
+		}
+		return StorageHelpers::MakeReadyFuture();
+	}
+
+	Statistics statistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return statistics_;
+	}
+
+private:
+	static constexpr char JournalMagic[4] = { 'Z', '2', 'J', '1' };
+	static constexpr std::size_t HashHexSize = 64;
+	static constexpr std::size_t JournalHeaderSize = sizeof(JournalMagic) + HashHexSize;
+
+	static std::string StateHash(const nlohmann::json& state)
+	{
+		return SecureBlobCodec::Sha256Hex(state.dump());
+	}
+
+	static SecureBlobCodec::Bytes ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return {};
+		}
+		return SecureBlobCodec::Bytes(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	static bool SyncStream(std::FILE* file)
+	{
+		if (std::fflush(file) != 0)
+		{
+			return false;
+		}
+#ifdef _WIN32
+		return _commit(_fileno(file)) == 0;
+#else
+		return ::fsync(fileno(file)) == 0;
+#endif
+	}
+
+	void ensureRecovered()
+	{
+		if (recovered_)
+		{
+			return;
+		}
+
+		state_ = nlohmann::json();
+		auto snapshot = ReadFile(snapshotPath_);
+		if (!snapshot.empty())
+		{
+			auto payload = codec_.Decode(snapshot);
+			if (!payload)
+			{
+				throw std::runtime_error("Activation snapshot is corrupted: " + snapshotPath_.string());
+			}
+			state_ = nlohmann::json::from_cbor(*payload);
+		}
+		else if (legacyStorage_)
+		{
+			auto legacy = legacyStorage_->load().get();
+			if (!legacy.isEmpty())
+			{
+				state_ = legacy;
+				statistics_.snapshotBytesWritten += writeSnapshot(state_);
+				legacyStorage_->clear().get();
+			}
+		}
+
+		std::string hash = StateHash(state_);
+		bool interruptedCompaction = std::filesystem::exists(oldJournalPath_);
+		if (interruptedCompaction)
+		{
+			replayJournal(oldJournalPath_, hash);
+		}
+		auto journalEnd = replayJournal(journalPath_, hash);
+
+		data_ = state_.is_null() ? Persistence::PersistentData() : state_.get<Persistence::PersistentData>();
+
+		if (interruptedCompaction)
+		{
+			// Finish the compaction: the snapshot must contain everything before the old journal goes away
+			statistics_.snapshotBytesWritten += writeSnapshot(state_);
+			startJournal(hash);
+			std::filesystem::remove(oldJournalPath_);
+		}
+		else if (journalEnd)
+		{
+			// Drop a torn record left by a crash and keep appending to the journal
+			std::filesystem::resize_file(journalPath_, *journalEnd);
+			journalBytes_ = *journalEnd;
+			openJournal();
+		}
+		else
+		{
+			startJournal(hash);
+		}
+
+		recovered_ = true;
+	}
+
+	// Applies the journal when it is based on the state identified by 'hash', returns the end of the last intact record
+	std::optional<std::uint64_t> replayJournal(const std::filesystem::path& path, std::string& hash)
+	{
+		auto journal = ReadFile(path);
+		if (journal.size() < JournalHeaderSize
+			|| !std::equal(std::begin(JournalMagic), std::end(JournalMagic), journal.begin())
+			|| std::string(journal.begin() + sizeof(JournalMagic), journal.begin() + JournalHeaderSize) != hash)
+		{
+			return std::nullopt;
+		}
+
+		std::size_t offset = JournalHeaderSize;
+		while (offset + 4 <= journal.size())
+		{
+			std::uint32_t size = static_cast<std::uint32_t>(journal[offset])
+				| (static_cast<std::uint32_t>(journal[offset + 1]) << 8)
+				| (static_cast<std::uint32_t>(journal[offset + 2]) << 16)
+				| (static_cast<std::uint32_t>(journal[offset + 3]) << 24);
+			if (offset + 4 + size > journal.size())
+			{
+				break;
+			}
+
+			auto payload = codec_.Decode(journal.data() + offset + 4, size);
+			if (!payload)
+			{
+				break;
+			}
+			state_ = state_.patch(nlohmann::json::from_cbor(*payload));
+			offset += 4 + size;
+		}
+
+		hash = StateHash(state_);
+		return offset;
+	}
+
+	// On failure the previous journal stays open when it is still in place, it matches the state in memory
+	void startJournal(const std::string& baseHash)
+	{
+		closeJournal();
+		try
+		{
+			writeJournalHeader(baseHash);
+		}
+		catch (...)
+		{
+			if (std::filesystem::exists(journalPath_))
+			{
+				try
+				{
+					openJournal();
+				}
+				catch (const std::exception&)
+				{
+				}
+			}
+			throw;
+		}
+		journalBytes_ = JournalHeaderSize;
+		openJournal();
+	}
+
+	void writeJournalHeader(const std::string& baseHash)
+	{
+		auto stagedPath = journalPath_;
+		stagedPath += ".tmp";
+		std::FILE* file = std::fopen(stagedPath.string().c_str(), "wb");
+		if (!file)
+		{
+			throw std::runtime_error("Failed to create activation journal: " + stagedPath.string());
+		}
+		std::fwrite(JournalMagic, 1, sizeof(JournalMagic), file);
+		std::fwrite(baseHash.data(), 1, baseHash.size(), file);
+		bool written = SyncStream(file);
+		std::fclose(file);
+		if (!written)
+		{
+			throw std::runtime_error("Failed to write activation journal: " + stagedPath.string());
+		}
+
+		StorageHelpers::ReplaceFileAtomically(stagedPath, journalPath_);
+	}
+
+	void openJournal()
+	{
+		journal_ = std::fopen(journalPath_.string().c_str(), "ab");
+		if (!journal_)
+		{
+			throw std::runtime_error("Failed to open activation journal: " + journalPath_.string());
+		}
+	}
+
+	void closeJournal()
+	{
+		if (journal_)
+		{
+			std::fclose(journal_);
+			journal_ = nullptr;
+		}
+	}
+
+	void appendRecord(const nlohmann::json& patch)
+	{
+		if (!journal_)
+		{
+			// A failed rotation left no journal open. An existing journal still matches the state in memory,
+			// otherwise the rotated one is kept as .journal.old and a new journal continues from this state.
+			if (std::filesystem::exists(journalPath_))
+			{
+				openJournal();
+			}
+			else
+			{
+				startJournal(StateHash(state_));
+			}
+		}
+		auto record = codec_.Encode(nlohmann::json::to_cbor(patch));
+		std::uint32_t size = static_cast<std::uint32_t>(record.size());
+		std::uint8_t header[4] = {
+			static_cast<std::uint8_t>(size),
+			static_cast<std::uint8_t>(size >> 8),
+			static_cast<std::uint8_t>(size >> 16),
+			static_cast<std::uint8_t>(size >> 24)
+		};
+
+		if (std::fwrite(header, 1, sizeof(header), journal_) != sizeof(header)
+			|| std::fwrite(record.data(), 1, record.size(), journal_) != record.size()
+			|| !SyncStream(journal_))
+		{
+			throw std::runtime_error("Failed to append to activation journal: " + journalPath_.string());
+		}
+
+		journalBytes_ += sizeof(header) + record.size();
+		++statistics_.recordsAppended;
+		statistics_.bytesAppended += sizeof(header) + record.size();
+	}
+
+	std::uint64_t writeSnapshot(const nlohmann::json& state)
+	{
+		auto blob = codec_.Encode(nlohmann::json::to_cbor(state));
+
+		auto stagedPath = snapshotPath_;
+		stagedPath += ".tmp";
+		{
+			std::ofstream file(stagedPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+			if (!file)
+			{
+				throw std::runtime_error("Failed to write activation snapshot: " + stagedPath.string());
+			}
+		}
+		StorageHelpers::ReplaceFileAtomically(stagedPath, snapshotPath_);
+		return blob.size();
+	}
+
+	void runCompactor()
+	{
+		Tracing::NameThread("Journal compactor");
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			wakeCompactor_.wait(lock, [this]() { return stopping_ || compactionRequested_; });
+			if (stopping_)
+			{
+				return;
+			}
+
+			compacting_ = true;
+			try
+			{
+				// Rotate the journal under the lock, new saves go to a journal based on the current state
+				closeJournal();
+				std::filesystem::rename(journalPath_, oldJournalPath_);
+				startJournal(StateHash(state_));
+				nlohmann::json snapshot = state_;
+
+				lock.unlock();
+				Tracing::Span span(Tracing::Categories::Storage, "Storage.Compact");
+				auto snapshotBytes = writeSnapshot(snapshot);
+				span.arg("snapshotBytes", std::to_string(snapshotBytes));
+				std::filesystem::remove(oldJournalPath_);
+				lock.lock();
+
+				++statistics_.compactions;
+				statistics_.snapshotBytesWritten += snapshotBytes;
+			}
+			catch (const std::exception& e)
+			{
+				if (!lock.owns_lock())
+				{
+					lock.lock();
+				}
+				Log::Error(Log::Categories::Storage, "Activation journal compaction failed", { { "error", e.what() } });
+				if (!journal_ && !std::filesystem::exists(journalPath_) && std::filesystem::exists(oldJournalPath_))
+				{
+					// The rotation failed before a new journal existed, keep appending to the previous one
+					std::error_code ec;
+					std::filesystem::rename(oldJournalPath_, journalPath_, ec);
+				}
+			}
+
+			compactionRequested_ = false;
+			compacting_ = false;
+			compactionFinished_.notify_all();
+		}
+	}
+
+	const std::filesystem::path snapshotPath_;
+	const std::filesystem::path journalPath_;
+	const std::filesystem::path oldJournalPath_;
+	const SecureBlobCodec codec_;
+	std::shared_ptr<Persistence::Storage::IActivationStorage> legacyStorage_;
+	const std::uint64_t compactionThresholdBytes_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable wakeCompactor_;
+	std::condition_variable compactionFinished_;
+	bool recovered_{ false };
+	nlohmann::json state_;
+	Persistence::PersistentData data_;
+	std::FILE* journal_{ nullptr };
+	std::uint64_t journalBytes_{ 0 };
+	bool compactionRequested_{ false };
+	bool compacting_{ false };
+	bool stopping_{ false };
+	Statistics statistics_;
+
+	std::thread compactor_;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <ctime>
+
+// When a lease is refreshed, with the current time passed in. The agent, the seat pool and the shared activation
+// decide on the wall clock, the fleet simulator (Tools/FleetSimulator) on its virtual clock.
+namespace LeasePolicy
+{
+	// True once the lease expires within the refresh window, also when it already expired
+	inline bool RefreshDue(std::time_t leaseExpiry, std::time_t now, int refreshBeforeExpirySeconds)
+	{
+		return std::difftime(leaseExpiry, now) <= refreshBeforeExpirySeconds;
+	}
+}
@@ -6,10 +6,16 @@
 #include <memory>
 
 #include "IActivationStorage.hpp"
+#include "CachedActivationStorage.hpp"
+#include "WriteBehindActivationStorage.hpp"
+#include "JournaledActivationStorage.hpp"
+#include "LockedActivationStorage.hpp"
+#include "DeviceFingerprint.hpp"
 #include "SecureActivationStorage.hpp"
 #include "SecureStorage.hpp" 
 #include "CoreLibraryManagerConfigProvider.hpp"
 #include "Helpers.hpp"
+#include "ActivationConfig.hpp"
 
 using namespace ZentitleLicensingClient;
 
@@ -28,10 +34,25 @@ public:
 
 	enum DeletionPrompt
 	{
-		Ask, Skip
+		Ask, Skip, Keep
 	};
 
-	static std::shared_ptr<Persistence::Storage::IActivationStorage> Initialize(bool useCoreLibrary, const std::string libraryPath = "", const std::string libraryName = "", const DeletionPrompt deletionPrompt = DeletionPrompt::Skip)
+	// Folder that holds the activation data for the given scope
+	static std::filesystem::path StorageDirectory(ActivationConsole::StorageScope scope)
+	{
+		auto folder = scope == ActivationConsole::StorageScope::Machine ? PredefinedFolder::PUBLIC_DATA : PredefinedFolder::USER_DATA;
+		return std::filesystem::path(SecureStorage::getSystemFolder(folder)) / AppDirectory;
+	}
+
+	// Permissions of the lock, snapshot and recorder files in the storage directory. User scope files are private to the
+	// user, machine scope files are shared with the group of the creating process, the same as the machine-wide agent socket.
+	static int FileMode(ActivationConsole::StorageScope scope)
+	{
+		return scope == ActivationConsole::StorageScope::Machine ? 0660 : 0600;
+	}
+
+	// appDirectory is relative to the data folder of the scope, the performance scenarios keep their seats apart from the console's
+	static std::shared_ptr<Persistence::Storage::IActivationStorage> Initialize(bool useCoreLibrary, const std::string libraryPath = "", const std::string libraryName = "", const DeletionPrompt deletionPrompt = DeletionPrompt::Skip, const ActivationConsole::StorageConfig& storageConfig = {}, const std::string& appDirectory = AppDirectory)
 	{
 		std::shared_ptr<Persistence::Storage::IActivationStorage> storage = nullptr;
 
@@ -41,12 +62,64 @@ public:
 			CoreLibraryManagerConfigProvider configProvider(libraryPath, libraryName);
 			SecureActivationStorage::setLibraryConfig(configProvider);
 
-			storage = std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
-				SecureStorage::getSystemFolder(PredefinedFolder::USER_DATA),
-				AppDirectory,
+			const bool machineWide = storageConfig.Scope == ActivationConsole::StorageScope::Machine;
+			const auto systemFolder = SecureStorage::getSystemFolder(machineWide ? PredefinedFolder::PUBLIC_DATA : PredefinedFolder::USER_DATA);
+			const auto storageDirectory = std::filesystem::path(systemFolder) / appDirectory;
+
+			auto secureStorage = std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
+				systemFolder,
+				appDirectory,
 				"license.encrypted"
 			)
 			);
+
+			std::shared_ptr<Persistence::Storage::IActivationStorage> persistence = secureStorage;
+			if (storageConfig.Backend == ActivationConsole::StorageBackend::Journaled)
+			{
+				// The journal key combines the random secret in license.key, readable by this user only, with the
+				// device fingerprint, so the files cannot be forged by other users or moved to another machine.
+				// The existing license.encrypted is imported on first use and removed afterwards.
+				auto fingerprint = DeviceFingerprint::Generate(libraryPath + libraryName);
+				if (!fingerprint)
+				{
+					throw std::runtime_error("Failed to generate the device fingerprint for the journaled storage");
+				}
+				std::filesystem::create_directories(storageDirectory);
+				auto secret = SecureBlobCodec::LoadOrCreateKey(storageDirectory / "license.key");
+
+				storage = std::make_shared<JournaledActivationStorage>(
+					storageDirectory,
+					"license",
+					SecureBlobCodec::DeriveKey(std::string(secret.begin(), secret.end()) + *fingerprint, "Z2_OnlineActivation_Console/journal"),
+					secureStorage,
+					storageConfig.JournalCompactionBytes,
+					storageConfig.Compression);
+			}
+			else if (machineWide)
+			{
+				// Every process on the host reads and writes the same file, writes are never held back
+				persistence = std::make_shared<LockedActivationStorage>(secureStorage, storageDirectory / "license.lock", FileMode(storageConfig.Scope));
+			}
+			else if (storageConfig.WriteBehindDebounceMs > 0)
+			{
+				auto stagingStorage = std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
+					systemFolder,
+					appDirectory,
+					"license.encrypted.tmp"
+				)
+				);
+
+				auto writeBehindStorage = std::make_shared<WriteBehindActivationStorage>(
+					secureStorage, stagingStorage, std::chrono::milliseconds(storageConfig.WriteBehindDebounceMs));
+				ActiveWriteBehindStorage() = writeBehindStorage;
+				persistence = writeBehindStorage;
+			}
+
+			if (!storage)
+			{
+				// Serve repeated state reads from memory instead of decrypting the file each time
+				storage = std::make_shared<CachedActivationStorage>(persistence);
+			}
 		}
 		else
 		{
@@ -54,13 +127,14 @@ public:
 		}
 
 		// Log storage details
-		std::cout << "- Using SecureActivationStorage storage with file: " << storage->storageId() << "\n";
+		std::cout << "- Using " << (storageConfig.Backend == ActivationConsole::StorageBackend::Journaled ? "JournaledActivationStorage" : "SecureActivationStorage")
+			<< " storage with file: " << storage->storageId() << "\n";
 
 		// Load data from storage
 		auto resultFuture = storage->load();
 		auto data = resultFuture.get();
 
-		if (data.isEmpty())
+		if (data.isEmpty() || deletionPrompt == DeletionPrompt::Keep)
 		{
 			return storage;
 		}
@@ -84,7 +158,52 @@ public:
 		return storage;
 	}
 
+	// License file of one seat of the warm seat pool (see SeatPool.hpp). Not cached: the seat pool manager reads
+	// it back after the worker that leased the seat changed it.
+	static std::shared_ptr<Persistence::Storage::IActivationStorage> ForPooledSeat(const std::string libraryPath, const std::string libraryName,
+		ActivationConsole::StorageScope scope, const std::string& seatName)
+	{
+		return ForSeatFolder(libraryPath, libraryName, scope, std::filesystem::path("seat-pool") / seatName);
+	}
+
+	// License file of a seat activated by --provision, one folder per seat under <storage folder>/provisioned
+	static std::shared_ptr<Persistence::Storage::IActivationStorage> ForProvisionedSeat(const std::string libraryPath, const std::string libraryName,
+		ActivationConsole::StorageScope scope, const std::string& folderName)
+	{
+		return ForSeatFolder(libraryPath, libraryName, scope, std::filesystem::path("provisioned") / folderName);
+	}
+
+	// Writes out any activation data still held back by the write-behind storage
+	static void Flush()
+	{
+		if (auto writeBehindStorage = ActiveWriteBehindStorage().lock())
+		{
+			writeBehindStorage->flush();
+		}
+	}
+
 private:
+	static std::shared_ptr<Persistence::Storage::IActivationStorage> ForSeatFolder(const std::string& libraryPath, const std::string& libraryName,
+		ActivationConsole::StorageScope scope, const std::filesystem::path& seatFolder)
+	{
+		CoreLibraryManagerConfigProvider configProvider(libraryPath, libraryName);
+		SecureActivationStorage::setLibraryConfig(configProvider);
+
+		const auto systemFolder = SecureStorage::getSystemFolder(scope == ActivationConsole::StorageScope::Machine ? PredefinedFolder::PUBLIC_DATA : PredefinedFolder::USER_DATA);
+		return std::make_shared<SecureActivationStorage>(SecureActivationStorage::withAppDirectory(
+			systemFolder,
+			(std::filesystem::path(AppDirectory) / seatFolder).string(),
+			"license.encrypted"
+		)
+		);
+	}
+
+	static std::weak_ptr<WriteBehindActivationStorage>& ActiveWriteBehindStorage()
+	{
+		static std::weak_ptr<WriteBehindActivationStorage> storage;
+		return storage;
+	}
+
 	// Utility to prompt confirmation
 	static bool ConfirmPrompt(const std::string& message)
 	{
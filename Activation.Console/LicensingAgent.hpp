@@ -0,0 +1,899 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "Activation.hpp"
+#include "ActivationConfig.hpp"
+#include "ActivationStateModel.hpp"
+#include "ActiveFeatureSet.hpp"
+#include "FlightRecorder.hpp"
+#include "LicensingApiException.hpp"
+#include "LeasePolicy.hpp"
+#include "LicensingAgentProtocol.hpp"
+#include "LicensingCall.hpp"
+#include "Logger.hpp"
+#include "ShutdownDrain.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Daemon mode of the console: owns the process' Activation and serves feature checks, checkout/return and
+// usage tracking to local clients over a Unix domain socket (see LicensingAgentProtocol.hpp).
+//
+// A single event loop thread (epoll on Linux, poll elsewhere) accepts connections, parses frames and answers
+// state and feature checks from an in-memory copy of the activation state, so they never touch the SDK.
+// Operations that call the licensing API run one at a time on a worker thread; when one completes the worker
+// hands the answer and a fresh copy of the state back to the loop. The worker also keeps the lease alive.
+class LicensingAgent
+{
+public:
+	using ChangeCallback = std::function<void()>;
+
+	// activationMutex guards every SDK call, onChange runs on the worker after each change (outside the mutex)
+	// shared: the socket is reachable by the members of the agent's group (machine-wide activation), otherwise by the owner only.
+	LicensingAgent(std::shared_ptr<Activation> activation, std::timed_mutex& activationMutex, const std::string& socketPath, bool shared,
+		const ActivationConsole::AgentConfig& config, ChangeCallback onChange = {})
+		: activation_(std::move(activation)), activationMutex_(activationMutex), socketPath_(socketPath), shared_(shared), config_(config), onChange_(std::move(onChange))
+	{
+		int pipeFds[2];
+		if (::pipe(pipeFds) != 0)
+		{
+			throw std::runtime_error(std::string("Failed to create agent wake pipe: ") + std::strerror(errno));
+		}
+		wakeRead_ = pipeFds[0];
+		wakeWrite_ = pipeFds[1];
+		SetNonBlocking(wakeRead_);
+		SetNonBlocking(wakeWrite_);
+
+		listenFd_ = Listen(socketPath_, shared ? 0660 : 0600);
+
+#ifdef __linux__
+		epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+		if (epollFd_ < 0)
+		{
+			throw std::runtime_error(std::string("Failed to create agent epoll instance: ") + std::strerror(errno));
+		}
+		watch(listenFd_, ListenerId, EPOLLIN);
+		watch(wakeRead_, WakeId, EPOLLIN);
+#endif
+
+		std::lock_guard<std::timed_mutex> lock(activationMutex_);
+		cache_ = captureState();
+	}
+
+	~LicensingAgent()
+	{
+		stop();
+		for (auto& entry : connections_)
+		{
+			::close(entry.second.fd);
+		}
+#ifdef __linux__
+		::close(epollFd_);
+#endif
+		::close(listenFd_);
+		::close(wakeRead_);
+		::close(wakeWrite_);
+
+		std::error_code ec;
+		std::filesystem::remove(socketPath_, ec);
+	}
+
+	LicensingAgent(const LicensingAgent&) = delete;
+	LicensingAgent& operator=(const LicensingAgent&) = delete;
+
+	// Serves clients on the calling thread until stop() is called
+	void run()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex_);
+			running_ = true;
+		}
+		worker_ = std::thread([this]() { work(); });
+
+		Log::Information(Log::Categories::Agent, "Licensing agent listening", { { "socket", socketPath_ } });
+		// stop() waits for the worker to be joined, so a failing event loop must still get there
+		std::exception_ptr failure;
+		try
+		{
+			while (!stopping_)
+			{
+				pollOnce();
+			}
+		}
+		catch (const std::exception& e)
+		{
+			Log::Error(Log::Categories::Agent, "Licensing agent event loop failed", { { "error", e.what() } });
+			failure = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex_);
+			workerStopping_ = true;
+		}
+		jobsChanged_.notify_all();
+		worker_.join();
+
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex_);
+			running_ = false;
+		}
+		stopped_.notify_all();
+
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	// Safe from any thread and from shutdown hooks, returns once run() has finished
+	void stop()
+	{
+		stopping_ = true;
+		wake();
+
+		std::unique_lock<std::mutex> lock(jobsMutex_);
+		stopped_.wait(lock, [this]() { return !running_; });
+	}
+
+private:
+	static constexpr std::uint64_t ListenerId = 0;
+	static constexpr std::uint64_t WakeId = 1;
+	// Per connection and direction. Frames are parsed as they arrive, so only a client that does not read its
+	// answers can exceed it, such a client is dropped.
+	static constexpr std::size_t MaxBufferedBytes = 4 * LicensingAgentProtocol::MaxBodySize;
+
+	struct CachedState
+	{
+		LicensingAgentProtocol::StateStatus state;
+		std::unordered_map<std::string, LicensingAgentProtocol::FeatureStatus> features;
+	};
+
+	struct Connection
+	{
+		int fd{ -1 };
+		std::vector<std::uint8_t> input;
+		std::vector<std::uint8_t> output;
+		std::size_t pendingJobs{ 0 };
+		bool closing{ false }; ///< Peer hung up, closed once the pending jobs have been answered
+	};
+
+	struct Job
+	{
+		std::uint64_t connectionId{ 0 };
+		std::uint32_t requestId{ 0 };
+		LicensingAgentProtocol::Opcode opcode{ LicensingAgentProtocol::Ping };
+		std::string key;
+		std::int32_t amount{ 0 };
+	};
+
+	struct Completion
+	{
+		std::uint64_t connectionId{ 0 };
+		std::vector<std::uint8_t> response;
+		std::shared_ptr<CachedState> state;
+	};
+
+	static void SetNonBlocking(int fd)
+	{
+		int flags = ::fcntl(fd, F_GETFL, 0);
+		::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+		::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+
+	static int Listen(const std::string& path, int mode)
+	{
+		sockaddr_un address{};
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			throw std::runtime_error("Agent socket path is too long: " + path);
+		}
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+		int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+		{
+			throw std::runtime_error(std::string("Failed to create agent socket: ") + std::strerror(errno));
+		}
+
+		// A socket file left behind by a crashed agent refuses connections and can be replaced
+		if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+		{
+			::close(fd);
+			throw std::runtime_error("Another licensing agent is already listening on " + path);
+		}
+		::close(fd);
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+
+		fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0
+			|| ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+			|| ::chmod(path.c_str(), static_cast<mode_t>(mode)) != 0
+			|| ::listen(fd, SOMAXCONN) != 0)
+		{
+			int error = errno;
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+			throw std::runtime_error("Failed to listen on " + path + ": " + std::strerror(error));
+		}
+		SetNonBlocking(fd);
+		return fd;
+	}
+
+	void wake()
+	{
+		const char signal = 1;
+		// A full pipe already guarantees a wake up
+		(void)!::write(wakeWrite_, &signal, 1);
+	}
+
+#ifdef __linux__
+	void watch(int fd, std::uint64_t id, std::uint32_t events)
+	{
+		epoll_event event{};
+		event.events = events;
+		event.data.u64 = id;
+		if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0)
+		{
+			throw std::runtime_error(std::string("Failed to watch agent socket: ") + std::strerror(errno));
+		}
+	}
+
+	void updateInterest(std::uint64_t id, Connection& connection)
+	{
+		// A closing connection only waits for its jobs, it must not keep reporting the hang up
+		if (connection.closing)
+		{
+			::epoll_ctl(epollFd_, EPOLL_CTL_DEL, connection.fd, nullptr);
+			return;
+		}
+
+		epoll_event event{};
+		event.events = EPOLLIN | EPOLLRDHUP;
+		if (!connection.output.empty())
+		{
+			event.events |= EPOLLOUT;
+		}
+		event.data.u64 = id;
+		::epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection.fd, &event);
+	}
+
+	void pollOnce()
+	{
+		epoll_event events[64];
+		int count = ::epoll_wait(epollFd_, events, 64, -1);
+		if (count < 0)
+		{
+			if (errno != EINTR)
+			{
+				throw std::runtime_error(std::string("Agent event loop failed: ") + std::strerror(errno));
+			}
+			return;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			dispatch(events[i].data.u64,
+				(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) != 0,
+				(events[i].events & EPOLLOUT) != 0);
+		}
+	}
+#else
+	void updateInterest(std::uint64_t, Connection&)
+	{
+	}
+
+	void pollOnce()
+	{
+		std::vector<pollfd> fds;
+		std::vector<std::uint64_t> ids;
+		fds.reserve(connections_.size() + 2);
+		fds.push_back({ listenFd_, POLLIN, 0 });
+		ids.push_back(ListenerId);
+		fds.push_back({ wakeRead_, POLLIN, 0 });
+		ids.push_back(WakeId);
+		for (const auto& entry : connections_)
+		{
+			if (entry.second.closing)
+			{
+				continue;
+			}
+			short events = static_cast<short>(POLLIN | (entry.second.output.empty() ? 0 : POLLOUT));
+			fds.push_back({ entry.second.fd, events, 0 });
+			ids.push_back(entry.first);
+		}
+
+		int count = ::poll(fds.data(), static_cast<nfds_t>(fds.size()), -1);
+		if (count < 0)
+		{
+			if (errno != EINTR)
+			{
+				throw std::runtime_error(std::string("Agent event loop failed: ") + std::strerror(errno));
+			}
+			return;
+		}
+
+		for (std::size_t i = 0; i < fds.size(); ++i)
+		{
+			if (fds[i].revents)
+			{
+				dispatch(ids[i], (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0, (fds[i].revents & POLLOUT) != 0);
+			}
+		}
+	}
+#endif
+
+	void dispatch(std::uint64_t id, bool readable, bool writable)
+	{
+		if (id == ListenerId)
+		{
+			acceptClients();
+			return;
+		}
+		if (id == WakeId)
+		{
+			drainWakePipe();
+			applyCompletions();
+			return;
+		}
+
+		auto it = connections_.find(id);
+		if (it == connections_.end())
+		{
+			return;
+		}
+
+		if (readable && !readFrom(id, it->second))
+		{
+			it->second.closing = true;
+		}
+		if (writable || !it->second.output.empty())
+		{
+			writeTo(it->second);
+		}
+		finish(id, it->second);
+	}
+
+	void acceptClients()
+	{
+		while (true)
+		{
+			int fd = ::accept(listenFd_, nullptr, nullptr);
+			if (fd < 0)
+			{
+				return;
+			}
+			if (connections_.size() >= static_cast<std::size_t>(config_.MaxClients) || !PeerAllowed(fd, shared_))
+			{
+				::close(fd);
+				continue;
+			}
+
+			SetNonBlocking(fd);
+			std::uint64_t id = nextConnectionId_++;
+			connections_[id].fd = fd;
+#ifdef __linux__
+			watch(fd, id, EPOLLIN | EPOLLRDHUP);
+#endif
+		}
+	}
+
+	// Without shared access only processes of the agent's user (and root) may connect, even if the socket file
+	// ended up more permissive. Shared access is limited by the group of the socket file.
+	static bool PeerAllowed(int fd, bool shared)
+	{
+		if (shared)
+		{
+			return true;
+		}
+#ifdef __linux__
+		ucred credentials{};
+		socklen_t length = sizeof(credentials);
+		if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+		{
+			return false;
+		}
+		uid_t peer = credentials.uid;
+#else
+		uid_t peer;
+		gid_t group;
+		if (::getpeereid(fd, &peer, &group) != 0)
+		{
+			return false;
+		}
+#endif
+		if (peer != ::geteuid() && peer != 0)
+		{
+			Log::Warning(Log::Categories::Agent, "Refused a client of another user", { { "uid", std::to_string(peer) } });
+			return false;
+		}
+		return true;
+	}
+
+	void drainWakePipe()
+	{
+		char buffer[64];
+		while (::read(wakeRead_, buffer, sizeof(buffer)) > 0)
+		{
+		}
+	}
+
+	// Returns false once the peer hung up or sent something that is not a frame
+	bool readFrom(std::uint64_t id, Connection& connection)
+	{
+		std::uint8_t chunk[4096];
+		while (true)
+		{
+			ssize_t count = ::recv(connection.fd, chunk, sizeof(chunk), 0);
+			if (count > 0)
+			{
+				connection.input.insert(connection.input.end(), chunk, chunk + count);
+				if (connection.input.size() > MaxBufferedBytes && !processInput(id, connection))
+				{
+					return false;
+				}
+				if (exceedsBuffers(connection))
+				{
+					return false;
+				}
+				continue;
+			}
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				return processInput(id, connection) && !exceedsBuffers(connection);
+			}
+			return false;
+		}
+	}
+
+	// Clears the answers of a client that is dropped for exceeding MaxBufferedBytes
+	bool exceedsBuffers(Connection& connection)
+	{
+		if (connection.input.size() <= MaxBufferedBytes && connection.output.size() <= MaxBufferedBytes)
+		{
+			return false;
+		}
+		Log::Warning(Log::Categories::Agent, "Dropped a client that does not read its answers");
+		connection.output.clear();
+		return true;
+	}
+
+	bool processInput(std::uint64_t id, Connection& connection)
+	{
+		std::size_t offset = 0;
+		while (true)
+		{
+			LicensingAgentProtocol::Frame frame;
+			auto consumed = LicensingAgentProtocol::NextFrame(connection.input.data() + offset, connection.input.size() - offset, frame);
+			if (!consumed)
+			{
+				return false;
+			}
+			if (*consumed == 0)
+			{
+				break;
+			}
+
+			handle(id, connection, frame);
+			offset += *consumed;
+		}
+		connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+		return true;
+	}
+
+	void handle(std::uint64_t id, Connection& connection, const LicensingAgentProtocol::Frame& frame)
+	{
+		using namespace LicensingAgentProtocol;
+		Reader reader(frame.payload, frame.payloadSize);
+
+		switch (frame.code)
+		{
+		case Opcode::Ping:
+			Writer(connection.output, frame.requestId, Status::Ok).u32(Version);
+			return;
+		case Opcode::GetState:
+			Writer(connection.output, frame.requestId, Status::Ok).state(cache_->state);
+			return;
+		case Opcode::CheckFeature:
+		{
+			std::string key;
+			if (!reader.string(key))
+			{
+				Writer(connection.output, frame.requestId, Status::BadRequest);
+				return;
+			}
+			if (cache_->state.state != static_cast<std::int32_t>(ActivationState::Active))
+			{
+				Writer(connection.output, frame.requestId, Status::NotActive);
+				return;
+			}
+
+			auto feature = cache_->features.find(key);
+			if (feature == cache_->features.end())
+			{
+				Writer(connection.output, frame.requestId, Status::UnknownFeature);
+				return;
+			}
+			Writer(connection.output, frame.requestId, Status::Ok).feature(feature->second);
+			return;
+		}
+		case Opcode::CheckoutFeature:
+		case Opcode::ReturnFeature:
+		case Opcode::TrackUsage:
+		{
+			Job job;
+			job.connectionId = id;
+			job.requestId = frame.requestId;
+			job.opcode = static_cast<Opcode>(frame.code);
+			if (!reader.string(job.key) || (job.opcode != Opcode::TrackUsage && !reader.i32(job.amount)))
+			{
+				Writer(connection.output, frame.requestId, Status::BadRequest);
+				return;
+			}
+
+			// The worker runs one job at a time, without a cap a client could queue requests faster than they are answered
+			if (connection.pendingJobs >= static_cast<std::size_t>(config_.MaxPendingRequestsPerClient)
+				|| pendingJobs_ >= static_cast<std::size_t>(config_.MaxPendingRequests))
+			{
+				Writer(connection.output, frame.requestId, Status::Busy);
+				return;
+			}
+
+			++connection.pendingJobs;
+			++pendingJobs_;
+			{
+				std::lock_guard<std::mutex> lock(jobsMutex_);
+				jobs_.push_back(std::move(job));
+			}
+			jobsChanged_.notify_one();
+			return;
+		}
+		default:
+			Writer(connection.output, frame.requestId, Status::BadRequest);
+			return;
+		}
+	}
+
+	void writeTo(Connection& connection)
+	{
+		std::size_t sent = 0;
+		while (sent < connection.output.size())
+		{
+			ssize_t count = ::send(connection.fd, connection.output.data() + sent, connection.output.size() - sent, SendFlags);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					connection.closing = true;
+					connection.output.clear();
+					return;
+				}
+				break;
+			}
+			sent += static_cast<std::size_t>(count);
+		}
+		connection.output.erase(connection.output.begin(), connection.output.begin() + sent);
+	}
+
+	void finish(std::uint64_t id, Connection& connection)
+	{
+		if (connection.closing && connection.pendingJobs == 0)
+		{
+			::close(connection.fd); // Also removes it from the epoll set
+			connections_.erase(id);
+			return;
+		}
+		updateInterest(id, connection);
+	}
+
+	void applyCompletions()
+	{
+		std::deque<Completion> completions;
+		{
+			std::lock_guard<std::mutex> lock(completionsMutex_);
+			completions.swap(completions_);
+		}
+
+		for (auto& completion : completions)
+		{
+			if (completion.state)
+			{
+				cache_ = std::move(completion.state);
+			}
+			if (completion.connectionId == ListenerId)
+			{
+				// Lease check of the worker, not the answer to a job
+				continue;
+			}
+
+			--pendingJobs_;
+			auto it = connections_.find(completion.connectionId);
+			if (it == connections_.end())
+			{
+				continue;
+			}
+
+			Connection& connection = it->second;
+			--connection.pendingJobs;
+			if (!connection.closing)
+			{
+				connection.output.insert(connection.output.end(), completion.response.begin(), completion.response.end());
+				writeTo(connection);
+				if (exceedsBuffers(connection))
+				{
+					connection.closing = true;
+				}
+			}
+			finish(completion.connectionId, connection);
+		}
+	}
+
+	void complete(Completion completion)
+	{
+		{
+			std::lock_guard<std::mutex> lock(completionsMutex_);
+			completions_.push_back(std::move(completion));
+		}
+		wake();
+	}
+
+	// Caller holds activationMutex_
+	std::shared_ptr<CachedState> captureState()
+	{
+		auto cached = std::make_shared<CachedState>();
+		const auto& info = activation_->getActivationInfo();
+
+		cached->state.state = static_cast<std::int32_t>(activation_->getState());
+		cached->state.mode = static_cast<std::int32_t>(info.activationMode);
+		if (info.leaseExpiry)
+		{
+			cached->state.leaseExpiry = static_cast<std::int64_t>(*info.leaseExpiry);
+		}
+		cached->state.featureCount = static_cast<std::uint32_t>(info.features.size());
+		FlightRecorder::Observe(cached->state.state, activation_->getStateAsString(),
+			info.leaseExpiry ? std::optional<std::int64_t>(cached->state.leaseExpiry) : std::nullopt);
+
+		cached->features.reserve(info.features.size());
+		for (const auto& feature : info.features)
+		{
+			LicensingAgentProtocol::FeatureStatus status;
+			status.type = static_cast<std::int32_t>(feature.type);
+			status.flags = static_cast<std::uint8_t>((feature.active ? LicensingAgentProtocol::HasActive : 0)
+				| (feature.available ? LicensingAgentProtocol::HasAvailable : 0)
+				| (feature.total ? LicensingAgentProtocol::HasTotal : 0));
+			status.active = feature.active ? static_cast<std::int64_t>(*feature.active) : 0;
+			status.available = feature.available ? static_cast<std::int64_t>(*feature.available) : 0;
+			status.total = feature.total ? static_cast<std::int64_t>(*feature.total) : 0;
+			cached->features.emplace(feature.key, status);
+		}
+		return cached;
+	}
+
+	void work()
+	{
+		Tracing::NameThread("Agent worker");
+		auto nextLeaseCheck = std::chrono::steady_clock::now();
+		while (true)
+		{
+			Job job;
+			bool haveJob = false;
+			{
+				std::unique_lock<std::mutex> lock(jobsMutex_);
+				jobsChanged_.wait_until(lock, nextLeaseCheck, [this]() { return workerStopping_ || !jobs_.empty(); });
+				if (workerStopping_)
+				{
+					return;
+				}
+				if (!jobs_.empty())
+				{
+					job = std::move(jobs_.front());
+					jobs_.pop_front();
+					haveJob = true;
+				}
+			}
+
+			if (haveJob)
+			{
+				execute(job);
+			}
+
+			// Checked between jobs as well, a steady stream of requests must not starve the lease
+			if (std::chrono::steady_clock::now() >= nextLeaseCheck)
+			{
+				keepLeaseAlive();
+				nextLeaseCheck = std::chrono::steady_clock::now() + std::chrono::seconds(config_.RefreshCheckIntervalSeconds);
+			}
+		}
+	}
+
+	void execute(const Job& job)
+	{
+		LicensingCall::BudgetScope budget;
+		using namespace LicensingAgentProtocol;
+		Completion completion;
+		completion.connectionId = job.connectionId;
+
+		Status status = Status::Ok;
+		std::string error;
+		{
+			std::lock_guard<std::timed_mutex> lock(activationMutex_);
+			try
+			{
+				auto activeFeatureSet = std::dynamic_pointer_cast<ActiveFeatureSet>(activation_->features());
+				if (activation_->getState() != ActivationState::Active)
+				{
+					status = Status::NotActive;
+				}
+				else if (!activeFeatureSet)
+				{
+					status = Status::NotAllowed;
+				}
+				else if (job.opcode == Opcode::CheckoutFeature)
+				{
+					LicensingCall::Call(LicensingCall::Operations::CheckoutFeature, [&]() { return activeFeatureSet->checkoutFeature(job.key, job.amount); });
+					Checkouts().checkedOut(job.key, job.amount);
+				}
+				else if (job.opcode == Opcode::ReturnFeature)
+				{
+					LicensingCall::Call(LicensingCall::Operations::ReturnFeature, [&]() { return activeFeatureSet->returnFeature(job.key, job.amount); });
+					Checkouts().returned(job.key, job.amount);
+				}
+				else
+				{
+					LicensingCall::Call(LicensingCall::Operations::TrackUsage, [&]() { return activeFeatureSet->trackUsage(job.key); });
+				}
+			}
+			catch (LicensingApiException& e)
+			{
+				status = Status::Failed;
+				error = e.what();
+				FlightRecorder::ApiError("Agent request failed: " + e.getApiError().toString());
+			}
+			catch (const std::exception& e)
+			{
+				status = Status::Failed;
+				error = e.what();
+				FlightRecorder::Error(std::string("Agent request failed: ") + e.what());
+			}
+			completion.state = captureState();
+		}
+
+		{
+			Writer writer(completion.response, job.requestId, status);
+			if (status == Status::Failed)
+			{
+				writer.string(error);
+			}
+		}
+
+		if (status == Status::Ok && onChange_)
+		{
+			onChange_();
+		}
+		complete(std::move(completion));
+	}
+
+	void keepLeaseAlive()
+	{
+		Completion completion;
+		bool refreshed = false;
+		{
+			std::lock_guard<std::timed_mutex> lock(activationMutex_);
+			auto state = activation_->getState();
+			const auto& info = activation_->getActivationInfo();
+			if ((state == ActivationState::Active || state == ActivationState::LeaseExpired)
+				&& info.activationMode == ActivationMode::Online
+				&& info.leaseExpiry
+				&& LeasePolicy::RefreshDue(*info.leaseExpiry, std::time(nullptr), config_.RefreshBeforeExpirySeconds))
+			{
+				try
+				{
+					LicensingCall::Call(LicensingCall::Operations::RefreshLease, [&]() { return activation_->refreshLease(); });
+					refreshed = true;
+				}
+				catch (LicensingApiException& e)
+				{
+					Log::Error(Log::Categories::Agent, "Licensing agent lease refresh failed", { { "error", e.what() } });
+					FlightRecorder::ApiError("Agent lease refresh failed: " + e.getApiError().toString());
+				}
+				catch (const std::exception& e)
+				{
+					Log::Error(Log::Categories::Agent, "Licensing agent lease refresh failed", { { "error", e.what() } });
+					FlightRecorder::Error(std::string("Agent lease refresh failed: ") + e.what());
+				}
+			}
+
+			// Also picks up changes made by other processes sharing the activation
+			completion.state = captureState();
+		}
+
+		if (refreshed && onChange_)
+		{
+			onChange_();
+		}
+		completion.connectionId = ListenerId;
+		complete(std::move(completion));
+	}
+
+#ifdef MSG_NOSIGNAL
+	static constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+	static constexpr int SendFlags = 0;
+#endif
+
+	std::shared_ptr<Activation> activation_;
+	std::timed_mutex& activationMutex_;
+	std::string socketPath_;
+	bool shared_;
+	ActivationConsole::AgentConfig config_;
+	ChangeCallback onChange_;
+
+	int listenFd_{ -1 };
+	int wakeRead_{ -1 };
+	int wakeWrite_{ -1 };
+#ifdef __linux__
+	int epollFd_{ -1 };
+#endif
+
+	// Owned by the event loop thread
+	std::unordered_map<std::uint64_t, Connection> connections_;
+	std::uint64_t nextConnectionId_{ WakeId + 1 };
+	std::shared_ptr<CachedState> cache_;
+	std::size_t pendingJobs_{ 0 }; ///< Jobs queued or running for all connections
+
+	std::atomic<bool> stopping_{ false };
+	std::mutex jobsMutex_;
+	std::condition_variable jobsChanged_;
+	std::condition_variable stopped_;
+	std::deque<Job> jobs_;
+	bool workerStopping_{ false };
+	bool running_{ false };
+	std::thread worker_;
+
+	std::mutex completionsMutex_;
+	std::deque<Completion> completions_;
+};
+
+#endif
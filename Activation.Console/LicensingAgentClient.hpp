@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "LicensingAgentProtocol.hpp"
+
+// Blocking client for the licensing agent, for applications that ask the agent instead of embedding the SDK.
+// One request is in flight at a time; share a client between threads only with external locking.
+// Throws std::runtime_error when the agent cannot be reached or the connection breaks.
+class LicensingAgentClient
+{
+public:
+	explicit LicensingAgentClient(const std::string& socketPath)
+	{
+		sockaddr_un address{};
+		if (socketPath.size() >= sizeof(address.sun_path))
+		{
+			throw std::runtime_error("Agent socket path is too long: " + socketPath);
+		}
+
+		fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd_ < 0)
+		{
+			throw std::runtime_error(std::string("Failed to create agent socket: ") + std::strerror(errno));
+		}
+
+		address.sun_family = AF_UNIX;
+		std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+		if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			int error = errno;
+			::close(fd_);
+			throw std::runtime_error("Failed to connect to the licensing agent at " + socketPath + ": " + std::strerror(error));
+		}
+	}
+
+	~LicensingAgentClient()
+	{
+		::close(fd_);
+	}
+
+	LicensingAgentClient(const LicensingAgentClient&) = delete;
+	LicensingAgentClient& operator=(const LicensingAgentClient&) = delete;
+
+	std::uint32_t ping()
+	{
+		auto response = call(LicensingAgentProtocol::Ping, [](LicensingAgentProtocol::Writer&) {});
+		std::uint32_t version = 0;
+		LicensingAgentProtocol::Reader reader(response.payload.data(), response.payload.size());
+		if (response.status != LicensingAgentProtocol::Ok || !reader.u32(version))
+		{
+			throw std::runtime_error("Invalid ping response from the licensing agent");
+		}
+		return version;
+	}
+
+	LicensingAgentProtocol::StateStatus getState()
+	{
+		auto response = call(LicensingAgentProtocol::GetState, [](LicensingAgentProtocol::Writer&) {});
+		LicensingAgentProtocol::StateStatus state;
+		LicensingAgentProtocol::Reader reader(response.payload.data(), response.payload.size());
+		if (response.status != LicensingAgentProtocol::Ok || !reader.state(state))
+		{
+			throw std::runtime_error("Invalid state response from the licensing agent");
+		}
+		return state;
+	}
+
+	// std::nullopt when the feature is unknown or the activation is not active
+	std::optional<LicensingAgentProtocol::FeatureStatus> checkFeature(const std::string& key)
+	{
+		auto response = call(LicensingAgentProtocol::CheckFeature, [&](LicensingAgentProtocol::Writer& writer) { writer.string(key); });
+		if (response.status != LicensingAgentProtocol::Ok)
+		{
+			return std::nullopt;
+		}
+
+		LicensingAgentProtocol::FeatureStatus feature;
+		LicensingAgentProtocol::Reader reader(response.payload.data(), response.payload.size());
+		if (!reader.feature(feature))
+		{
+			throw std::runtime_error("Invalid feature response from the licensing agent");
+		}
+		return feature;
+	}
+
+	LicensingAgentProtocol::Status checkoutFeature(const std::string& key, std::int32_t amount, std::string* error = nullptr)
+	{
+		return change(LicensingAgentProtocol::CheckoutFeature, key, amount, error);
+	}
+
+	LicensingAgentProtocol::Status returnFeature(const std::string& key, std::int32_t amount, std::string* error = nullptr)
+	{
+		return change(LicensingAgentProtocol::ReturnFeature, key, amount, error);
+	}
+
+	LicensingAgentProtocol::Status trackUsage(const std::string& key, std::string* error = nullptr)
+	{
+		auto response = call(LicensingAgentProtocol::TrackUsage, [&](LicensingAgentProtocol::Writer& writer) { writer.string(key); });
+		return result(response, error);
+	}
+
+private:
+	struct Response
+	{
+		LicensingAgentProtocol::Status status{ LicensingAgentProtocol::Failed };
+		std::vector<std::uint8_t> payload;
+	};
+
+	template <typename Fill>
+	Response call(LicensingAgentProtocol::Opcode opcode, Fill fill)
+	{
+		std::uint32_t requestId = ++lastRequestId_;
+		std::vector<std::uint8_t> request;
+		{
+			LicensingAgentProtocol::Writer writer(request, requestId, opcode);
+			fill(writer);
+		}
+		sendAll(request);
+
+		while (true)
+		{
+			LicensingAgentProtocol::Frame frame;
+			auto consumed = LicensingAgentProtocol::NextFrame(received_.data(), received_.size(), frame);
+			if (!consumed)
+			{
+				throw std::runtime_error("Corrupt response from the licensing agent");
+			}
+
+			if (*consumed == 0)
+			{
+				receiveMore();
+				continue;
+			}
+
+			Response response;
+			response.status = static_cast<LicensingAgentProtocol::Status>(frame.code);
+			response.payload.assign(frame.payload, frame.payload + frame.payloadSize);
+			received_.erase(received_.begin(), received_.begin() + *consumed);
+
+			// Answers to requests abandoned after an earlier error are skipped
+			if (frame.requestId == requestId)
+			{
+				return response;
+			}
+		}
+	}
+
+	LicensingAgentProtocol::Status change(LicensingAgentProtocol::Opcode opcode, const std::string& key, std::int32_t amount, std::string* error)
+	{
+		auto response = call(opcode, [&](LicensingAgentProtocol::Writer& writer) { writer.string(key).i32(amount); });
+		return result(response, error);
+	}
+
+	static LicensingAgentProtocol::Status result(const Response& response, std::string* error)
+	{
+		if (error && response.status == LicensingAgentProtocol::Failed)
+		{
+			LicensingAgentProtocol::Reader reader(response.payload.data(), response.payload.size());
+			reader.string(*error);
+		}
+		return response.status;
+	}
+
+	void sendAll(const std::vector<std::uint8_t>& data)
+	{
+		std::size_t sent = 0;
+		while (sent < data.size())
+		{
+			ssize_t written = ::send(fd_, data.data() + sent, data.size() - sent, SendFlags);
+			if (written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (written <= 0)
+			{
+				throw std::runtime_error(std::string("Failed to send to the licensing agent: ") + std::strerror(errno));
+			}
+			sent += static_cast<std::size_t>(written);
+		}
+	}
+
+	void receiveMore()
+	{
+		std::uint8_t chunk[4096];
+		while (true)
+		{
+			ssize_t count = ::recv(fd_, chunk, sizeof(chunk), 0);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count == 0)
+			{
+				throw std::runtime_error("The licensing agent closed the connection");
+			}
+			if (count < 0)
+			{
+				throw std::runtime_error(std::string("Failed to receive from the licensing agent: ") + std::strerror(errno));
+			}
+			received_.insert(received_.end(), chunk, chunk + count);
+			return;
+		}
+	}
+
+#ifdef MSG_NOSIGNAL
+	static constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+	static constexpr int SendFlags = 0;
+#endif
+
+	int fd_{ -1 };
+	std::uint32_t lastRequestId_{ 0 };
+	std::vector<std::uint8_t> received_;
+};
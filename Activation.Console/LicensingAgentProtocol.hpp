@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Wire format spoken between the licensing agent (console started with --agent) and local clients.
+// Has no SDK dependencies so client applications can include it on its own.
+//
+// Every message is a frame: [body length (4 bytes)][request id (4 bytes)][opcode or status (1 byte)][payload].
+// Integers are little endian, strings are [length (2 bytes)][bytes]. Responses carry the request id of the
+// request they answer; the agent answers requests of one connection in order except for the blocking
+// operations (checkout, return, usage tracking), which complete whenever the licensing API responds.
+namespace LicensingAgentProtocol
+{
+	constexpr std::uint32_t Version = 1;
+	constexpr std::size_t LengthSize = 4;
+	constexpr std::size_t HeaderSize = 4 + 1;                ///< Request id and opcode/status, counted in the body length
+	constexpr std::uint32_t MaxBodySize = 64 * 1024;
+	constexpr std::size_t MaxKeyLength = 0xFFFF;
+
+	enum Opcode : std::uint8_t
+	{
+		Ping = 1,            ///< Reply: [protocol version (u32)]
+		GetState = 2,        ///< Reply: [state (i32)][mode (i32)][has lease expiry (u8)][lease expiry (i64)][feature count (u32)]
+		CheckFeature = 3,    ///< Request: [key]. Reply: FeatureStatus
+		CheckoutFeature = 4, ///< Request: [key][amount (i32)]
+		ReturnFeature = 5,   ///< Request: [key][amount (i32)]
+		TrackUsage = 6       ///< Request: [key]
+	};
+
+	enum Status : std::uint8_t
+	{
+		Ok = 0,
+		UnknownFeature = 1,
+		NotActive = 2,   ///< The activation is not in the Active state
+		NotAllowed = 3,  ///< Feature set is read only (offline activation)
+		Failed = 4,      ///< Reply: [error message]
+		BadRequest = 5,
+		Busy = 6         ///< Too many checkouts, returns and usage tracks are queued, retry later
+	};
+
+	enum FeatureFlags : std::uint8_t
+	{
+		HasActive = 1 << 0,
+		HasAvailable = 1 << 1,
+		HasTotal = 1 << 2
+	};
+
+	struct FeatureStatus
+	{
+		std::int32_t type{ 0 }; ///< FeatureType as integer
+		std::uint8_t flags{ 0 };
+		std::int64_t active{ 0 };
+		std::int64_t available{ 0 };
+		std::int64_t total{ 0 };
+	};
+
+	struct StateStatus
+	{
+		std::int32_t state{ 0 }; ///< ActivationState as integer
+		std::int32_t mode{ 0 };  ///< ActivationMode as integer
+		std::optional<std::int64_t> leaseExpiry;
+		std::uint32_t featureCount{ 0 };
+	};
+
+	// Appends one frame to a byte buffer
+	class Writer
+	{
+	public:
+		Writer(std::vector<std::uint8_t>& buffer, std::uint32_t requestId, std::uint8_t code)
+			: buffer_(buffer), start_(buffer.size())
+		{
+			u32(0);
+			u32(requestId);
+			u8(code);
+		}
+
+		~Writer()
+		{
+			std::uint32_t length = static_cast<std::uint32_t>(buffer_.size() - start_ - LengthSize);
+			for (std::size_t i = 0; i < LengthSize; ++i)
+			{
+				buffer_[start_ + i] = static_cast<std::uint8_t>(length >> (8 * i));
+			}
+		}
+
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		Writer& u8(std::uint8_t value)
+		{
+			buffer_.push_back(value);
+			return *this;
+		}
+
+		Writer& u32(std::uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				buffer_.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+			}
+			return *this;
+		}
+
+		Writer& i32(std::int32_t value)
+		{
+			return u32(static_cast<std::uint32_t>(value));
+		}
+
+		Writer& i64(std::int64_t value)
+		{
+			std::uint64_t bits = static_cast<std::uint64_t>(value);
+			for (int i = 0; i < 8; ++i)
+			{
+				buffer_.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+			}
+			return *this;
+		}
+
+		Writer& string(const std::string& value)
+		{
+			std::size_t length = value.size() < MaxKeyLength ? value.size() : MaxKeyLength;
+			buffer_.push_back(static_cast<std::uint8_t>(length));
+			buffer_.push_back(static_cast<std::uint8_t>(length >> 8));
+			buffer_.insert(buffer_.end(), value.begin(), value.begin() + length);
+			return *this;
+		}
+
+		Writer& feature(const FeatureStatus& status)
+		{
+			return i32(status.type).u8(status.flags).i64(status.active).i64(status.available).i64(status.total);
+		}
+
+		Writer& state(const StateStatus& status)
+		{
+			return i32(status.state).i32(status.mode).u8(status.leaseExpiry ? 1 : 0)
+				.i64(status.leaseExpiry.value_or(0)).u32(status.featureCount);
+		}
+
+	private:
+		std::vector<std::uint8_t>& buffer_;
+		std::size_t start_;
+	};
+
+	// Bounds checked reader over one frame body, every accessor returns false once the body is exhausted
+	class Reader
+	{
+	public:
+		Reader(const std::uint8_t* data, std::size_t size)
+			: data_(data), size_(size)
+		{
+		}
+
+		bool u8(std::uint8_t& value)
+		{
+			if (size_ - offset_ < 1)
+			{
+				return false;
+			}
+			value = data_[offset_++];
+			return true;
+		}
+
+		bool u32(std::uint32_t& value)
+		{
+			if (size_ - offset_ < 4)
+			{
+				return false;
+			}
+			value = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				value |= static_cast<std::uint32_t>(data_[offset_++]) << (8 * i);
+			}
+			return true;
+		}
+
+		bool i32(std::int32_t& value)
+		{
+			std::uint32_t bits = 0;
+			if (!u32(bits))
+			{
+				return false;
+			}
+			value = static_cast<std::int32_t>(bits);
+			return true;
+		}
+
+		bool i64(std::int64_t& value)
+		{
+			if (size_ - offset_ < 8)
+			{
+				return false;
+			}
+			std::uint64_t bits = 0;
+			for (int i = 0; i < 8; ++i)
+			{
+				bits |= static_cast<std::uint64_t>(data_[offset_++]) << (8 * i);
+			}
+			value = static_cast<std::int64_t>(bits);
+			return true;
+		}
+
+		bool string(std::string& value)
+		{
+			if (size_ - offset_ < 2)
+			{
+				return false;
+			}
+			std::size_t length = data_[offset_] | (static_cast<std::size_t>(data_[offset_ + 1]) << 8);
+			offset_ += 2;
+			if (size_ - offset_ < length)
+			{
+				return false;
+			}
+			value.assign(reinterpret_cast<const char*>(data_ + offset_), length);
+			offset_ += length;
+			return true;
+		}
+
+		bool feature(FeatureStatus& status)
+		{
+			return i32(status.type) && u8(status.flags) && i64(status.active) && i64(status.available) && i64(status.total);
+		}
+
+		bool state(StateStatus& status)
+		{
+			std::uint8_t hasLeaseExpiry = 0;
+			std::int64_t leaseExpiry = 0;
+			if (!i32(status.state) || !i32(status.mode) || !u8(hasLeaseExpiry) || !i64(leaseExpiry) || !u32(status.featureCount))
+			{
+				return false;
+			}
+			status.leaseExpiry = hasLeaseExpiry ? std::optional<std::int64_t>(leaseExpiry) : std::nullopt;
+			return true;
+		}
+
+	private:
+		const std::uint8_t* data_;
+		std::size_t size_;
+		std::size_t offset_{ 0 };
+	};
+
+	struct Frame
+	{
+		std::uint32_t requestId{ 0 };
+		std::uint8_t code{ 0 };
+		const std::uint8_t* payload{ nullptr };
+		std::size_t payloadSize{ 0 };
+	};
+
+	// Splits a receive buffer into frames. Returns the number of bytes consumed by the frame found at
+	// the front of the buffer, 0 when more data is needed and std::nullopt when the stream is corrupt.
+	inline std::optional<std::size_t> NextFrame(const std::uint8_t* data, std::size_t size, Frame& frame)
+	{
+		if (size < LengthSize)
+		{
+			return 0;
+		}
+
+		std::uint32_t length = 0;
+		for (std::size_t i = 0; i < LengthSize; ++i)
+		{
+			length |= static_cast<std::uint32_t>(data[i]) << (8 * i);
+		}
+		if (length < HeaderSize || length > MaxBodySize)
+		{
+			return std::nullopt;
+		}
+		if (size - LengthSize < length)
+		{
+			return 0;
+		}
+
+		Reader header(data + LengthSize, HeaderSize);
+		header.u32(frame.requestId);
+		header.u8(frame.code);
+		frame.payload = data + LengthSize + HeaderSize;
+		frame.payloadSize = length - HeaderSize;
+		return LengthSize + length;
+	}
+}
@@ -0,0 +1,544 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ActivationConfig.hpp"
+#include "FlightRecorder.hpp"
+#include "LicensingOperations.hpp"
+#include "RateLimiter.hpp"
+#include "Tracer.hpp"
+
+// Bounded waits on the SDK futures. Every blocking licensing call goes through Await with the name of its
+// operation, which looks up the deadline in the Deadlines section of appsettings.json. The SDK has no way to
+// cancel a request, so an operation that misses its deadline is abandoned: the caller gets DeadlineExceeded,
+// the future is kept in the abandoned operations registry and its late outcome is reported once it completes.
+// Until then new calls on the same activation wait for it, the SDK does not support concurrent calls.
+// Requests to the Licensing API are started through Call, which first waits for the rate limiter (RateLimits
+// section) to let them go.
+namespace LicensingCall
+{
+	using Clock = std::chrono::steady_clock;
+
+	class DeadlineExceeded : public std::runtime_error
+	{
+	public:
+		DeadlineExceeded(const std::string& operation, std::chrono::milliseconds waited)
+			: std::runtime_error(operation + " did not complete within " + std::to_string(waited.count())
+				+ " ms, it keeps running in the background"),
+			operation_(operation)
+		{
+		}
+
+		const std::string& operation() const
+		{
+			return operation_;
+		}
+
+	protected:
+		DeadlineExceeded(const std::string& operation, const std::string& message)
+			: std::runtime_error(message), operation_(operation)
+		{
+		}
+
+	private:
+		std::string operation_;
+	};
+
+	// The rate limiter held the request back until its deadline, it was never sent
+	class RateLimited : public DeadlineExceeded
+	{
+	public:
+		RateLimited(const std::string& operation, std::chrono::milliseconds waited)
+			: DeadlineExceeded(operation, operation + " was held back by the rate limiter for " + std::to_string(waited.count())
+				+ " ms until its deadline, it was not sent")
+		{
+		}
+	};
+
+	// An operation abandoned on the same activation was still running at the deadline, the request was not sent
+	class ActivationBusy : public DeadlineExceeded
+	{
+	public:
+		ActivationBusy(const std::string& operation, std::chrono::milliseconds waited)
+			: DeadlineExceeded(operation, operation + " waited " + std::to_string(waited.count())
+				+ " ms for an abandoned licensing operation on the same activation until its deadline, it was not sent")
+		{
+		}
+	};
+
+	// Set once at startup, before any licensing call is made
+	inline ActivationConsole::DeadlineConfig& Config()
+	{
+		static ActivationConsole::DeadlineConfig config;
+		return config;
+	}
+
+	inline void Configure(const ActivationConsole::DeadlineConfig& config)
+	{
+		Config() = config;
+	}
+
+	// Lease refreshes, deactivations and feature returns keep or give back what the seat holds and go ahead of
+	// new work, usage tracking can wait the longest. Operations without a lane never reach the Licensing API.
+	inline std::optional<RateLimiter::Lane> LaneOf(const std::string& operation)
+	{
+		static const std::map<std::string, RateLimiter::Lane> lanes = {
+			{ Operations::RefreshLease, RateLimiter::Lane::High },
+			{ Operations::Deactivate, RateLimiter::Lane::High },
+			{ Operations::ReturnFeature, RateLimiter::Lane::High },
+			{ Operations::Initialize, RateLimiter::Lane::Normal },
+			{ Operations::Activate, RateLimiter::Lane::Normal },
+			{ Operations::PullRemoteState, RateLimiter::Lane::Normal },
+			{ Operations::GetEntitlement, RateLimiter::Lane::Normal },
+			{ Operations::CheckoutFeature, RateLimiter::Lane::Normal },
+			{ Operations::TrackUsage, RateLimiter::Lane::Low },
+		};
+		auto lane = lanes.find(operation);
+		return lane != lanes.end() ? std::optional<RateLimiter::Lane>(lane->second) : std::nullopt;
+	}
+
+	// Unlimited until Configure replaced it at startup. Never destroyed, background threads may still hold a
+	// ticket while the process exits.
+	inline RateLimiter*& LimiterSlot()
+	{
+		static RateLimiter* limiter = new RateLimiter(0, 1, {});
+		return limiter;
+	}
+
+	inline RateLimiter& Limiter()
+	{
+		return *LimiterSlot();
+	}
+
+	// Set once at startup, before any licensing call is made
+	inline void Configure(const ActivationConsole::RateLimitConfig& config)
+	{
+		LimiterSlot() = new RateLimiter(config.RequestsPerSecond, config.Burst, config.OperationRequestsPerSecond);
+	}
+
+	// Joins the rate limiter queue of the operation, for callers that poll instead of blocking
+	inline RateLimiter::Ticket Enqueue(const std::string& operation)
+	{
+		auto lane = LaneOf(operation);
+		return lane ? Limiter().enqueue(operation, *lane) : RateLimiter::Ticket();
+	}
+
+	// Blocks until the rate limiter lets the request go, false when the deadline passed first
+	inline bool AdmitBefore(const std::string& operation, const std::optional<Clock::time_point>& deadline)
+	{
+		return Enqueue(operation).waitUntil(deadline);
+	}
+
+	// Zero means no deadline
+	inline std::chrono::milliseconds TimeoutFor(const std::string& operation)
+	{
+		const auto& config = Config();
+		auto entry = config.OperationTimeoutsMs.find(operation);
+		return std::chrono::milliseconds(entry != config.OperationTimeoutsMs.end() ? entry->second : config.DefaultTimeoutMs);
+	}
+
+	// End of the latency budget of the current thread, unset outside of a BudgetScope
+	inline std::optional<Clock::time_point>& CurrentBudget()
+	{
+		thread_local std::optional<Clock::time_point> budget;
+		return budget;
+	}
+
+	// Caps the total time the calling thread blocks on licensing calls while the scope is alive (one console
+	// action, one agent job). Once the budget is spent, Await only returns results that are already available.
+	class BudgetScope
+	{
+	public:
+		BudgetScope()
+			: previous_(CurrentBudget())
+		{
+			if (Config().LatencyBudgetMs > 0)
+			{
+				auto end = Clock::now() + std::chrono::milliseconds(Config().LatencyBudgetMs);
+				CurrentBudget() = previous_ ? std::min(*previous_, end) : end;
+			}
+		}
+
+		~BudgetScope()
+		{
+			CurrentBudget() = previous_;
+		}
+
+		BudgetScope(const BudgetScope&) = delete;
+		BudgetScope& operator=(const BudgetScope&) = delete;
+
+	private:
+		std::optional<Clock::time_point> previous_;
+	};
+
+	// Activation the licensing calls of the current thread are made on. Null stands for the console's own
+	// activation, code that drives other activations (seat pool, provisioning) names them with an ActivationScope.
+	inline const void*& CurrentActivation()
+	{
+		thread_local const void* activation = nullptr;
+		return activation;
+	}
+
+	class ActivationScope
+	{
+	public:
+		explicit ActivationScope(const void* activation)
+			: previous_(CurrentActivation())
+		{
+			CurrentActivation() = activation;
+		}
+
+		~ActivationScope()
+		{
+			CurrentActivation() = previous_;
+		}
+
+		ActivationScope(const ActivationScope&) = delete;
+		ActivationScope& operator=(const ActivationScope&) = delete;
+
+	private:
+		const void* previous_;
+	};
+
+	// Operations that missed their deadline, kept per activation. The registry is never destroyed: the destructor of a future from
+	// std::async blocks until the operation finished, which would hang the process exit on a dead server.
+	class AbandonedOperations
+	{
+	public:
+		struct Finished
+		{
+			std::string operation;
+			std::chrono::milliseconds afterDeadline;
+			std::string outcome;
+		};
+
+		// Takes a std::future or std::shared_future
+		template <typename Future>
+		void add(const std::string& operation, Future future)
+		{
+			auto shared = std::make_shared<Future>(std::move(future));
+			Entry entry;
+			entry.operation = operation;
+			entry.activation = CurrentActivation();
+			entry.abandonedAt = Clock::now();
+			entry.ready = [shared]() { return shared->wait_for(std::chrono::seconds(0)) != std::future_status::timeout; };
+			entry.waitUntil = [shared](Clock::time_point deadline) { return shared->wait_until(deadline) != std::future_status::timeout; };
+			entry.wait = [shared]() { shared->wait(); };
+			entry.outcome = [shared]() -> std::string
+				{
+					try
+					{
+						shared->get();
+						return "completed";
+					}
+					catch (const std::exception& e)
+					{
+						return std::string("failed: ") + e.what();
+					}
+				};
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			entries_.push_back(std::move(entry));
+			++total_;
+		}
+
+		// Operations that completed since the last call, they are removed from the registry
+		std::vector<Finished> collectFinished()
+		{
+			std::vector<Entry> done;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto firstDone = std::partition(entries_.begin(), entries_.end(), [](const Entry& entry) { return !entry.ready(); });
+				std::move(firstDone, entries_.end(), std::back_inserter(done));
+				entries_.erase(firstDone, entries_.end());
+			}
+
+			std::vector<Finished> finished;
+			auto now = Clock::now();
+			for (auto& entry : done)
+			{
+				finished.push_back({ entry.operation,
+					std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.abandonedAt),
+					entry.outcome() });
+			}
+			return finished;
+		}
+
+		// Waits for the operations still running, false when some of them are still running at the deadline
+		bool waitUntil(Clock::time_point deadline) const
+		{
+			std::vector<std::function<bool(Clock::time_point)>> waits;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (const auto& entry : entries_)
+				{
+					waits.push_back(entry.waitUntil);
+				}
+			}
+
+			bool completed = true;
+			for (const auto& wait : waits)
+			{
+				completed = wait(deadline) && completed;
+			}
+			return completed;
+		}
+
+		// Waits for the operations still running on the activation, false when some of them are still running at
+		// the deadline
+		bool waitForActivation(const void* activation, const std::optional<Clock::time_point>& deadline) const
+		{
+			std::vector<Entry> running;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				std::copy_if(entries_.begin(), entries_.end(), std::back_inserter(running),
+					[activation](const Entry& entry) { return entry.activation == activation; });
+			}
+
+			for (const auto& entry : running)
+			{
+				if (!deadline)
+				{
+					entry.wait();
+				}
+				else if (!entry.waitUntil(*deadline))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::size_t pending() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return entries_.size();
+		}
+
+		std::size_t total() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return total_;
+		}
+
+	private:
+		struct Entry
+		{
+			std::string operation;
+			const void* activation{ nullptr };
+			Clock::time_point abandonedAt;
+			std::function<bool()> ready;
+			std::function<bool(Clock::time_point)> waitUntil;
+			std::function<void()> wait;
+			std::function<std::string()> outcome;
+		};
+
+		mutable std::mutex mutex_;
+		std::vector<Entry> entries_;
+		std::size_t total_{ 0 };
+	};
+
+	inline AbandonedOperations& Abandoned()
+	{
+		static auto* registry = new AbandonedOperations();
+		return *registry;
+	}
+
+	// Prints the late outcomes collected since the last report and the number of operations still running
+	inline void ReportAbandoned(std::ostream& out)
+	{
+		for (const auto& finished : Abandoned().collectFinished())
+		{
+			out << "Abandoned " << finished.operation << " " << finished.outcome
+				<< " (noticed " << finished.afterDeadline.count() << " ms after its deadline)" << '\n';
+		}
+		if (auto pending = Abandoned().pending())
+		{
+			out << pending << " abandoned licensing operation(s) still running in the background" << '\n';
+		}
+	}
+
+	// Await waits for the future until the operation deadline or the end of the latency budget, whichever comes
+	// first. Throws DeadlineExceeded and abandons the future when neither leaves enough time.
+	namespace Detail
+	{
+		inline std::optional<Clock::time_point> DeadlineFor(const std::string& operation, Clock::time_point start)
+		{
+			std::optional<Clock::time_point> deadline;
+			auto timeout = TimeoutFor(operation);
+			if (timeout.count() > 0)
+			{
+				deadline = start + timeout;
+			}
+			const auto& budget = CurrentBudget();
+			if (budget && (!deadline || *budget < *deadline))
+			{
+				deadline = budget;
+			}
+			return deadline;
+		}
+
+		template <typename Future>
+		void WaitOrAbandon(const std::string& operation, Future& future, Clock::time_point start, const std::optional<Clock::time_point>& deadline)
+		{
+			if (deadline && future.wait_until(*deadline) == std::future_status::timeout)
+			{
+				auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+				Abandoned().add(operation, std::move(future));
+				throw DeadlineExceeded(operation, waited);
+			}
+		}
+	}
+
+	namespace Detail
+	{
+		// Trace span and flight recorder entry of one wait. Both measure the time the caller was blocked, for Call
+		// including the time the request waited in the rate limiter queue.
+		class ObservedWait
+		{
+		public:
+			ObservedWait(const std::string& operation, bool shared)
+				: operation_(operation), span_(Tracing::Categories::Licensing, operation), start_(Clock::now())
+			{
+				if (shared)
+				{
+					span_.arg("shared", "true");
+				}
+			}
+
+			~ObservedWait()
+			{
+				FlightRecorder::Operation(operation_, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_), outcome_);
+			}
+
+			ObservedWait(const ObservedWait&) = delete;
+			ObservedWait& operator=(const ObservedWait&) = delete;
+
+			void queued(Clock::duration waited)
+			{
+				if (span_.active() && waited > Clock::duration::zero())
+				{
+					span_.arg("queuedMs", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(waited).count()));
+				}
+			}
+
+			void failed(const std::exception& e)
+			{
+				outcome_ = dynamic_cast<const DeadlineExceeded*>(&e) ? FlightRecorder::Outcome::DeadlineExceeded : FlightRecorder::Outcome::Failed;
+				span_.arg("error", e.what());
+			}
+
+		private:
+			const std::string& operation_;
+			Tracing::Span span_;
+			Clock::time_point start_;
+			FlightRecorder::Outcome outcome_{ FlightRecorder::Outcome::Completed };
+		};
+	}
+
+	template <typename T>
+	T Await(const std::string& operation, std::future<T> future)
+	{
+		Detail::ObservedWait observed(operation, false);
+		try
+		{
+			auto start = Clock::now();
+			Detail::WaitOrAbandon(operation, future, start, Detail::DeadlineFor(operation, start));
+			return future.get();
+		}
+		catch (const std::exception& e)
+		{
+			observed.failed(e);
+			throw;
+		}
+	}
+
+	// Result of a flight shared with other callers (see RequestCoalescer), abandoning it leaves them unaffected
+	template <typename T>
+	T Await(const std::string& operation, std::shared_future<T> future)
+	{
+		Detail::ObservedWait observed(operation, true);
+		try
+		{
+			auto start = Clock::now();
+			Detail::WaitOrAbandon(operation, future, start, Detail::DeadlineFor(operation, start));
+			return future.get();
+		}
+		catch (const std::exception& e)
+		{
+			observed.failed(e);
+			throw;
+		}
+	}
+
+	namespace Detail
+	{
+		// Waits for operations abandoned on the current activation, then for the rate limiter
+		inline void AdmitBefore(const std::string& operation, Clock::time_point start, const std::optional<Clock::time_point>& deadline)
+		{
+			if (!Abandoned().waitForActivation(CurrentActivation(), deadline))
+			{
+				throw ActivationBusy(operation, std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start));
+			}
+			if (!LicensingCall::AdmitBefore(operation, deadline))
+			{
+				throw RateLimited(operation, std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start));
+			}
+		}
+	}
+
+	// For requests started outside of Call. Throws ActivationBusy or RateLimited when an abandoned operation on
+	// the same activation or the rate limiter holds the request back past the deadline of the operation.
+	inline void Admit(const std::string& operation)
+	{
+		auto start = Clock::now();
+		Detail::AdmitBefore(operation, start, Detail::DeadlineFor(operation, start));
+	}
+
+	// Starts a request once the operations abandoned on the same activation finished and the rate limiter lets it
+	// go, then awaits it. The time waited counts against the deadline of the operation, a request still held back
+	// at its deadline is not sent at all.
+	//   LicensingCall::Call(LicensingCall::Operations::RefreshLease, [&]() { return activation.refreshLease(); });
+	template <typename Start>
+	auto Call(const std::string& operation, Start&& start)
+	{
+		Detail::ObservedWait observed(operation, false);
+		try
+		{
+			auto begin = Clock::now();
+			auto deadline = Detail::DeadlineFor(operation, begin);
+			Detail::AdmitBefore(operation, begin, deadline);
+			observed.queued(Clock::now() - begin);
+
+			auto future = std::forward<Start>(start)();
+			Detail::WaitOrAbandon(operation, future, begin, deadline);
+			return future.get();
+		}
+		catch (const std::exception& e)
+		{
+			observed.failed(e);
+			throw;
+		}
+	}
+
+	// Deadline for SDK calls that block instead of returning a future, they run on their own thread
+	template <typename Function>
+	auto Run(const std::string& operation, Function&& function)
+	{
+		return Call(operation, [&function]() { return std::async(std::launch::async, std::forward<Function>(function)); });
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+// Names of the licensing operations, used by LicensingCall and as keys in appsettings.json
+namespace LicensingCall
+{
+	// Also the keys of Deadlines.OperationTimeoutsMs and RateLimits.OperationRequestsPerSecond
+	namespace Operations
+	{
+		constexpr const char* Initialize = "Initialize";
+		constexpr const char* Activate = "Activate";
+		constexpr const char* ActivateOffline = "ActivateOffline";
+		constexpr const char* GenerateOfflineRequest = "GenerateOfflineRequest";
+		constexpr const char* PullRemoteState = "PullRemoteState";
+		constexpr const char* PullPersistedState = "PullPersistedState";
+		constexpr const char* RefreshLease = "RefreshLease";
+		constexpr const char* RefreshLeaseOffline = "RefreshLeaseOffline";
+		constexpr const char* Deactivate = "Deactivate";
+		constexpr const char* DeactivateOffline = "DeactivateOffline";
+		constexpr const char* GetEntitlement = "GetEntitlement";
+		constexpr const char* CheckoutFeature = "CheckoutFeature";
+		constexpr const char* ReturnFeature = "ReturnFeature";
+		constexpr const char* TrackUsage = "TrackUsage";
+
+		constexpr const char* All[] = {
+			Initialize, Activate, ActivateOffline, GenerateOfflineRequest, PullRemoteState, PullPersistedState, RefreshLease,
+			RefreshLeaseOffline, Deactivate, DeactivateOffline, GetEntitlement, CheckoutFeature, ReturnFeature, TrackUsage,
+		};
+
+		inline bool IsKnown(const std::string& operation)
+		{
+			return std::find(std::begin(All), std::end(All), operation) != std::end(All);
+		}
+	}
+}
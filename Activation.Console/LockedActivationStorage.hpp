@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "FileLock.hpp"
+#include "IActivationStorage.hpp"
+#include "PersistentData.hpp"
+#include "StorageHelpers.hpp"
+#include "Tracer.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Serializes access to an activation storage shared by several processes.
+// Saves and clears hold the exclusive lock until the inner operation has finished, loads hold the shared lock.
+class LockedActivationStorage : public Persistence::Storage::IActivationStorage
+{
+public:
+	LockedActivationStorage(std::shared_ptr<Persistence::Storage::IActivationStorage> inner, const std::filesystem::path& lockPath, int lockFileMode)
+		: inner_(std::move(inner)), fileLock_(lockPath, lockFileMode)
+	{
+	}
+
+	std::string storageId() const override
+	{
+		return inner_->storageId();
+	}
+
+	std::future<void> save(const Persistence::PersistentData& data) override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.LockedSave");
+		std::lock_guard<std::mutex> lock(mutex_);
+		FileLockGuard fileLock(fileLock_);
+		TraceLockWait(span);
+		inner_->save(data).get();
+		return StorageHelpers::MakeReadyFuture();
+	}
+
+	std::future<Persistence::PersistentData> load() override
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.LockedLoad");
+		std::lock_guard<std::mutex> lock(mutex_);
+		FileLockGuard fileLock(fileLock_, FileLockGuard::Mode::Shared);
+		TraceLockWait(span);
+		return StorageHelpers::MakeReadyFuture(inner_->load().get());
+	}
+
+	std::future<void> clear() override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		FileLockGuard fileLock(fileLock_);
+		inner_->clear().get();
+		return StorageHelpers::MakeReadyFuture();
+	}
+
+private:
+	// Time from the start of the span until both locks were held, other processes writing the file show up here
+	static void TraceLockWait(Tracing::Span& span)
+	{
+		if (span.active())
+		{
+			span.arg("lockWaitUs", std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(Tracing::Clock::now() - span.start()).count()));
+		}
+	}
+
+	std::shared_ptr<Persistence::Storage::IActivationStorage> inner_;
+
+	// flock() locks belong to the open file, threads of this process are serialized separately
+	std::mutex mutex_;
+	FileLock fileLock_;
+};
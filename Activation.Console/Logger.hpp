@@ -0,0 +1,617 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "json.hpp"
+
+#include "ActivationConfig.hpp"
+
+#pragma warning(disable : 4996)
+
+// Leveled, structured logging for the console's diagnostics, configured from the Logging section of
+// appsettings.json. Callers format their message and put it into a bounded ring buffer without taking a mutex,
+// a background thread writes it out. The record's strings are still allocated by the caller, and a producer
+// preempted in the middle of its push holds back the records queued after it until it resumes. A full buffer
+// drops the record and counts it, logging never waits for the output. Menus, tables, prompts and results
+// written to std::cout wait for the records queued before them, so the console output stays in order.
+namespace Log
+{
+	// Same names and order as the .NET log levels used in appsettings.json
+	enum class Level
+	{
+		Trace, Debug, Information, Warning, Error, Critical, None
+	};
+
+	// Category names, a LogLevel entry applies to its category and every category below it
+	namespace Categories
+	{
+		constexpr const char* Console = "Activation.Console";
+		constexpr const char* Memory = "Activation.Console.Memory";
+		constexpr const char* Agent = "Activation.Console.Agent";
+		constexpr const char* Provisioning = "Activation.Console.Provisioning";
+		constexpr const char* SeatPool = "Activation.Console.SeatPool";
+		constexpr const char* SharedActivation = "Activation.Console.SharedActivation";
+		constexpr const char* Shutdown = "Activation.Console.Shutdown";
+		constexpr const char* Storage = "Activation.Console.Storage";
+	}
+
+	using Fields = std::vector<std::pair<std::string, std::string>>;
+
+	inline const char* LevelName(Level level)
+	{
+		switch (level)
+		{
+		case Level::Trace: return "Trace";
+		case Level::Debug: return "Debug";
+		case Level::Information: return "Information";
+		case Level::Warning: return "Warning";
+		case Level::Error: return "Error";
+		case Level::Critical: return "Critical";
+		default: return "None";
+		}
+	}
+
+	inline std::optional<Level> ParseLevel(const std::string& name)
+	{
+		for (auto level : { Level::Trace, Level::Debug, Level::Information, Level::Warning, Level::Error, Level::Critical, Level::None })
+		{
+			if (name == LevelName(level))
+			{
+				return level;
+			}
+		}
+		return std::nullopt;
+	}
+
+	struct Record
+	{
+		std::chrono::system_clock::time_point time;
+		Level level{ Level::Information };
+		const char* category{ nullptr };
+		std::size_t thread{ 0 };
+		std::string message;
+		Fields fields;
+	};
+
+	namespace Detail
+	{
+		// Bounded multi-producer single-consumer queue. Producers claim a cell with a CAS on the enqueue position
+		// and publish it through the cell's sequence number, the drain thread is the only consumer.
+		class RingBuffer
+		{
+		public:
+			explicit RingBuffer(std::size_t capacity)
+			{
+				std::size_t size = 2;
+				while (size < capacity)
+				{
+					size <<= 1;
+				}
+				mask_ = size - 1;
+				cells_.reset(new Cell[size]);
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					cells_[i].sequence.store(i, std::memory_order_relaxed);
+				}
+			}
+
+			bool tryPush(Record&& record)
+			{
+				auto position = enqueue_.load(std::memory_order_relaxed);
+				Cell* cell;
+				while (true)
+				{
+					cell = &cells_[position & mask_];
+					auto sequence = cell->sequence.load(std::memory_order_acquire);
+					auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+					if (difference == 0)
+					{
+						if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+					else if (difference < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = enqueue_.load(std::memory_order_relaxed);
+					}
+				}
+
+				cell->record = std::move(record);
+				cell->sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Consumer only
+			bool tryPop(Record& record)
+			{
+				auto position = dequeue_.load(std::memory_order_relaxed);
+				auto& cell = cells_[position & mask_];
+				if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+				{
+					return false;
+				}
+
+				record = std::move(cell.record);
+				cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+				dequeue_.store(position + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			// Consumer only
+			bool empty() const
+			{
+				auto position = dequeue_.load(std::memory_order_relaxed);
+				return cells_[position & mask_].sequence.load(std::memory_order_acquire) != position + 1;
+			}
+
+		private:
+			struct Cell
+			{
+				std::atomic<std::size_t> sequence{ 0 };
+				Record record;
+			};
+
+			std::unique_ptr<Cell[]> cells_;
+			std::size_t mask_{ 0 };
+			alignas(64) std::atomic<std::size_t> enqueue_{ 0 };
+			alignas(64) std::atomic<std::size_t> dequeue_{ 0 };
+		};
+
+		inline void SetConsoleColor(int colorCode)
+		{
+#ifdef _WIN32
+			HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+			SetConsoleTextAttribute(hConsole, colorCode);
+#else
+			(void)colorCode; // No-op on non-Windows
+#endif
+		}
+	}
+
+	class Logger
+	{
+	public:
+		explicit Logger(const ActivationConsole::LoggingConfig& config)
+			: ring_(static_cast<std::size_t>(config.QueueCapacity > 0 ? config.QueueCapacity : 1)),
+			stdout_(std::cout.rdbuf()),
+			stderr_(std::cerr.rdbuf())
+		{
+			configure(config);
+			// Never joined, the logger lives until the process exits
+			std::thread([this]() { drain(); }).detach();
+		}
+
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
+
+		// Levels, format and output can change at any time, the queue capacity is fixed by the first configuration
+		void configure(const ActivationConsole::LoggingConfig& config)
+		{
+			std::scoped_lock lock(rulesMutex_, outputMutex_);
+			rules_.clear();
+			defaultLevel_ = Level::Information;
+			for (const auto& [category, name] : config.LogLevel)
+			{
+				auto level = ParseLevel(name);
+				if (!level)
+				{
+					std::cerr << "Unknown log level '" << name << "' for '" << category << "'." << '\n';
+					continue;
+				}
+				if (category == "Default")
+				{
+					defaultLevel_ = *level;
+				}
+				else
+				{
+					rules_.emplace_back(category, *level);
+				}
+			}
+
+			json_ = config.Format == "Json";
+			file_.reset();
+			if (!config.FilePath.empty())
+			{
+				file_ = std::make_unique<std::ofstream>(config.FilePath, std::ios::app);
+				if (!file_->is_open())
+				{
+					std::cerr << "Failed to open log file " << config.FilePath << ", logging to the console." << '\n';
+					file_.reset();
+				}
+			}
+			generation_.fetch_add(1, std::memory_order_release);
+		}
+
+		bool isEnabled(Level level, const char* category) const
+		{
+			return level != Level::None && level >= minimumLevel(category);
+		}
+
+		void write(Level level, const char* category, std::string message, Fields fields = {})
+		{
+			if (!isEnabled(level, category))
+			{
+				return;
+			}
+
+			Record record;
+			record.time = std::chrono::system_clock::now();
+			record.level = level;
+			record.category = category;
+			record.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+			record.message = std::move(message);
+			record.fields = std::move(fields);
+
+			if (!ring_.tryPush(std::move(record)))
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			accepted_.fetch_add(1, std::memory_order_seq_cst);
+			if (sleeping_.load(std::memory_order_seq_cst))
+			{
+				wake_.notify_one();
+			}
+		}
+
+		// Blocks until everything logged so far is written out. A no-op on the drain thread, which would wait for itself.
+		void flush()
+		{
+			if (OnDrainThread())
+			{
+				return;
+			}
+			auto target = accepted_.load();
+			if (written_.load() >= target)
+			{
+				return;
+			}
+			std::unique_lock<std::mutex> lock(mutex_);
+			flushRequested_ = true;
+			wake_.notify_one();
+			drained_.wait(lock, [this, target]() { return written_.load() >= target; });
+		}
+
+		std::uint64_t dropped() const
+		{
+			return dropped_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		Level minimumLevel(const char* category) const
+		{
+			// Categories are string constants, so the level is resolved once per category and thread
+			thread_local std::uint64_t cachedGeneration = 0;
+			thread_local std::unordered_map<const char*, Level> cache;
+
+			auto generation = generation_.load(std::memory_order_acquire);
+			if (cachedGeneration != generation)
+			{
+				cache.clear();
+				cachedGeneration = generation;
+			}
+
+			auto cached = cache.find(category);
+			if (cached != cache.end())
+			{
+				return cached->second;
+			}
+			auto level = resolve(category);
+			cache.emplace(category, level);
+			return level;
+		}
+
+		// Longest matching category prefix wins, like the .NET logging configuration
+		Level resolve(const std::string& category) const
+		{
+			std::lock_guard<std::mutex> lock(rulesMutex_);
+			Level level = defaultLevel_;
+			std::size_t longest = 0;
+			for (const auto& [prefix, prefixLevel] : rules_)
+			{
+				bool matches = category == prefix
+					|| (category.size() > prefix.size() && category.compare(0, prefix.size(), prefix) == 0 && category[prefix.size()] == '.');
+				if (matches && prefix.size() >= longest)
+				{
+					level = prefixLevel;
+					longest = prefix.size();
+				}
+			}
+			return level;
+		}
+
+		static bool& OnDrainThread()
+		{
+			thread_local bool drainThread = false;
+			return drainThread;
+		}
+
+		void drain()
+		{
+			OnDrainThread() = true;
+			std::vector<Record> batch;
+			Record record;
+			std::uint64_t reportedDropped = 0;
+			while (true)
+			{
+				while (batch.size() < 256 && ring_.tryPop(record))
+				{
+					batch.push_back(std::move(record));
+				}
+				auto popped = batch.size();
+
+				auto dropped = dropped_.load(std::memory_order_relaxed);
+				if (dropped != reportedDropped)
+				{
+					Record notice;
+					notice.time = std::chrono::system_clock::now();
+					notice.level = Level::Warning;
+					notice.category = Categories::Console;
+					notice.message = std::to_string(dropped - reportedDropped) + " log record(s) dropped, the log queue was full";
+					batch.push_back(std::move(notice));
+					reportedDropped = dropped;
+				}
+
+				if (!batch.empty())
+				{
+					output(batch);
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						written_ += popped;
+					}
+					drained_.notify_all();
+					batch.clear();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mutex_);
+				sleeping_.store(true, std::memory_order_seq_cst);
+				// Producers do not take the mutex, a missed wakeup only delays the output until the timeout
+				wake_.wait_for(lock, std::chrono::milliseconds(50), [this]() { return flushRequested_ || !ring_.empty(); });
+				sleeping_.store(false, std::memory_order_relaxed);
+				flushRequested_ = false;
+			}
+		}
+
+		void output(const std::vector<Record>& batch)
+		{
+			std::lock_guard<std::mutex> lock(outputMutex_);
+			for (const auto& record : batch)
+			{
+				if (file_)
+				{
+					*file_ << (json_ ? FormatJson(record) : FormatTimestamped(record)) << '\n';
+					continue;
+				}
+
+				// Errors go to the std::cerr buffer as before, std::cout is flushed first to keep the order
+				bool error = record.level >= Level::Error;
+				auto& stream = error ? stderr_ : stdout_;
+				if (error)
+				{
+					stdout_.flush();
+				}
+				if (json_)
+				{
+					stream << FormatJson(record) << '\n';
+				}
+				else
+				{
+					Detail::SetConsoleColor(error ? 4 : record.level == Level::Warning ? 6 : 7);
+					stream << FormatText(record) << '\n';
+					Detail::SetConsoleColor(7);
+				}
+			}
+
+			if (file_)
+			{
+				file_->flush();
+			}
+			stdout_.flush();
+			stderr_.flush();
+		}
+
+		static std::string FormatText(const Record& record)
+		{
+			std::string line = record.level == Level::Information ? std::string() : std::string(LevelName(record.level)) + ": ";
+			line += record.message;
+			for (const auto& [key, value] : record.fields)
+			{
+				line += " " + key + "=" + value;
+			}
+			return line;
+		}
+
+		static std::string FormatTimestamped(const Record& record)
+		{
+			std::ostringstream line;
+			line << FormatTime(record.time) << " [" << LevelName(record.level) << "] " << record.category << ": " << record.message;
+			for (const auto& [key, value] : record.fields)
+			{
+				line << " " << key << "=" << value;
+			}
+			return line.str();
+		}
+
+		static std::string FormatJson(const Record& record)
+		{
+			nlohmann::json line = {
+				{ "time", FormatTime(record.time) },
+				{ "level", LevelName(record.level) },
+				{ "category", record.category },
+				{ "thread", record.thread },
+				{ "message", record.message }
+			};
+			for (const auto& [key, value] : record.fields)
+			{
+				line[key] = value;
+			}
+			return line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+		}
+
+		static std::string FormatTime(std::chrono::system_clock::time_point time)
+		{
+			auto seconds = std::chrono::system_clock::to_time_t(time);
+			auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+			std::ostringstream text;
+			text << std::put_time(std::localtime(&seconds), "%F %T") << '.' << std::setw(3) << std::setfill('0') << milliseconds;
+			return text.str();
+		}
+
+		Detail::RingBuffer ring_;
+		std::atomic<std::uint64_t> accepted_{ 0 };
+		std::atomic<std::uint64_t> dropped_{ 0 };
+		std::atomic<bool> sleeping_{ false };
+		std::atomic<std::uint64_t> generation_{ 0 };
+
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::condition_variable drained_;
+		std::atomic<std::uint64_t> written_{ 0 };
+		bool flushRequested_{ false };
+
+		// Levels are only read when a thread logs to a category for the first time
+		mutable std::mutex rulesMutex_;
+		Level defaultLevel_{ Level::Information };
+		std::vector<std::pair<std::string, Level>> rules_;
+
+		// Held by the drain thread while writing
+		std::mutex outputMutex_;
+		std::ostream stdout_;       ///< The original std::cout buffer, std::cout itself waits for the log
+		std::ostream stderr_;       ///< The std::cerr buffer without the tie to std::cout, flushing std::cout would wait for the log
+		bool json_{ false };
+		std::unique_ptr<std::ofstream> file_;
+	};
+
+	namespace Detail
+	{
+		inline ActivationConsole::LoggingConfig& StartupConfig()
+		{
+			static ActivationConsole::LoggingConfig config;
+			return config;
+		}
+
+		// Never destroyed, records logged by static destructors and exit handlers still have a logger
+		inline Logger& Instance()
+		{
+			static auto* logger = new Logger(StartupConfig());
+			return *logger;
+		}
+
+		// Put in front of the std::cout buffer when logging to the console: console output first waits for the
+		// records queued before it. Costs two atomic loads while nothing is queued.
+		class OrderedConsoleBuffer : public std::streambuf
+		{
+		public:
+			explicit OrderedConsoleBuffer(std::streambuf* console)
+				: console_(console)
+			{
+			}
+
+		protected:
+			int overflow(int ch) override
+			{
+				if (traits_type::eq_int_type(ch, traits_type::eof()))
+				{
+					return traits_type::not_eof(ch);
+				}
+				Instance().flush();
+				return console_->sputc(traits_type::to_char_type(ch));
+			}
+
+			std::streamsize xsputn(const char* text, std::streamsize count) override
+			{
+				Instance().flush();
+				return console_->sputn(text, count);
+			}
+
+			// Also reached through std::cin, which flushes std::cout before every read
+			int sync() override
+			{
+				Instance().flush();
+				return console_->pubsync();
+			}
+
+		private:
+			std::streambuf* console_;
+		};
+	}
+
+	// Call once at startup, before other threads log
+	inline void Configure(const ActivationConsole::LoggingConfig& config)
+	{
+		Detail::StartupConfig() = config;
+		Detail::Instance().configure(config);
+		if (config.FilePath.empty())
+		{
+			// Leaked like the logger, std::cout is still flushed after static destructors ran
+			static auto* ordered = new Detail::OrderedConsoleBuffer(std::cout.rdbuf());
+			std::cout.rdbuf(ordered);
+		}
+		std::atexit([]() { Detail::Instance().flush(); });
+	}
+
+	inline bool IsEnabled(Level level, const char* category)
+	{
+		return Detail::Instance().isEnabled(level, category);
+	}
+
+	inline void Write(Level level, const char* category, std::string message, Fields fields = {})
+	{
+		Detail::Instance().write(level, category, std::move(message), std::move(fields));
+	}
+
+	inline void Debug(const char* category, std::string message, Fields fields = {})
+	{
+		Write(Level::Debug, category, std::move(message), std::move(fields));
+	}
+
+	inline void Information(const char* category, std::string message, Fields fields = {})
+	{
+		Write(Level::Information, category, std::move(message), std::move(fields));
+	}
+
+	inline void Warning(const char* category, std::string message, Fields fields = {})
+	{
+		Write(Level::Warning, category, std::move(message), std::move(fields));
+	}
+
+	inline void Error(const char* category, std::string message, Fields fields = {})
+	{
+		Write(Level::Error, category, std::move(message), std::move(fields));
+	}
+
+	inline void Flush()
+	{
+		Detail::Instance().flush();
+	}
+}
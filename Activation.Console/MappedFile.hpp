@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Fixed-size file mapped into memory and shared with every process that maps the same path.
+// In ReadWrite mode the file is created (zero filled) or grown to the requested size on first use,
+// in ReadOnly mode it must already exist with at least that size. mode is the permission set of the
+// file created or reopened in ReadWrite mode, see LicenseStorage::FileMode.
+class MappedFile
+{
+public:
+	enum class Access
+	{
+		ReadWrite,
+		ReadOnly
+	};
+
+	MappedFile(const std::filesystem::path& path, std::size_t size, Access access, int mode = 0600)
+		: path_(path), size_(size)
+	{
+		if (access == Access::ReadOnly)
+		{
+			openReadOnly();
+			return;
+		}
+
+		std::filesystem::create_directories(path.parent_path());
+#ifdef _WIN32
+		file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open mapped file: " + path.string());
+		}
+
+		ULARGE_INTEGER mappingSize{};
+		mappingSize.QuadPart = size;
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, nullptr);
+		if (!mapping_)
+		{
+			CloseHandle(file_);
+			throw std::runtime_error("Failed to map file: " + path.string());
+		}
+
+		data_ = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!data_)
+		{
+			CloseHandle(mapping_);
+			CloseHandle(file_);
+			throw std::runtime_error("Failed to map file: " + path.string());
+		}
+#else
+		fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, static_cast<mode_t>(mode));
+		if (fd_ < 0)
+		{
+			throw std::runtime_error("Failed to open mapped file: " + path.string());
+		}
+		::fchmod(fd_, static_cast<mode_t>(mode));
+
+		struct stat info {};
+		if (::fstat(fd_, &info) != 0 || (static_cast<std::size_t>(info.st_size) < size && ::ftruncate(fd_, static_cast<off_t>(size)) != 0))
+		{
+			::close(fd_);
+			throw std::runtime_error("Failed to size mapped file: " + path.string());
+		}
+
+		data_ = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (data_ == MAP_FAILED)
+		{
+			::close(fd_);
+			throw std::runtime_error("Failed to map file: " + path.string());
+		}
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		::munmap(data_, size_);
+		::close(fd_);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	void* data() const
+	{
+		return data_;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	const std::filesystem::path& path() const
+	{
+		return path_;
+	}
+
+	// Asks the OS to write dirty pages back to the file without waiting for completion
+	void flushAsync()
+	{
+#ifdef _WIN32
+		FlushViewOfFile(data_, size_);
+#else
+		::msync(data_, size_, MS_ASYNC);
+#endif
+	}
+
+private:
+	void openReadOnly()
+	{
+#ifdef _WIN32
+		file_ = CreateFileW(path_.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER fileSize{};
+		if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &fileSize) || static_cast<std::size_t>(fileSize.QuadPart) < size_)
+		{
+			if (file_ != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file_);
+			}
+			throw std::runtime_error("Mapped file is missing or too small: " + path_.string());
+		}
+
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data_ = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, size_) : nullptr;
+		if (!data_)
+		{
+			if (mapping_)
+			{
+				CloseHandle(mapping_);
+			}
+			CloseHandle(file_);
+			throw std::runtime_error("Failed to map file: " + path_.string());
+		}
+#else
+		fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat info {};
+		if (fd_ < 0 || ::fstat(fd_, &info) != 0 || static_cast<std::size_t>(info.st_size) < size_)
+		{
+			if (fd_ >= 0)
+			{
+				::close(fd_);
+			}
+			throw std::runtime_error("Mapped file is missing or too small: " + path_.string());
+		}
+
+		data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+		if (data_ == MAP_FAILED)
+		{
+			::close(fd_);
+			throw std::runtime_error("Failed to map file: " + path_.string());
+		}
+#endif
+	}
+
+	std::filesystem::path path_;
+	std::size_t size_;
+	void* data_{ nullptr };
+#ifdef _WIN32
+	HANDLE file_{ INVALID_HANDLE_VALUE };
+	HANDLE mapping_{ nullptr };
+#else
+	int fd_{ -1 };
+#endif
+};
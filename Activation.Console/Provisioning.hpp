@@ -0,0 +1,507 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json.hpp"
+
+#include "Activation.hpp"
+#include "ActivationCodeCredentialsModel.hpp"
+#include "ActivationConfig.hpp"
+#include "LicensingApiException.hpp"
+#include "LicensingCall.hpp"
+#include "Logger.hpp"
+#include "Tracer.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Bulk online activation for rolling out machines (--provision <manifest>). The manifest is a CSV file with one
+// seat per row and the inputs "Activate license with code" prompts for:
+//   activationCode,seatId,seatName,editionId
+// A header row with these names, empty lines and lines starting with # are skipped, and the last two columns may
+// be empty. Provisioning.Concurrency rows are activated at the same time. Each row has its own license file under
+// <storage folder>/provisioned, and the Licensing API requests of all workers together stay under
+// Provisioning.RequestsPerSecond. Every finished row is appended to the checkpoint file. A rerun skips the rows
+// already activated and tries the failed ones again.
+namespace Provisioning
+{
+	struct Row
+	{
+		std::size_t line{ 0 };
+		std::string activationCode;
+		std::string seatId;
+		std::string seatName;
+		std::string editionId;
+	};
+
+	namespace Detail
+	{
+		// One CSV record, fields may be quoted with "" for a literal quote
+		inline std::vector<std::string> SplitCsv(const std::string& line)
+		{
+			std::vector<std::string> fields(1);
+			bool quoted = false;
+			for (std::size_t i = 0; i < line.size(); ++i)
+			{
+				char c = line[i];
+				if (quoted)
+				{
+					if (c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+					{
+						fields.back() += '"';
+						++i;
+					}
+					else if (c == '"')
+					{
+						quoted = false;
+					}
+					else
+					{
+						fields.back() += c;
+					}
+				}
+				else if (c == '"')
+				{
+					quoted = true;
+				}
+				else if (c == ',')
+				{
+					fields.emplace_back();
+				}
+				else if (c != '\r')
+				{
+					fields.back() += c;
+				}
+			}
+			if (quoted)
+			{
+				throw std::runtime_error("unterminated quote");
+			}
+			for (auto& field : fields)
+			{
+				auto first = field.find_first_not_of(" \t");
+				auto last = field.find_last_not_of(" \t");
+				field = first == std::string::npos ? std::string() : field.substr(first, last - first + 1);
+			}
+			return fields;
+		}
+	}
+
+	// Folder name of a seat's license file, seat IDs may contain characters file systems do not allow.
+	// "." and ".." are escaped as a whole, they would name the provisioned folder itself or its parent.
+	inline std::string FolderName(const std::string& seatId)
+	{
+		bool dotsOnly = seatId == "." || seatId == "..";
+		std::string name;
+		for (unsigned char c : seatId)
+		{
+			if (std::isalnum(c) || c == '-' || c == '_' || (c == '.' && !dotsOnly))
+			{
+				name += static_cast<char>(c);
+			}
+			else
+			{
+				static const char* hex = "0123456789abcdef";
+				name += '%';
+				name += hex[c >> 4];
+				name += hex[c & 0xF];
+			}
+		}
+		return name;
+	}
+
+	inline std::vector<Row> ReadManifest(const std::filesystem::path& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open the manifest " + path.string());
+		}
+
+		std::vector<Row> rows;
+		// Seat IDs by their lower-case form with their line: folder names that differ only by case are the same
+		// folder on case-insensitive file systems
+		std::map<std::string, std::pair<std::string, std::size_t>> seatIds;
+		std::string line;
+		for (std::size_t number = 1; std::getline(file, line); ++number)
+		{
+			if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+			{
+				continue;
+			}
+
+			std::vector<std::string> fields;
+			try
+			{
+				fields = Detail::SplitCsv(line);
+			}
+			catch (const std::exception& e)
+			{
+				throw std::runtime_error(path.string() + ":" + std::to_string(number) + ": " + e.what());
+			}
+			if (rows.empty() && seatIds.empty() && fields[0] == "activationCode")
+			{
+				continue;
+			}
+			if (fields.size() < 2 || fields.size() > 4 || fields[0].empty() || fields[1].empty())
+			{
+				throw std::runtime_error(path.string() + ":" + std::to_string(number)
+					+ ": expected activationCode,seatId[,seatName[,editionId]] with an activation code and a seat ID");
+			}
+			std::string folded = fields[1];
+			std::transform(folded.begin(), folded.end(), folded.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			auto [listed, inserted] = seatIds.emplace(folded, std::make_pair(fields[1], number));
+			if (!inserted)
+			{
+				const auto& [seatId, line] = listed->second;
+				throw std::runtime_error(path.string() + ":" + std::to_string(number) + ": seat ID " + fields[1]
+					+ (seatId == fields[1] ? " is listed twice" : " differs only by case from seat ID " + seatId)
+					+ ", first listed on line " + std::to_string(line));
+			}
+			fields.resize(4);
+			rows.push_back({ number, fields[0], fields[1], fields[2], fields[3] });
+		}
+		return rows;
+	}
+
+	// Append-only record of the finished rows, one JSON object per line. A line torn by a crash is ignored, the
+	// row is simply provisioned again.
+	class Checkpoint
+	{
+	public:
+		explicit Checkpoint(const std::filesystem::path& path)
+			: path_(path)
+		{
+			std::ifstream existing(path);
+			std::string line;
+			bool tornLine = false;
+			while (std::getline(existing, line))
+			{
+				tornLine = existing.eof() && !line.empty();
+				auto entry = nlohmann::json::parse(line, nullptr, false);
+				if (entry.is_discarded() || !entry.is_object())
+				{
+					continue;
+				}
+				auto seatId = entry.value("seatId", std::string());
+				if (entry.value("status", std::string()) == "activated")
+				{
+					activated_.insert(seatId);
+				}
+				else
+				{
+					activated_.erase(seatId);
+				}
+			}
+
+			file_.open(path, std::ios::app);
+			if (!file_.is_open())
+			{
+				throw std::runtime_error("Failed to open the checkpoint file " + path.string());
+			}
+			if (tornLine)
+			{
+				file_ << '\n';
+			}
+		}
+
+		const std::filesystem::path& path() const
+		{
+			return path_;
+		}
+
+		bool activated(const std::string& seatId) const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return activated_.count(seatId) > 0;
+		}
+
+		// Flushed right away, the row counts as done once this returns
+		void record(const Row& row, bool activated, double milliseconds, const std::string& error)
+		{
+			nlohmann::json entry = {
+				{ "line", row.line },
+				{ "seatId", row.seatId },
+				{ "status", activated ? "activated" : "failed" },
+				{ "ms", milliseconds },
+				{ "at", static_cast<std::int64_t>(std::time(nullptr)) },
+			};
+			if (!error.empty())
+			{
+				entry["error"] = error;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			file_ << entry.dump() << '\n';
+			file_.flush();
+			if (activated)
+			{
+				activated_.insert(row.seatId);
+			}
+		}
+
+	private:
+		std::filesystem::path path_;
+		mutable std::mutex mutex_;
+		std::set<std::string> activated_;
+		std::ofstream file_;
+	};
+
+	struct Failure
+	{
+		Row row;
+		std::string error;
+	};
+
+	struct Report
+	{
+		std::size_t rows{ 0 };
+		std::size_t skipped{ 0 };        ///< Activated by an earlier run according to the checkpoint
+		std::size_t activated{ 0 };
+		std::size_t alreadyActive{ 0 };  ///< Found active in the seat's license file, e.g. after a crash before the checkpoint
+		std::size_t notStarted{ 0 };     ///< Left over when the run was stopped
+		std::vector<Failure> failures;
+		std::vector<double> latencies;   ///< Milliseconds per activated row, including the wait for the rate limiter
+		std::chrono::duration<double> elapsed{ 0 };
+		std::chrono::duration<double> throttled{ 0 }; ///< Time requests waited in the rate limiter during the run, summed
+	};
+
+	// Creates the Activation of a row on the row's own license file
+	using ActivationFactory = std::function<std::shared_ptr<Activation>(const Row&)>;
+
+	class Provisioner
+	{
+	public:
+		Provisioner(std::vector<Row> rows, ActivationFactory factory, Checkpoint& checkpoint, const ActivationConsole::ProvisioningConfig& config)
+			: rows_(std::move(rows)), factory_(std::move(factory)), checkpoint_(checkpoint), config_(config)
+		{
+		}
+
+		// Returns once every row was tried, or the current rows finished after stop()
+		Report run()
+		{
+			auto start = std::chrono::steady_clock::now();
+			auto waitedBefore = LimiterWait();
+			for (const auto& row : rows_)
+			{
+				if (checkpoint_.activated(row.seatId))
+				{
+					++report_.skipped;
+				}
+				else
+				{
+					pending_.push_back(&row);
+				}
+			}
+			report_.rows = rows_.size();
+
+			auto workers = std::min<std::size_t>(static_cast<std::size_t>(config_.Concurrency), pending_.size());
+			Log::Information(Log::Categories::Provisioning, "Provisioning seats", {
+				{ "rows", std::to_string(rows_.size()) },
+				{ "skipped", std::to_string(report_.skipped) },
+				{ "workers", std::to_string(workers) },
+				{ "requestsPerSecond", std::to_string(config_.RequestsPerSecond) } });
+
+			std::vector<std::thread> threads;
+			for (std::size_t i = 0; i < workers; ++i)
+			{
+				threads.emplace_back([this]() { work(); });
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			auto next = next_.load();
+			report_.notStarted = next < pending_.size() ? pending_.size() - next : 0;
+			report_.elapsed = std::chrono::steady_clock::now() - start;
+			report_.throttled = LimiterWait() - waitedBefore;
+			return report_;
+		}
+
+		// Safe from the shutdown hook, the workers finish the rows they started
+		void stop()
+		{
+			stopping_ = true;
+		}
+
+	private:
+		void work()
+		{
+			Tracing::NameThread("Provisioning worker");
+			while (!stopping_)
+			{
+				auto index = next_++;
+				if (index >= pending_.size())
+				{
+					break;
+				}
+				provision(*pending_[index]);
+			}
+		}
+
+		// Requests of the provisioning workers go through the rate limiter of the process (Provisioning.RequestsPerSecond
+		// lowers its global rate in main), this is the time all its queues waited so far
+		static std::chrono::duration<double> LimiterWait()
+		{
+			std::chrono::duration<double> waited{ 0 };
+			for (const auto& lane : LicensingCall::Limiter().metrics())
+			{
+				waited += lane.waited;
+			}
+			return waited;
+		}
+
+		// A request the rate limiter held back past its deadline was never sent, the worker queues it again
+		template <typename Start>
+		void callQueued(const std::string& operation, Start&& start)
+		{
+			while (true)
+			{
+				try
+				{
+					LicensingCall::Call(operation, start);
+					return;
+				}
+				catch (const LicensingCall::RateLimited&)
+				{
+					if (stopping_)
+					{
+						throw;
+					}
+				}
+			}
+		}
+
+		void provision(const Row& row)
+		{
+			auto start = std::chrono::steady_clock::now();
+			bool alreadyActive = false;
+			std::string error;
+			try
+			{
+				std::shared_ptr<Activation> activation;
+				{
+					// Creating the storage sets the process-wide storage library configuration
+					std::lock_guard<std::mutex> lock(factoryMutex_);
+					activation = factory_(row);
+				}
+				LicensingCall::ActivationScope seat(activation.get());
+
+				callQueued(LicensingCall::Operations::Initialize, [&]() { return activation->initialize(); });
+				alreadyActive = activation->getState() == ActivationState::Active;
+				if (!alreadyActive)
+				{
+					callQueued(LicensingCall::Operations::Activate, [&]() { return activation->activate(
+						std::make_shared<ActivationCodeCredentialsModel>(row.activationCode), row.seatName, row.editionId); });
+				}
+			}
+			catch (const LicensingApiException& e)
+			{
+				error = e.getApiError().toString();
+			}
+			catch (const std::exception& e)
+			{
+				error = e.what();
+			}
+
+			auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			checkpoint_.record(row, error.empty(), milliseconds, error);
+
+			std::lock_guard<std::mutex> lock(reportMutex_);
+			if (!error.empty())
+			{
+				report_.failures.push_back({ row, error });
+				Log::Error(Log::Categories::Provisioning, "Provisioning a seat failed", {
+					{ "line", std::to_string(row.line) }, { "seatId", row.seatId }, { "error", error } });
+				return;
+			}
+			++(alreadyActive ? report_.alreadyActive : report_.activated);
+			report_.latencies.push_back(milliseconds);
+			Log::Information(Log::Categories::Provisioning, alreadyActive ? "Seat was already active" : "Seat activated", {
+				{ "line", std::to_string(row.line) }, { "seatId", row.seatId }, { "ms", std::to_string(static_cast<long long>(milliseconds)) } });
+		}
+
+		std::vector<Row> rows_;
+		ActivationFactory factory_;
+		Checkpoint& checkpoint_;
+		ActivationConsole::ProvisioningConfig config_;
+
+		std::vector<const Row*> pending_;
+		std::atomic<std::size_t> next_{ 0 };
+		std::atomic<bool> stopping_{ false };
+		std::mutex factoryMutex_;
+		std::mutex reportMutex_;
+		Report report_;
+	};
+
+	inline void WriteReport(std::ostream& out, Report report, const std::filesystem::path& checkpointPath)
+	{
+		auto percentile = [&](double quantile)
+			{
+				auto rank = static_cast<std::size_t>(quantile * static_cast<double>(report.latencies.size() - 1) + 0.5);
+				return report.latencies[rank];
+			};
+		std::sort(report.latencies.begin(), report.latencies.end());
+
+		auto seconds = report.elapsed.count();
+		auto finished = report.activated + report.alreadyActive + report.failures.size();
+		out << '\n' << "Provisioning report" << '\n';
+		out << "  Rows:            " << report.rows << " (" << report.skipped << " skipped, activated by an earlier run)" << '\n';
+		out << "  Activated:       " << report.activated << (report.alreadyActive ? " (+" + std::to_string(report.alreadyActive) + " already active)" : std::string()) << '\n';
+		out << "  Failed:          " << report.failures.size() << '\n';
+		if (report.notStarted > 0)
+		{
+			out << "  Not started:     " << report.notStarted << " (stopped, rerun to continue)" << '\n';
+		}
+		out << std::fixed << std::setprecision(2);
+		out << "  Elapsed:         " << seconds << " s" << '\n';
+		out << "  Throughput:      " << (seconds > 0 ? static_cast<double>(finished) / seconds : 0.0) << " rows/s, "
+			<< (seconds > 0 ? static_cast<double>(report.activated + report.alreadyActive) / seconds : 0.0) << " activations/s" << '\n';
+		out << "  Rate limit wait: " << report.throttled.count() << " s over all workers" << '\n';
+		if (!report.latencies.empty())
+		{
+			out << std::setprecision(1) << "  Row latency:     p50 " << percentile(0.50) << " ms, p95 " << percentile(0.95)
+				<< " ms, max " << report.latencies.back() << " ms" << '\n';
+		}
+
+		if (!report.failures.empty())
+		{
+			// Grouped by error, one bad activation code usually fails many rows the same way
+			std::map<std::string, std::vector<const Failure*>> byError;
+			for (const auto& failure : report.failures)
+			{
+				byError[failure.error].push_back(&failure);
+			}
+			out << "  Failures:" << '\n';
+			for (const auto& [error, failures] : byError)
+			{
+				out << "    " << failures.size() << "x " << error << '\n' << "       lines";
+				for (std::size_t i = 0; i < failures.size() && i < 10; ++i)
+				{
+					out << ' ' << failures[i]->row.line;
+				}
+				out << (failures.size() > 10 ? " ..." : "") << '\n';
+			}
+		}
+		out << "  Checkpoint:      " << checkpointPath.string() << '\n';
+	}
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#include "TokenBucket.hpp"
+
+// Client-side rate limit in front of the licensing requests of the process. Every request takes a token from the
+// global bucket and, when its operation has a cap of its own, from the bucket of its operation. Requests held
+// back wait in priority lanes: a waiting request of a higher lane goes first, within a lane the order of arrival
+// is kept. A request whose operation bucket is empty does not hold up the requests behind it.
+class RateLimiter
+{
+public:
+	using Clock = TokenBucket::Clock;
+
+	enum class Lane
+	{
+		High,
+		Normal,
+		Low,
+	};
+	static constexpr std::size_t Lanes = 3;
+
+	struct LaneMetrics
+	{
+		std::size_t queued{ 0 };        ///< Requests waiting right now
+		std::size_t peakQueued{ 0 };    ///< Most requests waiting at the same time
+		std::uint64_t admitted{ 0 };
+		std::uint64_t delayed{ 0 };     ///< Admitted after waiting for a token
+		std::uint64_t dropped{ 0 };     ///< Left the queue unsent, usually because their deadline passed first
+		Clock::duration waited{ 0 };    ///< Summed over the delayed requests
+		Clock::duration longestWait{ 0 };
+	};
+
+private:
+	struct Waiter
+	{
+		Lane lane{ Lane::Normal };
+		TokenBucket* operationBucket{ nullptr };
+		Clock::time_point enqueued;
+		bool admitted{ false };
+	};
+
+public:
+	// A place in the queue. The request may be sent once tryAdmit() or waitUntil() returned true, a ticket
+	// destroyed before that leaves the queue.
+	class Ticket
+	{
+	public:
+		Ticket() = default;
+
+		Ticket(Ticket&& other) noexcept
+			: limiter_(other.limiter_), waiter_(std::move(other.waiter_))
+		{
+			other.limiter_ = nullptr;
+		}
+
+		Ticket& operator=(Ticket&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				limiter_ = other.limiter_;
+				waiter_ = std::move(other.waiter_);
+				other.limiter_ = nullptr;
+			}
+			return *this;
+		}
+
+		Ticket(const Ticket&) = delete;
+		Ticket& operator=(const Ticket&) = delete;
+
+		~Ticket()
+		{
+			release();
+		}
+
+		// Never blocks, for callers that poll (see ActivationAwaitables)
+		bool tryAdmit()
+		{
+			if (!limiter_)
+			{
+				return true;
+			}
+			std::lock_guard<std::mutex> lock(limiter_->mutex_);
+			return limiter_->tryAdmit(*waiter_, Clock::now());
+		}
+
+		// Blocks until the request may be sent, false when the deadline passed first
+		bool waitUntil(const std::optional<Clock::time_point>& deadline)
+		{
+			if (!limiter_)
+			{
+				return true;
+			}
+			std::unique_lock<std::mutex> lock(limiter_->mutex_);
+			while (true)
+			{
+				auto now = Clock::now();
+				if (limiter_->tryAdmit(*waiter_, now))
+				{
+					return true;
+				}
+				if (deadline && now >= *deadline)
+				{
+					return false;
+				}
+				auto wake = now + limiter_->retryDelay(*waiter_, now);
+				limiter_->changed_.wait_until(lock, deadline ? std::min(wake, *deadline) : wake);
+			}
+		}
+
+	private:
+		friend class RateLimiter;
+
+		Ticket(RateLimiter* limiter, std::shared_ptr<Waiter> waiter)
+			: limiter_(limiter), waiter_(std::move(waiter))
+		{
+		}
+
+		void release()
+		{
+			if (limiter_)
+			{
+				limiter_->leave(*waiter_);
+				limiter_ = nullptr;
+			}
+		}
+
+		RateLimiter* limiter_{ nullptr };
+		std::shared_ptr<Waiter> waiter_;
+	};
+
+	// A rate of 0 or less leaves the global or the operation unlimited
+	RateLimiter(double requestsPerSecond, double burst, const std::map<std::string, double>& operationRequestsPerSecond)
+		: global_(requestsPerSecond, burst)
+	{
+		for (const auto& [operation, rate] : operationRequestsPerSecond)
+		{
+			if (rate > 0)
+			{
+				operations_.emplace(operation, std::make_unique<TokenBucket>(rate, std::max(1.0, rate)));
+			}
+		}
+	}
+
+	RateLimiter(const RateLimiter&) = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+
+	bool limited() const
+	{
+		return !global_.unlimited() || !operations_.empty();
+	}
+
+	// Joins the queue of the lane. A ticket that can be admitted right away is returned admitted.
+	Ticket enqueue(const std::string& operation, Lane lane)
+	{
+		auto waiter = std::make_shared<Waiter>();
+		waiter->lane = lane;
+		auto bucket = operations_.find(operation);
+		waiter->operationBucket = bucket != operations_.end() ? bucket->second.get() : nullptr;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		waiter->enqueued = Clock::now();
+		auto& metrics = metrics_[Index(lane)];
+		queues_[Index(lane)].push_back(waiter.get());
+		metrics.peakQueued = std::max(metrics.peakQueued, ++metrics.queued);
+		tryAdmit(*waiter, waiter->enqueued);
+		return Ticket(this, std::move(waiter));
+	}
+
+	std::array<LaneMetrics, Lanes> metrics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return metrics_;
+	}
+
+	static const char* LaneName(Lane lane)
+	{
+		switch (lane)
+		{
+		case Lane::High:
+			return "high";
+		case Lane::Normal:
+			return "normal";
+		default:
+			return "low";
+		}
+	}
+
+	void report(std::ostream& out) const
+	{
+		auto milliseconds = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+		auto lanes = metrics();
+		for (std::size_t i = 0; i < Lanes; ++i)
+		{
+			const auto& lane = lanes[i];
+			out << "Rate limiter, " << LaneName(static_cast<Lane>(i)) << " priority: " << lane.admitted << " sent, " << lane.delayed << " delayed";
+			if (lane.delayed > 0)
+			{
+				out << " (" << std::fixed << std::setprecision(1) << milliseconds(lane.waited) / static_cast<double>(lane.delayed)
+					<< " ms average, " << milliseconds(lane.longestWait) << " ms longest)";
+			}
+			if (lane.dropped > 0)
+			{
+				out << ", " << lane.dropped << " gave up waiting";
+			}
+			out << ", peak queue depth " << lane.peakQueued << '\n';
+		}
+	}
+
+private:
+	static std::size_t Index(Lane lane)
+	{
+		return static_cast<std::size_t>(lane);
+	}
+
+	static bool Ready(TokenBucket* bucket, Clock::time_point now)
+	{
+		return !bucket || bucket->timeUntilAvailable(now) == Clock::duration::zero();
+	}
+
+	// Waiter the next global token goes to: the first of the highest lane whose operation has a token
+	const Waiter* next(Clock::time_point now) const
+	{
+		for (const auto& queue : queues_)
+		{
+			for (const auto* waiter : queue)
+			{
+				if (Ready(waiter->operationBucket, now))
+				{
+					return waiter;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	// Called with mutex_ held
+	bool tryAdmit(Waiter& waiter, Clock::time_point now)
+	{
+		if (waiter.admitted)
+		{
+			return true;
+		}
+		if (next(now) != &waiter || !Ready(&global_, now))
+		{
+			return false;
+		}
+		global_.tryAcquire(now);
+		if (waiter.operationBucket)
+		{
+			waiter.operationBucket->tryAcquire(now);
+		}
+
+		waiter.admitted = true;
+		remove(waiter);
+		auto& metrics = metrics_[Index(waiter.lane)];
+		++metrics.admitted;
+		auto waited = now - waiter.enqueued;
+		if (waited > Clock::duration::zero())
+		{
+			++metrics.delayed;
+			metrics.waited += waited;
+			metrics.longestWait = std::max(metrics.longestWait, waited);
+		}
+		changed_.notify_all();
+		return true;
+	}
+
+	// Called with mutex_ held. Waiters behind another one are woken when it leaves the queue, the timeout only
+	// covers a token refilling while nobody leaves.
+	Clock::duration retryDelay(const Waiter& waiter, Clock::time_point now)
+	{
+		if (!Ready(waiter.operationBucket, now))
+		{
+			return waiter.operationBucket->timeUntilAvailable(now);
+		}
+		if (next(now) == &waiter)
+		{
+			return std::max<Clock::duration>(global_.timeUntilAvailable(now), std::chrono::microseconds(100));
+		}
+		return std::chrono::milliseconds(100);
+	}
+
+	void remove(const Waiter& waiter)
+	{
+		auto& queue = queues_[Index(waiter.lane)];
+		queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+		--metrics_[Index(waiter.lane)].queued;
+	}
+
+	void leave(const Waiter& waiter)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!waiter.admitted)
+		{
+			remove(waiter);
+			++metrics_[Index(waiter.lane)].dropped;
+			changed_.notify_all();
+		}
+	}
+
+	TokenBucket global_;
+	std::map<std::string, std::unique_ptr<TokenBucket>> operations_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable changed_;
+	std::array<std::deque<const Waiter*>, Lanes> queues_;
+	std::array<LaneMetrics, Lanes> metrics_;
+};
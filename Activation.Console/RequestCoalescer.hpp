@@ -0,0 +1,251 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "json.hpp"
+
+#include "Activation.hpp"
+#include "ActivationConfig.hpp"
+#include "ActivationStateModel.hpp"
+#include "FileLock.hpp"
+#include "LicensingCall.hpp"
+#include "SharedActivationCoordinator.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Single-flight for the refreshLease() and pullRemoteState() requests of the console actions (see
+// ActivationActions::RefreshLeaseCoalesced). Callers that arrive while a request of the same kind is in flight
+// get the future of that request instead of sending their own. The background refreshes of the shared
+// activation and of the agent are not routed through it: they run under the activation mutex, which already
+// keeps them apart from the actions, and only one process refreshes a shared activation. The seat pool and the
+// startup initialization use activations or operations of their own.
+//
+// Opt-in across processes (CrossProcessWindowSeconds > 0): the request runs under an advisory lock in the
+// storage folder and leaves a stamp file behind when it finished. A process that finds a stamp written by
+// another process for the same seat within CrossProcessWindowSeconds re-initializes from the state that
+// process persisted instead of calling the server, so consoles whose users refresh the same seat at the same
+// time send one refresh instead of one per process. Consoles starting together still initialize one by one.
+//
+// The flights call the Activation from their own thread: callers must not use the same Activation for
+// anything else until the future they got completed, exactly as with the SDK futures.
+class RequestCoalescer
+{
+public:
+	struct Counters
+	{
+		std::uint64_t sent{ 0 };                    ///< Requests that went to the server
+		std::uint64_t joined{ 0 };                  ///< Callers that shared a request already in flight in this process
+		std::uint64_t servedByOtherProcess{ 0 };    ///< Requests answered from the state another process just fetched
+	};
+
+	// fileMode: permissions of the lock files in directory, see LicenseStorage::FileMode
+	RequestCoalescer(std::shared_ptr<Activation> activation, const std::filesystem::path& directory, int fileMode, const ActivationConsole::CoalescingConfig& config)
+		: activation_(std::move(activation)),
+		config_(config),
+		refresh_(directory, "refresh", fileMode),
+		pull_(directory, "pull", fileMode)
+	{
+	}
+
+	std::shared_future<bool> refreshLease()
+	{
+		return join(refresh_, [this]()
+			{
+				return coalesceAcrossProcesses(refresh_, LicensingCall::Operations::RefreshLease,
+					[this]() { return LicensingCall::Call(LicensingCall::Operations::RefreshLease, [this]() { return activation_->refreshLease(); }); },
+					[this]()
+					{
+						const auto& info = activation_->getActivationInfo();
+						return info.leaseExpiry && *info.leaseExpiry > std::time(nullptr);
+					});
+			});
+	}
+
+	std::shared_future<ActivationStateModel> pullRemoteState()
+	{
+		return join(pull_, [this]()
+			{
+				return coalesceAcrossProcesses(pull_, LicensingCall::Operations::PullRemoteState,
+					[this]()
+					{
+						LicensingCall::Admit(LicensingCall::Operations::PullRemoteState);
+						return activation_->pullRemoteState();
+					},
+					[this]() { return activation_->getActivationInfo(); });
+			});
+	}
+
+	Counters refreshCounters() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return refresh_.counters;
+	}
+
+	Counters pullCounters() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pull_.counters;
+	}
+
+	void report(std::ostream& out) const
+	{
+		auto print = [&out](const char* name, const Counters& counters)
+			{
+				out << name << ": " << counters.sent << " sent, " << counters.joined << " joined a request in flight, "
+					<< counters.servedByOtherProcess << " served by another process" << '\n';
+			};
+		print("Lease refreshes", refreshCounters());
+		print("Remote state pulls", pullCounters());
+	}
+
+	bool isFor(const Activation& activation) const
+	{
+		return activation_.get() == &activation;
+	}
+
+private:
+	template <typename T>
+	struct Flight
+	{
+		Flight(const std::filesystem::path& directory, const std::string& name, int fileMode)
+			: lock(directory / (name + ".lock"), fileMode), stampPath(directory / (name + ".stamp"))
+		{
+		}
+
+		FileLock lock;
+		std::filesystem::path stampPath;
+		std::shared_future<T> inFlight;
+		Counters counters;
+	};
+
+	template <typename T, typename Start>
+	std::shared_future<T> join(Flight<T>& flight, Start start)
+	{
+		// A flight stuck on a dead server stays in flight, later callers join it and time out on their own deadline
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (flight.inFlight.valid() && flight.inFlight.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++flight.counters.joined;
+			return flight.inFlight;
+		}
+		flight.inFlight = std::async(std::launch::async, std::move(start)).share();
+		return flight.inFlight;
+	}
+
+	// Runs under the flight's file lock: either sends the request and stamps it, or picks up the result of the
+	// request another process stamped moments ago
+	template <typename T, typename Remote, typename Local>
+	T coalesceAcrossProcesses(Flight<T>& flight, const char* operation, Remote remote, Local local)
+	{
+		const bool locked = config_.CrossProcessWindowSeconds > 0 && LockWithin(flight.lock, LicensingCall::TimeoutFor(operation));
+		const auto& info = activation_->getActivationInfo();
+		std::string seatId = info.seatId ? *info.seatId : std::string();
+
+		try
+		{
+			if (locked && StampedByOtherProcess(flight.stampPath, seatId, config_.CrossProcessWindowSeconds))
+			{
+				// Re-initializing loads the state the other process persisted to the shared storage
+				LicensingCall::Call(LicensingCall::Operations::Initialize, [&]() { return activation_->initialize(); });
+				countServedByOtherProcess(flight);
+				T result = local();
+				flight.lock.unlock();
+				return result;
+			}
+
+			countSent(flight);
+			T result = remote();
+			if (locked)
+			{
+				WriteStamp(flight.stampPath, seatId);
+				flight.lock.unlock();
+			}
+			return result;
+		}
+		catch (...)
+		{
+			if (locked)
+			{
+				flight.lock.unlock();
+			}
+			throw;
+		}
+	}
+
+	template <typename T>
+	void countSent(Flight<T>& flight)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++flight.counters.sent;
+	}
+
+	template <typename T>
+	void countServedByOtherProcess(Flight<T>& flight)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++flight.counters.servedByOtherProcess;
+	}
+
+	// Gives up on the lock after the operation deadline, a process stuck on a dead server must not hold up the others
+	static bool LockWithin(FileLock& lock, std::chrono::milliseconds timeout)
+	{
+		auto deadline = std::chrono::steady_clock::now() + (timeout.count() > 0 ? timeout : std::chrono::hours(24));
+		while (!lock.tryLock())
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		return true;
+	}
+
+	static bool StampedByOtherProcess(const std::filesystem::path& path, const std::string& seatId, int windowSeconds)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		auto stamp = nlohmann::json::parse(file, nullptr, false);
+		if (stamp.is_discarded() || !stamp.is_object())
+		{
+			return false;
+		}
+
+		auto age = std::time(nullptr) - stamp.value("completedAt", std::int64_t(0));
+		return stamp.value("processId", std::int64_t(0)) != SharedActivationCoordinator::CurrentProcessId()
+			&& stamp.value("seatId", std::string()) == seatId
+			&& age >= 0 && age <= windowSeconds;
+	}
+
+	static void WriteStamp(const std::filesystem::path& path, const std::string& seatId)
+	{
+		nlohmann::json stamp = {
+			{ "completedAt", static_cast<std::int64_t>(std::time(nullptr)) },
+			{ "processId", SharedActivationCoordinator::CurrentProcessId() },
+			{ "seatId", seatId }
+		};
+		std::ofstream file(path, std::ios::trunc);
+		file << stamp.dump();
+	}
+
+	std::shared_ptr<Activation> activation_;
+	ActivationConsole::CoalescingConfig config_;
+	mutable std::mutex mutex_;
+	Flight<bool> refresh_;
+	Flight<ActivationStateModel> pull_;
+};
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "json.hpp"
+
+#include "Activation.hpp"
+#include "ActivationCodeCredentialsModel.hpp"
+#include "ActivationConfig.hpp"
+#include "FileLock.hpp"
+#include "LeasePolicy.hpp"
+#include "LicensingCall.hpp"
+#include "Logger.hpp"
+#include "SharedActivationCoordinator.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Warm seat pool for short-lived workers. The manager (--seat-pool) keeps SeatPool.Size seats activated ahead
+// of time, each in its own folder under <storage folder>/seat-pool with its own seat ID and license file:
+//   <seat>/lease.lock   held by the worker that leased the seat, released by the OS when the worker exits
+//   <seat>/seat.json    seat ID and state: "pending" while the manager activates it, "ready" until a worker
+//                       leases it, "claimed" afterwards
+// A worker (--pooled-seat) leases a ready seat by locking it, which takes a few file operations instead of a
+// fingerprint, an activation and a first save. Once the lock of a claimed seat is free again the worker is
+// gone: the manager deactivates the seat, deletes its folder and activates a fresh one in its place. A seat
+// left pending by a failed activation or a crashed manager is deactivated the same way before it is deleted.
+namespace SeatPool
+{
+	constexpr const char* DirectoryName = "seat-pool";
+	constexpr const char* Pending = "pending";
+	constexpr const char* Ready = "ready";
+	constexpr const char* Claimed = "claimed";
+
+	struct SeatRecord
+	{
+		std::string seatId;
+		std::string state;
+		std::int64_t activatedAt{ 0 };
+		std::int64_t claimedBy{ 0 };    ///< Process ID of the worker, 0 while ready
+	};
+
+	namespace Detail
+	{
+		inline std::filesystem::path LockPath(const std::filesystem::path& seatDirectory)
+		{
+			return seatDirectory / "lease.lock";
+		}
+
+		inline std::filesystem::path RecordPath(const std::filesystem::path& seatDirectory)
+		{
+			return seatDirectory / "seat.json";
+		}
+
+		inline std::optional<SeatRecord> ReadRecord(const std::filesystem::path& seatDirectory)
+		{
+			std::ifstream file(RecordPath(seatDirectory));
+			if (!file.is_open())
+			{
+				return std::nullopt;
+			}
+
+			auto json = nlohmann::json::parse(file, nullptr, false);
+			if (json.is_discarded() || !json.is_object())
+			{
+				return std::nullopt;
+			}
+
+			SeatRecord record;
+			record.seatId = json.value("seatId", std::string());
+			record.state = json.value("state", std::string());
+			record.activatedAt = json.value("activatedAt", std::int64_t(0));
+			record.claimedBy = json.value("claimedBy", std::int64_t(0));
+			return record;
+		}
+
+		// Written next to the record and renamed over it, a reader never sees half a record
+		inline void WriteRecord(const std::filesystem::path& seatDirectory, const SeatRecord& record)
+		{
+			nlohmann::json json = {
+				{ "seatId", record.seatId },
+				{ "state", record.state },
+				{ "activatedAt", record.activatedAt },
+				{ "claimedBy", record.claimedBy }
+			};
+
+			auto temporary = RecordPath(seatDirectory);
+			temporary += ".tmp";
+			{
+				std::ofstream file(temporary, std::ios::trunc);
+				file << json.dump();
+				if (!file)
+				{
+					throw std::runtime_error("Failed to write seat record: " + temporary.string());
+				}
+			}
+			std::filesystem::rename(temporary, RecordPath(seatDirectory));
+		}
+	}
+
+	// A seat leased by this process, held until the object is destroyed or the process exits
+	class Lease
+	{
+	public:
+		// Null when no ready seat is left. fileMode: permissions of the seat lock files, see LicenseStorage::FileMode
+		static std::unique_ptr<Lease> Acquire(const std::filesystem::path& poolDirectory, int fileMode)
+		{
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(poolDirectory, error))
+			{
+				if (!entry.is_directory(error))
+				{
+					continue;
+				}
+
+				// Seats still being activated and seats already claimed are skipped
+				auto record = Detail::ReadRecord(entry.path());
+				if (!record || record->state != Ready)
+				{
+					continue;
+				}
+
+				auto lock = std::make_unique<FileLock>(Detail::LockPath(entry.path()), fileMode);
+				if (!lock->tryLock())
+				{
+					continue;
+				}
+
+				// Read again under the lock, another worker may have claimed it in between
+				record = Detail::ReadRecord(entry.path());
+				if (!record || record->state != Ready)
+				{
+					continue;
+				}
+
+				record->state = Claimed;
+				record->claimedBy = SharedActivationCoordinator::CurrentProcessId();
+				Detail::WriteRecord(entry.path(), *record);
+				return std::unique_ptr<Lease>(new Lease(entry.path(), std::move(lock), record->seatId));
+			}
+			return nullptr;
+		}
+
+		const std::string& seatId() const
+		{
+			return seatId_;
+		}
+
+		// Folder name of the seat, LicenseStorage::ForPooledSeat opens its license file
+		std::string name() const
+		{
+			return directory_.filename().string();
+		}
+
+	private:
+		Lease(std::filesystem::path directory, std::unique_ptr<FileLock> lock, std::string seatId)
+			: directory_(std::move(directory)), lock_(std::move(lock)), seatId_(std::move(seatId))
+		{
+		}
+
+		std::filesystem::path directory_;
+		std::unique_ptr<FileLock> lock_;
+		std::string seatId_;
+	};
+
+	// Keeps the pool at SeatPool.Size ready seats until stop() is called
+	class Manager
+	{
+	public:
+		// Creates the Activation of a pooled seat, with its seat ID and the storage of its folder
+		using ActivationFactory = std::function<std::shared_ptr<Activation>(const std::string& seatId, const std::string& name)>;
+
+		Manager(std::filesystem::path poolDirectory, int fileMode, ActivationFactory createActivation, const ActivationConsole::SeatPoolConfig& config)
+			: poolDirectory_(std::move(poolDirectory)), fileMode_(fileMode), createActivation_(std::move(createActivation)), config_(config)
+		{
+			if (config_.ActivationCode.empty())
+			{
+				throw std::runtime_error("SeatPool.ActivationCode is required to activate the pooled seats");
+			}
+			std::filesystem::create_directories(poolDirectory_);
+		}
+
+		void run()
+		{
+			Log::Information(Log::Categories::SeatPool, "Seat pool manager started", { { "size", std::to_string(config_.Size) }, { "directory", poolDirectory_.string() } });
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (!stopping_)
+			{
+				lock.unlock();
+				maintain();
+				lock.lock();
+				stopped_.wait_for(lock, std::chrono::milliseconds(config_.ReplenishIntervalMs), [this]() { return stopping_; });
+			}
+			Log::Information(Log::Categories::SeatPool, "Seat pool manager stopped, ready seats stay activated for the next start");
+		}
+
+		// Safe to call from a signal hook, run() returns after the seat it is working on
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			stopped_.notify_all();
+		}
+
+	private:
+		// One pass: reclaims the seats of workers that exited, keeps the leases of ready seats alive and
+		// activates seats until SeatPool.Size of them are ready
+		void maintain()
+		{
+			int ready = 0;
+			int leased = 0;
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(poolDirectory_, error))
+			{
+				if (!entry.is_directory(error) || isStopping())
+				{
+					continue;
+				}
+
+				FileLock lock(Detail::LockPath(entry.path()), fileMode_);
+				if (!lock.tryLock())
+				{
+					++leased;
+					continue;
+				}
+
+				auto record = Detail::ReadRecord(entry.path());
+				if (record && record->state == Ready)
+				{
+					keepLeaseAlive(entry.path(), *record);
+					++ready;
+				}
+				else
+				{
+					// A claimed seat whose worker exited, or a pending seat whose activation never finished
+					reclaim(entry.path(), record);
+				}
+				lock.unlock();
+			}
+
+			while (ready < config_.Size && !isStopping())
+			{
+				if (!activateSeat())
+				{
+					// The next pass tries again, the server may just be unavailable
+					break;
+				}
+				++ready;
+			}
+
+			if (ready != reportedReady_ || leased != reportedLeased_)
+			{
+				Log::Information(Log::Categories::SeatPool, "Seat pool changed", { { "ready", std::to_string(ready) }, { "leased", std::to_string(leased) } });
+				reportedReady_ = ready;
+				reportedLeased_ = leased;
+			}
+		}
+
+		bool activateSeat()
+		{
+			auto seatId = NewSeatId();
+			auto directory = poolDirectory_ / seatId;
+			std::filesystem::create_directories(directory);
+
+			// Locked while activating, workers also skip the seat because it is still pending
+			FileLock lock(Detail::LockPath(directory), fileMode_);
+			lock.lock();
+
+			// Recorded before the activation, so a seat the server activated is never deleted without deactivating it
+			SeatRecord record;
+			record.seatId = seatId;
+			record.state = Pending;
+			try
+			{
+				Detail::WriteRecord(directory, record);
+			}
+			catch (const std::exception& e)
+			{
+				Log::Error(Log::Categories::SeatPool, "Failed to create pooled seat", { { "seatId", seatId }, { "error", e.what() } });
+				std::error_code error;
+				std::filesystem::remove_all(directory, error);
+				return false;
+			}
+
+			try
+			{
+				auto activation = createActivation_(seatId, seatId);
+				LicensingCall::ActivationScope seat(activation.get());
+				LicensingCall::Call(LicensingCall::Operations::Initialize, [&]() { return activation->initialize(); });
+				LicensingCall::Call(LicensingCall::Operations::Activate, [&]() { return activation->activate(
+					std::make_shared<ActivationCodeCredentialsModel>(config_.ActivationCode), config_.SeatName, config_.EditionId); });
+
+				record.state = Ready;
+				record.activatedAt = static_cast<std::int64_t>(std::time(nullptr));
+				Detail::WriteRecord(directory, record);
+				activations_[seatId] = activation;
+				return true;
+			}
+			catch (const std::exception& e)
+			{
+				// Left pending, the next pass deactivates it in case the server activated it anyway
+				Log::Error(Log::Categories::SeatPool, "Failed to activate pooled seat", { { "seatId", seatId }, { "error", e.what() } });
+				return false;
+			}
+		}
+
+		void keepLeaseAlive(const std::filesystem::path& directory, const SeatRecord& record)
+		{
+			try
+			{
+				auto activation = activationOf(directory, record);
+				LicensingCall::ActivationScope seat(activation.get());
+				const auto& info = activation->getActivationInfo();
+				if (info.leaseExpiry && LeasePolicy::RefreshDue(*info.leaseExpiry, std::time(nullptr), config_.RefreshBeforeExpirySeconds))
+				{
+					LicensingCall::Call(LicensingCall::Operations::RefreshLease, [&]() { return activation->refreshLease(); });
+				}
+			}
+			catch (const std::exception& e)
+			{
+				Log::Error(Log::Categories::SeatPool, "Failed to refresh the lease of pooled seat", { { "seatId", record.seatId }, { "error", e.what() } });
+			}
+		}
+
+		void reclaim(const std::filesystem::path& directory, const std::optional<SeatRecord>& record)
+		{
+			if (record && !record->seatId.empty())
+			{
+				try
+				{
+					// A fresh Activation loads what the worker persisted, the cached one does not know about its changes
+					activations_.erase(record->seatId);
+					auto activation = createActivation_(record->seatId, directory.filename().string());
+					LicensingCall::ActivationScope seat(activation.get());
+					LicensingCall::Call(LicensingCall::Operations::Initialize, [&]() { return activation->initialize(); });
+					if (activation->getState() == ActivationState::Active)
+					{
+						ActivationOperationRes result = LicensingCall::Call(LicensingCall::Operations::Deactivate, [&]() { return activation->deactivate(); });
+						if (!result.IsSuccess())
+						{
+							throw std::runtime_error("The server did not confirm the deactivation");
+						}
+					}
+					Log::Information(Log::Categories::SeatPool, "Reclaimed pooled seat", { { "seatId", record->seatId }, { "processId", std::to_string(record->claimedBy) } });
+				}
+				catch (const std::exception& e)
+				{
+					// Kept for the next pass, deleting it would leave the seat activated on the server
+					Log::Error(Log::Categories::SeatPool, "Failed to deactivate pooled seat", { { "seatId", record->seatId }, { "error", e.what() } });
+					return;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::remove_all(directory, error);
+		}
+
+		std::shared_ptr<Activation> activationOf(const std::filesystem::path& directory, const SeatRecord& record)
+		{
+			auto cached = activations_.find(record.seatId);
+			if (cached != activations_.end())
+			{
+				return cached->second;
+			}
+
+			// Seat activated by an earlier run of the manager
+			auto activation = createActivation_(record.seatId, directory.filename().string());
+			LicensingCall::ActivationScope seat(activation.get());
+			LicensingCall::Call(LicensingCall::Operations::Initialize, [&]() { return activation->initialize(); });
+			activations_[record.seatId] = activation;
+			return activation;
+		}
+
+		bool isStopping()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return stopping_;
+		}
+
+		static std::string NewSeatId()
+		{
+			std::mt19937_64 generator(std::random_device{}());
+			std::ostringstream id;
+			id << "pool-" << std::hex << std::setw(16) << std::setfill('0') << generator();
+			return id.str();
+		}
+
+		std::filesystem::path poolDirectory_;
+		int fileMode_;
+		ActivationFactory createActivation_;
+		ActivationConsole::SeatPoolConfig config_;
+		std::map<std::string, std::shared_ptr<Activation>> activations_;
+		int reportedReady_{ -1 };
+		int reportedLeased_{ -1 };
+		std::mutex mutex_;
+		std::condition_variable stopped_;
+		bool stopping_{ false };
+	};
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Authenticated encryption of the activation data files owned by the console (journal records and snapshots).
+// Blob layout: [format version (1 byte)][IV (12 bytes)][ciphertext][GCM tag (16 bytes)].
+// The version byte is authenticated as well, so it cannot be flipped without the blob failing to decode.
+// Compressed payloads are deflated before encryption; blobs written before compression existed (Plain) still decode.
+class SecureBlobCodec
+{
+public:
+	using Bytes = std::vector<std::uint8_t>;
+	using Key = std::array<std::uint8_t, 32>;
+
+	enum FormatVersion : std::uint8_t
+	{
+		Plain = 1,  ///< Payload stored as is
+		Deflate = 2 ///< [uncompressed size (4 bytes, little endian)][zlib stream]
+	};
+
+	// Payloads below this size are never compressed, the zlib header would outweigh the savings
+	static constexpr std::size_t MinimumCompressedPayload = 128;
+
+	static constexpr std::size_t IvSize = 12;
+	static constexpr std::size_t TagSize = 16;
+	static constexpr std::size_t Overhead = 1 + IvSize + TagSize;
+
+	explicit SecureBlobCodec(const Key& key, bool compress = false)
+		: key_(key), compress_(compress)
+	{
+	}
+
+	// Derives the codec key from secret material and a purpose string
+	static Key DeriveKey(const std::string& secret, const std::string& context)
+	{
+		Key key{};
+		unsigned int length = 0;
+		std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+		const unsigned char separator = 0;
+		if (!ctx
+			|| EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1
+			|| EVP_DigestUpdate(ctx.get(), context.data(), context.size()) != 1
+			|| EVP_DigestUpdate(ctx.get(), &separator, 1) != 1
+			|| EVP_DigestUpdate(ctx.get(), secret.data(), secret.size()) != 1
+			|| EVP_DigestFinal_ex(ctx.get(), key.data(), &length) != 1)
+		{
+			throw std::runtime_error("Failed to derive storage key");
+		}
+		return key;
+	}
+
+	// Random secret of this installation, created on first use. The file is readable by the owner only (POSIX
+	// permissions 0600, the user profile ACL on Windows), so other users of the machine cannot read or forge the
+	// files encrypted with it. A key file other users can read, or one owned by someone else, is refused.
+	static Key LoadOrCreateKey(const std::filesystem::path& path)
+	{
+		Key key{};
+#ifndef _WIN32
+		struct stat status {};
+		if (::stat(path.string().c_str(), &status) == 0
+			&& (status.st_uid != ::geteuid() || (status.st_mode & (S_IRWXG | S_IRWXO)) != 0))
+		{
+			throw std::runtime_error("Storage key file must be owned by the current user and not accessible to others: " + path.string());
+		}
+#endif
+		{
+			std::ifstream existing(path, std::ios::binary);
+			if (existing)
+			{
+				Bytes content((std::istreambuf_iterator<char>(existing)), std::istreambuf_iterator<char>());
+				if (content.size() != key.size())
+				{
+					throw std::runtime_error("Storage key file is corrupted: " + path.string());
+				}
+				std::copy(content.begin(), content.end(), key.begin());
+				return key;
+			}
+		}
+
+		if (RAND_bytes(key.data(), static_cast<int>(key.size())) != 1)
+		{
+			throw std::runtime_error("Failed to generate storage key");
+		}
+		// Written under a name of its own and linked into place, a process starting at the same time either wins
+		// the link or reads the key of the one that did
+		std::uint32_t suffix = 0;
+		RAND_bytes(reinterpret_cast<unsigned char*>(&suffix), sizeof(suffix));
+		auto staged = path;
+		staged += "." + std::to_string(suffix) + ".tmp";
+#ifdef _WIN32
+		std::ofstream file(staged, std::ios::binary | std::ios::trunc);
+		bool written = file.write(reinterpret_cast<const char*>(key.data()), static_cast<std::streamsize>(key.size())) && file.flush();
+		file.close();
+#else
+		int fd = ::open(staged.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		bool written = fd >= 0 && ::fchmod(fd, S_IRUSR | S_IWUSR) == 0
+			&& ::write(fd, key.data(), key.size()) == static_cast<ssize_t>(key.size()) && ::fsync(fd) == 0;
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+#endif
+		std::error_code linkError;
+		if (written)
+		{
+			std::filesystem::create_hard_link(staged, path, linkError);
+		}
+		std::error_code ignored;
+		std::filesystem::remove(staged, ignored);
+		if (written && linkError && std::filesystem::exists(path))
+		{
+			return LoadOrCreateKey(path);
+		}
+		if (!written || linkError)
+		{
+			throw std::runtime_error("Failed to write storage key file: " + path.string());
+		}
+		return key;
+	}
+
+	static std::string Sha256Hex(const std::string& data)
+	{
+		std::array<std::uint8_t, 32> digest{};
+		unsigned int length = 0;
+		if (EVP_Digest(data.data(), data.size(), digest.data(), &length, EVP_sha256(), nullptr) != 1)
+		{
+			throw std::runtime_error("Failed to hash activation data");
+		}
+
+		static const char* hexDigits = "0123456789abcdef";
+		std::string hex;
+		hex.reserve(length * 2);
+		for (unsigned int i = 0; i < length; ++i)
+		{
+			hex.push_back(hexDigits[digest[i] >> 4]);
+			hex.push_back(hexDigits[digest[i] & 0x0F]);
+		}
+		return hex;
+	}
+
+	Bytes Encode(const Bytes& payload) const
+	{
+		if (compress_ && payload.size() >= MinimumCompressedPayload)
+		{
+			auto compressed = Compress(payload);
+			if (compressed.size() < payload.size())
+			{
+				return Seal(FormatVersion::Deflate, compressed);
+			}
+		}
+		return Seal(FormatVersion::Plain, payload);
+	}
+
+	// Returns std::nullopt when the blob is truncated, tampered with or was written with an unknown format version
+	std::optional<Bytes> Decode(const std::uint8_t* blob, std::size_t size) const
+	{
+		if (size < Overhead)
+		{
+			return std::nullopt;
+		}
+
+		std::uint8_t version = blob[0];
+		auto payload = Open(blob, size);
+		if (!payload)
+		{
+			return std::nullopt;
+		}
+
+		switch (version)
+		{
+		case FormatVersion::Plain:
+			return payload;
+		case FormatVersion::Deflate:
+			return Decompress(*payload);
+		default:
+			return std::nullopt;
+		}
+	}
+
+	std::optional<Bytes> Decode(const Bytes& blob) const
+	{
+		return Decode(blob.data(), blob.size());
+	}
+
+private:
+	using CipherContext = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+
+	Bytes Seal(std::uint8_t version, const Bytes& payload) const
+	{
+		Bytes blob(Overhead + payload.size());
+		blob[0] = version;
+		std::uint8_t* iv = blob.data() + 1;
+		std::uint8_t* ciphertext = iv + IvSize;
+		std::uint8_t* tag = ciphertext + payload.size();
+
+		if (RAND_bytes(iv, static_cast<int>(IvSize)) != 1)
+		{
+			throw std::runtime_error("Failed to generate storage IV");
+		}
+
+		CipherContext ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+		int length = 0;
+		if (!ctx
+			|| EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key_.data(), iv) != 1
+			|| EVP_EncryptUpdate(ctx.get(), nullptr, &length, &version, 1) != 1
+			|| EVP_EncryptUpdate(ctx.get(), ciphertext, &length, payload.data(), static_cast<int>(payload.size())) != 1
+			|| EVP_EncryptFinal_ex(ctx.get(), ciphertext + length, &length) != 1
+			|| EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, static_cast<int>(TagSize), tag) != 1)
+		{
+			throw std::runtime_error("Failed to encrypt activation data");
+		}
+		return blob;
+	}
+
+	std::optional<Bytes> Open(const std::uint8_t* blob, std::size_t size) const
+	{
+		const std::uint8_t version = blob[0];
+		const std::uint8_t* iv = blob + 1;
+		const std::uint8_t* ciphertext = iv + IvSize;
+		const std::size_t ciphertextSize = size - Overhead;
+		const std::uint8_t* tag = ciphertext + ciphertextSize;
+
+		Bytes payload(ciphertextSize);
+		CipherContext ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+		int length = 0;
+		if (!ctx
+			|| EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, key_.data(), iv) != 1
+			|| EVP_DecryptUpdate(ctx.get(), nullptr, &length, &version, 1) != 1
+			|| EVP_DecryptUpdate(ctx.get(), payload.data(), &length, ciphertext, static_cast<int>(ciphertextSize)) != 1
+			|| EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, static_cast<int>(TagSize), const_cast<std::uint8_t*>(tag)) != 1
+			|| EVP_DecryptFinal_ex(ctx.get(), payload.data() + length, &length) != 1)
+		{
+			return std::nullopt;
+		}
+		return payload;
+	}
+
+	static Bytes Compress(const Bytes& payload)
+	{
+		uLongf compressedSize = compressBound(static_cast<uLong>(payload.size()));
+		Bytes compressed(4 + compressedSize);
+		std::uint32_t size = static_cast<std::uint32_t>(payload.size());
+		compressed[0] = static_cast<std::uint8_t>(size);
+		compressed[1] = static_cast<std::uint8_t>(size >> 8);
+		compressed[2] = static_cast<std::uint8_t>(size >> 16);
+		compressed[3] = static_cast<std::uint8_t>(size >> 24);
+
+		if (compress2(compressed.data() + 4, &compressedSize, payload.data(), static_cast<uLong>(payload.size()), Z_BEST_SPEED) != Z_OK)
+		{
+			throw std::runtime_error("Failed to compress activation data");
+		}
+		compressed.resize(4 + compressedSize);
+		return compressed;
+	}
+
+	static std::optional<Bytes> Decompress(const Bytes& compressed)
+	{
+		if (compressed.size() < 4)
+		{
+			return std::nullopt;
+		}
+
+		uLongf size = static_cast<uLongf>(compressed[0])
+			| (static_cast<uLongf>(compressed[1]) << 8)
+			| (static_cast<uLongf>(compressed[2]) << 16)
+			| (static_cast<uLongf>(compressed[3]) << 24);
+		Bytes payload(size);
+		uLongf payloadSize = size;
+		if (uncompress(payload.data(), &payloadSize, compressed.data() + 4, static_cast<uLong>(compressed.size() - 4)) != Z_OK
+			|| payloadSize != size)
+		{
+			return std::nullopt;
+		}
+		return payload;
+	}
+
+	Key key_;
+	bool compress_;
+};
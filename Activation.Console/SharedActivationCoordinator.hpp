@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Activation.hpp"
+#include "ActivationConfig.hpp"
+#include "ActivationStateModel.hpp"
+#include "FileLock.hpp"
+#include "LeasePolicy.hpp"
+#include "LicensingCall.hpp"
+#include "Logger.hpp"
+#include "SharedStateSnapshot.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace ZentitleLicensingClient;
+
+// Coordinates one machine-wide activation between every console process on the host.
+//
+// All processes use the same seat and the same PUBLIC_DATA storage. Exactly one of them, the refresh
+// owner, holds the owner lock and keeps the lease alive; the lock is released by the OS when the owner
+// exits and another process takes over on its next check. After every change the activation state is
+// published to a shared memory snapshot, which the other processes read instead of asking the server.
+class SharedActivationCoordinator
+{
+public:
+	using ChangeCallback = std::function<void()>;
+
+	// onChange runs on the coordinator thread, under activationMutex(), after the background refresh changed the activation
+	SharedActivationCoordinator(std::shared_ptr<Activation> activation, const std::filesystem::path& directory, const ActivationConsole::SharedActivationConfig& config, ChangeCallback onChange = {})
+		: activation_(std::move(activation)),
+		config_(config),
+		onChange_(std::move(onChange)),
+		ownerLock_(directory / "refresh-owner.lock", SharedFileMode),
+		publishLock_(directory / "state.snapshot.lock", SharedFileMode),
+		snapshot_(directory / "state.snapshot", MappedFile::Access::ReadWrite, SharedFileMode)
+	{
+	}
+
+	~SharedActivationCoordinator()
+	{
+		{
+			std::lock_guard<std::mutex> lock(stopMutex_);
+			stopping_ = true;
+		}
+		wake_.notify_all();
+		if (worker_.joinable())
+		{
+			worker_.join();
+		}
+	}
+
+	SharedActivationCoordinator(const SharedActivationCoordinator&) = delete;
+	SharedActivationCoordinator& operator=(const SharedActivationCoordinator&) = delete;
+
+	void start()
+	{
+		worker_ = std::thread([this]() { run(); });
+	}
+
+	// Guards the Activation instance shared by user actions and the background refresh
+	std::timed_mutex& activationMutex()
+	{
+		return activationMutex_;
+	}
+
+	bool isRefreshOwner() const
+	{
+		return owner_.load();
+	}
+
+	std::optional<SharedStateSnapshot::View> readSnapshot() const
+	{
+		return snapshot_.read();
+	}
+
+	// Publishes the current activation state, the caller must not hold activationMutex()
+	void publish()
+	{
+		std::lock_guard<std::timed_mutex> lock(activationMutex_);
+		publishLocked();
+	}
+
+	static std::int64_t CurrentProcessId()
+	{
+#ifdef _WIN32
+		return static_cast<std::int64_t>(GetCurrentProcessId());
+#else
+		return static_cast<std::int64_t>(::getpid());
+#endif
+	}
+
+private:
+	// Machine scope, shared with the group like LicenseStorage::FileMode
+	static constexpr int SharedFileMode = 0660;
+
+	void run()
+	{
+		Tracing::NameThread("Shared activation coordinator");
+		while (true)
+		{
+			try
+			{
+				if (!owner_ && ownerLock_.tryLock())
+				{
+					owner_ = true;
+					publish();
+				}
+
+				if (owner_)
+				{
+					snapshot_.heartbeat(static_cast<std::int64_t>(std::time(nullptr)));
+					refreshIfDue();
+				}
+				else
+				{
+					followOwner();
+				}
+			}
+			catch (const std::exception& e)
+			{
+				Log::Error(Log::Categories::SharedActivation, "Shared activation coordination failed", { { "error", e.what() } });
+			}
+
+			std::unique_lock<std::mutex> lock(stopMutex_);
+			if (wake_.wait_for(lock, std::chrono::seconds(config_.RefreshCheckIntervalSeconds), [this]() { return stopping_; }))
+			{
+				return;
+			}
+		}
+	}
+
+	void refreshIfDue()
+	{
+		std::lock_guard<std::timed_mutex> lock(activationMutex_);
+
+		auto state = activation_->getState();
+		const auto& info = activation_->getActivationInfo();
+		if ((state != ActivationState::Active && state != ActivationState::LeaseExpired)
+			|| info.activationMode != ActivationMode::Online
+			|| !info.leaseExpiry)
+		{
+			return;
+		}
+
+		if (!LeasePolicy::RefreshDue(*info.leaseExpiry, std::time(nullptr), config_.RefreshBeforeExpirySeconds))
+		{
+			return;
+		}
+
+		try
+		{
+			LicensingCall::Call(LicensingCall::Operations::RefreshLease, [&]() { return activation_->refreshLease(); });
+		}
+		catch (const std::exception& e)
+		{
+			Log::Error(Log::Categories::SharedActivation, "Shared activation lease refresh failed", { { "error", e.what() } });
+		}
+		notifyChanged();
+		publishLocked();
+	}
+
+	// Picks up a lease the owner refreshed, so this process does not fall into LeaseExpired on its own
+	void followOwner()
+	{
+		auto published = snapshot_.read();
+		if (!published || !published->leaseExpiry || published->sequence == lastFollowedSequence_)
+		{
+			return;
+		}
+		lastFollowedSequence_ = published->sequence;
+
+		std::lock_guard<std::timed_mutex> lock(activationMutex_);
+		const auto& info = activation_->getActivationInfo();
+		if (!info.leaseExpiry || *info.leaseExpiry < *published->leaseExpiry)
+		{
+			// Relies on initialize() loading the activation from the storage before it contacts the server, so it
+			// picks up the state the owner persisted to the shared storage
+			LicensingCall::Call(LicensingCall::Operations::Initialize, [&]() { return activation_->initialize(); });
+			notifyChanged();
+		}
+	}
+
+	void notifyChanged()
+	{
+		if (onChange_)
+		{
+			onChange_();
+		}
+	}
+
+	void publishLocked()
+	{
+		auto payload = std::make_unique<SharedStateSnapshot::Payload>();
+		const auto& info = activation_->getActivationInfo();
+
+		payload->publishedAt = static_cast<std::int64_t>(std::time(nullptr));
+		payload->publisherProcessId = CurrentProcessId();
+		payload->state = static_cast<std::int32_t>(activation_->getState());
+		payload->mode = static_cast<std::int32_t>(info.activationMode);
+		payload->active = activation_->getState() == ActivationState::Active ? 1 : 0;
+		payload->hasLeaseExpiry = info.leaseExpiry ? 1 : 0;
+		payload->leaseExpiry = info.leaseExpiry ? static_cast<std::int64_t>(*info.leaseExpiry) : 0;
+		payload->heartbeatIntervalSeconds = config_.RefreshCheckIntervalSeconds;
+		SharedStateSnapshot::CopyKey(payload->seatId, sizeof(payload->seatId), info.seatId ? *info.seatId : std::string());
+
+		std::size_t count = 0;
+		for (const auto& feature : info.features)
+		{
+			if (count == SharedStateSnapshot::MaxFeatures)
+			{
+				break;
+			}
+
+			auto& record = payload->features[count];
+			if (!SharedStateSnapshot::CopyKey(record.key, sizeof(record.key), feature.key))
+			{
+				Log::Warning(Log::Categories::SharedActivation, "Feature key too long for the shared snapshot, not published", { { "key", feature.key } });
+				continue;
+			}
+			++count;
+			record.type = static_cast<std::int32_t>(feature.type);
+			record.flags = (feature.active ? SharedStateSnapshot::HasActive : 0u)
+				| (feature.available ? SharedStateSnapshot::HasAvailable : 0u)
+				| (feature.total ? SharedStateSnapshot::HasTotal : 0u);
+			record.active = feature.active ? static_cast<std::int64_t>(*feature.active) : 0;
+			record.available = feature.available ? static_cast<std::int64_t>(*feature.available) : 0;
+			record.total = feature.total ? static_cast<std::int64_t>(*feature.total) : 0;
+		}
+		payload->featureCount = static_cast<std::uint32_t>(count);
+
+		count = 0;
+		for (const auto& attribute : info.attributes)
+		{
+			if (count == SharedStateSnapshot::MaxAttributes)
+			{
+				break;
+			}
+
+			auto& record = payload->attributes[count];
+			if (!SharedStateSnapshot::CopyKey(record.key, sizeof(record.key), attribute.key)
+				|| !SharedStateSnapshot::CopyKey(record.type, sizeof(record.type), attribute.type)
+				|| !SharedStateSnapshot::CopyKey(record.value, sizeof(record.value), attribute.value ? *attribute.value : std::string()))
+			{
+				Log::Warning(Log::Categories::SharedActivation, "Attribute too long for the shared snapshot, not published", { { "key", attribute.key } });
+				continue;
+			}
+			record.hasValue = attribute.value ? 1 : 0;
+			++count;
+		}
+		payload->attributeCount = static_cast<std::uint32_t>(count);
+
+		FileLockGuard publishLock(publishLock_);
+		snapshot_.publish(*payload);
+		lastFollowedSequence_ = snapshot_.sequence();
+	}
+
+	std::shared_ptr<Activation> activation_;
+	ActivationConsole::SharedActivationConfig config_;
+	ChangeCallback onChange_;
+
+	std::timed_mutex activationMutex_;
+	FileLock ownerLock_;
+	FileLock publishLock_;
+	SharedStateSnapshot::Mapping snapshot_;
+	std::atomic<bool> owner_{ false };
+	std::atomic<std::uint64_t> lastFollowedSequence_{ 0 };
+
+	std::mutex stopMutex_;
+	std::condition_variable wake_;
+	bool stopping_{ false };
+	std::thread worker_;
+};
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Activation state published by one process into a file-backed shared memory region and read
+// by every other process on the host. Writers are serialized by the caller (see
+// SharedActivationCoordinator), readers use the sequence counter as a seqlock: an odd value
+// means a write is in progress, a changed value means the copy must be retried.
+// Has no SDK dependencies, client applications read it through SharedStateSnapshotReader.hpp.
+namespace SharedStateSnapshot
+{
+	constexpr std::uint32_t Magic = 0x5A325353; // "Z2SS"
+	constexpr std::uint32_t LayoutVersion = 3;
+	constexpr std::size_t MaxFeatures = 1024;
+	constexpr std::size_t MaxAttributes = 128;
+	constexpr std::size_t MaxKeyLength = 64;
+	constexpr std::size_t MaxSeatIdLength = 128;
+	constexpr std::size_t MaxAttributeTypeLength = 32;
+	constexpr std::size_t MaxAttributeValueLength = 256;
+	constexpr std::int64_t MissedHeartbeatsUntilStale = 3;
+	constexpr std::size_t IndexSlots = 2048; ///< Open addressing table over the feature keys, power of two and at most half full
+
+	static_assert((IndexSlots & (IndexSlots - 1)) == 0 && IndexSlots >= 2 * MaxFeatures, "Feature index must be a power of two with spare slots");
+
+	// Bits of FeatureRecord::flags
+	constexpr std::uint32_t HasActive = 1u << 0;
+	constexpr std::uint32_t HasAvailable = 1u << 1;
+	constexpr std::uint32_t HasTotal = 1u << 2;
+
+	struct FeatureRecord
+	{
+		char key[MaxKeyLength];
+		std::int32_t type;
+		std::uint32_t flags;
+		std::int64_t active;
+		std::int64_t available;
+		std::int64_t total;
+	};
+
+	struct AttributeRecord
+	{
+		char key[MaxKeyLength];
+		char type[MaxAttributeTypeLength];
+		std::uint32_t hasValue;
+		std::uint32_t reserved;
+		char value[MaxAttributeValueLength];
+	};
+
+	struct Payload
+	{
+		std::int64_t publishedAt;     ///< Unix time of the publication
+		std::int64_t publisherProcessId;
+		std::int32_t state;           ///< ActivationState as integer
+		std::int32_t mode;            ///< ActivationMode as integer
+		std::int32_t active;          ///< 1 when state is ActivationState::Active, readers need no SDK enum
+		std::int32_t hasLeaseExpiry;
+		std::int64_t leaseExpiry;     ///< Unix time
+		std::int64_t heartbeatIntervalSeconds; ///< How often the refresh owner updates Region::heartbeat
+		char seatId[MaxSeatIdLength];
+		std::uint32_t featureCount;
+		std::uint32_t attributeCount;
+		FeatureRecord features[MaxFeatures];
+		AttributeRecord attributes[MaxAttributes];
+		std::uint16_t featureIndex[IndexSlots]; ///< Feature position + 1, 0 marks an empty slot. Built by Mapping::publish
+	};
+
+	struct Region
+	{
+		std::uint32_t magic;
+		std::uint32_t layoutVersion;
+		std::atomic<std::uint64_t> sequence;
+		std::atomic<std::int64_t> heartbeat; ///< Unix time the refresh owner last checked the lease
+		Payload payload;
+	};
+
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::int64_t>::is_always_lock_free,
+		"Shared snapshot requires lock-free 64-bit atomics");
+
+	constexpr std::size_t PayloadHeaderSize = offsetof(Payload, features);
+
+	// Reader side copy of a publication
+	struct View
+	{
+		std::uint64_t sequence{ 0 };
+		std::int64_t publishedAt{ 0 };
+		std::int64_t publisherProcessId{ 0 };
+		std::int32_t state{ 0 };
+		std::int32_t mode{ 0 };
+		bool active{ false };
+		std::optional<std::int64_t> leaseExpiry;
+		std::string seatId;
+		std::vector<FeatureRecord> features;
+		std::vector<AttributeRecord> attributes;
+	};
+
+	// Published state a feature check depends on, read in the same pass as the feature record
+	struct Validity
+	{
+		bool active{ false };
+		std::optional<std::int64_t> leaseExpiry;
+		std::int64_t heartbeat{ 0 };
+		std::int64_t heartbeatIntervalSeconds{ 0 };
+
+		// False once the lease expired or the refresh owner stopped updating the heartbeat, for example
+		// because every console process of the machine-wide activation exited
+		bool grantsAt(std::int64_t now) const
+		{
+			if (!active || (leaseExpiry && now >= *leaseExpiry))
+			{
+				return false;
+			}
+			return heartbeatIntervalSeconds <= 0 || now - heartbeat <= MissedHeartbeatsUntilStale * heartbeatIntervalSeconds;
+		}
+	};
+
+	// Copies the key into a fixed-size, zero padded field. Returns false and leaves the field empty when the
+	// value does not fit, the caller skips such records instead of publishing a truncated key.
+	inline bool CopyKey(char* destination, std::size_t capacity, const std::string& value)
+	{
+		std::memset(destination, 0, capacity);
+		if (value.size() >= capacity)
+		{
+			return false;
+		}
+		std::memcpy(destination, value.data(), value.size());
+		return true;
+	}
+
+	// FNV-1a, shared by the writer building the index and the readers probing it
+	inline std::uint32_t HashKey(const char* key, std::size_t length)
+	{
+		std::uint32_t hash = 2166136261u;
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			hash ^= static_cast<std::uint8_t>(key[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	class Mapping
+	{
+	public:
+		// Read only mappings never create the file and cannot publish
+		Mapping(const std::filesystem::path& path, MappedFile::Access access, int mode = 0600)
+			: file_(path, sizeof(Region), access, mode)
+		{
+		}
+
+		Region& region() const
+		{
+			return *static_cast<Region*>(file_.data());
+		}
+
+		bool isPublished() const
+		{
+			const Region& shared = region();
+			return shared.magic == Magic && shared.layoutVersion == LayoutVersion
+				&& shared.sequence.load(std::memory_order_acquire) != 0;
+		}
+
+		std::uint64_t sequence() const
+		{
+			return region().sequence.load(std::memory_order_acquire);
+		}
+
+		// Marks the published state as still maintained, no writer lock needed
+		void heartbeat(std::int64_t now)
+		{
+			region().heartbeat.store(now, std::memory_order_release);
+		}
+
+		// Caller must hold the writer lock. Only the first featureCount/attributeCount records of the payload
+		// are copied, the feature index is built here.
+		void publish(const Payload& payload)
+		{
+			Region& shared = region();
+			if (shared.magic != Magic || shared.layoutVersion != LayoutVersion)
+			{
+				shared.sequence.store(0, std::memory_order_relaxed);
+				shared.layoutVersion = LayoutVersion;
+				shared.magic = Magic;
+			}
+
+			std::size_t featureCount = std::min<std::size_t>(payload.featureCount, MaxFeatures);
+			std::size_t attributeCount = std::min<std::size_t>(payload.attributeCount, MaxAttributes);
+
+			std::uint64_t sequence = shared.sequence.load(std::memory_order_relaxed);
+			shared.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			std::memcpy(&shared.payload, &payload, PayloadHeaderSize);
+			shared.payload.featureCount = static_cast<std::uint32_t>(featureCount);
+			shared.payload.attributeCount = static_cast<std::uint32_t>(attributeCount);
+			std::memcpy(shared.payload.features, payload.features, featureCount * sizeof(FeatureRecord));
+			std::memcpy(shared.payload.attributes, payload.attributes, attributeCount * sizeof(AttributeRecord));
+
+			std::memset(shared.payload.featureIndex, 0, sizeof(shared.payload.featureIndex));
+			for (std::size_t i = 0; i < featureCount; ++i)
+			{
+				const char* key = payload.features[i].key;
+				std::size_t slot = HashKey(key, ::strnlen(key, MaxKeyLength)) & (IndexSlots - 1);
+				while (shared.payload.featureIndex[slot] != 0)
+				{
+					slot = (slot + 1) & (IndexSlots - 1);
+				}
+				shared.payload.featureIndex[slot] = static_cast<std::uint16_t>(i + 1);
+			}
+
+			shared.sequence.store(sequence + 2, std::memory_order_release);
+			shared.heartbeat.store(payload.publishedAt, std::memory_order_release);
+		}
+
+		// Consistent copy of the published state, std::nullopt when nothing was published yet
+		std::optional<View> read() const
+		{
+			const Region& shared = region();
+			if (shared.magic != Magic || shared.layoutVersion != LayoutVersion)
+			{
+				return std::nullopt;
+			}
+
+			View view;
+			while (true)
+			{
+				std::uint64_t before = shared.sequence.load(std::memory_order_acquire);
+				if (before == 0)
+				{
+					return std::nullopt;
+				}
+				if (before & 1)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::int64_t publishedAt = shared.payload.publishedAt;
+				std::int64_t publisherProcessId = shared.payload.publisherProcessId;
+				std::int32_t state = shared.payload.state;
+				std::int32_t mode = shared.payload.mode;
+				std::int32_t active = shared.payload.active;
+				std::int32_t hasLeaseExpiry = shared.payload.hasLeaseExpiry;
+				std::int64_t leaseExpiry = shared.payload.leaseExpiry;
+				char seatId[MaxSeatIdLength];
+				std::memcpy(seatId, shared.payload.seatId, sizeof(seatId));
+				std::size_t featureCount = std::min<std::size_t>(shared.payload.featureCount, MaxFeatures);
+				view.features.resize(featureCount);
+				std::memcpy(view.features.data(), shared.payload.features, featureCount * sizeof(FeatureRecord));
+				std::size_t attributeCount = std::min<std::size_t>(shared.payload.attributeCount, MaxAttributes);
+				view.attributes.resize(attributeCount);
+				std::memcpy(view.attributes.data(), shared.payload.attributes, attributeCount * sizeof(AttributeRecord));
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (shared.sequence.load(std::memory_order_relaxed) != before)
+				{
+					continue;
+				}
+
+				seatId[MaxSeatIdLength - 1] = '\0';
+				view.sequence = before;
+				view.publishedAt = publishedAt;
+				view.publisherProcessId = publisherProcessId;
+				view.state = state;
+				view.mode = mode;
+				view.active = active != 0;
+				view.leaseExpiry = hasLeaseExpiry ? std::optional<std::int64_t>(leaseExpiry) : std::nullopt;
+				view.seatId = seatId;
+				return view;
+			}
+		}
+
+		// Looks up a single feature through the published index, without copying the rest of the state.
+		// Returns false when nothing was published or the key is unknown.
+		bool findFeature(const char* key, std::size_t length, FeatureRecord& record, Validity* validity = nullptr) const
+		{
+			const Region& shared = region();
+			if (length >= MaxKeyLength || shared.magic != Magic || shared.layoutVersion != LayoutVersion)
+			{
+				return false;
+			}
+
+			const std::uint32_t hash = HashKey(key, length);
+			while (true)
+			{
+				std::uint64_t before = shared.sequence.load(std::memory_order_acquire);
+				if (before == 0)
+				{
+					return false;
+				}
+				if (before & 1)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				bool found = false;
+				std::size_t featureCount = std::min<std::size_t>(shared.payload.featureCount, MaxFeatures);
+				std::size_t slot = hash & (IndexSlots - 1);
+				for (std::size_t probe = 0; probe < IndexSlots; ++probe)
+				{
+					std::size_t position = shared.payload.featureIndex[slot];
+					if (position == 0 || position > featureCount)
+					{
+						break;
+					}
+
+					const FeatureRecord& candidate = shared.payload.features[position - 1];
+					if (std::memcmp(candidate.key, key, length) == 0 && candidate.key[length] == '\0')
+					{
+						std::memcpy(&record, &candidate, sizeof(FeatureRecord));
+						found = true;
+						break;
+					}
+					slot = (slot + 1) & (IndexSlots - 1);
+				}
+				std::int32_t publishedActive = shared.payload.active;
+				std::int32_t hasLeaseExpiry = shared.payload.hasLeaseExpiry;
+				std::int64_t leaseExpiry = shared.payload.leaseExpiry;
+				std::int64_t heartbeatIntervalSeconds = shared.payload.heartbeatIntervalSeconds;
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (shared.sequence.load(std::memory_order_relaxed) != before)
+				{
+					continue;
+				}
+
+				if (validity)
+				{
+					validity->active = publishedActive != 0;
+					validity->leaseExpiry = hasLeaseExpiry ? std::optional<std::int64_t>(leaseExpiry) : std::nullopt;
+					validity->heartbeat = shared.heartbeat.load(std::memory_order_acquire);
+					validity->heartbeatIntervalSeconds = heartbeatIntervalSeconds;
+				}
+				return found;
+			}
+		}
+
+	private:
+		MappedFile file_;
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "SharedStateSnapshot.hpp"
+
+// Read only access to the activation state published by the console (Storage.Scope = Machine or --agent in
+// machine scope), for applications that only need to know whether a feature is enabled and how much of it is
+// available. After the constructor maps the file, lookups are plain memory reads and a clock read: no locks and
+// no SDK. Throws std::runtime_error when the snapshot file does not exist yet.
+class SharedStateSnapshotReader
+{
+public:
+	explicit SharedStateSnapshotReader(const std::filesystem::path& snapshotPath)
+		: mapping_(snapshotPath, MappedFile::Access::ReadOnly)
+	{
+	}
+
+	bool isPublished() const
+	{
+		return mapping_.isPublished();
+	}
+
+	// Feature record when the feature exists in the published state, regardless of the activation state
+	std::optional<SharedStateSnapshot::FeatureRecord> findFeature(const std::string& key) const
+	{
+		SharedStateSnapshot::FeatureRecord record;
+		if (!mapping_.findFeature(key.data(), key.size(), record))
+		{
+			return std::nullopt;
+		}
+		return record;
+	}
+
+	// True when the activation is active and grants the feature, its lease has not expired and a console process
+	// still maintains the published state
+	bool isFeatureEnabled(const std::string& key) const
+	{
+		SharedStateSnapshot::FeatureRecord record;
+		SharedStateSnapshot::Validity validity;
+		return mapping_.findFeature(key.data(), key.size(), record, &validity)
+			&& validity.grantsAt(static_cast<std::int64_t>(std::time(nullptr)));
+	}
+
+	// Available amount of an element pool or usage count feature, std::nullopt when not reported
+	std::optional<std::int64_t> available(const std::string& key) const
+	{
+		auto record = findFeature(key);
+		if (!record || !(record->flags & SharedStateSnapshot::HasAvailable))
+		{
+			return std::nullopt;
+		}
+		return record->available;
+	}
+
+	// Full copy of the published state, including the attributes
+	std::optional<SharedStateSnapshot::View> snapshot() const
+	{
+		return mapping_.read();
+	}
+
+private:
+	SharedStateSnapshot::Mapping mapping_;
+};
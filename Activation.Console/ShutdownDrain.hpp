@@ -0,0 +1,220 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Activation.hpp"
+#include "ActivationConfig.hpp"
+#include "ActiveFeatureSet.hpp"
+#include "LicenseStorage.hpp"
+#include "LicensingCall.hpp"
+#include "Logger.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Element-pool features this process checked out and did not return yet, keyed by feature key
+class CheckoutLedger
+{
+public:
+	void checkedOut(const std::string& key, int amount)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		outstanding_[key] += amount;
+	}
+
+	void returned(const std::string& key, int amount)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto entry = outstanding_.find(key);
+		if (entry == outstanding_.end())
+		{
+			return;
+		}
+		entry->second -= amount;
+		if (entry->second <= 0)
+		{
+			outstanding_.erase(entry);
+		}
+	}
+
+	std::map<std::string, int> outstanding() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return outstanding_;
+	}
+
+private:
+	mutable std::mutex mutex_;
+	std::map<std::string, int> outstanding_;
+};
+
+// Shared by the console actions and the agent, both record every checkout and return that succeeded
+inline CheckoutLedger& Checkouts()
+{
+	static CheckoutLedger ledger;
+	return ledger;
+}
+
+// Last stage before the process goes away, on quit or on a termination signal (register run() with
+// ShutdownHooks after the storage, hooks run in reverse order so the storage flushes what the drain changed):
+//   1. returns every outstanding checkout, all returns in flight at the same time
+//   2. waits for licensing operations abandoned earlier (usage tracking, returns) to reach the server
+//   3. deactivates the seat when Shutdown.DeactivateOnExit is set, and flushes the storage after it
+// Everything shares one drain deadline, whatever is still running after it is left to the abandoned operations.
+// The drain holds the activation mutex while it calls the SDK. Actions release it while they prompt, so only an
+// action that is busy with the activation delays the drain, and when it is still busy at the deadline the drain is skipped.
+class ShutdownDrain
+{
+public:
+	ShutdownDrain(std::shared_ptr<Activation> activation, std::timed_mutex& activationMutex, const ActivationConsole::ShutdownConfig& config)
+		: activation_(std::move(activation)), activationMutex_(activationMutex), config_(config)
+	{
+	}
+
+	// Idempotent, the quit path and the signal thread may both get here
+	void run()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (drained_)
+		{
+			return;
+		}
+		drained_ = true;
+
+		auto start = LicensingCall::Clock::now();
+		auto deadline = start + std::chrono::milliseconds(config_.DrainTimeoutMs);
+		std::unique_lock<std::timed_mutex> activationLock(activationMutex_, std::defer_lock);
+		if (!activationLock.try_lock_until(deadline))
+		{
+			Log::Warning(Log::Categories::Shutdown, "An action was still using the activation at the shutdown drain deadline, the drain is skipped",
+				{ { "outstanding", std::to_string(Checkouts().outstanding().size()) } });
+			return;
+		}
+
+		bool online = activation_->getState() == ActivationState::Active
+			&& activation_->getActivationInfo().activationMode == ActivationMode::Online;
+
+		auto [returned, outstanding] = online ? returnCheckouts(deadline) : std::make_pair(0, 0);
+
+		bool flushed = LicensingCall::Abandoned().waitUntil(deadline);
+		if (!flushed)
+		{
+			Log::Warning(Log::Categories::Shutdown, "Licensing operations did not complete before the shutdown drain deadline", { { "pending", std::to_string(LicensingCall::Abandoned().pending()) } });
+		}
+
+		if (config_.DeactivateOnExit && online)
+		{
+			// An operation abandoned earlier may still change the activation, deactivating under it could be undone
+			if (flushed || LicensingCall::Abandoned().waitForActivation(LicensingCall::CurrentActivation(), deadline))
+			{
+				deactivate(deadline);
+			}
+			else
+			{
+				Log::Warning(Log::Categories::Shutdown, "Deactivation skipped, an earlier operation on the activation is still running");
+			}
+		}
+
+		if (outstanding > 0)
+		{
+			Log::Information(Log::Categories::Shutdown, "Shutdown drain returned the checked out features", { { "returned", std::to_string(returned) }, { "outstanding", std::to_string(outstanding) },
+				{ "ms", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(LicensingCall::Clock::now() - start).count()) } });
+		}
+	}
+
+private:
+	std::pair<int, int> returnCheckouts(LicensingCall::Clock::time_point deadline)
+	{
+		auto outstanding = Checkouts().outstanding();
+		auto features = std::dynamic_pointer_cast<ActiveFeatureSet>(activation_->features());
+		if (outstanding.empty() || !features)
+		{
+			return { 0, static_cast<int>(outstanding.size()) };
+		}
+
+		// Send all returns first, waiting on them one by one would add up their round trips
+		std::vector<std::pair<std::pair<std::string, int>, std::future<void>>> returns;
+		for (const auto& checkout : outstanding)
+		{
+			if (!LicensingCall::AdmitBefore(LicensingCall::Operations::ReturnFeature, deadline))
+			{
+				Log::Warning(Log::Categories::Shutdown, "Feature return was held back by the rate limiter past the shutdown drain deadline", { { "feature", checkout.first } });
+				continue;
+			}
+			try
+			{
+				returns.emplace_back(checkout, features->returnFeature(checkout.first, checkout.second));
+			}
+			catch (const std::exception& e)
+			{
+				Log::Error(Log::Categories::Shutdown, "Failed to return feature", { { "feature", checkout.first }, { "error", e.what() } });
+			}
+		}
+
+		int returned = 0;
+		for (auto& [checkout, future] : returns)
+		{
+			if (future.wait_until(deadline) == std::future_status::timeout)
+			{
+				Log::Warning(Log::Categories::Shutdown, "Feature return did not complete before the shutdown drain deadline", { { "feature", checkout.first } });
+				LicensingCall::Abandoned().add(LicensingCall::Operations::ReturnFeature, std::move(future));
+				continue;
+			}
+
+			try
+			{
+				future.get();
+				Checkouts().returned(checkout.first, checkout.second);
+				++returned;
+			}
+			catch (const std::exception& e)
+			{
+				Log::Error(Log::Categories::Shutdown, "Failed to return feature", { { "feature", checkout.first }, { "error", e.what() } });
+			}
+		}
+		return { returned, static_cast<int>(outstanding.size()) };
+	}
+
+	void deactivate(LicensingCall::Clock::time_point deadline)
+	{
+		if (!LicensingCall::AdmitBefore(LicensingCall::Operations::Deactivate, deadline))
+		{
+			Log::Warning(Log::Categories::Shutdown, "Deactivation was held back by the rate limiter past the shutdown drain deadline");
+			return;
+		}
+		try
+		{
+			auto future = activation_->deactivate();
+			if (future.wait_until(deadline) == std::future_status::timeout)
+			{
+				Log::Warning(Log::Categories::Shutdown, "Deactivation did not complete before the shutdown drain deadline");
+				LicensingCall::Abandoned().add(LicensingCall::Operations::Deactivate, std::move(future));
+				return;
+			}
+			ActivationOperationRes result = future.get();
+			if (!result.IsSuccess())
+			{
+				Log::Error(Log::Categories::Shutdown, "Deactivation on exit was not successful");
+				return;
+			}
+			LicenseStorage::Flush();
+			Log::Information(Log::Categories::Shutdown, "Shutdown drain deactivated the seat");
+		}
+		catch (const std::exception& e)
+		{
+			Log::Error(Log::Categories::Shutdown, "Failed to deactivate on exit", { { "error", e.what() } });
+		}
+	}
+
+	std::shared_ptr<Activation> activation_;
+	std::timed_mutex& activationMutex_;
+	ActivationConsole::ShutdownConfig config_;
+	std::mutex mutex_;
+	bool drained_{ false };
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#endif
+
+// Process-wide list of callbacks that must run before the console goes away. main calls RunAll
+// on each of its quit paths, the signal watcher thread calls it on a termination signal.
+namespace ShutdownHooks
+{
+	using Hook = std::function<void()>;
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::pair<std::size_t, Hook>> hooks;
+		std::size_t nextId{ 1 };
+		std::atomic<bool> signalHandlersInstalled{ false };
+	};
+
+	inline Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	inline std::size_t Register(Hook hook)
+	{
+		auto& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		auto id = registry.nextId++;
+		registry.hooks.emplace_back(id, std::move(hook));
+		return id;
+	}
+
+	inline void Unregister(std::size_t id)
+	{
+		auto& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.hooks.erase(
+			std::remove_if(registry.hooks.begin(), registry.hooks.end(),
+				[id](const std::pair<std::size_t, Hook>& entry) { return entry.first == id; }),
+			registry.hooks.end());
+	}
+
+	// Runs the registered hooks, most recently registered first. Hooks stay registered and must be idempotent.
+	inline void RunAll()
+	{
+		std::vector<std::pair<std::size_t, Hook>> hooks;
+		{
+			auto& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			hooks = registry.hooks;
+		}
+
+		for (auto it = hooks.rbegin(); it != hooks.rend(); ++it)
+		{
+			try
+			{
+				it->second();
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Shutdown hook failed: " << e.what() << '\n';
+			}
+		}
+	}
+
+#ifdef _WIN32
+	inline BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType)
+	{
+		switch (ctrlType)
+		{
+		case CTRL_C_EVENT:
+		case CTRL_BREAK_EVENT:
+		case CTRL_CLOSE_EVENT:
+		case CTRL_SHUTDOWN_EVENT:
+			// Console control handlers already run on a dedicated thread
+			RunAll();
+			return FALSE;
+		default:
+			return FALSE;
+		}
+	}
+
+	inline void InstallSignalHandlers()
+	{
+		if (GetRegistry().signalHandlersInstalled.exchange(true))
+		{
+			return;
+		}
+		SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+	}
+#else
+	inline int& SignalPipeWriteEnd()
+	{
+		static int fd = -1;
+		return fd;
+	}
+
+	inline void ForwardSignalToPipe(int signalNumber)
+	{
+		// Only async-signal-safe work here, the hooks run on the watcher thread
+		unsigned char value = static_cast<unsigned char>(signalNumber);
+		ssize_t ignored = ::write(SignalPipeWriteEnd(), &value, 1);
+		(void)ignored;
+	}
+
+	inline void InstallSignalHandlers()
+	{
+		if (GetRegistry().signalHandlersInstalled.exchange(true))
+		{
+			return;
+		}
+
+		int fds[2];
+		if (::pipe(fds) != 0)
+		{
+			std::cerr << "Failed to install shutdown signal handlers." << '\n';
+			return;
+		}
+		SignalPipeWriteEnd() = fds[1];
+
+		std::thread([readEnd = fds[0]]()
+			{
+				unsigned char value = 0;
+				ssize_t received;
+				while ((received = ::read(readEnd, &value, 1)) != 1)
+				{
+					// Interrupted reads are retried, any other error or a closed pipe means no signal will arrive
+					if (received == 0 || errno != EINTR)
+					{
+						::close(readEnd);
+						return;
+					}
+				}
+
+				RunAll();
+
+				// Let the default disposition terminate the process with the original signal
+				int signalNumber = static_cast<int>(value);
+				std::signal(signalNumber, SIG_DFL);
+				std::raise(signalNumber);
+			}).detach();
+
+		struct sigaction action {};
+		action.sa_handler = ForwardSignalToPipe;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+
+		for (int signalNumber : { SIGINT, SIGTERM, SIGHUP })
+		{
+			sigaction(signalNumber, &action, nullptr);
+		}
+	}
+#endif
+}
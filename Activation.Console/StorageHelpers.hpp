@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace StorageHelpers
+{
+	// Identity of a storage file on disk, used to detect modifications made outside this process
+	struct FileSignature
+	{
+		bool exists{ false };
+		std::uint64_t device{ 0 };
+		std::uint64_t inode{ 0 };
+		std::uint64_t size{ 0 };
+		std::int64_t modifiedNs{ 0 };
+
+		bool operator==(const FileSignature& other) const
+		{
+			return exists == other.exists
+				&& device == other.device
+				&& inode == other.inode
+				&& size == other.size
+				&& modifiedNs == other.modifiedNs;
+		}
+
+		bool operator!=(const FileSignature& other) const
+		{
+			return !(*this == other);
+		}
+
+		static FileSignature Of(const std::filesystem::path& path)
+		{
+			FileSignature signature;
+#ifndef _WIN32
+			struct stat info {};
+			if (::stat(path.c_str(), &info) != 0)
+			{
+				return signature;
+			}
+
+			signature.exists = true;
+			signature.device = static_cast<std::uint64_t>(info.st_dev);
+			signature.inode = static_cast<std::uint64_t>(info.st_ino);
+			signature.size = static_cast<std::uint64_t>(info.st_size);
+#ifdef __APPLE__
+			signature.modifiedNs = static_cast<std::int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+			signature.modifiedNs = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#else
+			std::error_code ec;
+			auto size = std::filesystem::file_size(path, ec);
+			if (ec)
+			{
+				return signature;
+			}
+			auto modified = std::filesystem::last_write_time(path, ec);
+			if (ec)
+			{
+				return signature;
+			}
+
+			signature.exists = true;
+			signature.size = static_cast<std::uint64_t>(size);
+			signature.modifiedNs = static_cast<std::int64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count());
+#endif
+			return signature;
+		}
+	};
+
+	template <typename T>
+	std::future<T> MakeReadyFuture(T value)
+	{
+		std::promise<T> promise;
+		promise.set_value(std::move(value));
+		return promise.get_future();
+	}
+
+	inline std::future<void> MakeReadyFuture()
+	{
+		std::promise<void> promise;
+		promise.set_value();
+		return promise.get_future();
+	}
+
+	// Forces the file content to stable storage
+	inline bool SyncFile(const std::filesystem::path& path)
+	{
+#ifdef _WIN32
+		HANDLE handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		bool flushed = FlushFileBuffers(handle) != 0;
+		CloseHandle(handle);
+		return flushed;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		bool synced = ::fsync(fd) == 0;
+		::close(fd);
+		return synced;
+#endif
+	}
+
+	// Replaces 'target' with the fully written 'staged' file, readers see either the old or the new file, never a mix
+	inline void ReplaceFileAtomically(const std::filesystem::path& staged, const std::filesystem::path& target)
+	{
+		SyncFile(staged);
+		std::filesystem::rename(staged, target);
+#ifndef _WIN32
+		// Persist the directory entry as well, otherwise the rename itself may be lost on power failure
+		SyncFile(target.parent_path());
+#endif
+	}
+}
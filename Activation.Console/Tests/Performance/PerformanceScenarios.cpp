@@ -0,0 +1,559 @@
+// End-to-end performance scenarios: the real Activation and LicenseStorage stack against the local Licensing API
+// stand-in (Tools/MockLicensingApi). Each scenario measures its latency samples, compares p50 and p99 with the
+// baseline file and fails when one of them is slower than the tolerance band allows. A scenario without recorded
+// baseline values is skipped (exit code 77), or fails with --require-baseline. --record writes the measured p50 and
+// p99 into the baseline file and keeps everything else in it.
+//
+// With --network the stand-in sits behind the fault proxy (Tools/FaultProxy) and the measured operations see the
+// network of the scenario file, the setup in between does not. Operations wait with the Deadlines of appsettings.json
+// like the console does, failures are counted instead of ending the run, and the run fails when p99 exceeds the
+// deadlines of the measured operations: timeouts have to keep the tail bounded however bad the network gets.
+// The baseline values of a network run are stored as <scenario>@<network scenario name>.
+//
+// Usage: Zentitle.Activation.PerformanceScenarios <scenario> --routes <routes.json> --baseline <baseline.json>
+//            [--network <scenario.json>] [--iterations <count>] [--record | --require-baseline]
+// Run it from the build directory so that appsettings.json (CoreLibPath, Storage) is found.
+
+#include "ActivationConfig.hpp"
+#include "Activation.hpp"
+#include "ActivationCodeCredentialsModel.hpp"
+#include "ActiveFeatureSet.hpp"
+#include "CoreLibraryManagerConfigProvider.hpp"
+#include "FaultProxy.hpp"
+#include "LicenseStorage.hpp"
+#include "LicensingCall.hpp"
+#include "MockLicensingApiServer.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int ExitSkipped = 77; ///< SKIP_RETURN_CODE of the CTest registrations
+	constexpr const char* StorageDirectory = "Z2_OnlineActivation_Console_PerformanceTests";
+	constexpr const char* PoolFeatureKey = "perf.pool";
+	constexpr std::size_t LargeEntitlementFeatures = 5000;
+
+	using Samples = std::vector<double>; ///< Milliseconds
+
+	namespace Operations = LicensingCall::Operations;
+
+	class Context
+	{
+	public:
+		Context(const ActivationConsole::ActivationConfig& config, MockLicensingApi::Server& server, FaultProxy::Proxy* proxy, const std::string& scenario)
+			: config_(config), server_(server), proxy_(proxy), appDirectory_((std::filesystem::path(StorageDirectory) / scenario).string())
+		{
+			std::filesystem::path coreLibraryPath = config.CoreLibPath;
+			libraryDirectory_ = coreLibraryPath.parent_path().string();
+			if (!libraryDirectory_.empty())
+			{
+				libraryDirectory_ += std::filesystem::path::preferred_separator;
+			}
+			libraryName_ = coreLibraryPath.filename().string();
+			configProvider_ = std::make_unique<CoreLibraryManagerConfigProvider>(libraryDirectory_, libraryName_);
+
+			// Machine scope would share the seat with other processes, the scenarios keep to themselves
+			config_.Storage.Scope = ActivationConsole::StorageScope::User;
+		}
+
+		MockLicensingApi::Server& server()
+		{
+			return server_;
+		}
+
+		// A new Activation on the scenario's storage folder, as the console creates it at startup
+		std::shared_ptr<Activation> create(LicenseStorage::DeletionPrompt deletionPrompt)
+		{
+			ActivationOptions options;
+			OnlineActivationOptions onlineOptions;
+			onlineOptions.licensingApiUrl = proxy_ ? proxy_->url() : server_.url();
+			onlineOptions.productId = "perf-product";
+			onlineOptions.seatId = "perf-seat";
+			onlineOptions.tenantId = "perf-tenant";
+			OfflineActivationOptions offlineOptions;
+			offlineOptions.tenantRsaKeyModulus = server_.modulus();
+			options.onlineActivationOptionsOpt = onlineOptions;
+			options.offlineActivationOptionsOpt = offlineOptions;
+
+			options.setActivationStorage(LicenseStorage::Initialize(true, libraryDirectory_, libraryName_, deletionPrompt, config_.Storage, appDirectory_));
+			return Activation::create(options, *configProvider_);
+		}
+
+		// Initialized and activated on a cleared storage folder
+		std::shared_ptr<Activation> createActivated()
+		{
+			auto activation = create(LicenseStorage::DeletionPrompt::Skip);
+			LicensingCall::Await(Operations::Initialize, activation->initialize());
+			activate(*activation);
+			return activation;
+		}
+
+		static void activate(Activation& activation)
+		{
+			LicensingCall::Await(Operations::Activate,
+				activation.activate(std::make_shared<ActivationCodeCredentialsModel>("PERF-ACTIVATION-CODE"), "Performance scenarios", ""));
+		}
+
+		// Times one sample. Faults are only injected while it runs, and behind the proxy a failed operation is
+		// counted and returns false, its sample is the time until the failure.
+		template <typename Action>
+		bool measure(Samples& samples, Action&& action)
+		{
+			if (proxy_)
+			{
+				proxy_->setFaultsEnabled(true);
+			}
+			auto start = std::chrono::steady_clock::now();
+			bool completed = true;
+			try
+			{
+				action();
+			}
+			catch (const LicensingCall::DeadlineExceeded&)
+			{
+				completed = false;
+				++deadlinesExceeded_;
+			}
+			catch (const std::exception&)
+			{
+				if (!proxy_)
+				{
+					throw;
+				}
+				completed = false;
+				++failures_;
+			}
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			if (proxy_)
+			{
+				proxy_->setFaultsEnabled(false);
+			}
+			if (!completed && !proxy_)
+			{
+				throw std::runtime_error("An operation missed its deadline against the stand-in");
+			}
+			return completed;
+		}
+
+		// After a failed sample: lets the abandoned operations finish, then brings the activation back to the
+		// state the scenario expects on the clean network
+		void recover(Activation& activation, ActivationState expected)
+		{
+			LicensingCall::Abandoned().waitUntil(LicensingCall::Clock::now() + std::chrono::minutes(2));
+			LicensingCall::Abandoned().collectFinished();
+			if (activation.getState() == expected)
+			{
+				return;
+			}
+			if (expected == ActivationState::Active)
+			{
+				activate(activation);
+			}
+			else
+			{
+				LicensingCall::Await(Operations::Deactivate, activation.deactivate());
+			}
+		}
+
+		std::size_t failures() const
+		{
+			return failures_;
+		}
+
+		std::size_t deadlinesExceeded() const
+		{
+			return deadlinesExceeded_;
+		}
+
+		void cleanUp()
+		{
+			LicenseStorage::Flush();
+			std::error_code error;
+			std::filesystem::remove_all(std::filesystem::path(SecureStorage::getSystemFolder(PredefinedFolder::USER_DATA)) / appDirectory_, error);
+		}
+
+	private:
+		ActivationConsole::ActivationConfig config_;
+		MockLicensingApi::Server& server_;
+		FaultProxy::Proxy* proxy_;
+		std::string appDirectory_;
+		std::string libraryDirectory_;
+		std::string libraryName_;
+		std::unique_ptr<CoreLibraryManagerConfigProvider> configProvider_;
+		std::size_t failures_{ 0 };
+		std::size_t deadlinesExceeded_{ 0 };
+	};
+
+	// New process on an activated seat: create the Activation on the persisted state and initialize it
+	Samples ColdStart(Context& context, std::size_t iterations)
+	{
+		context.createActivated().reset();
+		LicenseStorage::Flush();
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			std::shared_ptr<Activation> activation;
+			context.measure(samples, [&]()
+				{
+					activation = context.create(LicenseStorage::DeletionPrompt::Keep);
+					LicensingCall::Await(Operations::Initialize, activation->initialize());
+				});
+			LicensingCall::Abandoned().waitUntil(LicensingCall::Clock::now() + std::chrono::minutes(2));
+			activation.reset();
+			LicenseStorage::Flush();
+		}
+		return samples;
+	}
+
+	Samples Activate(Context& context, std::size_t iterations)
+	{
+		auto activation = context.create(LicenseStorage::DeletionPrompt::Skip);
+		LicensingCall::Await(Operations::Initialize, activation->initialize());
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			if (!context.measure(samples, [&]() { Context::activate(*activation); }))
+			{
+				context.recover(*activation, ActivationState::Active);
+			}
+			LicensingCall::Await(Operations::Deactivate, activation->deactivate());
+		}
+		return samples;
+	}
+
+	// One sample per checkout and return of a single element of the pool feature
+	Samples CheckoutReturn(Context& context, std::size_t iterations)
+	{
+		auto activation = context.createActivated();
+		auto features = std::dynamic_pointer_cast<ActiveFeatureSet>(activation->features());
+		if (!features)
+		{
+			throw std::runtime_error("The activation has no active feature set");
+		}
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			if (!context.measure(samples, [&]()
+				{
+					LicensingCall::Await(Operations::CheckoutFeature, features->checkoutFeature(PoolFeatureKey, 1));
+					LicensingCall::Await(Operations::ReturnFeature, features->returnFeature(PoolFeatureKey, 1));
+				}))
+			{
+				context.recover(*activation, ActivationState::Active);
+			}
+		}
+		LicensingCall::Await(Operations::Deactivate, activation->deactivate());
+		return samples;
+	}
+
+	Samples RefreshLease(Context& context, std::size_t iterations)
+	{
+		auto activation = context.createActivated();
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			if (!context.measure(samples, [&]() { LicensingCall::Await(Operations::RefreshLease, activation->refreshLease()); }))
+			{
+				context.recover(*activation, ActivationState::Active);
+			}
+		}
+		LicensingCall::Await(Operations::Deactivate, activation->deactivate());
+		return samples;
+	}
+
+	// Reading back the persisted state of an entitlement with thousands of features through a new storage stack,
+	// the read-through cache of the running one would answer from memory
+	Samples PersistedStateReload(Context& context, std::size_t iterations)
+	{
+		context.server().setGeneratedFeatures(LargeEntitlementFeatures);
+		auto activation = context.createActivated();
+		LicenseStorage::Flush();
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			context.measure(samples, [&]()
+				{
+					auto persisted = LicensingCall::Await(Operations::PullPersistedState,
+						context.create(LicenseStorage::DeletionPrompt::Keep)->pullPersistedState());
+					if (persisted.isEmpty())
+					{
+						throw std::runtime_error("The persisted state is empty");
+					}
+				});
+		}
+		LicensingCall::Await(Operations::Deactivate, activation->deactivate());
+		context.server().setGeneratedFeatures(0);
+		return samples;
+	}
+
+	Samples Deactivate(Context& context, std::size_t iterations)
+	{
+		auto activation = context.create(LicenseStorage::DeletionPrompt::Skip);
+		LicensingCall::Await(Operations::Initialize, activation->initialize());
+
+		Samples samples;
+		for (std::size_t i = 0; i < iterations; ++i)
+		{
+			Context::activate(*activation);
+			if (!context.measure(samples, [&]() { LicensingCall::Await(Operations::Deactivate, activation->deactivate()); }))
+			{
+				context.recover(*activation, ActivationState::NotActivated);
+			}
+		}
+		return samples;
+	}
+
+	struct Scenario
+	{
+		std::function<Samples(Context&, std::size_t)> run;
+		std::size_t iterations;
+		std::vector<const char*> operations; ///< Awaited in every sample, their deadlines bound its duration
+	};
+
+	const std::map<std::string, Scenario>& Scenarios()
+	{
+		static const std::map<std::string, Scenario> scenarios = {
+			{ "cold-start", { ColdStart, 20, { Operations::Initialize } } },
+			{ "activate", { Activate, 20, { Operations::Activate } } },
+			{ "checkout-return", { CheckoutReturn, 1000, { Operations::CheckoutFeature, Operations::ReturnFeature } } },
+			{ "refresh-lease", { RefreshLease, 200, { Operations::RefreshLease } } },
+			{ "persisted-state-reload", { PersistedStateReload, 50, { Operations::PullPersistedState } } },
+			{ "deactivate", { Deactivate, 20, { Operations::Deactivate } } },
+		};
+		return scenarios;
+	}
+
+	double Percentile(Samples samples, double quantile)
+	{
+		std::sort(samples.begin(), samples.end());
+		auto rank = static_cast<std::size_t>(std::ceil(quantile * samples.size()));
+		return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+	}
+
+	// Slowest value still within the tolerance band around the baseline value
+	double Limit(double baseline, double percent, double minimumMs)
+	{
+		return std::max(baseline * (1.0 + percent / 100.0), baseline + minimumMs);
+	}
+
+	bool Compare(const char* name, double measured, double baseline, double percent, double minimumMs)
+	{
+		auto limit = Limit(baseline, percent, minimumMs);
+		bool passed = measured <= limit;
+		std::cout << "  " << name << ": " << std::fixed << std::setprecision(3) << measured << " ms, baseline " << baseline
+			<< " ms, limit " << limit << " ms" << (passed ? "" : "  REGRESSION") << '\n';
+		return passed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: Zentitle.Activation.PerformanceScenarios <scenario> --routes <routes.json> --baseline <baseline.json> [--network <scenario.json>] [--iterations <count>] [--record | --require-baseline]" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	std::string scenarioName = argv[1];
+	std::string routesPath;
+	std::string baselinePath;
+	std::string networkPath;
+	std::optional<std::size_t> iterations;
+	bool record = false;
+	bool requireBaseline = false;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--routes" && i + 1 < argc)
+		{
+			routesPath = argv[++i];
+		}
+		else if (argument == "--baseline" && i + 1 < argc)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (argument == "--network" && i + 1 < argc)
+		{
+			networkPath = argv[++i];
+		}
+		else if (argument == "--iterations" && i + 1 < argc)
+		{
+			char* end = nullptr;
+			const char* count = argv[++i];
+			auto parsed = std::strtoul(count, &end, 10);
+			if (end == count || *end != '\0' || parsed == 0)
+			{
+				std::cerr << "--iterations must be a positive number, got '" << count << "'" << '\n';
+				return EXIT_FAILURE;
+			}
+			iterations = parsed;
+		}
+		else if (argument == "--record")
+		{
+			record = true;
+		}
+		else if (argument == "--require-baseline")
+		{
+			requireBaseline = true;
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto scenario = Scenarios().find(scenarioName);
+	if (scenario == Scenarios().end() || routesPath.empty() || baselinePath.empty())
+	{
+		std::cerr << "Unknown scenario '" << scenarioName << "' or missing --routes/--baseline" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	nlohmann::json baseline = nlohmann::json::object();
+	if (std::ifstream baselineFile{ baselinePath })
+	{
+		baseline = nlohmann::json::parse(baselineFile);
+	}
+
+	auto configPath = (std::filesystem::current_path() / "appsettings.json").string();
+	auto config = ActivationConsole::LoadConfiguration(configPath);
+	LicensingCall::Configure(config.Deadlines);
+
+	// A connection the proxy resets must not end the process
+	std::signal(SIGPIPE, SIG_IGN);
+
+	Samples samples;
+	MockLicensingApi::Server::Counters counters;
+	std::optional<FaultProxy::Counters> networkCounters;
+	std::string baselineKey = scenarioName;
+	std::size_t failures = 0;
+	std::size_t deadlinesExceeded = 0;
+	try
+	{
+		MockLicensingApi::Server server(routesPath);
+		server.start();
+
+		std::unique_ptr<FaultProxy::Proxy> proxy;
+		if (!networkPath.empty())
+		{
+			proxy = std::make_unique<FaultProxy::Proxy>(FaultProxy::Scenario::Load(networkPath), server.url());
+			proxy->setFaultsEnabled(false);
+			proxy->start();
+			baselineKey += "@" + proxy->scenario().name;
+		}
+
+		Context context(config, server, proxy.get(), scenarioName);
+		context.cleanUp();
+		samples = scenario->second.run(context, iterations.value_or(scenario->second.iterations));
+		context.cleanUp();
+		failures = context.failures();
+		deadlinesExceeded = context.deadlinesExceeded();
+
+		if (proxy)
+		{
+			proxy->stop();
+			networkCounters = proxy->counters();
+		}
+		server.stop();
+		counters = server.counters();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << scenarioName << " failed: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	if (counters.unmatched > 0)
+	{
+		std::cerr << scenarioName << ": " << counters.unmatched << " request(s) had no route in " << routesPath
+			<< ", the routes file no longer matches the requests of the SDK" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	auto p50 = Percentile(samples, 0.50);
+	auto p99 = Percentile(samples, 0.99);
+	std::cout << baselineKey << ": " << samples.size() << " samples, " << counters.requests << " API requests" << '\n';
+
+	bool bounded = true;
+	if (networkCounters)
+	{
+		std::cout << "  " << failures << " failed, " << deadlinesExceeded << " past their deadline; injected "
+			<< networkCounters->httpErrors << " HTTP errors, " << networkCounters->resets << " resets, "
+			<< networkCounters->stalls << " stalls" << '\n';
+
+		// Every wait in a sample ends at its deadline at the latest, so do the samples, give or take the setup
+		// in the cold start and the scheduling of the waiting thread
+		double deadlinesMs = 0;
+		for (const auto* operation : scenario->second.operations)
+		{
+			auto timeout = LicensingCall::TimeoutFor(operation);
+			deadlinesMs = timeout.count() > 0 && deadlinesMs >= 0 ? deadlinesMs + static_cast<double>(timeout.count()) : -1;
+		}
+		if (deadlinesMs < 0)
+		{
+			std::cout << "  an operation of the scenario has no deadline, the tail latency is unbounded" << '\n';
+		}
+		else
+		{
+			auto limit = deadlinesMs + 250.0;
+			bounded = Percentile(samples, 0.99) <= limit;
+			std::cout << std::fixed << std::setprecision(3) << "  p99 bound by the deadlines: " << limit << " ms"
+				<< (bounded ? "" : "  UNBOUNDED") << '\n';
+		}
+	}
+
+	if (record)
+	{
+		// Only the measured values change, a tolerance of the scenario stays
+		auto& entry = baseline["scenarios"][baselineKey];
+		if (!entry.is_object())
+		{
+			entry = nlohmann::json::object();
+		}
+		entry["p50Ms"] = p50;
+		entry["p99Ms"] = p99;
+		std::ofstream(baselinePath) << baseline.dump(2) << '\n';
+		std::cout << std::fixed << std::setprecision(3) << "  recorded p50 " << p50 << " ms, p99 " << p99 << " ms in " << baselinePath << '\n';
+		return bounded ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	const auto& recorded = baseline.contains("scenarios") && baseline["scenarios"].contains(baselineKey)
+		? baseline["scenarios"][baselineKey] : nlohmann::json::object();
+	if (!recorded.is_object() || !recorded.contains("p50Ms") || !recorded["p50Ms"].is_number()
+		|| !recorded.contains("p99Ms") || !recorded["p99Ms"].is_number())
+	{
+		std::cout << std::fixed << std::setprecision(3) << "  p50 " << p50 << " ms, p99 " << p99
+			<< " ms, no baseline recorded, run with --record on the reference machine" << '\n';
+		return bounded && !requireBaseline ? ExitSkipped : EXIT_FAILURE;
+	}
+
+	// Scenario values override the file-wide tolerance
+	auto tolerance = baseline.value("tolerance", nlohmann::json::object());
+	tolerance.update(recorded.value("tolerance", nlohmann::json::object()));
+	auto minimumMs = tolerance.value("minimumMs", 1.0);
+
+	bool passed = Compare("p50", p50, recorded["p50Ms"].get<double>(), tolerance.value("p50Percent", 25.0), minimumMs) && bounded;
+	passed = Compare("p99", p99, recorded["p99Ms"].get<double>(), tolerance.value("p99Percent", 50.0), minimumMs) && passed;
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
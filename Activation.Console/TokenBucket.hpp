@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Thread-safe token bucket: tokens accrue at the rate up to the burst, every request takes one.
+// A rate of 0 or less disables the limit.
+class TokenBucket
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	TokenBucket(double ratePerSecond, double burst)
+		: rate_(ratePerSecond), burst_(std::max(1.0, burst)), tokens_(burst_), updated_(Clock::now())
+	{
+	}
+
+	TokenBucket(const TokenBucket&) = delete;
+	TokenBucket& operator=(const TokenBucket&) = delete;
+
+	bool unlimited() const
+	{
+		return rate_ <= 0;
+	}
+
+	// Takes a token if one is available
+	bool tryAcquire(Clock::time_point now = Clock::now())
+	{
+		if (unlimited())
+		{
+			return true;
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		refill(now);
+		if (tokens_ < 1.0)
+		{
+			return false;
+		}
+		tokens_ -= 1.0;
+		return true;
+	}
+
+	// Zero when a token is available now
+	Clock::duration timeUntilAvailable(Clock::time_point now = Clock::now())
+	{
+		if (unlimited())
+		{
+			return Clock::duration::zero();
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		refill(now);
+		if (tokens_ >= 1.0)
+		{
+			return Clock::duration::zero();
+		}
+		return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens_) / rate_));
+	}
+
+	// Blocks until a token is taken, returns how long that took
+	Clock::duration acquire()
+	{
+		auto start = Clock::now();
+		while (!tryAcquire())
+		{
+			std::this_thread::sleep_for(std::max<Clock::duration>(timeUntilAvailable(), std::chrono::microseconds(100)));
+		}
+		return Clock::now() - start;
+	}
+
+private:
+	void refill(Clock::time_point now)
+	{
+		if (now > updated_)
+		{
+			tokens_ = std::min(burst_, tokens_ + std::chrono::duration<double>(now - updated_).count() * rate_);
+			updated_ = now;
+		}
+	}
+
+	const double rate_;
+	const double burst_;
+	std::mutex mutex_;
+	double tokens_;
+	Clock::time_point updated_;
+};
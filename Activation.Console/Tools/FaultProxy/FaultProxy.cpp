@@ -0,0 +1,83 @@
+// Runs the fault injection proxy of a network scenario file on 127.0.0.1 until SIGINT/SIGTERM. Point
+// Licensing.ApiUrl in appsettings.json at the printed URL to see how the console copes with the network the
+// scenario describes, then compare the counters printed on exit with the console's own logs and traces.
+//
+// Usage: Zentitle.FaultProxy <scenario.json> [--listen <port>] [--upstream <url>] [--events <file.jsonl>]
+
+#include "FaultProxy.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: Zentitle.FaultProxy <scenario.json> [--listen <port>] [--upstream <url>] [--events <file.jsonl>]" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	std::uint16_t port = 0;
+	std::string upstream;
+	std::string events;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--listen" && i + 1 < argc)
+		{
+			port = static_cast<std::uint16_t>(std::atoi(argv[++i]));
+		}
+		else if (argument == "--upstream" && i + 1 < argc)
+		{
+			upstream = argv[++i];
+		}
+		else if (argument == "--events" && i + 1 < argc)
+		{
+			events = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Block the signals before the proxy threads start, so only sigwait below receives them.
+	// A TLS upstream that goes away must not take the process down with SIGPIPE.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	try
+	{
+		FaultProxy::Proxy proxy(FaultProxy::Scenario::Load(argv[1]), upstream);
+		if (!events.empty())
+		{
+			proxy.setEventLog(events);
+		}
+		proxy.start(port);
+
+		std::cout << "Fault proxy for scenario '" << proxy.scenario().name << "' listening on " << proxy.url() << '\n';
+		std::cout << "Set Licensing.ApiUrl to this URL, the TenantRsaKeyModulus stays the one of the upstream" << std::endl;
+
+		int received = 0;
+		sigwait(&signals, &received);
+
+		proxy.stop();
+		auto counters = proxy.counters();
+		std::cout << counters.connections << " connections, " << counters.requests << " requests, "
+			<< counters.httpErrors << " injected HTTP errors, " << counters.resets << " resets, "
+			<< counters.stalls << " stalls, " << counters.upstreamFailures << " upstream failures" << '\n';
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
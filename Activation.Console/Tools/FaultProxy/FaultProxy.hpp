@@ -0,0 +1,965 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "MockLicensingApiServer.hpp"
+#include "json.hpp"
+
+// Proxy between the console and the Licensing API that degrades the network as a scenario file describes:
+//
+//   {
+//     "name": "satellite",
+//     "upstream": "https://example.api.zentitle.io",
+//     "mode": "http",
+//     "seed": 7,
+//     "loop": false,
+//     "phases": [
+//       {
+//         "name": "link",
+//         "durationSeconds": 60,
+//         "latency": { "distribution": "lognormal", "medianMs": 600, "sigma": 0.4 },
+//         "bandwidthKbps": 512,
+//         "stall": { "probability": 0.05, "durationMs": 3000 },
+//         "reset": { "probability": 0.02 },
+//         "httpErrors": [ { "status": 429, "probability": 0.05, "retryAfterSeconds": 2, "pathPrefix": "/api" } ]
+//       }
+//     ]
+//   }
+//
+// Phases run one after the other from the moment faults are enabled, the last one stays in effect unless "loop" is set.
+// Latency distributions are "constant" (valueMs), "uniform" (minMs, maxMs), "normal" (meanMs, stddevMs) and
+// "lognormal" (medianMs, sigma). In "http" mode the proxy reads whole requests: latency delays each request, resets
+// and HTTP errors replace it, and bandwidth caps and stalls slow down the response. The upstream may be https, the
+// console then talks plain http to the proxy. "tcp" mode forwards bytes to a plain upstream port without parsing them,
+// each chunk is delayed, and resets and stalls hit whole connections.
+namespace FaultProxy
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Latency
+	{
+		enum class Distribution
+		{
+			Constant, Uniform, Normal, LogNormal
+		};
+
+		Distribution distribution{ Distribution::Constant };
+		double first{ 0 };  ///< valueMs, minMs, meanMs or medianMs
+		double second{ 0 }; ///< maxMs, stddevMs or sigma
+
+		static Latency Parse(const nlohmann::json& json)
+		{
+			Latency latency;
+			auto distribution = json.value("distribution", std::string("constant"));
+			if (distribution == "constant")
+			{
+				latency.first = json.value("valueMs", 0.0);
+			}
+			else if (distribution == "uniform")
+			{
+				latency.distribution = Distribution::Uniform;
+				latency.first = json.value("minMs", 0.0);
+				latency.second = json.value("maxMs", latency.first);
+			}
+			else if (distribution == "normal")
+			{
+				latency.distribution = Distribution::Normal;
+				latency.first = json.value("meanMs", 0.0);
+				latency.second = json.value("stddevMs", 0.0);
+			}
+			else if (distribution == "lognormal")
+			{
+				latency.distribution = Distribution::LogNormal;
+				latency.first = json.value("medianMs", 0.0);
+				latency.second = json.value("sigma", 0.0);
+			}
+			else
+			{
+				throw std::runtime_error("Unknown latency distribution '" + distribution + "'");
+			}
+			return latency;
+		}
+
+		std::chrono::microseconds sample(std::mt19937_64& random) const
+		{
+			double milliseconds = first;
+			switch (distribution)
+			{
+			case Distribution::Uniform:
+				milliseconds = std::uniform_real_distribution<double>(first, second)(random);
+				break;
+			case Distribution::Normal:
+				milliseconds = second > 0 ? std::normal_distribution<double>(first, second)(random) : first;
+				break;
+			case Distribution::LogNormal:
+				milliseconds = first > 0 && second > 0 ? std::lognormal_distribution<double>(std::log(first), second)(random) : first;
+				break;
+			default:
+				break;
+			}
+			return std::chrono::microseconds(static_cast<std::int64_t>(std::max(0.0, milliseconds) * 1000.0));
+		}
+	};
+
+	struct HttpError
+	{
+		int status{ 503 };
+		double probability{ 0 };
+		std::string pathPrefix;   ///< Empty matches every request
+		int retryAfterSeconds{ 0 }; ///< Retry-After header when > 0
+	};
+
+	struct Phase
+	{
+		std::string name;
+		std::chrono::milliseconds duration{ 0 }; ///< 0 lasts until the end
+		Latency latency;
+		std::uint64_t bytesPerSecond{ 0 };       ///< 0 is unlimited
+		double stallProbability{ 0 };
+		std::chrono::milliseconds stallDuration{ 0 };
+		double resetProbability{ 0 };
+		std::vector<HttpError> httpErrors;
+	};
+
+	struct Scenario
+	{
+		std::string name;
+		std::string upstream;
+		bool tcp{ false };
+		bool loop{ false };
+		std::uint64_t seed{ 1 };
+		std::vector<Phase> phases;
+
+		static Scenario Load(const std::string& path)
+		{
+			std::ifstream input(path);
+			if (!input)
+			{
+				throw std::runtime_error("Failed to open the network scenario " + path);
+			}
+			auto json = nlohmann::json::parse(input);
+
+			Scenario scenario;
+			scenario.name = json.value("name", std::string("network"));
+			scenario.upstream = json.value("upstream", std::string());
+			scenario.tcp = json.value("mode", std::string("http")) == "tcp";
+			scenario.loop = json.value("loop", false);
+			scenario.seed = json.value("seed", std::uint64_t{ 1 });
+			for (const auto& entry : json.at("phases"))
+			{
+				Phase phase;
+				phase.name = entry.value("name", std::string());
+				phase.duration = std::chrono::milliseconds(static_cast<std::int64_t>(entry.value("durationSeconds", 0.0) * 1000.0));
+				if (entry.contains("latency"))
+				{
+					phase.latency = Latency::Parse(entry["latency"]);
+				}
+				phase.bytesPerSecond = entry.value("bandwidthKbps", std::uint64_t{ 0 }) * 1000 / 8;
+				if (entry.contains("stall"))
+				{
+					phase.stallProbability = entry["stall"].value("probability", 0.0);
+					phase.stallDuration = std::chrono::milliseconds(entry["stall"].value("durationMs", 0));
+				}
+				if (entry.contains("reset"))
+				{
+					phase.resetProbability = entry["reset"].value("probability", 0.0);
+				}
+				for (const auto& error : entry.value("httpErrors", nlohmann::json::array()))
+				{
+					phase.httpErrors.push_back({ error.value("status", 503), error.value("probability", 0.0),
+						error.value("pathPrefix", std::string()), error.value("retryAfterSeconds", 0) });
+				}
+				scenario.phases.push_back(std::move(phase));
+			}
+			if (scenario.phases.empty())
+			{
+				throw std::runtime_error("The network scenario " + path + " has no phases");
+			}
+			return scenario;
+		}
+	};
+
+	struct Upstream
+	{
+		bool tls{ false };
+		std::string host;
+		std::string port;
+
+		static Upstream Parse(const std::string& url)
+		{
+			Upstream upstream;
+			auto rest = url;
+			if (rest.rfind("https://", 0) == 0)
+			{
+				upstream.tls = true;
+				rest = rest.substr(8);
+			}
+			else if (rest.rfind("http://", 0) == 0)
+			{
+				rest = rest.substr(7);
+			}
+			rest = rest.substr(0, rest.find('/'));
+			auto colon = rest.rfind(':');
+			upstream.host = colon == std::string::npos ? rest : rest.substr(0, colon);
+			upstream.port = colon == std::string::npos ? (upstream.tls ? "443" : "80") : rest.substr(colon + 1);
+			if (upstream.host.empty())
+			{
+				throw std::runtime_error("Invalid upstream URL '" + url + "'");
+			}
+			return upstream;
+		}
+
+		std::string hostHeader() const
+		{
+			return (port == "80" && !tls) || (port == "443" && tls) ? host : host + ":" + port;
+		}
+	};
+
+	struct Counters
+	{
+		std::uint64_t connections{ 0 };
+		std::uint64_t requests{ 0 };
+		std::uint64_t httpErrors{ 0 };
+		std::uint64_t resets{ 0 };
+		std::uint64_t stalls{ 0 };
+		std::uint64_t upstreamFailures{ 0 };
+	};
+
+	namespace Detail
+	{
+		inline int Connect(const Upstream& upstream)
+		{
+			addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			addrinfo* addresses = nullptr;
+			if (::getaddrinfo(upstream.host.c_str(), upstream.port.c_str(), &hints, &addresses) != 0)
+			{
+				return -1;
+			}
+
+			int socket = -1;
+			for (auto* address = addresses; address && socket < 0; address = address->ai_next)
+			{
+				socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+				if (socket >= 0 && ::connect(socket, address->ai_addr, address->ai_addrlen) != 0)
+				{
+					::close(socket);
+					socket = -1;
+				}
+			}
+			::freeaddrinfo(addresses);
+
+			if (socket >= 0)
+			{
+				int noDelay = 1;
+				::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+				MockLicensingApi::IgnoreSigpipe(socket);
+			}
+			return socket;
+		}
+
+		// Closes with RST instead of FIN, like a middlebox dropping the connection
+		inline void Reset(int socket)
+		{
+			linger abort{ 1, 0 };
+			::setsockopt(socket, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+			::close(socket);
+		}
+
+		// Plain or TLS connection to the upstream, reconnected on demand
+		class UpstreamConnection
+		{
+		public:
+			UpstreamConnection(const Upstream& upstream, SSL_CTX* context)
+				: upstream_(upstream), context_(context)
+			{
+			}
+
+			~UpstreamConnection()
+			{
+				close();
+			}
+
+			UpstreamConnection(const UpstreamConnection&) = delete;
+			UpstreamConnection& operator=(const UpstreamConnection&) = delete;
+
+			bool open()
+			{
+				if (socket_ >= 0)
+				{
+					return true;
+				}
+				socket_ = Connect(upstream_);
+				if (socket_ < 0 || !upstream_.tls)
+				{
+					return socket_ >= 0;
+				}
+
+				ssl_ = SSL_new(context_);
+				SSL_set_fd(ssl_, socket_);
+				SSL_set_tlsext_host_name(ssl_, upstream_.host.c_str());
+				SSL_set1_host(ssl_, upstream_.host.c_str());
+				if (SSL_connect(ssl_) != 1)
+				{
+					close();
+					return false;
+				}
+				return true;
+			}
+
+			void close()
+			{
+				if (ssl_)
+				{
+					SSL_free(ssl_);
+					ssl_ = nullptr;
+				}
+				if (socket_ >= 0)
+				{
+					::close(socket_);
+					socket_ = -1;
+				}
+			}
+
+			bool write(const std::string& data)
+			{
+				if (!ssl_)
+				{
+					return MockLicensingApi::SendAll(socket_, data);
+				}
+				return SSL_write(ssl_, data.data(), static_cast<int>(data.size())) == static_cast<int>(data.size());
+			}
+
+			long read(char* buffer, std::size_t size)
+			{
+				if (!ssl_)
+				{
+					return static_cast<long>(::recv(socket_, buffer, size, 0));
+				}
+				return SSL_read(ssl_, buffer, static_cast<int>(size));
+			}
+
+		private:
+			Upstream upstream_;
+			SSL_CTX* context_;
+			int socket_{ -1 };
+			SSL* ssl_{ nullptr };
+		};
+
+		// Reads a whole HTTP/1.1 response, sized by Content-Length, chunked encoding or the end of the connection
+		inline bool ReadResponse(UpstreamConnection& upstream, std::string& response, bool& closeAfter)
+		{
+			std::string pending;
+			auto fill = [&]()
+				{
+					char buffer[16 * 1024];
+					auto received = upstream.read(buffer, sizeof(buffer));
+					if (received <= 0)
+					{
+						return false;
+					}
+					pending.append(buffer, static_cast<std::size_t>(received));
+					return true;
+				};
+
+			std::size_t headerEnd;
+			while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos)
+			{
+				if (!fill())
+				{
+					return false;
+				}
+			}
+
+			auto headers = pending.substr(0, headerEnd);
+			std::string lower(headers.size(), '\0');
+			std::transform(headers.begin(), headers.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			closeAfter = lower.find("\r\nconnection: close") != std::string::npos;
+
+			auto bodyStart = headerEnd + 4;
+			auto status = std::atoi(headers.c_str() + headers.find(' ') + 1);
+			auto lengthHeader = lower.find("\r\ncontent-length:");
+			if (status == 204 || status == 304 || (status >= 100 && status < 200))
+			{
+				response = pending.substr(0, bodyStart);
+				return true;
+			}
+			if (lengthHeader != std::string::npos)
+			{
+				auto length = static_cast<std::size_t>(std::stoull(lower.substr(lengthHeader + 17)));
+				while (pending.size() < bodyStart + length)
+				{
+					if (!fill())
+					{
+						return false;
+					}
+				}
+				response = pending.substr(0, bodyStart + length);
+				return true;
+			}
+			if (lower.find("\r\ntransfer-encoding: chunked") != std::string::npos)
+			{
+				auto position = bodyStart;
+				for (;;)
+				{
+					std::size_t lineEnd;
+					while ((lineEnd = pending.find("\r\n", position)) == std::string::npos)
+					{
+						if (!fill())
+						{
+							return false;
+						}
+					}
+					auto size = std::stoull(pending.substr(position, lineEnd - position), nullptr, 16);
+					if (size == 0)
+					{
+						// Trailers end with an empty line
+						std::size_t end;
+						while ((end = pending.find("\r\n\r\n", lineEnd)) == std::string::npos)
+						{
+							if (!fill())
+							{
+								return false;
+							}
+						}
+						response = pending.substr(0, end + 4);
+						return true;
+					}
+					position = lineEnd + 2 + static_cast<std::size_t>(size) + 2;
+					while (pending.size() < position)
+					{
+						if (!fill())
+						{
+							return false;
+						}
+					}
+				}
+			}
+
+			while (fill())
+			{
+			}
+			closeAfter = true;
+			response = std::move(pending);
+			return true;
+		}
+
+		// Paces writes to the phase's bandwidth and stalls once per transfer when the dice say so
+		inline bool SendShaped(int socket, const std::string& data, const Phase& phase, bool stall, std::mt19937_64& random)
+		{
+			const std::size_t chunk = phase.bytesPerSecond > 0 ? std::max<std::size_t>(512, phase.bytesPerSecond / 50) : data.size();
+			const std::size_t stallAt = stall ? std::uniform_int_distribution<std::size_t>(0, data.size())(random) : data.size() + 1;
+			const auto start = Clock::now();
+			bool stalled = false;
+			for (std::size_t sent = 0; sent < data.size();)
+			{
+				if (!stalled && sent >= stallAt)
+				{
+					std::this_thread::sleep_for(phase.stallDuration);
+					stalled = true;
+				}
+				auto length = std::min(chunk, data.size() - sent);
+				if (!stalled && sent < stallAt && sent + length > stallAt)
+				{
+					length = stallAt - sent;
+				}
+				if (!MockLicensingApi::SendAll(socket, data.substr(sent, length)))
+				{
+					return false;
+				}
+				sent += length;
+				if (phase.bytesPerSecond > 0)
+				{
+					std::this_thread::sleep_until(start + std::chrono::microseconds(sent * 1000000 / phase.bytesPerSecond)
+						+ (stalled ? phase.stallDuration : std::chrono::milliseconds(0)));
+				}
+			}
+			if (!stalled && stall)
+			{
+				std::this_thread::sleep_for(phase.stallDuration);
+			}
+			return true;
+		}
+	}
+
+	class Proxy
+	{
+	public:
+		Proxy(Scenario scenario, const std::string& upstreamUrl)
+			: scenario_(std::move(scenario)), upstream_(Upstream::Parse(upstreamUrl.empty() ? scenario_.upstream : upstreamUrl))
+		{
+			if (upstream_.tls)
+			{
+				if (scenario_.tcp)
+				{
+					throw std::runtime_error("tcp mode forwards bytes unchanged, use a plain upstream or http mode for https");
+				}
+				tlsContext_ = SSL_CTX_new(TLS_client_method());
+				SSL_CTX_set_default_verify_paths(tlsContext_);
+				SSL_CTX_set_verify(tlsContext_, SSL_VERIFY_PEER, nullptr);
+			}
+		}
+
+		~Proxy()
+		{
+			stop();
+			if (tlsContext_)
+			{
+				SSL_CTX_free(tlsContext_);
+			}
+		}
+
+		Proxy(const Proxy&) = delete;
+		Proxy& operator=(const Proxy&) = delete;
+
+		// Listens on 127.0.0.1, port 0 picks a free port
+		void start(std::uint16_t port = 0)
+		{
+			listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+			int reuse = 1;
+			::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			address.sin_port = htons(port);
+			if (listener_ < 0 || ::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener_, 128) != 0)
+			{
+				throw std::runtime_error("Failed to listen on 127.0.0.1:" + std::to_string(port));
+			}
+			socklen_t length = sizeof(address);
+			::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+			port_ = ntohs(address.sin_port);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (faultsEnabled_)
+				{
+					phasesStart_ = Clock::now();
+					phasesStarted_ = true;
+				}
+			}
+			running_ = true;
+			acceptThread_ = std::thread([this]() { acceptLoop(); });
+		}
+
+		void stop()
+		{
+			if (!running_.exchange(false))
+			{
+				return;
+			}
+			::shutdown(listener_, SHUT_RDWR);
+			::close(listener_);
+			acceptThread_.join();
+
+			std::map<std::uint64_t, std::thread> connections;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (int socket : sockets_)
+				{
+					::shutdown(socket, SHUT_RDWR);
+				}
+				connections.swap(connections_);
+				finished_.clear();
+			}
+			for (auto& [index, connection] : connections)
+			{
+				connection.join();
+			}
+		}
+
+		std::string url() const
+		{
+			return "http://127.0.0.1:" + std::to_string(port_);
+		}
+
+		// Disabled, requests pass through unchanged. The phases start when faults are enabled for the first time,
+		// so set up a workload with faults disabled before start and enable them when the measurement begins.
+		void setFaultsEnabled(bool enabled)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			faultsEnabled_ = enabled;
+			if (enabled && !phasesStarted_)
+			{
+				phasesStart_ = Clock::now();
+				phasesStarted_ = true;
+			}
+		}
+
+		// One JSON line per request or connection with the faults injected into it
+		void setEventLog(const std::string& path)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			events_.open(path, std::ios::out | std::ios::trunc);
+			if (!events_)
+			{
+				throw std::runtime_error("Failed to open the event log " + path);
+			}
+		}
+
+		Counters counters() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return counters_;
+		}
+
+		const Scenario& scenario() const
+		{
+			return scenario_;
+		}
+
+	private:
+		// The phase in effect now, nullptr while faults are disabled
+		const Phase* currentPhase() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!faultsEnabled_)
+			{
+				return nullptr;
+			}
+
+			std::chrono::milliseconds total{ 0 };
+			for (const auto& phase : scenario_.phases)
+			{
+				total += phase.duration;
+			}
+
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - phasesStart_);
+			bool endless = std::any_of(scenario_.phases.begin(), scenario_.phases.end(), [](const Phase& phase) { return phase.duration.count() == 0; });
+			if (scenario_.loop && !endless && total.count() > 0)
+			{
+				elapsed = elapsed % total;
+			}
+			for (const auto& phase : scenario_.phases)
+			{
+				if (phase.duration.count() == 0 || elapsed < phase.duration)
+				{
+					return &phase;
+				}
+				elapsed -= phase.duration;
+			}
+			return &scenario_.phases.back();
+		}
+
+		void count(std::uint64_t Counters::* counter)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			++(counters_.*counter);
+		}
+
+		void logEvent(const std::string& phase, const std::string& request, const std::string& fault, std::chrono::microseconds latency, Clock::time_point start, int status)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!events_.is_open())
+			{
+				return;
+			}
+			nlohmann::json event = {
+				{ "timeMs", std::chrono::duration<double, std::milli>(start - phasesStart_).count() },
+				{ "phase", phase },
+				{ "request", request },
+				{ "fault", fault },
+				{ "latencyMs", latency.count() / 1000.0 },
+				{ "status", status },
+				{ "durationMs", std::chrono::duration<double, std::milli>(Clock::now() - start).count() },
+			};
+			events_ << event.dump() << '\n';
+			events_.flush();
+		}
+
+		void acceptLoop()
+		{
+			std::uint64_t connectionIndex = 0;
+			while (running_)
+			{
+				int socket = ::accept(listener_, nullptr, nullptr);
+				if (socket < 0)
+				{
+					continue;
+				}
+				int noDelay = 1;
+				::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+				MockLicensingApi::IgnoreSigpipe(socket);
+
+				std::vector<std::thread> finished;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (!running_)
+					{
+						::close(socket);
+						break;
+					}
+					finished = takeFinished();
+					++counters_.connections;
+					sockets_.insert(socket);
+					// Every connection draws from its own generator, a scenario replays the same faults per connection
+					auto index = connectionIndex++;
+					auto seed = scenario_.seed * 1000003 + index;
+					connections_.emplace(index, std::thread([this, socket, seed, index]()
+						{
+							std::mt19937_64 random(seed);
+							if (scenario_.tcp)
+							{
+								serveTcp(socket, random);
+							}
+							else
+							{
+								serveHttp(socket, random);
+							}
+							std::lock_guard<std::mutex> lock(mutex_);
+							sockets_.erase(socket);
+							finished_.push_back(index);
+						}));
+				}
+				for (auto& connection : finished)
+				{
+					connection.join();
+				}
+			}
+		}
+
+		// Called with mutex_ held. Threads of closed connections, joined by the accept loop so that a long scenario
+		// does not keep one finished thread per connection around.
+		std::vector<std::thread> takeFinished()
+		{
+			std::vector<std::thread> finished;
+			for (auto index : finished_)
+			{
+				auto connection = connections_.find(index);
+				if (connection != connections_.end())
+				{
+					finished.push_back(std::move(connection->second));
+					connections_.erase(connection);
+				}
+			}
+			finished_.clear();
+			return finished;
+		}
+
+		void serveHttp(int client, std::mt19937_64& random)
+		{
+			Detail::UpstreamConnection upstream(upstream_, tlsContext_);
+			std::uniform_real_distribution<double> dice(0.0, 1.0);
+			std::string pending;
+			while (auto request = MockLicensingApi::ReadRequest(client, pending))
+			{
+				auto start = Clock::now();
+				count(&Counters::requests);
+				auto name = request->method + " " + request->path;
+
+				const Phase* phase = currentPhase();
+				if (!phase)
+				{
+					static const Phase passThrough{};
+					phase = &passThrough;
+				}
+
+				if (dice(random) < phase->resetProbability)
+				{
+					count(&Counters::resets);
+					logEvent(phase->name, name, "reset", {}, start, 0);
+					Detail::Reset(client);
+					return;
+				}
+
+				auto latency = phase->latency.sample(random);
+				std::this_thread::sleep_for(latency);
+
+				const HttpError* injected = nullptr;
+				for (const auto& error : phase->httpErrors)
+				{
+					if (request->path.rfind(error.pathPrefix, 0) == 0 && dice(random) < error.probability)
+					{
+						injected = &error;
+						break;
+					}
+				}
+				bool stall = dice(random) < phase->stallProbability;
+				if (stall)
+				{
+					count(&Counters::stalls);
+				}
+
+				std::string response;
+				bool closeAfter = false;
+				int status = 0;
+				if (injected)
+				{
+					count(&Counters::httpErrors);
+					status = injected->status;
+					std::string body = "{\"error\":\"Injected by the fault proxy\"}";
+					response = "HTTP/1.1 " + std::to_string(status) + " " + MockLicensingApi::ReasonPhrase(status) + "\r\n"
+						+ "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n"
+						+ (injected->retryAfterSeconds > 0 ? "Retry-After: " + std::to_string(injected->retryAfterSeconds) + "\r\n" : "")
+						+ "\r\n" + body;
+				}
+				else if (!forward(upstream, *request, response, closeAfter))
+				{
+					count(&Counters::upstreamFailures);
+					status = 502;
+					std::string body = "{\"error\":\"The fault proxy could not reach the upstream\"}";
+					response = "HTTP/1.1 502 Bad Gateway\r\nContent-Type: application/json\r\nContent-Length: "
+						+ std::to_string(body.size()) + "\r\n\r\n" + body;
+				}
+				else
+				{
+					status = std::atoi(response.c_str() + response.find(' ') + 1);
+				}
+
+				bool sent = Detail::SendShaped(client, response, *phase, stall, random);
+				logEvent(phase->name, name, injected ? std::to_string(injected->status) : stall ? "stall" : "", latency, start, status);
+				if (!sent || closeAfter)
+				{
+					break;
+				}
+			}
+			::close(client);
+		}
+
+		bool forward(Detail::UpstreamConnection& upstream, const MockLicensingApi::Request& request, std::string& response, bool& closeAfter)
+		{
+			std::string message = request.method + " " + request.path + " HTTP/1.1\r\n";
+			message += "Host: " + upstream_.hostHeader() + "\r\n";
+			for (const auto& [name, value] : request.headers)
+			{
+				// The whole body is already here, and the proxy sets the upstream host
+				if (strcasecmp(name.c_str(), "Host") != 0 && strcasecmp(name.c_str(), "Expect") != 0)
+				{
+					message += name + ": " + value + "\r\n";
+				}
+			}
+			message += "\r\n";
+			message += request.body;
+
+			// A kept-alive upstream connection may have been closed in the meantime, retry once on a new one
+			for (int attempt = 0; attempt < 2; ++attempt)
+			{
+				if (!upstream.open())
+				{
+					return false;
+				}
+				if (upstream.write(message) && Detail::ReadResponse(upstream, response, closeAfter))
+				{
+					if (closeAfter)
+					{
+						upstream.close();
+					}
+					return true;
+				}
+				upstream.close();
+			}
+			return false;
+		}
+
+		void serveTcp(int client, std::mt19937_64& random)
+		{
+			auto start = Clock::now();
+			const Phase* phase = currentPhase();
+			static const Phase passThrough{};
+			if (!phase)
+			{
+				phase = &passThrough;
+			}
+
+			std::uniform_real_distribution<double> dice(0.0, 1.0);
+			if (dice(random) < phase->resetProbability)
+			{
+				count(&Counters::resets);
+				logEvent(phase->name, "connection", "reset", {}, start, 0);
+				Detail::Reset(client);
+				return;
+			}
+
+			int upstream = Detail::Connect(upstream_);
+			if (upstream < 0)
+			{
+				count(&Counters::upstreamFailures);
+				::close(client);
+				return;
+			}
+
+			bool stall = dice(random) < phase->stallProbability;
+			if (stall)
+			{
+				count(&Counters::stalls);
+			}
+			logEvent(phase->name, "connection", stall ? "stall" : "", {}, start, 0);
+
+			// Both directions are delayed chunk by chunk, only the responses are stalled
+			auto pump = [this, phase](int from, int to, std::uint64_t seed, bool stallOnce)
+				{
+					std::mt19937_64 pumpRandom(seed);
+					char buffer[16 * 1024];
+					for (;;)
+					{
+						auto received = ::recv(from, buffer, sizeof(buffer), 0);
+						if (received <= 0)
+						{
+							break;
+						}
+						std::this_thread::sleep_for(phase->latency.sample(pumpRandom));
+						if (!Detail::SendShaped(to, std::string(buffer, static_cast<std::size_t>(received)), *phase, stallOnce, pumpRandom))
+						{
+							break;
+						}
+						stallOnce = false;
+					}
+					::shutdown(to, SHUT_WR);
+				};
+
+			std::thread requests(pump, client, upstream, random(), false);
+			pump(upstream, client, random(), stall);
+			requests.join();
+			::close(upstream);
+			::close(client);
+		}
+
+		Scenario scenario_;
+		Upstream upstream_;
+		SSL_CTX* tlsContext_{ nullptr };
+
+		int listener_{ -1 };
+		std::uint16_t port_{ 0 };
+		std::atomic<bool> running_{ false };
+		std::thread acceptThread_;
+
+		mutable std::mutex mutex_;
+		bool faultsEnabled_{ true };
+		bool phasesStarted_{ false };
+		Clock::time_point phasesStart_{ Clock::now() };
+		std::set<int> sockets_;
+		std::map<std::uint64_t, std::thread> connections_;
+		std::vector<std::uint64_t> finished_;    ///< Connections whose thread is about to return
+		std::ofstream events_;
+		Counters counters_;
+	};
+}
@@ -0,0 +1,317 @@
+// Generates FeatureKeys.hpp from a captured feature list: an enum with one constexpr ID per feature key and a
+// minimal perfect hash from key to that dense ID, so application code can keep feature state in a flat array and
+// check features by ID without hashing strings. Keys unknown at build time are reported as -1 by IndexOf and are
+// kept aside by IndexedFeatureSet.
+//
+// Accepted input: the file written by the console's "Export feature keys" action, a PersistentData dump
+// ({ "activation": { "features": [...] } }), { "features": [...] } or a plain array. Features are objects with
+// a "key" or plain strings.
+//
+// Usage: Zentitle.FeatureKeyGenerator <features.json> <FeatureKeys.hpp>
+
+#include "FeatureKeyHash.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	std::uint32_t Hash(const std::string& key, std::uint32_t seed)
+	{
+		return FeatureKeyHash(key, seed);
+	}
+
+	std::vector<std::string> ReadKeys(const nlohmann::json& input)
+	{
+		const nlohmann::json* features = &input;
+		if (input.is_object())
+		{
+			if (input.contains("activation") && input["activation"].contains("features"))
+			{
+				features = &input["activation"]["features"];
+			}
+			else if (input.contains("features"))
+			{
+				features = &input["features"];
+			}
+		}
+
+		if (!features->is_array())
+		{
+			throw std::runtime_error("No feature array found in the input");
+		}
+
+		std::set<std::string> keys;
+		for (const auto& feature : *features)
+		{
+			if (feature.is_string())
+			{
+				keys.insert(feature.get<std::string>());
+			}
+			else if (feature.is_object() && feature.contains("key"))
+			{
+				keys.insert(feature["key"].get<std::string>());
+			}
+			else
+			{
+				throw std::runtime_error("Feature without a key: " + feature.dump());
+			}
+		}
+		return { keys.begin(), keys.end() };
+	}
+
+	// "element-pool.seats" -> ElementPoolSeats, names are made unique with a numeric suffix
+	std::vector<std::string> MakeIdentifiers(const std::vector<std::string>& keys)
+	{
+		std::vector<std::string> identifiers;
+		std::set<std::string> used;
+		for (const auto& key : keys)
+		{
+			std::string identifier;
+			bool upper = true;
+			for (char c : key)
+			{
+				if (std::isalnum(static_cast<unsigned char>(c)))
+				{
+					identifier += upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+					upper = false;
+				}
+				else
+				{
+					upper = true;
+				}
+			}
+			if (identifier.empty() || std::isdigit(static_cast<unsigned char>(identifier[0])))
+			{
+				identifier = "Feature" + identifier;
+			}
+
+			std::string unique = identifier;
+			for (int suffix = 2; used.count(unique); ++suffix)
+			{
+				unique = identifier + std::to_string(suffix);
+			}
+			used.insert(unique);
+			identifiers.push_back(unique);
+		}
+		return identifiers;
+	}
+
+	// Hash and displace: keys are grouped into buckets by Hash(key, 0). Buckets with several keys get the first
+	// seed that sends all of them to free slots, single key buckets take a free slot directly (stored as -(slot + 1)).
+	bool BuildPerfectHash(const std::vector<std::string>& keys, std::vector<std::int32_t>& displacements, std::vector<std::size_t>& slotOfKey)
+	{
+		const std::size_t count = keys.size();
+		const std::size_t bucketCount = std::max<std::size_t>(1, count);
+		std::vector<std::vector<std::size_t>> buckets(bucketCount);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			buckets[Hash(keys[i], 0) % bucketCount].push_back(i);
+		}
+
+		std::vector<std::size_t> order(bucketCount);
+		for (std::size_t i = 0; i < bucketCount; ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		displacements.assign(bucketCount, 0);
+		slotOfKey.assign(count, 0);
+		std::vector<bool> taken(count, false);
+
+		for (std::size_t bucket : order)
+		{
+			const auto& members = buckets[bucket];
+			if (members.empty())
+			{
+				break;
+			}
+
+			if (members.size() == 1)
+			{
+				auto freeSlot = std::find(taken.begin(), taken.end(), false) - taken.begin();
+				taken[freeSlot] = true;
+				slotOfKey[members[0]] = static_cast<std::size_t>(freeSlot);
+				displacements[bucket] = -static_cast<std::int32_t>(freeSlot) - 1;
+				continue;
+			}
+
+			bool placed = false;
+			for (std::uint32_t seed = 1; seed < 10000000 && !placed; ++seed)
+			{
+				std::vector<std::size_t> slots;
+				for (std::size_t member : members)
+				{
+					std::size_t slot = Hash(keys[member], seed) % count;
+					if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end())
+					{
+						break;
+					}
+					slots.push_back(slot);
+				}
+
+				if (slots.size() == members.size())
+				{
+					for (std::size_t i = 0; i < members.size(); ++i)
+					{
+						taken[slots[i]] = true;
+						slotOfKey[members[i]] = slots[i];
+					}
+					displacements[bucket] = static_cast<std::int32_t>(seed);
+					placed = true;
+				}
+			}
+
+			if (!placed)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string Escape(const std::string& value)
+	{
+		std::ostringstream escaped;
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				throw std::runtime_error("Feature key with control characters: " + value);
+			}
+			else
+			{
+				escaped << c;
+			}
+		}
+		return escaped.str();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <features.json> <FeatureKeys.hpp>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		std::ifstream inputFile(argv[1]);
+		if (!inputFile.is_open())
+		{
+			throw std::runtime_error(std::string("Failed to open ") + argv[1]);
+		}
+		nlohmann::json input;
+		inputFile >> input;
+
+		auto keys = ReadKeys(input);
+		if (keys.size() > 0xFFFF)
+		{
+			throw std::runtime_error("Too many feature keys");
+		}
+
+		std::vector<std::int32_t> displacements;
+		std::vector<std::size_t> slotOfKey;
+		if (!BuildPerfectHash(keys, displacements, slotOfKey))
+		{
+			throw std::runtime_error("Failed to build a perfect hash for the feature keys");
+		}
+
+		// IDs are the perfect hash slots, so IndexOf(key) == static_cast<std::size_t>(Id)
+		auto identifiers = MakeIdentifiers(keys);
+		std::vector<std::size_t> keyInSlot(keys.size());
+		for (std::size_t i = 0; i < keys.size(); ++i)
+		{
+			keyInSlot[slotOfKey[i]] = i;
+		}
+
+		std::ostringstream header;
+		header << "// Generated by Zentitle.FeatureKeyGenerator, do not edit. Regenerate from an updated feature list instead.\n"
+			<< "#pragma once\n\n"
+			<< "#include <array>\n#include <cstddef>\n#include <cstdint>\n#include <string_view>\n\n"
+			<< "#include \"FeatureKeyHash.hpp\"\n\n"
+			<< "struct FeatureKeys\n{\n"
+			<< "\tenum class Id : std::uint16_t\n\t{\n";
+		for (std::size_t slot = 0; slot < keys.size(); ++slot)
+		{
+			header << "\t\t" << identifiers[keyInSlot[slot]] << " = " << slot << ", ///< \"" << Escape(keys[keyInSlot[slot]]) << "\"\n";
+		}
+		header << "\t};\n\n"
+			<< "\tstatic constexpr std::size_t Count = " << keys.size() << ";\n\n"
+			<< "\tstatic constexpr std::array<std::string_view, Count> Keys = {\n";
+		for (std::size_t slot = 0; slot < keys.size(); ++slot)
+		{
+			header << "\t\t\"" << Escape(keys[keyInSlot[slot]]) << "\",\n";
+		}
+		header << "\t};\n\n"
+			<< "\tstatic constexpr std::array<std::int32_t, " << displacements.size() << "> Displacements = {";
+		for (std::size_t i = 0; i < displacements.size(); ++i)
+		{
+			header << (i % 16 == 0 ? "\n\t\t" : " ") << displacements[i] << ",";
+		}
+		header << "\n\t};\n\n"
+			<< "\t// Dense ID of a key, -1 for keys that were not in the feature list at build time\n";
+		if (keys.empty())
+		{
+			// No modulo by a zero Count is emitted at all, compilers reject or warn about it even in a dead branch
+			header << "\tstatic constexpr int IndexOf(std::string_view)\n\t{\n"
+				<< "\t\treturn -1;\n"
+				<< "\t}\n";
+		}
+		else
+		{
+			header << "\tstatic constexpr int IndexOf(std::string_view key)\n\t{\n"
+				<< "\t\tstd::int32_t displacement = Displacements[FeatureKeyHash(key, 0) % Displacements.size()];\n"
+				<< "\t\tstd::size_t slot = displacement < 0 ? static_cast<std::size_t>(-displacement - 1) : FeatureKeyHash(key, static_cast<std::uint32_t>(displacement)) % Count;\n"
+				<< "\t\treturn slot < Count && Keys[slot] == key ? static_cast<int>(slot) : -1;\n"
+				<< "\t}\n";
+		}
+		header << "};\n";
+
+		// Unchanged output keeps the timestamp, so dependents are not rebuilt
+		std::string generated = header.str();
+		std::ifstream existing(argv[2], std::ios::binary);
+		std::string previous((std::istreambuf_iterator<char>(existing)), std::istreambuf_iterator<char>());
+		if (previous != generated)
+		{
+			auto directory = std::filesystem::path(argv[2]).parent_path();
+			if (!directory.empty())
+			{
+				std::filesystem::create_directories(directory);
+			}
+			std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+			output << generated;
+			if (!output)
+			{
+				throw std::runtime_error(std::string("Failed to write ") + argv[2]);
+			}
+		}
+
+		std::cout << "Generated " << keys.size() << " feature keys into " << argv[2] << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Feature key generation failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
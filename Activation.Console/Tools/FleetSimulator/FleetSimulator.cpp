@@ -0,0 +1,238 @@
+// Simulates a fleet of seats over hours or days of virtual time (see FleetSimulator.hpp) and reports the request
+// rate the Licensing API sees: per report interval, the busiest minutes with the requests behind them, the peak
+// element pool usage and the wall clock time the simulation took.
+//
+// Usage: Zentitle.FleetSimulator <fleet.json> [--seats <count>] [--hours <hours>] [--top <minutes>] [--csv <file>]
+// Run it from the build directory to take the Agent refresh settings of appsettings.json as defaults.
+
+#include "ActivationConfig.hpp"
+#include "FleetSimulator.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using namespace FleetSimulation;
+
+	void WriteTimeline(std::ostream& out, const Scenario& scenario, const Backend& backend, Time intervalSeconds)
+	{
+		const auto& perSecond = backend.perSecond();
+		const auto& poolPerMinute = backend.poolPerMinute();
+
+		out << std::left << std::setw(21) << "Interval (UTC)" << std::right << std::setw(12) << "Requests"
+			<< std::setw(10) << "Avg/s" << std::setw(10) << "Peak/s" << std::setw(10) << "Pool" << '\n';
+		for (Time offset = 0; offset < scenario.duration; offset += intervalSeconds)
+		{
+			auto end = std::min(scenario.duration, offset + intervalSeconds);
+			auto first = perSecond.begin() + offset;
+			auto last = perSecond.begin() + end;
+			auto requests = std::accumulate(first, last, std::uint64_t{ 0 });
+			auto peak = *std::max_element(first, last);
+			auto pool = *std::max_element(poolPerMinute.begin() + offset / 60, poolPerMinute.begin() + std::max(offset / 60 + 1, end / 60));
+
+			out << std::left << std::setw(21) << FormatUtc(scenario.start + offset).substr(0, 16) << std::right
+				<< std::setw(12) << requests
+				<< std::setw(10) << std::fixed << std::setprecision(2) << static_cast<double>(requests) / static_cast<double>(end - offset)
+				<< std::setw(10) << peak << std::setw(10) << pool << '\n';
+		}
+	}
+
+	// Busiest minutes at least SpikeSeparationMinutes apart, so that one long spike is listed once. The share of
+	// each request kind shows what lined the seats up.
+	constexpr std::size_t SpikeSeparationMinutes = 15;
+
+	void WriteSpikes(std::ostream& out, const Scenario& scenario, const Backend& backend, std::size_t count)
+	{
+		const auto& perMinute = backend.perMinute();
+		auto total = [&](std::size_t minute) { return std::accumulate(perMinute[minute].begin(), perMinute[minute].end(), std::uint64_t{ 0 }); };
+		std::vector<std::size_t> byRequests(perMinute.size());
+		std::iota(byRequests.begin(), byRequests.end(), std::size_t{ 0 });
+		std::stable_sort(byRequests.begin(), byRequests.end(), [&](std::size_t a, std::size_t b) { return total(a) > total(b); });
+
+		std::vector<std::size_t> minutes;
+		for (auto minute : byRequests)
+		{
+			if (minutes.size() == count)
+			{
+				break;
+			}
+			bool separate = std::none_of(minutes.begin(), minutes.end(), [minute](std::size_t chosen)
+				{
+					return (minute > chosen ? minute - chosen : chosen - minute) < SpikeSeparationMinutes;
+				});
+			if (separate)
+			{
+				minutes.push_back(minute);
+			}
+		}
+		count = minutes.size();
+
+		std::uint64_t all = 0;
+		for (std::size_t minute = 0; minute < perMinute.size(); ++minute)
+		{
+			all += total(minute);
+		}
+		double average = perMinute.empty() ? 0.0 : static_cast<double>(all) / static_cast<double>(perMinute.size());
+
+		const auto& perSecond = backend.perSecond();
+		auto peakSecond = std::max_element(perSecond.begin(), perSecond.end());
+		out << "Peak second: " << *peakSecond << " requests at " << FormatUtc(scenario.start + (peakSecond - perSecond.begin()))
+			<< ", average " << std::fixed << std::setprecision(2) << static_cast<double>(all) / static_cast<double>(scenario.duration) << " per second" << '\n';
+		out << "Busiest minutes (average " << std::fixed << std::setprecision(1) << average << " requests per minute):" << '\n';
+		for (std::size_t i = 0; i < count && total(minutes[i]) > 0; ++i)
+		{
+			auto minute = minutes[i];
+			auto requests = total(minute);
+			out << "  " << FormatUtc(scenario.start + static_cast<Time>(minute) * 60).substr(0, 16) << "  " << std::setw(8) << requests
+				<< " requests, " << std::setprecision(1) << (average > 0 ? static_cast<double>(requests) / average : 0.0) << "x average:";
+			for (std::size_t kind = 0; kind < RequestKinds; ++kind)
+			{
+				if (perMinute[minute][kind] > 0)
+				{
+					out << ' ' << RequestName(static_cast<Request>(kind)) << ' ' << perMinute[minute][kind];
+				}
+			}
+			out << '\n';
+		}
+	}
+
+	void WriteCsv(const std::string& path, const Scenario& scenario, const Backend& backend)
+	{
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out)
+		{
+			throw std::runtime_error("Failed to open " + path);
+		}
+		out << "minute";
+		for (std::size_t kind = 0; kind < RequestKinds; ++kind)
+		{
+			out << ',' << RequestName(static_cast<Request>(kind));
+		}
+		out << ",poolInUse\n";
+
+		const auto& perMinute = backend.perMinute();
+		for (std::size_t minute = 0; minute < perMinute.size(); ++minute)
+		{
+			out << FormatUtc(scenario.start + static_cast<Time>(minute) * 60);
+			for (auto requests : perMinute[minute])
+			{
+				out << ',' << requests;
+			}
+			out << ',' << backend.poolPerMinute()[minute] << '\n';
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: Zentitle.FleetSimulator <fleet.json> [--seats <count>] [--hours <hours>] [--top <minutes>] [--csv <file>]" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	std::optional<std::size_t> seats;
+	std::optional<double> hours;
+	std::size_t top = 10;
+	std::string csvPath;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--seats" && i + 1 < argc)
+		{
+			seats = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (argument == "--hours" && i + 1 < argc)
+		{
+			hours = std::strtod(argv[++i], nullptr);
+		}
+		else if (argument == "--top" && i + 1 < argc)
+		{
+			top = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (argument == "--csv" && i + 1 < argc)
+		{
+			csvPath = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	try
+	{
+		ActivationConsole::AgentConfig agentDefaults;
+		auto configPath = (std::filesystem::current_path() / "appsettings.json").string();
+		if (std::filesystem::exists(configPath))
+		{
+			agentDefaults = ActivationConsole::LoadConfiguration(configPath).Agent;
+		}
+
+		auto scenario = Scenario::Load(argv[1], agentDefaults);
+		if (seats)
+		{
+			scenario.seats = *seats;
+		}
+		if (hours)
+		{
+			scenario.duration = static_cast<Time>(*hours * 3600);
+		}
+		if (scenario.duration <= 0)
+		{
+			throw std::runtime_error("The simulated duration must be positive");
+		}
+
+		auto wallStart = std::chrono::steady_clock::now();
+		Simulator simulator(scenario);
+		auto results = simulator.run();
+		auto wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+		const auto& backend = simulator.backend();
+
+		std::cout << "Fleet '" << scenario.name << "': " << scenario.seats << " seats, " << scenario.duration / 3600.0 << " h from "
+			<< FormatUtc(scenario.start) << " UTC, lease " << scenario.leaseSeconds << " s, agent checks every "
+			<< scenario.refreshCheckIntervalSeconds << " s and refreshes " << scenario.refreshBeforeExpirySeconds << " s before expiry" << '\n';
+		std::cout << std::fixed << std::setprecision(2) << "Simulated in " << wallSeconds << " s wall clock, "
+			<< results.events << " events, " << static_cast<double>(scenario.duration) / std::max(wallSeconds, 1e-9) << "x real time" << '\n' << '\n';
+
+		WriteTimeline(std::cout, scenario, backend, std::max<Time>(3600, scenario.duration / 48 / 3600 * 3600));
+		std::cout << '\n';
+		WriteSpikes(std::cout, scenario, backend, top);
+		std::cout << '\n';
+
+		std::cout << "Requests:";
+		for (std::size_t kind = 0; kind < RequestKinds; ++kind)
+		{
+			std::cout << ' ' << RequestName(static_cast<Request>(kind)) << ' ' << backend.totals()[kind];
+		}
+		std::cout << ", " << backend.unavailable() << " during outages" << '\n';
+		std::cout << "Sessions: " << results.sessions << " started, " << results.blockedSessions << " blocked by an expired lease or used up usage, "
+			<< results.abandonedSessions << " abandoned after " << scenario.poolRetryLimit << " denied checkouts" << '\n';
+		std::cout << "Element pool: peak " << backend.poolPeak() << (scenario.poolSize > 0 ? " of " + std::to_string(scenario.poolSize) : std::string())
+			<< " at " << FormatUtc(backend.poolPeakTime()) << ", " << backend.deniedCheckouts() << " checkouts denied, "
+			<< backend.lostReturns() << " returns lost in outages" << '\n';
+		std::cout << "Usage: " << backend.deniedUsage() << " usage tracks denied at the limit of the period" << '\n';
+		std::cout << "Leases: " << results.leaseLapses << " refreshed only after they expired" << '\n';
+
+		if (!csvPath.empty())
+		{
+			WriteCsv(csvPath, scenario, backend);
+			std::cout << "Per-minute request counts written to " << csvPath << '\n';
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,725 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ActivationConfig.hpp"
+#include "LeasePolicy.hpp"
+#include "json.hpp"
+
+// Discrete-event simulation of a fleet of seats over hours or days of simulated time. Every seat runs the licensing
+// agent's lease keeping (LeasePolicy on a virtual clock, the Agent settings of appsettings.json) and a workload of
+// sessions that check out an element of a pool and track usage of a usage-count feature. The Licensing API is an
+// in-process model with leases, one element pool, usage periods and outages. Events are processed in time order and
+// idle stretches are skipped: a seat's agent only wakes at the check that finds its lease due.
+//
+//   {
+//     "name": "office-fleet",
+//     "start": "2026-01-05T00:00:00Z",
+//     "durationHours": 168,
+//     "seed": 1,
+//     "seats": 5000,
+//     "activationSpreadSeconds": 900,
+//     "offlineFraction": 0.05,
+//     "refreshJitterSeconds": 0,
+//     "Agent": { "RefreshCheckIntervalSeconds": 30, "RefreshBeforeExpirySeconds": 300 },
+//     "backend": { "leaseSeconds": 3600, "offlineLeaseSeconds": 604800, "poolSize": 1200,
+//                  "usagePeriodHours": 24, "usageLimit": 6, "outages": [ { "startHours": 50, "durationMinutes": 30 } ] },
+//     "sessions": { "perSeatPerDay": 3, "medianMinutes": 50, "sigma": 0.7, "usagePerSession": 1,
+//                   "hourlyProfile": [ ... 24 weights ... ], "weekendFactor": 0.15,
+//                   "poolRetrySeconds": 120, "poolRetryLimit": 5 }
+//   }
+//
+// The Agent section takes the names and defaults of appsettings.json. refreshJitterSeconds is a what-if the console
+// does not implement: every refresh comes up to that many seconds earlier, drawn anew for each lease.
+namespace FleetSimulation
+{
+	using Time = std::int64_t; ///< Simulated seconds since the epoch, UTC
+
+	namespace Detail
+	{
+		// Days since 1970-01-01 of a proleptic Gregorian date
+		inline std::int64_t DaysFromCivil(std::int64_t year, unsigned month, unsigned day)
+		{
+			year -= month <= 2;
+			const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+			const auto yearOfEra = static_cast<unsigned>(year - era * 400);
+			const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+			const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			return era * 146097 + static_cast<std::int64_t>(dayOfEra) - 719468;
+		}
+
+		inline void CivilFromDays(std::int64_t days, std::int64_t& year, unsigned& month, unsigned& day)
+		{
+			days += 719468;
+			const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+			const auto dayOfEra = static_cast<unsigned>(days - era * 146097);
+			const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+			const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+			const unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+			day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+			month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+			year = static_cast<std::int64_t>(yearOfEra) + era * 400 + (month <= 2);
+		}
+
+		inline std::int64_t FloorDiv(std::int64_t value, std::int64_t divisor)
+		{
+			return value / divisor - (value % divisor != 0 && (value < 0) != (divisor < 0));
+		}
+	}
+
+	// "YYYY-MM-DDTHH:MM:SSZ"
+	inline Time ParseUtc(const std::string& text)
+	{
+		int year = 0;
+		unsigned month = 0, day = 0, hour = 0, minute = 0, second = 0;
+		if (std::sscanf(text.c_str(), "%d-%u-%uT%u:%u:%u", &year, &month, &day, &hour, &minute, &second) != 6)
+		{
+			throw std::runtime_error("Invalid UTC time '" + text + "', expected YYYY-MM-DDTHH:MM:SSZ");
+		}
+		return Detail::DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+	}
+
+	// "YYYY-MM-DD HH:MM:SS"
+	inline std::string FormatUtc(Time time)
+	{
+		auto days = Detail::FloorDiv(time, 86400);
+		auto seconds = time - days * 86400;
+		std::int64_t year = 0;
+		unsigned month = 0, day = 0;
+		Detail::CivilFromDays(days, year, month, day);
+		char buffer[64];
+		std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02u %02lld:%02lld:%02lld", static_cast<long long>(year), month, day,
+			static_cast<long long>(seconds / 3600), static_cast<long long>(seconds / 60 % 60), static_cast<long long>(seconds % 60));
+		return buffer;
+	}
+
+	// The only time source of the simulation, moved forward by the event loop
+	class VirtualClock
+	{
+	public:
+		explicit VirtualClock(Time start)
+			: now_(start)
+		{
+		}
+
+		Time now() const
+		{
+			return now_;
+		}
+
+		void advanceTo(Time time)
+		{
+			if (time < now_)
+			{
+				throw std::logic_error("The virtual clock cannot go back");
+			}
+			now_ = time;
+		}
+
+	private:
+		Time now_;
+	};
+
+	// Requests the fleet sends to the Licensing API, named like the LicensingCall operations
+	enum class Request
+	{
+		Activate, RefreshLease, RefreshLeaseOffline, CheckoutFeature, ReturnFeature, TrackUsage
+	};
+
+	constexpr std::size_t RequestKinds = 6;
+
+	inline const char* RequestName(Request request)
+	{
+		static const char* const names[RequestKinds] = { "Activate", "RefreshLease", "RefreshLeaseOffline", "CheckoutFeature", "ReturnFeature", "TrackUsage" };
+		return names[static_cast<std::size_t>(request)];
+	}
+
+	struct Outage
+	{
+		Time start;
+		Time end;
+	};
+
+	struct Scenario
+	{
+		std::string name;
+		Time start{ 0 };
+		Time duration{ 0 };
+		std::uint64_t seed{ 1 };
+		std::size_t seats{ 0 };
+		Time activationSpread{ 0 };
+		double offlineFraction{ 0 };
+		int refreshCheckIntervalSeconds{ 0 };
+		int refreshBeforeExpirySeconds{ 0 };
+		int refreshJitterSeconds{ 0 };
+
+		Time leaseSeconds{ 3600 };
+		Time offlineLeaseSeconds{ 7 * 86400 };
+		std::int64_t poolSize{ 0 };           ///< 0 is unlimited
+		Time usagePeriodSeconds{ 86400 };     ///< Periods start at midnight UTC of the start day
+		std::int64_t usageLimit{ 0 };         ///< Per seat and period, 0 is unlimited
+		std::vector<Outage> outages;
+
+		double sessionsPerSeatPerDay{ 0 };
+		double sessionMedianSeconds{ 3600 };
+		double sessionSigma{ 0.5 };
+		std::int64_t usagePerSession{ 1 };
+		std::array<double, 24> hourlyProfile{};
+		double weekendFactor{ 1 };
+		Time poolRetrySeconds{ 120 };
+		int poolRetryLimit{ 5 };
+
+		static Scenario Load(const std::string& path, const ActivationConsole::AgentConfig& agentDefaults)
+		{
+			std::ifstream input(path);
+			if (!input)
+			{
+				throw std::runtime_error("Failed to open the fleet scenario " + path);
+			}
+			auto json = nlohmann::json::parse(input);
+
+			Scenario scenario;
+			scenario.name = json.value("name", std::string("fleet"));
+			scenario.start = ParseUtc(json.value("start", std::string("2026-01-05T00:00:00Z")));
+			scenario.duration = static_cast<Time>(json.value("durationHours", 24.0) * 3600);
+			scenario.seed = json.value("seed", std::uint64_t{ 1 });
+			scenario.seats = json.value("seats", std::size_t{ 1000 });
+			scenario.activationSpread = json.value("activationSpreadSeconds", Time{ 0 });
+			scenario.offlineFraction = json.value("offlineFraction", 0.0);
+			scenario.refreshJitterSeconds = json.value("refreshJitterSeconds", 0);
+
+			auto agent = json.value("Agent", nlohmann::json::object());
+			scenario.refreshCheckIntervalSeconds = agent.value(ActivationConsole::constant_strings::configRefreshCheckIntervalSeconds, agentDefaults.RefreshCheckIntervalSeconds);
+			scenario.refreshBeforeExpirySeconds = agent.value(ActivationConsole::constant_strings::configRefreshBeforeExpirySeconds, agentDefaults.RefreshBeforeExpirySeconds);
+			if (scenario.refreshCheckIntervalSeconds <= 0)
+			{
+				throw std::runtime_error("RefreshCheckIntervalSeconds must be positive");
+			}
+
+			auto backend = json.value("backend", nlohmann::json::object());
+			scenario.leaseSeconds = backend.value("leaseSeconds", scenario.leaseSeconds);
+			scenario.offlineLeaseSeconds = backend.value("offlineLeaseSeconds", scenario.offlineLeaseSeconds);
+			scenario.poolSize = backend.value("poolSize", scenario.poolSize);
+			scenario.usagePeriodSeconds = static_cast<Time>(backend.value("usagePeriodHours", 24.0) * 3600);
+			scenario.usageLimit = backend.value("usageLimit", scenario.usageLimit);
+			for (const auto& outage : backend.value("outages", nlohmann::json::array()))
+			{
+				auto start = scenario.start + static_cast<Time>(outage.value("startHours", 0.0) * 3600);
+				scenario.outages.push_back({ start, start + static_cast<Time>(outage.value("durationMinutes", 0.0) * 60) });
+			}
+			if (scenario.leaseSeconds <= 0 || scenario.offlineLeaseSeconds <= 0 || scenario.usagePeriodSeconds <= 0)
+			{
+				throw std::runtime_error("Lease and usage period lengths must be positive");
+			}
+
+			auto sessions = json.value("sessions", nlohmann::json::object());
+			scenario.sessionsPerSeatPerDay = sessions.value("perSeatPerDay", 0.0);
+			scenario.sessionMedianSeconds = sessions.value("medianMinutes", 60.0) * 60;
+			scenario.sessionSigma = sessions.value("sigma", 0.5);
+			scenario.usagePerSession = sessions.value("usagePerSession", std::int64_t{ 1 });
+			scenario.hourlyProfile.fill(1.0);
+			if (sessions.contains("hourlyProfile"))
+			{
+				auto profile = sessions["hourlyProfile"].get<std::vector<double>>();
+				if (profile.size() != 24)
+				{
+					throw std::runtime_error("hourlyProfile needs 24 weights, one per hour of the day (UTC)");
+				}
+				std::copy(profile.begin(), profile.end(), scenario.hourlyProfile.begin());
+			}
+			scenario.weekendFactor = sessions.value("weekendFactor", 1.0);
+			scenario.poolRetrySeconds = sessions.value("poolRetrySeconds", scenario.poolRetrySeconds);
+			scenario.poolRetryLimit = sessions.value("poolRetryLimit", scenario.poolRetryLimit);
+			return scenario;
+		}
+	};
+
+	// The Licensing API as the fleet sees it. Counts every request in the second it arrives.
+	class Backend
+	{
+	public:
+		enum class Outcome
+		{
+			Ok, Denied, Unavailable
+		};
+
+		Backend(const Scenario& scenario, const VirtualClock& clock)
+			: scenario_(scenario), clock_(clock),
+			perSecond_(static_cast<std::size_t>(scenario.duration) + 1),
+			perMinute_(static_cast<std::size_t>(scenario.duration / 60) + 1),
+			poolPerMinute_(perMinute_.size()),
+			usage_(scenario.seats)
+		{
+			periodAnchor_ = Detail::FloorDiv(scenario.start, 86400) * 86400;
+		}
+
+		// Lease expiry, nullopt while the API is down
+		std::optional<Time> activate(bool offline)
+		{
+			if (!count(Request::Activate))
+			{
+				return std::nullopt;
+			}
+			return clock_.now() + (offline ? scenario_.offlineLeaseSeconds : scenario_.leaseSeconds);
+		}
+
+		std::optional<Time> refreshLease(bool offline)
+		{
+			if (!count(offline ? Request::RefreshLeaseOffline : Request::RefreshLease))
+			{
+				return std::nullopt;
+			}
+			return clock_.now() + (offline ? scenario_.offlineLeaseSeconds : scenario_.leaseSeconds);
+		}
+
+		Outcome checkout()
+		{
+			if (!count(Request::CheckoutFeature))
+			{
+				return Outcome::Unavailable;
+			}
+			if (scenario_.poolSize > 0 && poolInUse_ >= scenario_.poolSize)
+			{
+				++deniedCheckouts_;
+				return Outcome::Denied;
+			}
+			++poolInUse_;
+			notePool();
+			return Outcome::Ok;
+		}
+
+		// The element stays checked out when the return does not reach the API, like a crashed console
+		Outcome returnFeature()
+		{
+			if (!count(Request::ReturnFeature))
+			{
+				++lostReturns_;
+				return Outcome::Unavailable;
+			}
+			--poolInUse_;
+			return Outcome::Ok;
+		}
+
+		Outcome trackUsage(std::size_t seat, std::int64_t amount)
+		{
+			if (!count(Request::TrackUsage))
+			{
+				return Outcome::Unavailable;
+			}
+			auto& usage = usage_[seat];
+			auto period = periodStart(clock_.now());
+			if (usage.period != period)
+			{
+				usage = { period, 0 };
+			}
+			if (scenario_.usageLimit > 0 && usage.used + amount > scenario_.usageLimit)
+			{
+				++deniedUsage_;
+				return Outcome::Denied;
+			}
+			usage.used += amount;
+			return Outcome::Ok;
+		}
+
+		// currentUsagePeriodStart and nextUsagePeriodStart of the usage-count feature
+		Time periodStart(Time time) const
+		{
+			return periodAnchor_ + Detail::FloorDiv(time - periodAnchor_, scenario_.usagePeriodSeconds) * scenario_.usagePeriodSeconds;
+		}
+
+		Time nextPeriodStart(Time time) const
+		{
+			return periodStart(time) + scenario_.usagePeriodSeconds;
+		}
+
+		bool available(Time time) const
+		{
+			return std::none_of(scenario_.outages.begin(), scenario_.outages.end(),
+				[time](const Outage& outage) { return time >= outage.start && time < outage.end; });
+		}
+
+		const std::vector<std::uint32_t>& perSecond() const
+		{
+			return perSecond_;
+		}
+
+		const std::vector<std::array<std::uint32_t, RequestKinds>>& perMinute() const
+		{
+			return perMinute_;
+		}
+
+		// Highest number of elements checked out at once within each minute
+		const std::vector<std::int64_t>& poolPerMinute() const
+		{
+			return poolPerMinute_;
+		}
+
+		const std::array<std::uint64_t, RequestKinds>& totals() const
+		{
+			return totals_;
+		}
+
+		std::uint64_t unavailable() const
+		{
+			return unavailable_;
+		}
+
+		std::uint64_t deniedCheckouts() const
+		{
+			return deniedCheckouts_;
+		}
+
+		std::uint64_t deniedUsage() const
+		{
+			return deniedUsage_;
+		}
+
+		std::uint64_t lostReturns() const
+		{
+			return lostReturns_;
+		}
+
+		std::int64_t poolPeak() const
+		{
+			return poolPeak_;
+		}
+
+		Time poolPeakTime() const
+		{
+			return poolPeakTime_;
+		}
+
+	private:
+		struct Usage
+		{
+			Time period{ 0 };
+			std::int64_t used{ 0 };
+		};
+
+		// Counts the request, false when it arrives during an outage
+		bool count(Request request)
+		{
+			auto offset = static_cast<std::size_t>(clock_.now() - scenario_.start);
+			auto kind = static_cast<std::size_t>(request);
+			++perSecond_[offset];
+			++perMinute_[offset / 60][kind];
+			++totals_[kind];
+			if (!available(clock_.now()))
+			{
+				++unavailable_;
+				return false;
+			}
+			return true;
+		}
+
+		void notePool()
+		{
+			auto minute = static_cast<std::size_t>((clock_.now() - scenario_.start) / 60);
+			poolPerMinute_[minute] = std::max(poolPerMinute_[minute], poolInUse_);
+			if (poolInUse_ > poolPeak_)
+			{
+				poolPeak_ = poolInUse_;
+				poolPeakTime_ = clock_.now();
+			}
+		}
+
+		const Scenario& scenario_;
+		const VirtualClock& clock_;
+		Time periodAnchor_{ 0 };
+
+		std::vector<std::uint32_t> perSecond_;
+		std::vector<std::array<std::uint32_t, RequestKinds>> perMinute_;
+		std::vector<std::int64_t> poolPerMinute_;
+		std::array<std::uint64_t, RequestKinds> totals_{};
+		std::uint64_t unavailable_{ 0 };
+		std::uint64_t deniedCheckouts_{ 0 };
+		std::uint64_t deniedUsage_{ 0 };
+		std::uint64_t lostReturns_{ 0 };
+
+		std::int64_t poolInUse_{ 0 };
+		std::int64_t poolPeak_{ 0 };
+		Time poolPeakTime_{ 0 };
+		std::vector<Usage> usage_;
+	};
+
+	struct Results
+	{
+		std::uint64_t events{ 0 };
+		std::uint64_t sessions{ 0 };
+		std::uint64_t abandonedSessions{ 0 }; ///< Gave up after poolRetryLimit denied checkouts
+		std::uint64_t blockedSessions{ 0 };   ///< The lease had expired or the usage was used up
+		std::uint64_t leaseLapses{ 0 };       ///< Refreshes that came after the lease expired
+	};
+
+	class Simulator
+	{
+	public:
+		explicit Simulator(const Scenario& scenario)
+			: scenario_(scenario), clock_(scenario.start), backend_(scenario, clock_), random_(scenario.seed), seats_(scenario.seats)
+		{
+			double mean = 0;
+			for (double weight : scenario.hourlyProfile)
+			{
+				mean += weight / 24.0;
+			}
+			profileScale_ = mean > 0 ? 1.0 / mean : 0.0;
+			maxWeight_ = *std::max_element(scenario.hourlyProfile.begin(), scenario.hourlyProfile.end()) * profileScale_ * std::max(1.0, scenario.weekendFactor);
+		}
+
+		Results run()
+		{
+			std::uniform_real_distribution<double> unit(0.0, 1.0);
+			for (std::size_t index = 0; index < seats_.size(); ++index)
+			{
+				auto& seat = seats_[index];
+				seat.offline = unit(random_) < scenario_.offlineFraction;
+				auto activateAt = scenario_.start + (scenario_.activationSpread > 0 ? std::uniform_int_distribution<Time>(0, scenario_.activationSpread)(random_) : 0);
+				schedule(activateAt, index, Kind::Activate);
+			}
+
+			const Time end = scenario_.start + scenario_.duration;
+			while (!events_.empty() && events_.top().time < end)
+			{
+				auto event = events_.top();
+				events_.pop();
+				clock_.advanceTo(event.time);
+				++results_.events;
+				switch (event.kind)
+				{
+				case Kind::Activate:
+					activate(event.seat);
+					break;
+				case Kind::LeaseCheck:
+					checkLease(event.seat);
+					break;
+				case Kind::SessionStart:
+					startSession(event.seat, event.attempt);
+					break;
+				case Kind::SessionEnd:
+					endSession(event.seat);
+					break;
+				}
+			}
+			return results_;
+		}
+
+		const Backend& backend() const
+		{
+			return backend_;
+		}
+
+	private:
+		enum class Kind : std::uint8_t
+		{
+			Activate, LeaseCheck, SessionStart, SessionEnd
+		};
+
+		struct Event
+		{
+			Time time;
+			std::uint64_t sequence; ///< Keeps events of the same second in the order they were scheduled
+			std::uint32_t seat;
+			Kind kind;
+			std::uint8_t attempt;
+
+			bool operator>(const Event& other) const
+			{
+				return time != other.time ? time > other.time : sequence > other.sequence;
+			}
+		};
+
+		struct Seat
+		{
+			bool offline{ false };
+			bool active{ false };
+			bool inSession{ false };
+			int extraWindow{ 0 };
+			Time agentStart{ 0 };   ///< The agent checks the lease every interval from here on
+			Time leaseExpiry{ 0 };
+		};
+
+		void schedule(Time time, std::size_t seat, Kind kind, std::uint8_t attempt = 0)
+		{
+			events_.push({ time, sequence_++, static_cast<std::uint32_t>(seat), kind, attempt });
+		}
+
+		// First tick of the seat's agent after now
+		Time nextTick(const Seat& seat, Time after) const
+		{
+			const Time interval = scenario_.refreshCheckIntervalSeconds;
+			return seat.agentStart + (Detail::FloorDiv(after - seat.agentStart, interval) + 1) * interval;
+		}
+
+		// The first agent tick at which LeasePolicy::RefreshDue holds, the ticks before it would find nothing to do
+		void scheduleLeaseCheck(std::size_t index)
+		{
+			const auto& seat = seats_[index];
+			Time due = seat.leaseExpiry - scenario_.refreshBeforeExpirySeconds - seat.extraWindow;
+			schedule(nextTick(seat, std::max(clock_.now(), due - 1)), index, Kind::LeaseCheck);
+		}
+
+		void activate(std::size_t index)
+		{
+			auto& seat = seats_[index];
+			auto expiry = backend_.activate(seat.offline);
+			if (!expiry)
+			{
+				// The console is started again a check interval later
+				schedule(clock_.now() + scenario_.refreshCheckIntervalSeconds, index, Kind::Activate);
+				return;
+			}
+			seat.active = true;
+			seat.agentStart = clock_.now();
+			seat.leaseExpiry = *expiry;
+			drawJitter(seat);
+			scheduleLeaseCheck(index);
+			scheduleNextSession(index, clock_.now());
+		}
+
+		void checkLease(std::size_t index)
+		{
+			auto& seat = seats_[index];
+			if (!LeasePolicy::RefreshDue(seat.leaseExpiry, clock_.now(), scenario_.refreshBeforeExpirySeconds + seat.extraWindow))
+			{
+				scheduleLeaseCheck(index);
+				return;
+			}
+
+			bool lapsed = clock_.now() > seat.leaseExpiry;
+			auto expiry = backend_.refreshLease(seat.offline);
+			if (!expiry)
+			{
+				schedule(nextTick(seat, clock_.now()), index, Kind::LeaseCheck);
+				return;
+			}
+			if (lapsed)
+			{
+				++results_.leaseLapses;
+			}
+			seat.leaseExpiry = *expiry;
+			drawJitter(seat);
+			scheduleLeaseCheck(index);
+		}
+
+		void drawJitter(Seat& seat)
+		{
+			seat.extraWindow = scenario_.refreshJitterSeconds > 0 ? std::uniform_int_distribution<int>(0, scenario_.refreshJitterSeconds)(random_) : 0;
+		}
+
+		// Session arrivals are a Poisson process whose rate follows the hourly profile, drawn by thinning
+		void scheduleNextSession(std::size_t index, Time after)
+		{
+			if (scenario_.sessionsPerSeatPerDay <= 0 || maxWeight_ <= 0)
+			{
+				return;
+			}
+			const double maxRate = scenario_.sessionsPerSeatPerDay / 86400.0 * maxWeight_;
+			std::exponential_distribution<double> gap(maxRate);
+			std::uniform_real_distribution<double> unit(0.0, 1.0);
+			const Time end = scenario_.start + scenario_.duration;
+			double time = static_cast<double>(after);
+			for (;;)
+			{
+				time += gap(random_);
+				if (time >= static_cast<double>(end))
+				{
+					return;
+				}
+				if (unit(random_) * maxWeight_ <= weight(static_cast<Time>(time)))
+				{
+					break;
+				}
+			}
+			schedule(static_cast<Time>(time), index, Kind::SessionStart);
+		}
+
+		double weight(Time time) const
+		{
+			auto days = Detail::FloorDiv(time, 86400);
+			auto hour = static_cast<std::size_t>((time - days * 86400) / 3600);
+			// 1970-01-01 was a Thursday, Monday is 0
+			auto weekday = days + 3 - Detail::FloorDiv(days + 3, 7) * 7;
+			return scenario_.hourlyProfile[hour] * profileScale_ * (weekday >= 5 ? scenario_.weekendFactor : 1.0);
+		}
+
+		void startSession(std::size_t index, std::uint8_t attempt)
+		{
+			auto& seat = seats_[index];
+			if (seat.inSession)
+			{
+				scheduleNextSession(index, clock_.now());
+				return;
+			}
+			if (attempt == 0)
+			{
+				++results_.sessions;
+			}
+			if (clock_.now() > seat.leaseExpiry)
+			{
+				++results_.blockedSessions;
+				scheduleNextSession(index, clock_.now());
+				return;
+			}
+
+			auto checkout = backend_.checkout();
+			if (checkout != Backend::Outcome::Ok)
+			{
+				if (attempt + 1 >= scenario_.poolRetryLimit)
+				{
+					++results_.abandonedSessions;
+					scheduleNextSession(index, clock_.now());
+				}
+				else
+				{
+					schedule(clock_.now() + scenario_.poolRetrySeconds, index, Kind::SessionStart, static_cast<std::uint8_t>(attempt + 1));
+				}
+				return;
+			}
+
+			if (backend_.trackUsage(index, scenario_.usagePerSession) == Backend::Outcome::Denied)
+			{
+				// The usage is used up until the next period. The user gives the element back and tries again once
+				// the agent's first check after the rollover shows the new period.
+				++results_.blockedSessions;
+				backend_.returnFeature();
+				auto rollover = backend_.nextPeriodStart(clock_.now());
+				schedule(nextTick(seat, rollover - 1), index, Kind::SessionStart);
+				return;
+			}
+
+			seat.inSession = true;
+			std::lognormal_distribution<double> duration(std::log(scenario_.sessionMedianSeconds), scenario_.sessionSigma);
+			schedule(clock_.now() + std::max<Time>(1, static_cast<Time>(duration(random_))), index, Kind::SessionEnd);
+		}
+
+		void endSession(std::size_t index)
+		{
+			seats_[index].inSession = false;
+			backend_.returnFeature();
+			scheduleNextSession(index, clock_.now());
+		}
+
+		const Scenario& scenario_;
+		VirtualClock clock_;
+		Backend backend_;
+		std::mt19937_64 random_;
+		std::vector<Seat> seats_;
+		std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+		std::uint64_t sequence_{ 0 };
+		double profileScale_{ 0 };
+		double maxWeight_{ 0 };
+		Results results_;
+	};
+}
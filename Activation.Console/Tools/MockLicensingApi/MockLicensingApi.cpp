@@ -0,0 +1,54 @@
+// Serves the canned Licensing API responses of a routes file on 127.0.0.1 until SIGINT/SIGTERM, for running the
+// console or the performance scenarios against a local stand-in. Prints the URL and the tenant RSA modulus to put
+// into appsettings.json (Licensing.ApiUrl and Licensing.TenantRsaKeyModulus).
+//
+// Usage: Zentitle.MockLicensingApi <routes.json> [port] [generated-features]
+
+#include "MockLicensingApiServer.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: Zentitle.MockLicensingApi <routes.json> [port] [generated-features]" << '\n';
+		return EXIT_FAILURE;
+	}
+
+	// Block the signals before the server threads start, so only sigwait below receives them
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	try
+	{
+		MockLicensingApi::Server server(argv[1]);
+		if (argc > 3)
+		{
+			server.setGeneratedFeatures(std::strtoul(argv[3], nullptr, 10));
+		}
+		server.start(argc > 2 ? static_cast<std::uint16_t>(std::atoi(argv[2])) : 0);
+
+		std::cout << "Licensing API stand-in listening on " << server.url() << '\n';
+		std::cout << "TenantRsaKeyModulus: " << server.modulus() << std::endl;
+
+		int received = 0;
+		sigwait(&signals, &received);
+
+		server.stop();
+		auto counters = server.counters();
+		std::cout << counters.requests << " requests, " << counters.unmatched << " without a route" << '\n';
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,630 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+#include "json.hpp"
+
+// Local stand-in for the Zentitle Licensing API, serving canned responses from a routes file:
+//
+//   {
+//     "signature": { "header": "N-Signature" },
+//     "leaseSeconds": 3600,
+//     "features": [ { "key": "pool", "type": "ElementPool", "active": 0, "available": 100, "total": 100 } ],
+//     "routes": [
+//       { "method": "POST", "path": "/api/v1/activation/features/{featureKey}/checkout", "latencyMs": 2, "body": { ... } }
+//     ]
+//   }
+//
+// Strings in a body may contain {{now}}, {{leaseExpiry}} and the {parameters} of the route path as {{featureKey}}.
+// A string that is exactly "{{json:features}}" is replaced by the features array, followed by the synthetic features
+// added with setGeneratedFeatures for large entitlements.
+// Responses are signed with RSA-SHA256 by a key generated at startup, hand modulus() to the SDK as tenant key.
+// Unmatched requests are answered with 404 and counted, so a changed SDK request shows up right away.
+namespace MockLicensingApi
+{
+#ifdef MSG_NOSIGNAL
+	constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+	constexpr int SendFlags = 0; ///< macOS, the sockets set SO_NOSIGPIPE instead
+#endif
+
+	// Keeps a peer that went away from raising SIGPIPE where send has no flag for it
+	inline void IgnoreSigpipe(int socket)
+	{
+#ifdef SO_NOSIGPIPE
+		int enabled = 1;
+		::setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#else
+		(void)socket;
+#endif
+	}
+
+	struct Request
+	{
+		std::string method;
+		std::string path;
+		std::vector<std::pair<std::string, std::string>> headers;
+		std::string body;
+
+		std::optional<std::string> header(const std::string& name) const
+		{
+			for (const auto& [key, value] : headers)
+			{
+				if (key.size() == name.size() && std::equal(key.begin(), key.end(), name.begin(),
+					[](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); }))
+				{
+					return value;
+				}
+			}
+			return std::nullopt;
+		}
+	};
+
+	// Reads one HTTP/1.1 request with a Content-Length body from the socket, pending holds bytes read past it
+	inline std::optional<Request> ReadRequest(int socket, std::string& pending)
+	{
+		std::size_t headerEnd;
+		while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos)
+		{
+			char buffer[16 * 1024];
+			auto received = ::recv(socket, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+			{
+				return std::nullopt;
+			}
+			pending.append(buffer, static_cast<std::size_t>(received));
+		}
+
+		Request request;
+		auto lineEnd = pending.find("\r\n");
+		auto requestLine = pending.substr(0, lineEnd);
+		auto firstSpace = requestLine.find(' ');
+		auto secondSpace = requestLine.find(' ', firstSpace + 1);
+		if (firstSpace == std::string::npos || secondSpace == std::string::npos)
+		{
+			return std::nullopt;
+		}
+		request.method = requestLine.substr(0, firstSpace);
+		request.path = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+
+		for (auto position = lineEnd + 2; position < headerEnd;)
+		{
+			auto end = pending.find("\r\n", position);
+			auto line = pending.substr(position, end - position);
+			auto colon = line.find(':');
+			if (colon != std::string::npos)
+			{
+				auto value = line.substr(colon + 1);
+				value.erase(0, value.find_first_not_of(" \t"));
+				request.headers.emplace_back(line.substr(0, colon), value);
+			}
+			position = end + 2;
+		}
+
+		std::size_t contentLength = 0;
+		if (auto length = request.header("Content-Length"))
+		{
+			contentLength = static_cast<std::size_t>(std::stoull(*length));
+		}
+		// curl waits for an interim response before sending larger bodies
+		auto expect = request.header("Expect");
+		if (expect && *expect == "100-continue" && pending.size() - (headerEnd + 4) < contentLength)
+		{
+			static const char continueResponse[] = "HTTP/1.1 100 Continue\r\n\r\n";
+			::send(socket, continueResponse, sizeof(continueResponse) - 1, SendFlags);
+		}
+
+		while (pending.size() - (headerEnd + 4) < contentLength)
+		{
+			char buffer[16 * 1024];
+			auto received = ::recv(socket, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+			{
+				return std::nullopt;
+			}
+			pending.append(buffer, static_cast<std::size_t>(received));
+		}
+
+		request.body = pending.substr(headerEnd + 4, contentLength);
+		pending.erase(0, headerEnd + 4 + contentLength);
+		return request;
+	}
+
+	inline bool SendAll(int socket, const std::string& data)
+	{
+		std::size_t sent = 0;
+		while (sent < data.size())
+		{
+			auto written = ::send(socket, data.data() + sent, data.size() - sent, SendFlags);
+			if (written <= 0)
+			{
+				return false;
+			}
+			sent += static_cast<std::size_t>(written);
+		}
+		return true;
+	}
+
+	inline const char* ReasonPhrase(int status)
+	{
+		switch (status)
+		{
+		case 200: return "OK";
+		case 204: return "No Content";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 404: return "Not Found";
+		case 409: return "Conflict";
+		case 429: return "Too Many Requests";
+		case 500: return "Internal Server Error";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		default: return "Status";
+		}
+	}
+
+	inline std::string Base64(const unsigned char* data, std::size_t length)
+	{
+		std::string encoded(4 * ((length + 2) / 3), '\0');
+		auto written = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded.data()), data, static_cast<int>(length));
+		encoded.resize(static_cast<std::size_t>(written));
+		return encoded;
+	}
+
+	inline std::string IsoTime(std::time_t time)
+	{
+		std::tm utc{};
+		gmtime_r(&time, &utc);
+		char buffer[32];
+		return std::string(buffer, std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc));
+	}
+
+	class Server
+	{
+	public:
+		struct Route
+		{
+			std::string method;
+			std::vector<std::string> segments; ///< Path split at '/', "{name}" segments capture
+			int status{ 200 };
+			std::chrono::milliseconds latency{ 0 };
+			std::string bodyTemplate;
+		};
+
+		struct Counters
+		{
+			std::uint64_t requests{ 0 };
+			std::uint64_t unmatched{ 0 };
+		};
+
+		explicit Server(const std::string& routesPath)
+		{
+			std::ifstream input(routesPath);
+			if (!input)
+			{
+				throw std::runtime_error("Failed to open the routes file " + routesPath);
+			}
+			auto routes = nlohmann::json::parse(input);
+
+			leaseSeconds_ = routes.value("leaseSeconds", 3600);
+			if (routes.contains("signature"))
+			{
+				signatureHeader_ = routes["signature"].value("header", std::string());
+			}
+			baseFeatures_ = routes.value("features", nlohmann::json::array());
+			features_ = baseFeatures_.dump();
+			for (const auto& entry : routes.at("routes"))
+			{
+				Route route;
+				route.method = entry.at("method").get<std::string>();
+				route.segments = Split(entry.at("path").get<std::string>());
+				route.status = entry.value("status", 200);
+				route.latency = std::chrono::milliseconds(entry.value("latencyMs", 0));
+				route.bodyTemplate = entry.contains("body") ? entry["body"].dump() : std::string();
+				routes_.push_back(std::move(route));
+			}
+
+			GenerateKey();
+		}
+
+		~Server()
+		{
+			stop();
+			EVP_PKEY_free(key_);
+		}
+
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// Listens on 127.0.0.1, port 0 picks a free port
+		void start(std::uint16_t port = 0)
+		{
+			listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+			if (listener_ < 0)
+			{
+				throw std::runtime_error("Failed to create the listening socket");
+			}
+			int reuse = 1;
+			::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			address.sin_port = htons(port);
+			if (::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener_, 128) != 0)
+			{
+				::close(listener_);
+				throw std::runtime_error("Failed to listen on 127.0.0.1:" + std::to_string(port));
+			}
+
+			socklen_t length = sizeof(address);
+			::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+			port_ = ntohs(address.sin_port);
+
+			running_ = true;
+			acceptThread_ = std::thread([this]() { acceptLoop(); });
+		}
+
+		void stop()
+		{
+			if (!running_.exchange(false))
+			{
+				return;
+			}
+			::shutdown(listener_, SHUT_RDWR);
+			::close(listener_);
+			acceptThread_.join();
+
+			std::map<std::uint64_t, std::thread> connections;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (int socket : sockets_)
+				{
+					::shutdown(socket, SHUT_RDWR);
+				}
+				connections.swap(connections_);
+				finished_.clear();
+			}
+			for (auto& [id, connection] : connections)
+			{
+				connection.join();
+			}
+		}
+
+		std::uint16_t port() const
+		{
+			return port_;
+		}
+
+		std::string url() const
+		{
+			return "http://127.0.0.1:" + std::to_string(port_);
+		}
+
+		// Base64 of the big-endian modulus of the signing key
+		const std::string& modulus() const
+		{
+			return modulus_;
+		}
+
+		// Number of synthetic features appended to the features of the routes file
+		void setGeneratedFeatures(std::size_t count)
+		{
+			auto features = baseFeatures_;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				features.push_back({
+					{ "key", "generated.feature." + std::to_string(i) },
+					{ "type", i % 2 == 0 ? "Bool" : "ElementPool" },
+					{ "active", 0 },
+					{ "available", i % 2 == 0 ? nlohmann::json(nullptr) : nlohmann::json(100) },
+					{ "total", i % 2 == 0 ? nlohmann::json(nullptr) : nlohmann::json(100) },
+					});
+			}
+			std::lock_guard<std::mutex> lock(mutex_);
+			features_ = features.dump();
+		}
+
+		Counters counters() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return counters_;
+		}
+
+	private:
+		static std::vector<std::string> Split(const std::string& path)
+		{
+			std::vector<std::string> segments;
+			std::size_t start = 0;
+			auto end = path.find('?');
+			auto trimmed = path.substr(0, end);
+			while (start <= trimmed.size())
+			{
+				auto slash = trimmed.find('/', start);
+				if (slash == std::string::npos)
+				{
+					slash = trimmed.size();
+				}
+				if (slash > start)
+				{
+					segments.push_back(trimmed.substr(start, slash - start));
+				}
+				start = slash + 1;
+			}
+			return segments;
+		}
+
+		static void Replace(std::string& text, const std::string& token, const std::string& value)
+		{
+			for (auto position = text.find(token); position != std::string::npos; position = text.find(token, position + value.size()))
+			{
+				text.replace(position, token.size(), value);
+			}
+		}
+
+		void GenerateKey()
+		{
+			auto* context = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+			if (!context || EVP_PKEY_keygen_init(context) <= 0 || EVP_PKEY_CTX_set_rsa_keygen_bits(context, 2048) <= 0
+				|| EVP_PKEY_keygen(context, &key_) <= 0)
+			{
+				EVP_PKEY_CTX_free(context);
+				throw std::runtime_error("Failed to generate the signing key");
+			}
+			EVP_PKEY_CTX_free(context);
+
+			BIGNUM* modulus = nullptr;
+			EVP_PKEY_get_bn_param(key_, "n", &modulus);
+			std::vector<unsigned char> bytes(static_cast<std::size_t>(BN_num_bytes(modulus)));
+			BN_bn2bin(modulus, bytes.data());
+			BN_free(modulus);
+			modulus_ = Base64(bytes.data(), bytes.size());
+		}
+
+		std::string sign(const std::string& body) const
+		{
+			auto* context = EVP_MD_CTX_new();
+			std::size_t length = 0;
+			std::vector<unsigned char> signature;
+			if (EVP_DigestSignInit(context, nullptr, EVP_sha256(), nullptr, key_) > 0
+				&& EVP_DigestSign(context, nullptr, &length, reinterpret_cast<const unsigned char*>(body.data()), body.size()) > 0)
+			{
+				signature.resize(length);
+				EVP_DigestSign(context, signature.data(), &length, reinterpret_cast<const unsigned char*>(body.data()), body.size());
+				signature.resize(length);
+			}
+			EVP_MD_CTX_free(context);
+			return Base64(signature.data(), signature.size());
+		}
+
+		// Bodies only change with the clock second, reusing the last signature keeps RSA out of most responses
+		std::string cachedSignature(const std::string& body)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (const auto& [signedBody, signature] : signatures_)
+				{
+					if (signedBody == body)
+					{
+						return signature;
+					}
+				}
+			}
+
+			auto signature = sign(body);
+			std::lock_guard<std::mutex> lock(mutex_);
+			signatures_[nextSignature_++ % signatures_.size()] = { body, signature };
+			return signature;
+		}
+
+		void acceptLoop()
+		{
+			while (running_)
+			{
+				int socket = ::accept(listener_, nullptr, nullptr);
+				if (socket < 0)
+				{
+					continue;
+				}
+				int noDelay = 1;
+				::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+				IgnoreSigpipe(socket);
+
+				std::vector<std::thread> finished;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (!running_)
+					{
+						::close(socket);
+						break;
+					}
+					finished = takeFinished();
+					sockets_.insert(socket);
+					auto id = nextConnection_++;
+					connections_.emplace(id, std::thread([this, socket, id]() { serve(socket, id); }));
+				}
+				for (auto& connection : finished)
+				{
+					connection.join();
+				}
+			}
+		}
+
+		// Called with mutex_ held. Threads of closed connections, joined by the accept loop so that a long run with
+		// many short connections does not keep one finished thread per connection around.
+		std::vector<std::thread> takeFinished()
+		{
+			std::vector<std::thread> finished;
+			for (auto id : finished_)
+			{
+				auto connection = connections_.find(id);
+				if (connection != connections_.end())
+				{
+					finished.push_back(std::move(connection->second));
+					connections_.erase(connection);
+				}
+			}
+			finished_.clear();
+			return finished;
+		}
+
+		void serve(int socket, std::uint64_t id)
+		{
+			std::string pending;
+			while (auto request = ReadRequest(socket, pending))
+			{
+				auto response = respond(*request);
+				if (!SendAll(socket, response))
+				{
+					break;
+				}
+				auto connection = request->header("Connection");
+				if (connection && *connection == "close")
+				{
+					break;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			sockets_.erase(socket);
+			::close(socket);
+			finished_.push_back(id);
+		}
+
+		std::string respond(const Request& request)
+		{
+			auto segments = Split(request.path);
+			for (const auto& route : routes_)
+			{
+				if (route.method != request.method || route.segments.size() != segments.size())
+				{
+					continue;
+				}
+
+				std::vector<std::pair<std::string, std::string>> parameters;
+				bool matches = true;
+				for (std::size_t i = 0; i < segments.size() && matches; ++i)
+				{
+					const auto& pattern = route.segments[i];
+					if (pattern.size() > 2 && pattern.front() == '{' && pattern.back() == '}')
+					{
+						parameters.emplace_back(pattern.substr(1, pattern.size() - 2), segments[i]);
+					}
+					else
+					{
+						matches = pattern == segments[i];
+					}
+				}
+				if (!matches)
+				{
+					continue;
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					++counters_.requests;
+				}
+				if (route.latency.count() > 0)
+				{
+					std::this_thread::sleep_for(route.latency);
+				}
+				return render(route, parameters);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				++counters_.requests;
+				++counters_.unmatched;
+			}
+			return Format(404, "{\"error\":\"No mock route for " + request.method + " " + request.path + "\"}", {});
+		}
+
+		std::string render(const Route& route, const std::vector<std::pair<std::string, std::string>>& parameters)
+		{
+			auto body = route.bodyTemplate;
+			auto now = std::time(nullptr);
+			Replace(body, "{{now}}", IsoTime(now));
+			Replace(body, "{{leaseExpiry}}", IsoTime(now + leaseSeconds_));
+			for (const auto& [name, value] : parameters)
+			{
+				Replace(body, "{{" + name + "}}", value);
+			}
+			if (body.find("\"{{json:features}}\"") != std::string::npos)
+			{
+				std::string features;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					features = features_;
+				}
+				Replace(body, "\"{{json:features}}\"", features);
+			}
+
+			std::string signature;
+			if (!signatureHeader_.empty())
+			{
+				signature = signatureHeader_ + ": " + cachedSignature(body) + "\r\n";
+			}
+			return Format(route.status, body, signature);
+		}
+
+		static std::string Format(int status, const std::string& body, const std::string& extraHeaders)
+		{
+			std::string response = "HTTP/1.1 " + std::to_string(status) + " " + ReasonPhrase(status) + "\r\n";
+			response += "Content-Type: application/json\r\n";
+			response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+			response += extraHeaders;
+			response += "\r\n";
+			response += body;
+			return response;
+		}
+
+		std::vector<Route> routes_;
+		int leaseSeconds_{ 3600 };
+		std::string signatureHeader_;
+		nlohmann::json baseFeatures_;
+		EVP_PKEY* key_{ nullptr };
+		std::string modulus_;
+
+		int listener_{ -1 };
+		std::uint16_t port_{ 0 };
+		std::atomic<bool> running_{ false };
+		std::thread acceptThread_;
+
+		mutable std::mutex mutex_;
+		std::set<int> sockets_;
+		std::map<std::uint64_t, std::thread> connections_;
+		std::vector<std::uint64_t> finished_;    ///< Connections whose thread is about to return
+		std::uint64_t nextConnection_{ 0 };
+		std::string features_;
+		std::array<std::pair<std::string, std::string>, 8> signatures_;
+		std::size_t nextSignature_{ 0 };
+		Counters counters_;
+	};
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ActivationConfig.hpp"
+
+// Chrome trace-event recording of licensing operations, storage access and console rendering, configured from
+// the Tracing section of appsettings.json. A Span records one complete event when it goes out of scope. The
+// event goes into a buffer owned by the recording thread, only a full buffer is handed to the writer thread,
+// which appends it to Tracing.FilePath. The file is a JSON array of trace events that Perfetto and
+// chrome://tracing open as is, also when the process died before the closing bracket was written.
+// With tracing disabled a span costs one atomic load.
+namespace Tracing
+{
+	namespace Categories
+	{
+		constexpr const char* Licensing = "licensing";
+		constexpr const char* Storage = "storage";
+		constexpr const char* Display = "display";
+	}
+
+	using Clock = std::chrono::steady_clock;
+	using Args = std::vector<std::pair<const char*, std::string>>;
+
+	struct Event
+	{
+		char phase{ 'X' };              ///< 'X' complete event, 'M' metadata
+		const char* category{ "" };
+		std::string name;
+		std::uint32_t thread{ 0 };      ///< Small sequential ID, stable for the life of the thread
+		Clock::time_point start;
+		Clock::duration duration{ 0 };
+		Args args;
+	};
+
+	namespace Detail
+	{
+		// Events recorded by one thread. Its mutex is only contended while a flush takes the events of a thread
+		// that is still recording.
+		struct ThreadBuffer
+		{
+			std::mutex mutex;
+			std::vector<Event> events;
+			std::uint32_t thread{ 0 };
+		};
+
+		inline std::int64_t ProcessId()
+		{
+#ifdef _WIN32
+			return static_cast<std::int64_t>(GetCurrentProcessId());
+#else
+			return static_cast<std::int64_t>(::getpid());
+#endif
+		}
+	}
+
+	class Tracer
+	{
+	public:
+		Tracer()
+			: epoch_(Clock::now())
+		{
+		}
+
+		Tracer(const Tracer&) = delete;
+		Tracer& operator=(const Tracer&) = delete;
+
+		// Only the first configuration that enables tracing takes effect, the trace file is not switched later
+		void configure(const ActivationConsole::TracingConfig& config)
+		{
+			if (!config.Enabled)
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(outputMutex_);
+				if (file_)
+				{
+					return;
+				}
+				file_ = std::make_unique<std::ofstream>(config.FilePath, std::ios::trunc);
+				if (!file_->is_open())
+				{
+					std::cerr << "Failed to open trace file " << config.FilePath << ", tracing is disabled." << '\n';
+					file_.reset();
+					return;
+				}
+
+				*file_ << "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << processId_ << ",\"tid\":0,\"args\":{\"name\":\"Activation.Console\"}}";
+			}
+
+			bufferEvents_ = static_cast<std::size_t>(std::max(config.BufferEvents, 1));
+			// Never joined, the tracer lives until the process exits
+			std::thread([this]() { writeFullBuffers(); }).detach();
+			enabled_.store(true, std::memory_order_release);
+		}
+
+		bool enabled() const
+		{
+			return enabled_.load(std::memory_order_acquire);
+		}
+
+		void record(Event event)
+		{
+			auto& buffer = current();
+			std::vector<Event> full;
+			{
+				std::lock_guard<std::mutex> lock(buffer.mutex);
+				event.thread = buffer.thread;
+				buffer.events.push_back(std::move(event));
+				if (buffer.events.size() < bufferEvents_)
+				{
+					return;
+				}
+				full.swap(buffer.events);
+				buffer.events.reserve(bufferEvents_);
+			}
+			handOver(std::move(full));
+		}
+
+		// Writes out every event recorded so far, including the partly filled buffers of running threads
+		void flush()
+		{
+			if (!enabled())
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (const auto& buffer : buffers_)
+				{
+					std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+					if (!buffer->events.empty())
+					{
+						full_.push_back(std::move(buffer->events));
+						buffer->events.clear();
+					}
+				}
+			}
+			writePending();
+
+			std::lock_guard<std::mutex> lock(outputMutex_);
+			file_->flush();
+		}
+
+		// Last flush at exit, events recorded after it are dropped
+		void close()
+		{
+			if (!enabled())
+			{
+				return;
+			}
+			flush();
+			enabled_.store(false, std::memory_order_relaxed);
+			{
+				// Spans still running hand their events over later, they must not land after the closing bracket
+				std::lock_guard<std::mutex> lock(mutex_);
+				closed_ = true;
+				full_.clear();
+			}
+
+			std::lock_guard<std::mutex> lock(outputMutex_);
+			*file_ << "\n]\n";
+			file_->flush();
+		}
+
+		double microsecondsSinceEpoch(Clock::time_point time) const
+		{
+			return std::chrono::duration<double, std::micro>(time - epoch_).count();
+		}
+
+	private:
+		// Registers the buffer of the calling thread on first use and hands its events over when the thread exits
+		class Registration
+		{
+		public:
+			explicit Registration(Tracer& tracer)
+				: tracer_(tracer), buffer_(std::make_shared<Detail::ThreadBuffer>())
+			{
+				buffer_->thread = tracer_.nextThread_.fetch_add(1, std::memory_order_relaxed);
+				buffer_->events.reserve(tracer_.bufferEvents_);
+				std::lock_guard<std::mutex> lock(tracer_.mutex_);
+				tracer_.buffers_.push_back(buffer_);
+			}
+
+			~Registration()
+			{
+				tracer_.retire(buffer_);
+			}
+
+			Detail::ThreadBuffer& buffer()
+			{
+				return *buffer_;
+			}
+
+		private:
+			Tracer& tracer_;
+			std::shared_ptr<Detail::ThreadBuffer> buffer_;
+		};
+
+		Detail::ThreadBuffer& current()
+		{
+			thread_local Registration registration(*this);
+			return registration.buffer();
+		}
+
+		void retire(const std::shared_ptr<Detail::ThreadBuffer>& buffer)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buffer), buffers_.end());
+				std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+				if (!buffer->events.empty() && !closed_)
+				{
+					full_.push_back(std::move(buffer->events));
+				}
+			}
+			wake_.notify_one();
+		}
+
+		void handOver(std::vector<Event> events)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (closed_)
+				{
+					return;
+				}
+				full_.push_back(std::move(events));
+			}
+			wake_.notify_one();
+		}
+
+		void writeFullBuffers()
+		{
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					wake_.wait(lock, [this]() { return !full_.empty(); });
+				}
+				writePending();
+			}
+		}
+
+		// Held across taking and writing the batch, a flush returns only after the writer thread wrote its batch
+		void writePending()
+		{
+			std::lock_guard<std::mutex> outputLock(outputMutex_);
+			std::vector<std::vector<Event>> pending;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				pending.swap(full_);
+				if (closed_)
+				{
+					return;
+				}
+			}
+			if (pending.empty())
+			{
+				return;
+			}
+
+			// Formatted by hand, building a json object per event would make the writer the slowest part of tracing
+			std::string text;
+			for (const auto& events : pending)
+			{
+				for (const auto& event : events)
+				{
+					append(text, event);
+				}
+			}
+
+			file_->write(text.data(), static_cast<std::streamsize>(text.size()));
+		}
+
+		void append(std::string& text, const Event& event) const
+		{
+			char numbers[96];
+			text += ",\n{\"name\":";
+			AppendQuoted(text, event.name);
+			text += ",\"cat\":";
+			AppendQuoted(text, event.category);
+			text += ",\"ph\":\"";
+			text += event.phase;
+			std::snprintf(numbers, sizeof(numbers), "\",\"ts\":%.3f,\"pid\":%lld,\"tid\":%u",
+				microsecondsSinceEpoch(event.start), static_cast<long long>(processId_), static_cast<unsigned>(event.thread));
+			text += numbers;
+			if (event.phase == 'X')
+			{
+				std::snprintf(numbers, sizeof(numbers), ",\"dur\":%.3f", std::chrono::duration<double, std::micro>(event.duration).count());
+				text += numbers;
+			}
+			if (!event.args.empty())
+			{
+				text += ",\"args\":{";
+				for (std::size_t i = 0; i < event.args.size(); ++i)
+				{
+					if (i > 0)
+					{
+						text += ',';
+					}
+					AppendQuoted(text, event.args[i].first);
+					text += ':';
+					AppendQuoted(text, event.args[i].second);
+				}
+				text += '}';
+			}
+			text += '}';
+		}
+
+		static void AppendQuoted(std::string& text, const std::string& value)
+		{
+			text += '"';
+			for (char ch : value)
+			{
+				switch (ch)
+				{
+				case '"': text += "\\\""; break;
+				case '\\': text += "\\\\"; break;
+				case '\n': text += "\\n"; break;
+				case '\r': text += "\\r"; break;
+				case '\t': text += "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(ch) < 0x20)
+					{
+						char escaped[8];
+						std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(ch)));
+						text += escaped;
+					}
+					else
+					{
+						text += ch;
+					}
+				}
+			}
+			text += '"';
+		}
+
+		const Clock::time_point epoch_;
+		const std::int64_t processId_{ Detail::ProcessId() };
+		std::atomic<bool> enabled_{ false };
+		std::atomic<std::uint32_t> nextThread_{ 1 };
+		std::size_t bufferEvents_{ 1024 };
+
+		// Registered buffers and the full ones waiting for the writer thread
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::vector<std::shared_ptr<Detail::ThreadBuffer>> buffers_;
+		std::vector<std::vector<Event>> full_;
+		bool closed_{ false };    ///< Set by close(), events handed over afterwards are dropped
+
+		std::mutex outputMutex_;
+		std::unique_ptr<std::ofstream> file_;
+	};
+
+	// Never destroyed, threads that exit during static destruction still hand their events over
+	inline Tracer& Instance()
+	{
+		static auto* tracer = new Tracer();
+		return *tracer;
+	}
+
+	// Call once at startup, before other threads record spans
+	inline void Configure(const ActivationConsole::TracingConfig& config)
+	{
+		Instance().configure(config);
+		if (Instance().enabled())
+		{
+			std::atexit([]() { Instance().close(); });
+		}
+	}
+
+	inline bool Enabled()
+	{
+		return Instance().enabled();
+	}
+
+	inline void Flush()
+	{
+		Instance().flush();
+	}
+
+	// Writes the remaining events and ends the trace file, spans recorded afterwards are dropped
+	inline void Close()
+	{
+		Instance().close();
+	}
+
+	// Shown in the trace viewer instead of the thread ID
+	inline void NameThread(const char* name)
+	{
+		if (!Enabled())
+		{
+			return;
+		}
+		Event event;
+		event.phase = 'M';
+		event.name = "thread_name";
+		event.category = "__metadata";
+		event.start = Clock::now();
+		event.args.emplace_back("name", name);
+		Instance().record(std::move(event));
+	}
+
+	// Records the time from construction to destruction as one complete event on the calling thread
+	class Span
+	{
+	public:
+		Span(const char* category, const char* name)
+			: active_(Enabled())
+		{
+			if (active_)
+			{
+				event_.category = category;
+				event_.name = name;
+				event_.start = Clock::now();
+			}
+		}
+
+		Span(const char* category, const std::string& name)
+			: active_(Enabled())
+		{
+			if (active_)
+			{
+				event_.category = category;
+				event_.name = name;
+				event_.start = Clock::now();
+			}
+		}
+
+		~Span()
+		{
+			if (active_)
+			{
+				event_.duration = Clock::now() - event_.start;
+				Instance().record(std::move(event_));
+			}
+		}
+
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+
+		// False while tracing is disabled, callers skip formatting their arguments
+		bool active() const
+		{
+			return active_;
+		}
+
+		Clock::time_point start() const
+		{
+			return event_.start;
+		}
+
+		void arg(const char* key, std::string value)
+		{
+			if (active_)
+			{
+				event_.args.emplace_back(key, std::move(value));
+			}
+		}
+
+	private:
+		bool active_;
+		Event event_;
+	};
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "IActivationStorage.hpp"
+#include "Logger.hpp"
+#include "PersistentData.hpp"
+#include "ShutdownHooks.hpp"
+#include "StorageHelpers.hpp"
+#include "Tracer.hpp"
+
+using namespace ZentitleLicensingClient;
+
+// Write-behind decorator that coalesces bursts of saves into a single write.
+// A save only records the latest state, a background thread persists it once the debounce window
+// that started with the first unsaved change has elapsed. Loads see the pending state immediately.
+// The state is written to a staging storage first and then renamed over the target file, so a crash
+// in the middle of a write leaves the previous file intact.
+// Pending state is flushed on flush(), clear(), destruction and on termination signals.
+class WriteBehindActivationStorage : public Persistence::Storage::IActivationStorage
+{
+public:
+	struct Statistics
+	{
+		std::uint64_t savesRequested{ 0 };
+		std::uint64_t writesPerformed{ 0 };
+		std::uint64_t writeFailures{ 0 };
+	};
+
+	WriteBehindActivationStorage(
+		std::shared_ptr<Persistence::Storage::IActivationStorage> target,
+		std::shared_ptr<Persistence::Storage::IActivationStorage> staging,
+		std::chrono::milliseconds debounce)
+		: target_(std::move(target)), staging_(std::move(staging)), debounce_(debounce)
+	{
+		writer_ = std::thread([this]() { run(); });
+		shutdownHookId_ = ShutdownHooks::Register([this]() { flush(); });
+	}
+
+	~WriteBehindActivationStorage() override
+	{
+		ShutdownHooks::Unregister(shutdownHookId_);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wakeWriter_.notify_all();
+		writer_.join();
+	}
+
+	WriteBehindActivationStorage(const WriteBehindActivationStorage&) = delete;
+	WriteBehindActivationStorage& operator=(const WriteBehindActivationStorage&) = delete;
+
+	std::string storageId() const override
+	{
+		return target_->storageId();
+	}
+
+	std::future<void> save(const Persistence::PersistentData& data) override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			++statistics_.savesRequested;
+			pending_ = data;
+			if (!deadline_)
+			{
+				deadline_ = std::chrono::steady_clock::now() + debounce_;
+			}
+		}
+		wakeWriter_.notify_all();
+
+		std::promise<void> saved;
+		saved.set_value();
+		return saved.get_future();
+	}
+
+	std::future<Persistence::PersistentData> load() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (pending_)
+			{
+				return StorageHelpers::MakeReadyFuture(*pending_);
+			}
+			if (inFlight_)
+			{
+				return StorageHelpers::MakeReadyFuture(*inFlight_);
+			}
+		}
+		return target_->load();
+	}
+
+	std::future<void> clear() override
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			// Drop unsaved state so it cannot resurrect the activation after the clear
+			pending_.reset();
+			deadline_.reset();
+			writeFinished_.wait(lock, [this]() { return !inFlight_; });
+		}
+		return target_->clear();
+	}
+
+	// Blocks until every save issued so far is on disk
+	void flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (pending_)
+		{
+			deadline_ = std::chrono::steady_clock::now();
+			wakeWriter_.notify_all();
+		}
+		writeFinished_.wait(lock, [this]() { return !pending_ && !inFlight_; });
+	}
+
+	Statistics statistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return statistics_;
+	}
+
+private:
+	void run()
+	{
+		Tracing::NameThread("Write-behind storage");
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			if (!pending_)
+			{
+				if (stopping_)
+				{
+					return;
+				}
+				wakeWriter_.wait(lock);
+				continue;
+			}
+
+			if (!stopping_ && std::chrono::steady_clock::now() < *deadline_)
+			{
+				wakeWriter_.wait_until(lock, *deadline_);
+				continue;
+			}
+
+			inFlight_ = std::move(pending_);
+			pending_.reset();
+			deadline_.reset();
+
+			lock.unlock();
+			bool written = write(*inFlight_);
+			lock.lock();
+
+			++statistics_.writesPerformed;
+			if (!written)
+			{
+				++statistics_.writeFailures;
+			}
+			inFlight_.reset();
+			writeFinished_.notify_all();
+		}
+	}
+
+	bool write(const Persistence::PersistentData& data)
+	{
+		Tracing::Span span(Tracing::Categories::Storage, "Storage.Write");
+		span.arg("staged", useDirectWrites_ ? "false" : "true");
+		try
+		{
+			if (!useDirectWrites_)
+			{
+				std::filesystem::path stagingPath = staging_->storageId();
+				std::filesystem::path targetPath = target_->storageId();
+
+				staging_->save(data).get();
+				StorageHelpers::ReplaceFileAtomically(stagingPath, targetPath);
+
+				if (!renameVerified_)
+				{
+					// The renamed file must still be readable through the target storage, otherwise
+					// fall back to writing the target directly from now on
+					bool readable;
+					try
+					{
+						readable = target_->load().get().isEmpty() == data.isEmpty();
+					}
+					catch (const std::exception&)
+					{
+						readable = false;
+					}
+					if (!readable)
+					{
+						Log::Warning(Log::Categories::Storage, "Staged activation storage file could not be read back after rename, using direct writes");
+						useDirectWrites_ = true;
+						target_->save(data).get();
+					}
+					renameVerified_ = true;
+				}
+				return true;
+			}
+
+			target_->save(data).get();
+			return true;
+		}
+		catch (const std::exception& e)
+		{
+			Log::Error(Log::Categories::Storage, "Failed to persist activation data", { { "error", e.what() } });
+			return false;
+		}
+	}
+
+	std::shared_ptr<Persistence::Storage::IActivationStorage> target_;
+	std::shared_ptr<Persistence::Storage::IActivationStorage> staging_;
+	const std::chrono::milliseconds debounce_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable wakeWriter_;
+	std::condition_variable writeFinished_;
+	std::optional<Persistence::PersistentData> pending_;
+	std::optional<Persistence::PersistentData> inFlight_;
+	std::optional<std::chrono::steady_clock::time_point> deadline_;
+	bool stopping_{ false };
+	Statistics statistics_;
+
+	// Only touched by the writer thread
+	bool renameVerified_{ false };
+	bool useDirectWrites_{ false };
+
+	std::size_t shutdownHookId_{ 0 };
+	std::thread writer_;
+};
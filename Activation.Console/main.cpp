@@ -1,5 +1,6 @@
 ﻿
 #include "DynamicLibraryLoader.hpp"
+#include "DeviceFingerprint.hpp"
 #include "OSMacros.hpp"
 #include "ActivationCodeCredentialsModel.hpp"
 #include "Activation.hpp"
@@ -9,11 +10,28 @@
 #include "LicenseStorage.hpp"
 #include "CoreLibraryManagerConfigProvider.hpp"
 #include "PromptHelper.hpp"
+#include "ShutdownHooks.hpp"
+#include "SharedActivationCoordinator.hpp"
+#include "LicensingAgent.hpp"
+#include "LicensingCall.hpp"
+#include "FlightRecorder.hpp"
+#include "Logger.hpp"
+#include "Tracer.hpp"
+#include "AllocationTracker.hpp"
+#include "RequestCoalescer.hpp"
+#include "ShutdownDrain.hpp"
+#include "Provisioning.hpp"
+#include "SeatPool.hpp"
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <vector>
 
@@ -26,37 +44,44 @@ void handleExceptions(const std::function<void()>& func)
 {
 	using namespace ZentitleLicensingClient;
 
+	// Printed, and kept in the flight recorder after the console output is gone
+	auto report = [](const std::string& message)
+		{
+			Log::Error(Log::Categories::Console, message);
+			FlightRecorder::Error(message);
+		};
+
 	try
 	{
 		func();
 	}
 	catch (const CommandExecutorException& e)
 	{
-		std::cerr << "CommandExecutorException: " << e.what() << std::endl;
+		report(std::string("CommandExecutorException: ") + e.what());
 	}
 	catch (const HttpRequestException& e)
 	{
-		std::cerr << "HttpRequestException: " << e.what() << std::endl;
+		report(std::string("HttpRequestException: ") + e.what());
 	}
 	catch (const DataValidationException& e)
 	{
-		std::cerr << "DataValidationException: " << e.what() << std::endl;
+		report(std::string("DataValidationException: ") + e.what());
 	}
 	catch (const StateException& e)
 	{
-		std::cerr << "StateException: " << e.what() << std::endl;
+		report(std::string("StateException: ") + e.what());
 	}
 	catch (const SDKException& e)
 	{
-		std::cerr << "SDKException: " << e.what() << std::endl;
+		report(std::string("SDKException: ") + e.what());
 	}
 	catch (const std::exception& e)
 	{
-		std::cerr << "An error occurred: " << e.what() << std::endl;
+		report(std::string("An error occurred: ") + e.what());
 	}
 	catch (...)
 	{
-		std::cerr << "An unknown error occurred." << std::endl;
+		report("An unknown error occurred.");
 	}
 }
 
@@ -66,10 +91,70 @@ unsigned long long randomize()
 	return gen();
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+	// --agent: serve the activation to local clients over a Unix domain socket instead of the interactive menu
+	// --seat-pool: keep SeatPool.Size seats activated for workers instead of the interactive menu
+	// --pooled-seat: lease a seat from the pool instead of activating one
+	// --provision <manifest>: activate every seat of the manifest and exit, see Provisioning.hpp
+	// --dump-flight-recorder [file]: print the flight recorder of the storage folder, or of the given file, and exit
+	bool agentMode = false;
+	bool seatPoolMode = false;
+	bool pooledSeatMode = false;
+	bool provisionMode = false;
+	bool dumpFlightRecorder = false;
+	std::string manifestPath;
+	std::string flightRecorderPath;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--agent")
+		{
+			agentMode = true;
+		}
+		else if (std::string(argv[i]) == "--seat-pool")
+		{
+			seatPoolMode = true;
+		}
+		else if (std::string(argv[i]) == "--pooled-seat")
+		{
+			pooledSeatMode = true;
+		}
+		else if (std::string(argv[i]) == "--provision" && i + 1 < argc)
+		{
+			provisionMode = true;
+			manifestPath = argv[++i];
+		}
+		else if (std::string(argv[i]) == "--dump-flight-recorder")
+		{
+			dumpFlightRecorder = true;
+			if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+			{
+				flightRecorderPath = argv[++i];
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argv[i] << '\n';
+			std::cerr << "Usage: " << argv[0] << " [--agent | --seat-pool | --pooled-seat | --provision <manifest> | --dump-flight-recorder [file]]" << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (agentMode + seatPoolMode + pooledSeatMode + provisionMode + dumpFlightRecorder > 1)
+	{
+		std::cerr << "--agent, --seat-pool, --pooled-seat, --provision and --dump-flight-recorder cannot be combined." << '\n';
+		return EXIT_FAILURE;
+	}
+
+#ifdef _WIN32
+	if (agentMode)
+	{
+		std::cerr << "Agent mode is only supported on Linux and macOS." << '\n';
+		return EXIT_FAILURE;
+	}
+#endif
+
 	std::string currentPath = std::filesystem::current_path().string();
-	constexpr int fingerprintOptionDefault = 1 << 0;
 
 #ifdef ZEN_WIN64
 #ifdef _DEBUG
@@ -81,12 +166,80 @@ int main()
 #endif
 
 	ActivationConsole::ActivationConfig config = ActivationConsole::LoadConfiguration(configPath);
+	Log::Configure(config.Logging);
+
+	const auto flightRecorderDirectory = LicenseStorage::StorageDirectory(config.Storage.Scope);
+	if (dumpFlightRecorder)
+	{
+		try
+		{
+			FlightRecorder::Dump(flightRecorderPath.empty() ? flightRecorderDirectory / FlightRecorder::FileName : std::filesystem::path(flightRecorderPath), std::cout);
+			return EXIT_SUCCESS;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Failed to read the flight recorder: " << e.what() << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!FlightRecorder::Open(flightRecorderDirectory, agentMode ? "agent" : seatPoolMode ? "seat pool manager" : pooledSeatMode ? "pooled seat" : provisionMode ? "provisioning" : "interactive",
+		LicenseStorage::FileMode(config.Storage.Scope)))
+	{
+		Log::Warning(Log::Categories::Console, "Failed to open the flight recorder, state changes and errors are not recorded.");
+	}
+	Tracing::Configure(config.Tracing);
+	Tracing::NameThread("Console");
+	LicensingCall::Configure(config.Deadlines);
+	auto rateLimits = config.RateLimits;
+	if (provisionMode && config.Provisioning.RequestsPerSecond > 0
+		&& (rateLimits.RequestsPerSecond <= 0 || config.Provisioning.RequestsPerSecond < rateLimits.RequestsPerSecond))
+	{
+		// The provisioning workers share the limiter of the process, the lower of the two rates applies
+		rateLimits.RequestsPerSecond = config.Provisioning.RequestsPerSecond;
+		rateLimits.Burst = std::max(1.0, std::min(rateLimits.Burst, config.Provisioning.RequestsPerSecond));
+	}
+	LicensingCall::Configure(rateLimits);
+	// Registered first so they run last, after every other hook logged its outcome and recorded its spans
+	ShutdownHooks::Register([]() { Tracing::Close(); });
+	ShutdownHooks::Register([]() { FlightRecorder::Flush(); });
+	ShutdownHooks::Register([]() { Log::Flush(); });
+	ShutdownHooks::InstallSignalHandlers();
 	std::string seatId = "";
+	const bool machineWide = config.Storage.Scope == ActivationConsole::StorageScope::Machine;
 
+	// Pooled seats have their own license files, which needs the core library, and are never shared
+	if ((seatPoolMode || pooledSeatMode) && (!config.UseCoreLibrary || machineWide))
+	{
+		std::cerr << "The seat pool requires the core library and the user storage scope." << '\n';
+		return EXIT_FAILURE;
+	}
+
+	// Every provisioned seat has its own license file as well
+	if (provisionMode && !config.UseCoreLibrary)
+	{
+		std::cerr << "Provisioning requires the core library." << '\n';
+		return EXIT_FAILURE;
+	}
+
+	const auto seatPoolDirectory = LicenseStorage::StorageDirectory(config.Storage.Scope) / SeatPool::DirectoryName;
+	std::unique_ptr<SeatPool::Lease> seatLease;
+	if (pooledSeatMode)
+	{
+		auto leaseBegin = std::chrono::steady_clock::now();
+		seatLease = SeatPool::Lease::Acquire(seatPoolDirectory, LicenseStorage::FileMode(config.Storage.Scope));
+		if (!seatLease)
+		{
+			std::cerr << "No ready seat in " << seatPoolDirectory.string() << ", is the seat pool manager (--seat-pool) running?" << '\n';
+			return EXIT_FAILURE;
+		}
+		Log::Information(Log::Categories::Console, "- Leased pooled seat " + seatLease->seatId() + " in "
+			+ std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - leaseBegin).count()) + " us");
+	}
 
 	if (config.UseCoreLibrary)
 	{
-		std::cout << "- Using Zentitle2Core C++ library for secure license storage and offline activation operations" << std::endl;
+		Log::Information(Log::Categories::Console, "- Using Zentitle2Core C++ library for secure license storage and offline activation operations");
 
 		std::unique_ptr<helpers::DynamicLibraryLoader> loader;
 
@@ -96,26 +249,40 @@ int main()
 		}
 		else
 		{
-			std::cerr << "No path to the core library provided. Please provide a valid path in the configuration file." << std::endl;
+			std::cerr << "No path to the core library provided. Please provide a valid path in the configuration file." << '\n';
 			return EXIT_FAILURE;
 		}
 
-		if (Confirm([](ConfirmOptions& o) { o.Message = "Use device fingerprint for seat ID generation?"; }))
+		if (seatLease)
 		{
-			const auto loadedFunction = loader->get_function<int32_t(char*, int*, int)>("generateDeviceFingerprint");
-
-			const static unsigned int DeviceFingerprintMaxLength = 128;
-			std::array<char, DeviceFingerprintMaxLength> generatedDeviceFingerprint = {};
-			int length = 0;
-
-			const int32_t retValue = loadedFunction(generatedDeviceFingerprint.data(), &length, fingerprintOptionDefault);
+			seatId = seatLease->seatId();
+		}
+		else if (seatPoolMode || provisionMode)
+		{
+			// Every pooled seat gets its own seat ID, provisioned seats take theirs from the manifest
+		}
+		// A machine-wide activation only works if every process on the host ends up with the same seat,
+		// the agent runs unattended and must resume the seat it was activated with
+		else if (machineWide || agentMode)
+		{
+			auto fingerprint = DeviceFingerprint::Generate(*loader);
+			if (!fingerprint)
+			{
+				return EXIT_FAILURE;
+			}
 
-			if (retValue != 0 || length < 0 || static_cast<std::size_t>(length) > generatedDeviceFingerprint.size())
+			seatId = *fingerprint;
+			Log::Information(Log::Categories::Console, std::string("- ") + (machineWide ? "Machine-wide activation" : "Agent mode") + ", using device fingerprint as seat ID");
+		}
+		else if (Confirm([](ConfirmOptions& o) { o.Message = "Use device fingerprint for seat ID generation?"; }))
+		{
+			auto fingerprint = DeviceFingerprint::Generate(*loader);
+			if (!fingerprint)
 			{
 				return EXIT_FAILURE;
 			}
 
-			seatId = std::string(generatedDeviceFingerprint.data(), static_cast<std::size_t>(length));
+			seatId = *fingerprint;
 		}
 		else
 		{
@@ -127,7 +294,7 @@ int main()
 			}
 			else
 			{
-				std::cout << "Using manually entered seat ID: " << seatId << std::endl;
+				std::cout << "Using manually entered seat ID: " << seatId << '\n';
 			}
 
 		}
@@ -136,7 +303,7 @@ int main()
 	{
 		std::cout << "- Zentitle2Core C++ library usage is disabled in 'appsettings.json', it won't be loaded and offline activation won't work";
 		seatId = std::to_string(randomize());
-		std::cout << "Generated random seatId: " << seatId << std::endl;
+		std::cout << "Generated random seatId: " << seatId << '\n';
 	}
 
 
@@ -169,19 +336,245 @@ int main()
 	}
 	std::string libraryName = coreLibraryPath.filename().string();
 
-	options.setActivationStorage(LicenseStorage::Initialize(config.UseCoreLibrary, libraryDirectory, libraryName, LicenseStorage::DeletionPrompt::Ask));
+	CoreLibraryManagerConfigProvider configProvider(libraryDirectory, libraryName);
+
+	if (seatPoolMode)
+	{
+		int exitCode = EXIT_FAILURE;
+		handleExceptions([&]() {
+			auto manager = std::make_shared<SeatPool::Manager>(seatPoolDirectory, LicenseStorage::FileMode(config.Storage.Scope),
+				[&](const std::string& poolSeatId, const std::string& name)
+				{
+					auto seatOptions = options;
+					seatOptions.onlineActivationOptionsOpt->seatId = poolSeatId;
+					seatOptions.setActivationStorage(LicenseStorage::ForPooledSeat(libraryDirectory, libraryName, config.Storage.Scope, name));
+					return Activation::create(seatOptions, configProvider);
+				},
+				config.SeatPool);
+
+			// Same as for the agent, the hook may outlive run() on the signal thread
+			std::weak_ptr<SeatPool::Manager> stoppable = manager;
+			auto hook = ShutdownHooks::Register([stoppable]() {
+				if (auto running = stoppable.lock())
+				{
+					running->stop();
+				}
+				});
+			manager->run();
+			ShutdownHooks::Unregister(hook);
+			exitCode = EXIT_SUCCESS;
+			});
+		ShutdownHooks::RunAll();
+		return exitCode;
+	}
+
+	if (provisionMode)
+	{
+		int exitCode = EXIT_FAILURE;
+		handleExceptions([&]() {
+			auto rows = Provisioning::ReadManifest(manifestPath);
+			Provisioning::Checkpoint checkpoint(config.Provisioning.CheckpointFile.empty()
+				? std::filesystem::path(manifestPath + ".checkpoint")
+				: std::filesystem::path(config.Provisioning.CheckpointFile));
+			auto provisioner = std::make_shared<Provisioning::Provisioner>(std::move(rows),
+				[&](const Provisioning::Row& row)
+				{
+					auto seatOptions = options;
+					seatOptions.onlineActivationOptionsOpt->seatId = row.seatId;
+					seatOptions.setActivationStorage(LicenseStorage::ForProvisionedSeat(libraryDirectory, libraryName, config.Storage.Scope,
+						Provisioning::FolderName(row.seatId)));
+					return Activation::create(seatOptions, configProvider);
+				},
+				checkpoint, config.Provisioning);
+
+			// A signal stops handing out rows, the rows in flight still finish and make it into the checkpoint
+			std::weak_ptr<Provisioning::Provisioner> stoppable = provisioner;
+			auto hook = ShutdownHooks::Register([stoppable]() {
+				if (auto running = stoppable.lock())
+				{
+					running->stop();
+				}
+				});
+			auto report = provisioner->run();
+			ShutdownHooks::Unregister(hook);
+
+			Provisioning::WriteReport(std::cout, report, checkpoint.path());
+			exitCode = report.failures.empty() && report.notStarted == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+			});
+		ShutdownHooks::RunAll();
+		return exitCode;
+	}
+
+	// The shared activation of other processes and the activation the agent serves must never be deleted from
+	// here, a pooled seat is deactivated by the seat pool manager once this process released it
+	auto storage = seatLease
+		? LicenseStorage::ForPooledSeat(libraryDirectory, libraryName, config.Storage.Scope, seatLease->name())
+		: LicenseStorage::Initialize(config.UseCoreLibrary, libraryDirectory, libraryName,
+			machineWide || agentMode ? LicenseStorage::DeletionPrompt::Keep : LicenseStorage::DeletionPrompt::Ask, config.Storage);
+	options.setActivationStorage(storage);
 
 
 	// Create Activation Instance
-	CoreLibraryManagerConfigProvider configProvider(libraryDirectory, libraryName);
 	std::shared_ptr<Activation> activation = Activation::create(options, configProvider);
 
-	std::cout << "Activation instance created." << std::endl;
-	handleExceptions([&]() {
-		ActivationActions::Initialize(*activation);
-		});
+	Log::Information(Log::Categories::Console, "Activation instance created.");
 
-	std::cout << "Activation initialized." << std::endl;
+	// Offline-first: a persisted lease that stays valid long enough is used right away, initialize() reconciles
+	// with the server in the background. Shared and agent activations always initialize first, a pooled seat
+	// always starts offline-first because the seat pool manager keeps its lease fresh.
+	auto startupBegin = std::chrono::steady_clock::now();
+	std::shared_ptr<const ActivationSnapshot> persistedSnapshot;
+	if ((config.Startup.OfflineFirst || seatLease) && !machineWide && !agentMode)
+	{
+		persistedSnapshot = ActivationActions::LoadValidPersistedState(*storage, seatId, config.Startup.MinimumLeaseRemainingSeconds);
+	}
+
+	// Readers use the published snapshot, it is replaced after every change of the activation
+	std::shared_ptr<ActivationSnapshots> snapshots;
+	std::optional<std::shared_future<void>> pendingInitialize;
+	bool initializeAbandoned = false;
+	if (persistedSnapshot)
+	{
+		pendingInitialize = std::async(std::launch::async, [activation]()
+			{
+				LicensingCall::Admit(LicensingCall::Operations::Initialize);
+				activation->initialize().get();
+			}).share();
+		snapshots = std::make_shared<ActivationSnapshots>(activation, persistedSnapshot);
+		Log::Information(Log::Categories::Console, "Licensed from the persisted state in "
+			+ std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startupBegin).count())
+			+ " ms, lease valid until " + ActivationActions::FormatDateTime(*persistedSnapshot->info.leaseExpiry)
+			+ ". Initializing in the background.");
+	}
+	else
+	{
+		// The startup counts as one action, the initialization and the wait below share its latency budget
+		LicensingCall::BudgetScope startupBudget;
+		handleExceptions([&]() {
+			pendingInitialize = ActivationActions::Initialize(*activation);
+			});
+
+		if (pendingInitialize && (machineWide || agentMode))
+		{
+			// The shared activation and the agent read the activation right away, they wait for the initialization
+			// until the budget is spent and give up without an initialized activation
+			Log::Information(Log::Categories::Console, "Waiting for the initialization to finish...");
+			const auto& budget = LicensingCall::CurrentBudget();
+			if (budget && pendingInitialize->wait_until(*budget) != std::future_status::ready)
+			{
+				Log::Error(Log::Categories::Console, "The initialization did not finish within Deadlines.LatencyBudgetMs, exiting.");
+				return EXIT_FAILURE;
+			}
+			pendingInitialize->wait();
+			pendingInitialize.reset();
+		}
+
+		if (pendingInitialize)
+		{
+			// Not read until the initialization that missed its deadline finished, see finishInitialize
+			initializeAbandoned = true;
+			snapshots = std::make_shared<ActivationSnapshots>(activation, ActivationSnapshot::Initializing());
+		}
+		else
+		{
+			Log::Information(Log::Categories::Console, "Activation initialized.");
+			snapshots = std::make_shared<ActivationSnapshots>(activation);
+		}
+	}
+	ActivationActions::PublishedSnapshots() = snapshots;
+
+	std::shared_ptr<RequestCoalescer> coalescer;
+	if (config.Coalescing.Enabled)
+	{
+		coalescer = std::make_shared<RequestCoalescer>(activation, LicenseStorage::StorageDirectory(config.Storage.Scope),
+			LicenseStorage::FileMode(config.Storage.Scope), config.Coalescing);
+		ActivationActions::Coalescer() = coalescer;
+	}
+
+	// Actions and the first real snapshot wait until the background initialization finished. One that missed its
+	// deadline keeps running on the activation, the persisted snapshot stays published until it completed.
+	auto finishInitialize = [&]() {
+		if (!pendingInitialize)
+		{
+			return;
+		}
+		if (!initializeAbandoned)
+		{
+			initializeAbandoned = !ActivationActions::AwaitInitialization(*pendingInitialize);
+		}
+		if (pendingInitialize->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			pendingInitialize.reset();
+			snapshots->refresh();
+		}
+		};
+
+	std::unique_ptr<SharedActivationCoordinator> sharedActivation;
+	if (machineWide)
+	{
+		sharedActivation = std::make_unique<SharedActivationCoordinator>(
+			activation, LicenseStorage::StorageDirectory(config.Storage.Scope), config.SharedActivation,
+			[snapshots]() { snapshots->refresh(); });
+		sharedActivation->start();
+	}
+
+	// Registered after the storage so its flush runs after the drain, and before the agent so the agent stops first
+	auto shutdownConfig = config.Shutdown;
+	if (machineWide && shutdownConfig.DeactivateOnExit)
+	{
+		// The seat is shared with the other processes on this host
+		Log::Warning(Log::Categories::Console, "Shutdown.DeactivateOnExit is ignored for machine-wide activations.");
+		shutdownConfig.DeactivateOnExit = false;
+	}
+	// Held around every SDK call of the actions, the agent and the drain
+	std::timed_mutex consoleActivationMutex;
+	std::timed_mutex& activationMutex = sharedActivation ? sharedActivation->activationMutex() : consoleActivationMutex;
+	auto drain = std::make_shared<ShutdownDrain>(activation, activationMutex, shutdownConfig);
+	ShutdownHooks::Register([drain]() { drain->run(); });
+
+#ifndef _WIN32
+	if (agentMode)
+	{
+		if (activation->getState() != ActivationState::Active)
+		{
+			Log::Warning(Log::Categories::Console, "The activation is not active, activate it in interactive mode first. Feature checks will be refused.");
+		}
+
+		std::string socketPath = config.Agent.SocketPath.empty()
+			? (LicenseStorage::StorageDirectory(config.Storage.Scope) / "agent.sock").string()
+			: config.Agent.SocketPath;
+
+		handleExceptions([&]() {
+			auto agent = std::make_shared<LicensingAgent>(activation,
+				activationMutex,
+				socketPath,
+				machineWide,
+				config.Agent,
+				[&]() {
+					if (sharedActivation)
+					{
+						sharedActivation->publish();
+					}
+				});
+
+			// The hook may still be running on the signal thread after run() returned, so it keeps the agent alive itself
+			std::weak_ptr<LicensingAgent> stoppable = agent;
+			auto hook = ShutdownHooks::Register([stoppable]() {
+				if (auto running = stoppable.lock())
+				{
+					running->stop();
+				}
+				});
+			agent->run();
+			ShutdownHooks::Unregister(hook);
+			});
+
+		// Drains the activation, then closes the trace and flushes the recorder and the log
+		ShutdownHooks::RunAll();
+
+		return EXIT_SUCCESS;
+	}
+#endif
 
 	// Main application loop
 	handleExceptions([&]() {
@@ -189,14 +582,38 @@ int main()
 
 		while (!quit)
 		{
-			auto state = activation->getState();
-			auto mode = activation->getActivationInfo().activationMode;
+			if (pendingInitialize && pendingInitialize->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				finishInitialize();
+			}
+			// The menu goes straight to std::cout, the messages of the last action come first
+			Log::Flush();
+			LicensingCall::ReportAbandoned(std::cout);
+
+			// The menu only reads the published snapshot, the activation itself is only touched under the activation
+			// lock while an action runs
+			auto snapshot = snapshots->current();
+			auto state = snapshot->state;
+			auto mode = snapshot->info.activationMode;
 
-			std::cout << "\nCurrent activation state: " << activation->getStateAsString() << std::endl;
+			std::cout << "\nCurrent activation state: " << snapshot->stateName << '\n';
 			std::cout << "Activation mode: "
-				<< (mode == ActivationMode::Online ? "Online" : "Offline") << std::endl;
+				<< (mode == ActivationMode::Online ? "Online" : "Offline") << '\n';
+
+			if (sharedActivation)
+			{
+				auto published = sharedActivation->readSnapshot();
+				std::cout << "Shared activation: "
+					<< (sharedActivation->isRefreshOwner() ? "this process owns lease refreshes" : "lease refreshes owned by another process");
+				if (published)
+				{
+					std::cout << " (last published by process " << published->publisherProcessId
+						<< " at " << DisplayHelper::timeToString(static_cast<std::time_t>(published->publishedAt)) << ")";
+				}
+				std::cout << '\n';
+			}
 
-			std::cout << "Available actions:" << std::endl;
+			std::cout << "Available actions:" << '\n';
 
 			auto actionMapping = std::find_if(ActivationActions::AvailableActions.begin(),
 				ActivationActions::AvailableActions.end(),
@@ -220,7 +637,8 @@ int main()
 							name == "Track usage of a bool feature" ||
 							name == "Deactivate license" ||
 							name == "Refresh activation lease" ||
-							name == "Pull activation state from the server"))
+							name == "Pull activation state from the server" ||
+							name == "Export feature keys (for the feature key generator)"))
 					{
 						continue;
 					}
@@ -234,15 +652,15 @@ int main()
 
 					filteredActions.push_back(actionMapping->actions[i]);
 					filteredActionNames.push_back(name);
-					std::cout << filteredActionNames.size() << ". " << name << std::endl;
+					std::cout << filteredActionNames.size() << ". " << name << '\n';
 				}
 			}
 			else
 			{
-				std::cout << "No specific actions available for current state." << std::endl;
+				std::cout << "No specific actions available for current state." << '\n';
 			}
 
-			std::cout << "0. Quit" << std::endl;
+			std::cout << "0. Quit" << '\n';
 
 			std::string selectedActionStr;
 			std::cout << "Enter your choice: ";
@@ -253,6 +671,12 @@ int main()
 
 			if (normalizedInput == "0" || normalizedInput == "quit" || normalizedInput == "q")
 			{
+				if (pendingInitialize && !initializeAbandoned)
+				{
+					// Exit must not wait for a server that does not answer
+					LicensingCall::Abandoned().add(LicensingCall::Operations::Initialize, *pendingInitialize);
+				}
+				pendingInitialize.reset();
 				quit = true;
 				continue;
 			}
@@ -260,7 +684,7 @@ int main()
 			size_t selectedAction = 0;
 			if (!InputHelper::TryParseSizeT(trimmedInput, selectedAction) || selectedAction == 0)
 			{
-				std::cout << "Invalid selection. Please try again." << std::endl;
+				std::cout << "Invalid selection. Please try again." << '\n';
 				continue;
 			}
 
@@ -268,15 +692,59 @@ int main()
 
 			if (selectedAction < filteredActions.size())
 			{
-				std::cout << "\nExecuting: " << filteredActionNames[selectedAction] << std::endl;
-				filteredActions[selectedAction](*activation, config.ApiUrl);
+				if (pendingInitialize)
+				{
+					if (!initializeAbandoned)
+					{
+						Log::Information(Log::Categories::Console, "Waiting for the background initialization to finish...");
+					}
+					finishInitialize();
+					if (pendingInitialize)
+					{
+						std::cout << "The initialization is still running in the background, the persisted state is shown until it finished."
+							<< " Please try again later." << '\n';
+						continue;
+					}
+					if (snapshots->current()->state != state)
+					{
+						std::cout << "The activation state changed to " << snapshots->current()->stateName
+							<< " during initialization, please choose again." << '\n';
+						continue;
+					}
+				}
+
+				std::cout << "\nExecuting: " << filteredActionNames[selectedAction] << '\n';
+				LicensingCall::BudgetScope budget;
+				AllocationTracking::Scope memory(filteredActionNames[selectedAction]);
+				{
+					// Released by the action while it prompts for input
+					ActivationActions::ActionLock activationLock(activationMutex);
+					filteredActions[selectedAction](*activation, config.ApiUrl);
+					snapshots->refresh();
+				}
+				if (sharedActivation)
+				{
+					sharedActivation->publish();
+				}
 			}
 			else
 			{
-				std::cout << "Invalid selection. Please try again." << std::endl;
+				std::cout << "Invalid selection. Please try again." << '\n';
 			}
 		}
 		});
 
+	ShutdownHooks::RunAll();
+
+	if (coalescer)
+	{
+		coalescer->report(std::cout);
+	}
+	if (LicensingCall::Limiter().limited())
+	{
+		LicensingCall::Limiter().report(std::cout);
+	}
+	AllocationTracking::Report(std::cout);
+
 	return EXIT_SUCCESS;
 }